@@ -0,0 +1,530 @@
+/*
+  Copyright (c) 2005-2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or
+  without modification, are permitted provided that the
+  following conditions are met:
+
+  1. Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the
+     following disclaimer.
+  2. Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the
+     following disclaimer in the documentation and/or other
+     materials provided with the distribution.
+  3. Neither the name of authors nor the names of its
+     contributors may be used to endorse or promote products
+     derived from this software without specific prior written
+     permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+  CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+  INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  The shared agent: one uim-el-agent process serving every Emacs of the
+  user through a Unix domain socket.  Emacs still starts uim-el-agent,
+  but with -s it only relays stdin/stdout to the shared agent, which is
+  started on demand with -S.  Context ids are looked up in a namespace
+  per connection.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/param.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <uim/uim.h>
+#include <uim/uim-util.h>
+#include <uim/uim-helper.h>
+
+#include "agent-server.h"
+
+#define AGENT_SOCKET_NAME "uim-el-agent"
+#define READ_BUFFER_SIZE 1024
+#define MAX_LINE_SIZE 65536
+#define CONNECT_RETRY_COUNT 10
+#define CONNECT_RETRY_INTERVAL 100000 /* usec */
+/* a client that lets this much output pile up is considered stuck */
+#define MAX_OUTPUT_SIZE (1024 * 1024)
+
+typedef struct agent_client {
+  int fd;
+  int id;
+  output_buffer out;
+  char *buf;
+  size_t len;
+  size_t size;
+  /* what the globals current and focused are while serving the client */
+  uim_agent_context *current;
+  int focused;
+} agent_client;
+
+static agent_client **clients = NULL;
+static int nr_clients = 0;
+static int nr_client_slots = 0;
+static int last_client_id = 0;
+
+
+/* the socket lives next to the one of uim-helper-server */
+static int
+get_socket_path(char *path, int len)
+{
+  char *p;
+
+  if (!uim_helper_get_pathname(path, len))
+	return -1;
+
+  if ((p = strrchr(path, '/')) == NULL)
+	return -1;
+  *(p + 1) = '\0';
+
+  if (strlcat(path, AGENT_SOCKET_NAME, len) >= (size_t)len)
+	return -1;
+
+  return 0;
+}
+
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+	if ((n = write(fd, buf, len)) < 0) {
+	  if (errno == EINTR)
+		continue;
+	  return -1;
+	}
+	buf += n;
+	len -= n;
+  }
+
+  return 0;
+}
+
+
+/*
+ * The running agent holds a lock next to its socket until it exits.  An
+ * agent that can't take it leaves the socket to its owner, and one that
+ * can knows that the socket, if any, was left by an agent that died.
+ */
+static int
+lock_socket_path(const char *path)
+{
+  char lock_path[MAXPATHLEN];
+  struct flock fl;
+  int fd;
+
+  if (strlcpy(lock_path, path, sizeof(lock_path)) >= sizeof(lock_path)
+	  || strlcat(lock_path, ".lock", sizeof(lock_path)) >= sizeof(lock_path))
+	return -1;
+
+  if ((fd = open(lock_path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) < 0)
+	return -1;
+
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  if (fcntl(fd, F_SETLK, &fl) < 0) {
+	close(fd);
+	return -1;
+  }
+
+  return fd;
+}
+
+
+int
+agent_server_init(void)
+{
+  struct sockaddr_un server;
+  char path[MAXPATHLEN];
+  int fd, lock_fd;
+
+  if (get_socket_path(path, sizeof(path)) < 0) {
+	debug_printf(DEBUG_ERROR, "failed to get socket path\n");
+	return -1;
+  }
+
+  /* another agent got here first; the relay will connect to it */
+  if ((lock_fd = lock_socket_path(path)) < 0) {
+	debug_printf(DEBUG_NOTE, "shared agent already running\n");
+	return -1;
+  }
+
+  unlink(path);
+
+  if ((fd = socket(PF_UNIX, SOCK_STREAM, 0)) < 0) {
+	debug_printf(DEBUG_ERROR, "socket: %s\n", strerror(errno));
+	close(lock_fd);
+	return -1;
+  }
+  fchmod(fd, S_IRUSR | S_IWUSR);
+
+  memset(&server, 0, sizeof(server));
+  server.sun_family = PF_UNIX;
+  strlcpy(server.sun_path, path, sizeof(server.sun_path));
+
+  if (bind(fd, (struct sockaddr *)&server, sizeof(server)) < 0
+	  || listen(fd, 5) < 0) {
+	debug_printf(DEBUG_ERROR, "bind/listen: %s\n", strerror(errno));
+	close(fd);
+	close(lock_fd);
+	return -1;
+  }
+  /* lock_fd stays open, and the lock held, for the rest of our life */
+
+  /* don't get the signals sent to the Emacs which started us */
+  setsid();
+  signal(SIGPIPE, SIG_IGN);
+
+  /* tell the relay that we are ready */
+  printf("\n");
+  fflush(stdout);
+  freopen("/dev/null", "r", stdin);
+  freopen("/dev/null", "w", stdout);
+
+  return fd;
+}
+
+
+/* make the client's state that of the agent while serving it */
+static void
+enter_client(agent_client *cl)
+{
+  agent_client_id = cl->id;
+  a_set_output(&cl->out);
+  current = cl->current;
+  focused = cl->focused;
+}
+
+static void
+leave_client(agent_client *cl)
+{
+  cl->current = current;
+  cl->focused = focused;
+  current = NULL;
+  focused = 0;
+  a_set_output(NULL);
+  agent_client_id = 0;
+}
+
+
+/*
+ * write as much of the queued output as the client takes now
+ * @return -1 if the client is gone
+ */
+static int
+flush_client(agent_client *cl)
+{
+  ssize_t n;
+  size_t done = 0;
+
+  while (done < cl->out.len) {
+	n = write(cl->fd, cl->out.str + done, cl->out.len - done);
+	if (n < 0) {
+	  if (errno == EINTR)
+		continue;
+	  if (errno == EAGAIN || errno == EWOULDBLOCK)
+		break;
+	  return -1;
+	}
+	done += n;
+  }
+
+  cl->out.len -= done;
+  memmove(cl->out.str, cl->out.str + done, cl->out.len);
+
+  return 0;
+}
+
+
+static void
+accept_client(int server_fd)
+{
+  agent_client *cl;
+  int fd, flag;
+
+  if ((fd = accept(server_fd, NULL, NULL)) < 0) {
+	debug_printf(DEBUG_WARNING, "accept: %s\n", strerror(errno));
+	return;
+  }
+
+  if (uim_helper_check_connection_fd(fd)
+	  || (flag = fcntl(fd, F_GETFL)) < 0
+	  || fcntl(fd, F_SETFL, flag | O_NONBLOCK) < 0) {
+	close(fd);
+	return;
+  }
+
+  if (nr_clients == nr_client_slots) {
+	nr_client_slots = nr_client_slots ? nr_client_slots * 2 : 8;
+	clients = uim_realloc(clients, sizeof(agent_client *) * nr_client_slots);
+  }
+
+  cl = uim_malloc(sizeof(agent_client));
+  cl->fd = fd;
+  cl->id = ++last_client_id;
+  cl->out.str = NULL;
+  cl->out.len = cl->out.size = 0;
+  cl->size = READ_BUFFER_SIZE * 2;
+  cl->buf = uim_malloc(cl->size);
+  cl->len = 0;
+  cl->current = NULL;
+  cl->focused = 0;
+  clients[nr_clients++] = cl;
+
+  debug_printf(DEBUG_NOTE, "client %d connected\n", cl->id);
+
+  enter_client(cl);
+  a_printf("OK\n");
+  leave_client(cl);
+  flush_client(cl);
+}
+
+
+static void
+close_client(int i)
+{
+  agent_client *cl = clients[i];
+
+  debug_printf(DEBUG_NOTE, "client %d disconnected\n", cl->id);
+
+  enter_client(cl);
+  release_uim_agent_client(cl->id);
+  leave_client(cl);
+
+  close(cl->fd);
+  free(cl->out.str);
+  free(cl->buf);
+  free(cl);
+
+  clients[i] = clients[--nr_clients];
+}
+
+
+/*
+ * read from the client and process every complete line
+ * @return -1 if the client should be closed
+ */
+static int
+read_client(agent_client *cl, int (*handler)(char *line))
+{
+  char *start, *end, *eol, saved;
+  ssize_t n;
+  int ret = 0;
+
+  if (cl->size - cl->len < READ_BUFFER_SIZE + 1) {
+	if (cl->size >= MAX_LINE_SIZE) {
+	  debug_printf(DEBUG_WARNING, "client %d: line too long\n", cl->id);
+	  return -1;
+	}
+	cl->size *= 2;
+	cl->buf = uim_realloc(cl->buf, cl->size);
+  }
+
+  n = read(cl->fd, cl->buf + cl->len, cl->size - cl->len - 1);
+  if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+	return 0;
+  if (n <= 0)
+	return -1;
+  cl->len += n;
+
+  enter_client(cl);
+
+  start = cl->buf;
+  end = cl->buf + cl->len;
+  while ((eol = memchr(start, '\n', end - start)) != NULL) {
+	/* the command parser wants a string ending with '\n' */
+	saved = *(eol + 1);
+	*(eol + 1) = '\0';
+	if (!handler(start)) {
+	  ret = -1;
+	  break;
+	}
+	*(eol + 1) = saved;
+	start = eol + 1;
+  }
+
+  leave_client(cl);
+
+  cl->len = end - start;
+  memmove(cl->buf, start, cl->len);
+
+  if (ret == 0 && flush_client(cl) < 0)
+	ret = -1;
+  if (cl->out.len > MAX_OUTPUT_SIZE) {
+	debug_printf(DEBUG_WARNING, "client %d: not reading its output\n",
+				 cl->id);
+	ret = -1;
+  }
+
+  return ret;
+}
+
+
+void
+agent_server_run(int server_fd, int (*handler)(char *line))
+{
+  fd_set rfds, wfds;
+  int i, fdmax;
+
+  while (1) {
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_SET(server_fd, &rfds);
+	fdmax = server_fd;
+	for (i = 0; i < nr_clients; i++) {
+	  FD_SET(clients[i]->fd, &rfds);
+	  if (clients[i]->out.len > 0)
+		FD_SET(clients[i]->fd, &wfds);
+	  if (clients[i]->fd > fdmax)
+		fdmax = clients[i]->fd;
+	}
+
+	if (select(fdmax + 1, &rfds, &wfds, NULL, NULL) < 0) {
+	  if (errno == EINTR)
+		continue;
+	  debug_printf(DEBUG_ERROR, "select: %s\n", strerror(errno));
+	  return;
+	}
+
+	if (FD_ISSET(server_fd, &rfds))
+	  accept_client(server_fd);
+
+	for (i = 0; i < nr_clients; ) {
+	  if ((FD_ISSET(clients[i]->fd, &wfds) && flush_client(clients[i]) < 0)
+		  || (FD_ISSET(clients[i]->fd, &rfds)
+			  && read_client(clients[i], handler) < 0)) {
+		close_client(i);
+		/* like uim-helper-server, quit when nobody uses us */
+		if (nr_clients == 0)
+		  return;
+		continue;
+	  }
+	  i++;
+	}
+  }
+}
+
+
+/* connect to the shared agent, starting it if it isn't running */
+static int
+connect_server(const char *command)
+{
+  struct sockaddr_un server;
+  char path[MAXPATHLEN], buf[128];
+  FILE *serv_r = NULL, *serv_w = NULL;
+  int fd, i;
+
+  if (get_socket_path(path, sizeof(path)) < 0)
+	return -1;
+
+  memset(&server, 0, sizeof(server));
+  server.sun_family = PF_UNIX;
+  strlcpy(server.sun_path, path, sizeof(server.sun_path));
+
+  if ((fd = socket(PF_UNIX, SOCK_STREAM, 0)) < 0)
+	return -1;
+
+  if (connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+	if (uim_ipc_open_command_with_option(0, &serv_r, &serv_w,
+										 command, "-S") == 0)
+	  goto error;
+
+	while (fgets(buf, sizeof(buf), serv_r) != NULL) {
+	  if (strcmp(buf, "\n") == 0)
+		break;
+	}
+	fclose(serv_r);
+	fclose(serv_w);
+
+	/* the agent owning the socket may be just about to listen */
+	for (i = 0; connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0;
+		 i++) {
+	  if (i == CONNECT_RETRY_COUNT)
+		goto error;
+	  usleep(CONNECT_RETRY_INTERVAL);
+	}
+  }
+
+  if (uim_helper_check_connection_fd(fd))
+	goto error;
+
+  return fd;
+
+ error:
+  close(fd);
+  return -1;
+}
+
+
+/* pass data between Emacs and the shared agent until either side closes */
+int
+agent_server_relay(const char *command)
+{
+  fd_set rfds;
+  char buf[READ_BUFFER_SIZE];
+  ssize_t n;
+  int fd;
+
+  if ((fd = connect_server(command)) < 0) {
+	debug_printf(DEBUG_ERROR, "can't connect to the shared agent\n");
+	return -1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  while (1) {
+	FD_ZERO(&rfds);
+	FD_SET(STDIN_FILENO, &rfds);
+	FD_SET(fd, &rfds);
+
+	if (select(fd + 1, &rfds, NULL, NULL, NULL) < 0) {
+	  if (errno == EINTR)
+		continue;
+	  break;
+	}
+
+	if (FD_ISSET(STDIN_FILENO, &rfds)) {
+	  if ((n = read(STDIN_FILENO, buf, sizeof(buf))) < 0 && errno == EINTR)
+		continue;
+	  if (n <= 0 || write_all(fd, buf, n) < 0)
+		break;
+	}
+
+	if (FD_ISSET(fd, &rfds)) {
+	  if ((n = read(fd, buf, sizeof(buf))) < 0 && errno == EINTR)
+		continue;
+	  if (n <= 0 || write_all(STDOUT_FILENO, buf, n) < 0)
+		break;
+	}
+  }
+
+  close(fd);
+  return 0;
+}
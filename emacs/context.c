@@ -45,6 +45,94 @@ int focused = 0;
 uim_agent_context_list *agent_context_list_head = NULL;
 uim_agent_context_list *agent_context_list_tail = NULL;
 
+int agent_client_id = 0;
+
+/* (client id, context id) -> context */
+#define CONTEXT_HASH_INITIAL_SIZE 64
+static uim_agent_context_list **context_hash = NULL;
+static unsigned context_hash_size = 0;
+static unsigned context_hash_count = 0;
+
+static unsigned
+context_hash_index(int client_id, int id)
+{
+  return ((unsigned)client_id * 31 + (unsigned)id) & (context_hash_size - 1);
+}
+
+static void
+context_hash_grow(void)
+{
+  uim_agent_context_list **old = context_hash, *ptr, *next;
+  unsigned i, old_size = context_hash_size;
+  unsigned idx;
+
+  context_hash_size = old_size ? old_size * 2 : CONTEXT_HASH_INITIAL_SIZE;
+  context_hash = uim_malloc(sizeof(uim_agent_context_list *)
+							* context_hash_size);
+  for (i = 0; i < context_hash_size; i++)
+	context_hash[i] = NULL;
+
+  for (i = 0; i < old_size; i++) {
+	for (ptr = old[i]; ptr != NULL; ptr = next) {
+	  next = ptr->hash_next;
+	  idx = context_hash_index(ptr->agent_context->client_id,
+							   ptr->agent_context->context_id);
+	  ptr->hash_next = context_hash[idx];
+	  context_hash[idx] = ptr;
+	}
+  }
+  free(old);
+}
+
+static void
+context_hash_insert(uim_agent_context_list *ptr)
+{
+  unsigned idx;
+
+  if (context_hash_count >= context_hash_size)
+	context_hash_grow();
+
+  idx = context_hash_index(ptr->agent_context->client_id,
+						   ptr->agent_context->context_id);
+  ptr->hash_next = context_hash[idx];
+  context_hash[idx] = ptr;
+  context_hash_count++;
+}
+
+static void
+context_hash_remove(uim_agent_context_list *ptr)
+{
+  uim_agent_context_list **p;
+
+  p = &context_hash[context_hash_index(ptr->agent_context->client_id,
+									   ptr->agent_context->context_id)];
+  for (; *p != NULL; p = &(*p)->hash_next) {
+	if (*p == ptr) {
+	  *p = ptr->hash_next;
+	  context_hash_count--;
+	  return;
+	}
+  }
+}
+
+static uim_agent_context_list *
+context_hash_lookup(int client_id, int id)
+{
+  uim_agent_context_list *ptr;
+
+  if (context_hash == NULL)
+	return NULL;
+
+  for (ptr = context_hash[context_hash_index(client_id, id)]; ptr != NULL;
+	   ptr = ptr->hash_next) {
+	if (ptr->agent_context->context_id == id
+		&& ptr->agent_context->client_id == client_id)
+	  return ptr;
+  }
+
+  return NULL;
+}
+
 static void
 update_context_im(uim_agent_context *ua)
 {
@@ -82,12 +170,9 @@ get_uim_agent_context(int id)
 
   debug_printf(DEBUG_NOTE, "get_uim_agent_context (%d)\n", id);
   
-  for (ptr = agent_context_list_head; ptr != NULL; ptr = ptr->next) {
-	if (ptr->agent_context->context_id == id)
-	  return ptr->agent_context;
-  }
+  ptr = context_hash_lookup(agent_client_id, id);
 
-  return NULL;
+  return ptr ? ptr->agent_context : NULL;
 }
 
 
@@ -159,8 +244,10 @@ switch_context_im_all(const char *im)
 						   "custom-preserved-default-im-name",
 						   quot_im_name);
 
+  /* other clients of the shared agent hear of the change by themselves */
   for (ptr = agent_context_list_head; ptr != NULL; ptr = ptr->next) {
-	switch_context_im(ptr->agent_context, im);
+	if (ptr->agent_context->client_id == agent_client_id)
+	  switch_context_im(ptr->agent_context, im);
   }
 
   free(quot_im_name);
@@ -262,6 +349,9 @@ new_uim_agent_context(int id, const char *encoding)
   ptr->prev = NULL;
 
   ptr->agent_context->context_id = id;
+  ptr->agent_context->client_id = agent_client_id;
+
+  context_hash_insert(ptr);
 
   if (agent_context_list_tail != NULL) {
 	agent_context_list_tail->next = ptr;
@@ -277,58 +367,79 @@ new_uim_agent_context(int id, const char *encoding)
 }
 
 
+static void
+free_uim_agent_context_list(uim_agent_context_list *ptr)
+{
+  uim_agent_context *ua = ptr->agent_context;
+
+  /* clear current */
+  if (current == ua) {
+	clear_current_uim_agent_context();
+	current = NULL;
+  }
+
+  /* release */
+  uim_release_context(ua->context);
+
+  /* clear candidate */
+  clear_candidate(ua->cand);
+  free(ua->cand);
+
+  /* clear preedit */
+  clear_preedit(ua->pe);
+  free(ua->pe);
+
+  /* free others */
+  free(ua->encoding);
+  free(ua->im);
+  free(ua->prop->list);
+  free(ua->prop);
+  free(ua->comstr);
+
+  /* rebuild list */
+  context_hash_remove(ptr);
+
+  if (ptr->next != NULL)
+	ptr->next->prev = ptr->prev;
+  else
+	agent_context_list_tail = ptr->prev;
+
+  if (ptr->prev != NULL)
+	ptr->prev->next = ptr->next;
+  else
+	agent_context_list_head = ptr->next;
+
+  free(ua);
+  free(ptr);
+}
+
+
 /* release context from context list */
 int
 release_uim_agent_context(int context_id)
 {
   uim_agent_context_list *ptr;
-  
-  for (ptr = agent_context_list_head; ptr != NULL; ptr = ptr->next) {
-	if (ptr->agent_context->context_id == context_id) {
-
-	  uim_agent_context *ua = ptr->agent_context;
-
-	  /* clear current */
-	  if (current == ua)
-		clear_current_uim_agent_context();
-	  
-	  /* release */
-	  uim_release_context(ua->context);
-
-	  /* clear candidate */
-	  clear_candidate(ua->cand);
-	  free(ua->cand);
-
-	  /* clear preedit */
-	  clear_preedit(ua->pe);
-	  free(ua->pe);
-
-	  /* free others */
-	  free(ua->encoding);
-	  free(ua->im);
-	  free(ua->prop->list);
-	  free(ua->prop);
-	  free(ua->comstr);
-
-	  /* rebuild list */
-	  if (ptr->next != NULL)
-		ptr->next->prev = ptr->prev;
-	  else
-		agent_context_list_tail = ptr->prev;
-
-	  if (ptr->prev != NULL)
-		ptr->prev->next = ptr->next;
-	  else
-		agent_context_list_head = ptr->next;
-
-	  free(ua);
-	  free(ptr);
-
-	  return context_id;
-	}
-  }
 
-  return -1;
+  if ((ptr = context_hash_lookup(agent_client_id, context_id)) == NULL)
+	return -1;
+
+  free_uim_agent_context_list(ptr);
+
+  return context_id;
+}
+
+
+/* release all contexts of a client of the shared agent */
+void
+release_uim_agent_client(int client_id)
+{
+  uim_agent_context_list *ptr, *next;
+
+  for (ptr = agent_context_list_head; ptr != NULL; ptr = next) {
+	next = ptr->next;
+	if (ptr->agent_context->client_id == client_id)
+	  free_uim_agent_context_list(ptr);
+  }
 }
 
 
@@ -61,6 +61,7 @@ uim_context create_context(const char *encoding, uim_agent_context *ptr);
 uim_agent_context *create_uim_agent_context(const char *encoding);
 uim_agent_context *new_uim_agent_context(int id, const char *encoding);
 int release_uim_agent_context(int id);
+void release_uim_agent_client(int client_id);
 
 uim_agent_context *get_uim_agent_context(int id);
 
@@ -82,6 +83,9 @@ int show_im_uim_agent_context(uim_agent_context *ua);
 extern uim_agent_context *current;
 extern int focused;
 
+/* client whose context ids are looked up */
+extern int agent_client_id;
+
 extern uim_agent_context_list *agent_context_list_head;
 extern uim_agent_context_list *agent_context_list_tail;
 
@@ -43,15 +43,21 @@ helper_send_im_list(void)
   int buflen;
   char *buf;
   const char *current_im_name;
-  uim_agent_context *ua;
+  uim_agent_context *ua = NULL;
+  uim_agent_context_list *ptr;
   int dummy_agent_context = 0;
 
   debug_printf(DEBUG_NOTE, "helper_send_im_list\n");
 
-  /* Use 1st context */
-  if (agent_context_list_head) {
-	ua = agent_context_list_head->agent_context;
-  } else {
+  /* Use 1st context of the client */
+  for (ptr = agent_context_list_head; ptr != NULL; ptr = ptr->next) {
+	if (ptr->agent_context->client_id == agent_client_id) {
+	  ua = ptr->agent_context;
+	  break;
+	}
+  }
+
+  if (ua == NULL) {
 	dummy_agent_context = 1;
 	ua = new_uim_agent_context(1, NULL);
   }
@@ -241,7 +247,8 @@ helper_handler(uim_agent_context *ua, char *helper_message)
 		*p = '\0';
 		val = p + 1;
 		  for (ptr = agent_context_list_head; ptr != NULL; ptr = ptr->next) {
-			uim_prop_update_custom(ptr->agent_context->context, custom, val);
+			if (ptr->agent_context->client_id == agent_client_id)
+			  uim_prop_update_custom(ptr->agent_context->context, custom, val);
 		  }
 		}
 	  }
@@ -36,26 +36,74 @@
 
 #include "output.h"
 
-#if 0
+/* stdout unless the shared agent is answering one of its clients */
+static output_buffer *output = NULL;
+
+/* the shared agent never blocks on a client, so its output is queued */
+void
+a_set_output(output_buffer *ob)
+{
+  output = ob;
+}
+
+static void
+output_reserve(size_t len)
+{
+  if (output->size - output->len < len + 1) {
+	while (output->size - output->len < len + 1)
+	  output->size = output->size ? output->size * 2 : 1024;
+	output->str = uim_realloc(output->str, output->size);
+  }
+}
+
 int
-a_putchar(const int c)
+a_putchar(int c)
 {
+  if (!output)
 	return putchar(c);
+
+  output_reserve(1);
+  output->str[output->len++] = (char)c;
+
+  return c;
 }
 
 int
 a_printf(const char *fmt, ...)
 {
   int ret = 0;
-	va_list ap;
+  va_list ap;
+
+  if (!output) {
+	va_start(ap, fmt);
+	ret = vprintf(fmt, ap);
+	va_end(ap);
+	return ret;
+  }
+
+  output_reserve(0);
+  va_start(ap, fmt);
+  ret = vsnprintf(output->str + output->len,
+				  output->size - output->len, fmt, ap);
+  va_end(ap);
 
+  if (ret >= 0 && (size_t)ret >= output->size - output->len) {
+	output_reserve(ret);
 	va_start(ap, fmt);
-	ret = vfprintf(stdout, fmt, ap);
-	va_end(ap);  
+	vsnprintf(output->str + output->len, output->size - output->len, fmt, ap);
+	va_end(ap);
+  }
+  if (ret > 0)
+	output->len += ret;
 
   return ret;
 }
-#endif
+
+int
+a_flush(void)
+{
+  return output ? 0 : fflush(stdout);
+}
 
 
 void
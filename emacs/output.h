@@ -43,10 +43,20 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include <uim/uim.h>
+
 #include "debug.h"
 
-#define a_printf printf
-#define a_putchar putchar
+typedef struct output_buffer {
+  char *str;
+  size_t len;
+  size_t size;
+} output_buffer;
+
+int a_printf(const char *fmt, ...);
+int a_putchar(int c);
+int a_flush(void);
+void a_set_output(output_buffer *ob);
 
 void output_with_escape(const char *str);
 
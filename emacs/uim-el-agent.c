@@ -547,7 +547,8 @@ process_keyvector(int serial, int cid, uim_key ukey, const char *keyname)
 
   if (! focused ||
 	  current == NULL || 
-	  (current != NULL && current->context_id != cid)) {
+	  (current != NULL && (current->context_id != cid
+						   || current->client_id != agent_client_id))) {
 
 	if (set_current_uim_agent_context(get_uim_agent_context(cid)) < 0) {
 	  debug_printf(DEBUG_WARNING, "context %d not found\n", cid);
@@ -625,150 +626,184 @@ cleanup(void)
 }
 
 
-int
-main(int argc, char *argv[])
+/*
+  process one line of input
+
+  command format 
+    serial CID COMMAND OPTION
+
+  key format
+    serial CID [keyvector]
+
+  returns 0 on QUIT
+*/
+static int
+process_line(char *buf)
 {
-  int opt;
+  int cid, serial;
+  char *p1, *p2, *c;
+  char keyname[32];
+  uim_key ukey;
 
-  setlocale(LC_CTYPE, "");
+  p1 = buf;
+  serial = -1;
 
-  while ((opt = getopt(argc, argv, "d")) != -1) {
-	switch (opt) {
-	case 'd':
-	  debug_level ++;
-	  break;
-	}
+  if ((p2 = strchr(p1, ' ')) == NULL) {
+	debug_printf(DEBUG_WARNING, "input error: space after 1st string\n");
+	goto ERROR;
   }
 
-  if (debug_level == 0) fclose(stderr);
+  /* 1st string must be digit */
+  *p2 = '\0';
+  serial = strtol(p1, &c, 10);
+  if (c != p2) {
+	debug_printf(DEBUG_WARNING, "input error: invalid serial %d\n", serial);
+	goto ERROR;
+  }
 
-  if (uim_init() < 0) {
-	debug_printf(DEBUG_ERROR, "uim_init failed\n");
-	return -1;
+  p1 = p2 + 1;
+  if ((p2 = strchr(p1, ' ')) == NULL) {
+	debug_printf(DEBUG_WARNING, "input error: no space after 2nd string\n");
+	goto ERROR;
   }
 
-  atexit(cleanup);
+  /* 2nd string must be digit */
+  *p2 = '\0';
+  cid = strtol(p1, &c, 10);
+  if (c != p2) {
+	debug_printf(DEBUG_WARNING, "invalid cid %d\n", cid);
+	goto ERROR;
+  }
 
+  /* 3rd string */
+  p1 = p2 + 1;
 
-  a_printf("OK\n");
+  if (*p1 == '[') {
+	/* keyvector if 3rd string starts with [  */
 
-  while (1) {
-	int cid, serial;
-	char *p1, *p2, *c;
-	char buf[2048], keyname[32];
-	uim_key ukey;
+	if ((p2 = strchr(p1, ']')) == NULL) {
+	  /* no corresponding ]  */
+	  debug_printf(DEBUG_WARNING, "']' not found\n");
+	  goto ERROR;
+	}
 
-	fflush(stdout);
+	p2 ++; 
+	if (*p2 == ']') p2 ++; /* for [X-]] */
+	*p2 = '\0';   /* replace character after ] with \0  */
+
+	ukey.mod = 0;
+	ukey.key = -1;
+	keyname[0] = '\0';
 
-	if (fgets(buf, sizeof (buf), stdin) == NULL) {
-	  if (feof(stdin))
-	    debug_printf(DEBUG_NOTE, "unexpected EOF\n");
-	  else
-	    debug_printf(DEBUG_ERROR, "failed to read command: %s\n",
-			 strerror (errno));
-	  goto QUIT;
-	}
 
-	p1 = buf;
-	serial = -1;
+	if (analyze_keyvector(p1, &ukey, keyname, sizeof(keyname)) > 0) {
 
-	/*
-	  command format 
-	    serial CID COMMAND OPTION
+	  a_printf("( %d %d ", serial, cid);
+	  if (process_keyvector(serial, cid, ukey, keyname) < 0)
+		a_printf(" ( f ) ");
+	  else
+		a_printf(" ( a ) ");
 
-	  key format
-	    serial CID [keyvector]
-	*/
+	  a_printf(" )\n");
+	  a_flush();
 
-	if ((p2 = strchr(p1, ' ')) == NULL) {
-	  debug_printf(DEBUG_WARNING, "input error: space after 1st string\n");
-	  goto ERROR;
+	  return 1;
 	}
 
-	/* 1st string must be digit */
-	*p2 = '\0';
-	serial = strtol(p1, &c, 10);
-	if (c != p2) {
-	  debug_printf(DEBUG_WARNING, "input error: invalid serial %d\n", serial);
-	  goto ERROR;
-	}
+	goto ERROR;
 
-	p1 = p2 + 1;
-	if ((p2 = strchr(p1, ' ')) == NULL) {
-	  debug_printf(DEBUG_WARNING, "input error: no space after 2nd string\n");
-	  goto ERROR;
-	}
 
-	/* 2nd string must be digit */
-	*p2 = '\0';
-	cid = strtol(p1, &c, 10);
-	if (c != p2) {
-	  debug_printf(DEBUG_WARNING, "invalid cid %d\n", cid);
-	  goto ERROR;
+  } else if (*p1 >= 'A' && *p1 <= 'Z') {
+	/* command */
+
+	if (strncmp(p1, "QUIT", 4) == 0) return 0;
+
+	a_printf("( %d %d ", serial, cid);
+	if (process_command(serial, cid, p1) < 0) {
+	  debug_printf(DEBUG_WARNING, "command error\n");
+	  a_printf(" ( f ) ");   /* command error */
+	} else {
+	  a_printf(" ( a ) ");   /* command ok */
 	}
 
-	/* 3rd string */
-	p1 = p2 + 1;
+	a_printf(" )\n");
+	a_flush();
 
-	if (*p1 == '[') {
-	  /* keyvector if 3rd string starts with [  */
+	return 1;
+  }
+  
+  debug_printf(DEBUG_WARNING, "invalid input\n");
+	
+ ERROR:
+  a_printf("( %d 0 ( x ) )\n", serial);
+  a_flush();
 
-	  if ((p2 = strchr(p1, ']')) == NULL) {
-		/* no corresponding ]  */
-		debug_printf(DEBUG_WARNING, "']' not found\n");
-		goto ERROR;
-	  }
+  return 1;
+}
 
-	  p2 ++; 
-	  if (*p2 == ']') p2 ++; /* for [X-]] */
-	  *p2 = '\0';   /* replace character after ] with \0  */
 
-	  ukey.mod = 0;
-	  ukey.key = -1;
-	  keyname[0] = '\0';
+int
+main(int argc, char *argv[])
+{
+  int opt;
+  int shared = 0, server = 0, server_fd = -1;
 
+  setlocale(LC_CTYPE, "");
 
-	  if (analyze_keyvector(p1, &ukey, keyname, sizeof(keyname)) > 0) {
+  while ((opt = getopt(argc, argv, "dsS")) != -1) {
+	switch (opt) {
+	case 'd':
+	  debug_level ++;
+	  break;
+	case 's':
+	  /* relay to the shared agent */
+	  shared = 1;
+	  break;
+	case 'S':
+	  /* run as the shared agent */
+	  server = 1;
+	  break;
+	}
+  }
 
-	  	a_printf("( %d %d ", serial, cid);
-		if (process_keyvector(serial, cid, ukey, keyname) < 0)
-		  a_printf(" ( f ) ");
-		else
-		  a_printf(" ( a ) ");
+  if (debug_level == 0) fclose(stderr);
 
-		a_printf(" )\n");
-		fflush(stdout);
+  if (shared)
+	return agent_server_relay(argv[0]);
 
-		continue;
-	  }
+  if (server && (server_fd = agent_server_init()) < 0)
+	return -1;
 
-	  goto ERROR;
+  if (uim_init() < 0) {
+	debug_printf(DEBUG_ERROR, "uim_init failed\n");
+	return -1;
+  }
 
+  atexit(cleanup);
 
-	} else if (*p1 >= 'A' && *p1 <= 'Z') {
-	  /* command */
+  if (server) {
+	agent_server_run(server_fd, process_line);
+	return 0;
+  }
 
-	  if (strncmp(p1, "QUIT", 4) == 0) goto QUIT;
+  a_printf("OK\n");
 
-	  a_printf("( %d %d ", serial, cid);
-	  if (process_command(serial, cid, p1) < 0) {
-		debug_printf(DEBUG_WARNING, "command error\n");
-		a_printf(" ( f ) ");   /* command error */
-	  } else {
-		a_printf(" ( a ) ");   /* command ok */
-	  }
+  while (1) {
+	char buf[2048];
 
-	  a_printf(" )\n");
-	  fflush(stdout);
+	a_flush();
 
-	  continue;
+	if (fgets(buf, sizeof (buf), stdin) == NULL) {
+	  if (feof(stdin))
+	    debug_printf(DEBUG_NOTE, "unexpected EOF\n");
+	  else
+	    debug_printf(DEBUG_ERROR, "failed to read command: %s\n",
+			 strerror (errno));
+	  goto QUIT;
 	}
-  
-	debug_printf(DEBUG_WARNING, "invalid input\n");
-	
-  ERROR:
-	a_printf("( %d 0 ( x ) )\n", serial);
-	fflush(stdout);
+
+	if (!process_line(buf))
+	  goto QUIT;
   }
 
  QUIT:
@@ -776,4 +811,3 @@ main(int argc, char *argv[])
   uim_quit();
   return 0;
 }
-
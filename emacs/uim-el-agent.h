@@ -51,6 +51,7 @@
 #include "helper.h"
 #include "callback.h"
 #include "prop.h"
+#include "agent-server.h"
 
 static int cmd_release(int context_id);
 static int cmd_helper(int context_id, char *message);
@@ -75,6 +76,7 @@ static int process_command(int serial, int cid, char *cmd);
 static int process_keyvector(int serial, int cid,
 							 uim_key ukey, const char *keyname);
 static int analyze_keyvector(char *vector, uim_key *ukey, char *keyname, size_t keyname_len);
+static int process_line(char *buf);
 
 void cleanup(void);
 
@@ -182,6 +182,22 @@ process_message(char *msg)
 		}
 	  }
 
+	} else if (strcmp("custom_update_batch", msg) == 0) {
+
+	  /* uim.el takes one custom per line */
+	  char *val, *custom = eol + 1;
+
+	  while ((eol = strchr(custom, '\n')) != NULL && eol != custom) {
+		*eol = '\0';
+		val = eol + 1;
+
+		if ((eol = strchr(val, '\n')) == NULL)
+		  break;
+		*eol = '\0';
+		printf("prop_update_custom %s %s\n", custom, val);
+		custom = eol + 1;
+	  }
+
 	} else if (strcmp("custom_reload_notify", msg) == 0) {
 
 	  printf("custom_reload_notify\n");
@@ -98,6 +98,7 @@ typedef struct property {
 typedef struct uim_agent_context {
   uim_context context;
   int context_id;
+  int client_id;             /* 0 unless served by the shared agent */
   char *encoding;
   char *im;
   preedit *pe;
@@ -111,6 +112,7 @@ typedef struct uim_agent_context_list {
   uim_agent_context *agent_context;
   struct uim_agent_context_list *next;
   struct uim_agent_context_list *prev;
+  struct uim_agent_context_list *hash_next;
 } uim_agent_context_list;
 
 
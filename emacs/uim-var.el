@@ -85,6 +85,13 @@ Example:
 " )
 
 
+;; Share one uim-el-agent among every Emacs of the user
+(defvar uim-el-agent-shared nil
+  "Non-nil means connecting to the uim-el-agent shared by every Emacs
+of the user instead of starting a dedicated one.  Input methods and
+dictionaries are then loaded only once.")
+
+
 (defvar uim-el-helper-agent "uim-el-helper-agent"
   "Overwrite this variable if uim-el-helper-agent is not in command path.
 
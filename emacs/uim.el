@@ -482,7 +482,9 @@
 
     (message "uim.el: starting uim-el-agent...")
 
-    (setq proc (start-process "uim-el-agent" buffer uim-el-agent))
+    (setq proc (if uim-el-agent-shared
+		   (start-process "uim-el-agent" buffer uim-el-agent "-s")
+		 (start-process "uim-el-agent" buffer uim-el-agent)))
 
     (if (not proc)
 	(error "uim.el: Couldn't invoke uim-el-agent."))
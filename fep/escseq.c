@@ -61,6 +61,10 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#include <sys/uio.h>
 
 #include "uim-fep.h"
 #include "draw.h"
@@ -70,6 +74,14 @@
 
 #define my_putp(str) tputs(str, 1, my_putchar);
 
+/*
+ * Everything written to the terminal is collected here and sent by
+ * put_flush(), which is called before uim-fep waits for input, so that
+ * a redraw reaches the terminal in one write instead of one per
+ * escape sequence or byte.
+ */
+#define OUTBUF_SIZE 4096
+
 
 /* TRUE */
 static int s_init = FALSE;
@@ -105,6 +117,9 @@ static const char *s_orig_fore_num;
 static const char *s_orig_back_num;
 /* ڤƤ륨ץ󥹤¸Хåե */
 static char *s_escseq_buf = NULL;
+/* output not written yet */
+static char s_outbuf[OUTBUF_SIZE];
+static int s_outbuf_len = 0;
 
 /* °ʤ */
 static const struct attribute_tag s_attr_none = {
@@ -147,6 +162,7 @@ static int cfmakeraw(struct termios *termios_p);
 static void change_background_attr(struct attribute_tag *from, struct attribute_tag to);
 static const char *attr2escseq(const struct attribute_tag *attr);
 static void set_attr(const char *str, int len);
+static void put_bytes(const char *str, int len);
 static int my_putchar(int c);
 
 
@@ -340,6 +356,7 @@ void quit_escseq(void)
   }
   put_restore_cursor();
   put_cursor_normal();
+  put_flush();
 }
 
 /*
@@ -391,7 +408,7 @@ void fixtty(void)
   put_cursor_invisible();
   /* ǲԤ鳫ϤȤΤ˥ */
   if (g_opt.status_type == LASTLINE) {
-    write(g_win_out, "\n", strlen("\n"));
+    put_bytes("\n", strlen("\n"));
   }
 
   if (!s_init) {
@@ -527,7 +544,8 @@ struct point_tag get_cursor_position(void)
     return s_cursor;
   }
 
-  write(g_win_out, "\033[6n", strlen("\033[6n"));
+  put_bytes("\033[6n", strlen("\033[6n"));
+  put_flush();
 
   while (TRUE) {
     char *next_escseq;
@@ -1017,7 +1035,7 @@ void put_delete(int n)
  */
 void put_crlf(void)
 {
-  write(g_win_out, "\r\n", strlen("\r\n"));
+  put_bytes("\r\n", strlen("\r\n"));
   s_cursor.col = 0;
   s_cursor.row++;
   if (s_cursor.row >= g_win->ws_row) {
@@ -1073,7 +1091,7 @@ void put_erase(int n)
 
   s_cursor.col += n;
   assert(s_cursor.col <= g_win->ws_col || g_opt.no_report_cursor);
-  write(g_win_out, spaces, n);
+  put_bytes(spaces, n);
 
   free(spaces);
   debug(("<put erase %d>", n));
@@ -1131,7 +1149,7 @@ void put_uim_str(const char *str, int attr)
 
   s_cursor.col += strwidth(str);
   assert(s_cursor.col <= g_win->ws_col || g_opt.no_report_cursor);
-  write(g_win_out, str, strlen(str));
+  put_bytes(str, strlen(str));
   debug(("<put_uim_str \"%s\">", str));
 }
 
@@ -1181,7 +1199,7 @@ void put_pty_str(const char *str, int len)
   }
   change_attr(&s_attr, &s_attr_pty);
   /* put_exit_uim_mode(); */
-  write(g_win_out, str, len);
+  put_bytes(str, len);
   set_attr(str, len);
   g_commit = FALSE;
   s_cursor.row = s_cursor.col = UNDEFINED;
@@ -1226,9 +1244,70 @@ void escseq_winch(void)
   s_cursor.row = s_cursor.col = UNDEFINED;
 }
 
+/*
+ * Write out the pending output
+ */
+void put_flush(void)
+{
+  int done = 0;
+
+  while (done < s_outbuf_len) {
+    ssize_t n = write(g_win_out, s_outbuf + done, s_outbuf_len - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    done += n;
+  }
+  s_outbuf_len = 0;
+}
+
+/*
+ * Append len bytes of str to the pending output. When it doesn't fit,
+ * the pending output and str are written together with writev.
+ */
+static void put_bytes(const char *str, int len)
+{
+  struct iovec iov[2];
+  ssize_t n;
+
+  if (s_outbuf_len + len <= OUTBUF_SIZE) {
+    memcpy(s_outbuf + s_outbuf_len, str, len);
+    s_outbuf_len += len;
+    return;
+  }
+
+  iov[0].iov_base = s_outbuf;
+  iov[0].iov_len = s_outbuf_len;
+  iov[1].iov_base = (char *)str;
+  iov[1].iov_len = len;
+  while (iov[0].iov_len + iov[1].iov_len > 0) {
+    if ((n = writev(g_win_out, iov, 2)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if ((size_t)n < iov[0].iov_len) {
+      iov[0].iov_base = (char *)iov[0].iov_base + n;
+      iov[0].iov_len -= n;
+    } else {
+      n -= iov[0].iov_len;
+      iov[0].iov_len = 0;
+      iov[1].iov_base = (char *)iov[1].iov_base + n;
+      iov[1].iov_len -= n;
+    }
+  }
+  s_outbuf_len = 0;
+}
+
 static int my_putchar(int c)
 {
-  char ch = c;
-  write(g_win_out, &ch, 1);
+  if (s_outbuf_len == OUTBUF_SIZE) {
+    put_flush();
+  }
+  s_outbuf[s_outbuf_len++] = c;
   return c;
 }
@@ -74,6 +74,7 @@ void put_uim_str_len(const char *str, int attr, int len);
 void put_uim_str_no_color(const char *str, int attr);
 void put_uim_str_no_color_len(const char *str, int attr, int len);
 void put_pty_str(const char *str, int len);
+void put_flush(void);
 char *cut_padding(const char *escseq);
 void escseq_winch(void);
 
@@ -102,6 +102,13 @@ void helper_handler(void)
         }
       }
 
+    } else if (str_has_prefix(message, "custom_update_batch")) {
+      char *eol;
+      debug(("custom_update_batch\n"));
+      if ((eol = strchr(message, '\n')) != NULL) {
+        uim_prop_update_customs(g_context, eol + 1);
+      }
+
     } else if (str_has_prefix(message, "custom_reload_notify")) {
       debug(("custom_reload_notify\n"));
       uim_prop_reload_configs();
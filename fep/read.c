@@ -55,6 +55,7 @@
 
 #include "uim-fep.h"
 #include "read.h"
+#include "escseq.h"
 
 static char *s_unget_buf = NULL;
 static int s_buf_size = 0;
@@ -74,6 +75,7 @@ int my_select(int n, fd_set *readfds, struct timeval *timeout)
     FD_SET(g_win_in, readfds);
     return 1;
   }
+  put_flush();
   return select(n, readfds, NULL, NULL, timeout);
 }
 
@@ -88,6 +90,7 @@ int my_pselect(int n, fd_set *readfds, const sigset_t *sigmask)
     FD_SET(g_win_in, readfds);
     return 1;
   }
+  put_flush();
   return pselect_(n, readfds, NULL, NULL, NULL, sigmask);
 }
 
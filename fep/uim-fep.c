@@ -1125,6 +1125,7 @@ static void recover(void)
   put_exit_attribute_mode();
   put_restore_cursor();
   put_cursor_normal();
+  put_flush();
   recover_loop();
   done(EXIT_SUCCESS);
 }
@@ -1139,6 +1140,7 @@ static void sigtstp_handler(void)
 
   quit_escseq();
   put_save_cursor();
+  put_flush();
   tcsetattr(g_win_in, TCSAFLUSH, &s_save_tios);
 
   sigemptyset(&act.sa_mask);
@@ -64,23 +64,21 @@ int compose_handle_key(GdkEventKey *event, IMUIMContext *uic);
 static int parse_line(char *line, char **argv, int argsize);
 static unsigned int KeySymToUcs4(KeySym keysym);
 static int get_compose_filename(char *, size_t);
-static void ParseComposeStringFile(FILE *fp);
+static void ParseComposeStringFile(uim_x_compose_builder *builder, FILE *fp);
 static int get_lang_region(char *, size_t);
 static int TransFileName(char *, const char *, size_t);
 
-static DefTree *g_tree;
+static uim_x_compose_table *g_table;
 
 Compose *
 im_uim_compose_new()
 {
-    DefTree *top = g_tree;
     Compose *p;
 
     p = malloc(sizeof(Compose));
     if (p) {
-	p->m_composed = NULL;
-	p->m_top = top;
-	p->m_context = top;
+	p->m_table = g_table;
+	p->m_context = UIM_X_COMPOSE_ROOT;
     }
 
     return p;
@@ -90,40 +88,34 @@ static int
 handleKey(unsigned int xkeysym, unsigned int xkeystate, int is_push,
 		     IMUIMContext *uic)
 {
-    DefTree *p;
-    DefTree *m_top = uic->compose->m_top;
-    DefTree *m_context = uic->compose->m_context;
+    int p;
+    uim_x_compose_table *m_table = uic->compose->m_table;
+    int m_context = uic->compose->m_context;
 
-    if ((is_push == 0)  || m_top == NULL)
+    if ((is_push == 0)  || m_table == NULL)
 	return 0;
 
     if (IsModifierKey(xkeysym))
 	return 0;
 
-    for (p = m_context; p ; p = p->next) {
-	if (((xkeystate & p->modifier_mask) == p->modifier) &&
-		(xkeysym == p->keysym)) {
-	    break;
-	}
-    }
+    p = uim_x_compose_table_lookup(m_table, m_context, xkeysym, xkeystate);
 
-    if (p) { /* Matched */
-	if (p->succession) { /* Intermediate */
-	    uic->compose->m_context = p->succession;
+    if (p != -1) { /* Matched */
+	if (!uim_x_compose_table_is_leaf(m_table, p)) { /* Intermediate */
+	    uic->compose->m_context = p;
 	    return 1;
 	} else { /* Terminate (reached to leaf) */
-	    uic->compose->m_composed = p;
 	    /* commit string here */
-	    im_uim_commit_string(uic, uic->compose->m_composed->utf8);
+	    im_uim_commit_string(uic, uim_x_compose_table_utf8(m_table, p));
 	    /* initialize internal state for next key sequence */
-	    uic->compose->m_context = m_top;
+	    uic->compose->m_context = UIM_X_COMPOSE_ROOT;
 	    return 1;
 	}
     } else { /* Unmatched */
-	if (m_context == m_top)
+	if (m_context == UIM_X_COMPOSE_ROOT)
 	    return 0;
 	/* Error (Sequence Unmatch occurred) */
-	uic->compose->m_context = m_top;
+	uic->compose->m_context = UIM_X_COMPOSE_ROOT;
 	return 1;
     }
 }
@@ -131,8 +123,7 @@ handleKey(unsigned int xkeysym, unsigned int xkeystate, int is_push,
 void
 im_uim_compose_reset(Compose *compose)
 {
-    compose->m_context = compose->m_top;
-    compose->m_composed = NULL;
+    compose->m_context = UIM_X_COMPOSE_ROOT;
 }
 
 static int
@@ -457,31 +448,23 @@ get_mb_string(char *buf, KeySym ks)
 #define SEQUENCE_MAX    10
 
 static int
-parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
+parse_compose_line(uim_x_compose_builder *builder, FILE *fp, char **tokenbuf,
+		   size_t *buflen)
 {
     int token;
     unsigned modifier_mask;
     unsigned modifier;
     unsigned tmp;
     KeySym keysym = NoSymbol;
-    DefTree **top = &g_tree;
-    DefTree *p = NULL;
     Bool exclam, tilde;
     KeySym rhs_keysym = 0;
     char *rhs_string_mb;
     int l = 0;
     int lastch = 0;
     char local_mb_buf[MB_LEN_MAX + 1];
-    char *rhs_string_utf8;
-
-    struct DefBuffer {
-	unsigned modifier_mask;
-	unsigned modifier;
-	KeySym keysym;
-    };
-
-    struct DefBuffer buf[SEQUENCE_MAX];
-    int i, n;
+    char *result;
+    struct uim_x_compose_key buf[SEQUENCE_MAX];
+    int n;
     const char *encoding;
     g_get_charset(&encoding);
 
@@ -507,7 +490,8 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
 	    infp = fopen(filename, "r");
 	    if (infp == NULL)
 		goto error;
-	    ParseComposeStringFile(infp);
+	    uim_x_compose_builder_add_source(builder, filename);
+	    ParseComposeStringFile(builder, infp);
 	    fclose(infp);
 	    return 0;
 	} else if ((token == KEY) && (strcmp("None", *tokenbuf) == 0)) {
@@ -618,49 +602,11 @@ parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
 	goto error;
     }
 
-    {
-	char *result;
-	result = g_locale_to_utf8(rhs_string_mb, -1, NULL, NULL, NULL);
-	if (!result)
-	    rhs_string_utf8 = strdup("");
-	else
-	    rhs_string_utf8 = strdup(result);
-	g_free(result);
-    }
+    result = g_locale_to_utf8(rhs_string_mb, -1, NULL, NULL, NULL);
+    free(rhs_string_mb);
+    n = uim_x_compose_builder_add(builder, buf, n, result ? result : "");
+    g_free(result);
 
-    for (i = 0; i < n; i++) {
-	for (p = *top; p; p = p->next) {
-	    if (buf[i].keysym == p->keysym &&
-		buf[i].modifier == p->modifier &&
-		buf[i].modifier_mask == p->modifier_mask) {
-		break;
-	    }
-	}
-	if (p) {
-	    top = &p->succession;
-	} else {
-	    if ((p = (DefTree*)malloc(sizeof(DefTree))) == NULL) {
-		free(rhs_string_mb);
-		goto error;
-	    }
-	    p->keysym = buf[i].keysym;
-	    p->modifier = buf[i].modifier;
-	    p->modifier_mask = buf[i].modifier_mask;
-	    p->succession = NULL;
-	    p->next = *top;
-	    p->mb = NULL;
-	    p->utf8 = NULL;
-	    p->ks = NoSymbol;
-	    *top = p;
-	    top = &p->succession;
-	}
-    }
-
-    free(p->mb);
-    p->mb = rhs_string_mb;
-    free(p->utf8);
-    p->utf8 = rhs_string_utf8;
-    p->ks = rhs_keysym;
     return n;
 error:
     while (token != ENDOFLINE && token != ENDOFFILE) {
@@ -670,7 +616,7 @@ error:
 }
 
 static void
-ParseComposeStringFile(FILE *fp)
+ParseComposeStringFile(uim_x_compose_builder *builder, FILE *fp)
 {
     char *tbp, *p[1];
     struct stat st;
@@ -682,7 +628,7 @@ ParseComposeStringFile(FILE *fp)
 	tbp = (char *)malloc(buflen);
 	p[0] = tbp;
 	if (tbp != NULL) {
-	    while (parse_compose_line(fp, p, &buflen) >= 0) {
+	    while (parse_compose_line(builder, fp, p, &buflen) >= 0) {
 	    }
 	    free(p[0]);
 	}
@@ -706,10 +652,16 @@ get_lang_region(char *locale, size_t len)
     return 1;
 }
 
+static void
+parse_compose_file(uim_x_compose_builder *builder, void *fp)
+{
+    ParseComposeStringFile(builder, (FILE *)fp);
+}
+
 void im_uim_create_compose_tree()
 {
     FILE *fp = NULL;
-    char name[MAXPATHLEN];
+    char name[MAXPATHLEN], locale[BUFSIZ];
     char lang_region[BUFSIZ];
     const char *encoding;
     char *compose_env;
@@ -747,29 +699,18 @@ void im_uim_create_compose_tree()
 	return;
     }
 
-    ParseComposeStringFile(fp);
-    fclose(fp);
-}
-
-static void
-FreeComposeTree(DefTree *top)
-{
-    if (!top)
-	return;
+    snprintf(locale, sizeof(locale), "%s.%s", lang_region, encoding);
 
-    if (top->succession)
-	FreeComposeTree(top->succession);
-    if (top->next)
-	FreeComposeTree(top->next);
-    free(top->mb);
-    free(top->utf8);
-    free(top);
+    /* parsed only if the cached table is missing or stale */
+    g_table = uim_x_compose_table_open(name, locale, parse_compose_file, fp);
+    fclose(fp);
 }
 
 void
 im_uim_release_compose_tree()
 {
-    FreeComposeTree(g_tree);
+    uim_x_compose_table_close(g_table);
+    g_table = NULL;
 }
 
 static int
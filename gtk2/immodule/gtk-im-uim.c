@@ -128,8 +128,8 @@ static gboolean handle_key_on_toplevel(GtkWidget *widget, GdkEventKey *event, gp
 static void cand_delay_timer_remove(UIMCandWinGtk *cwin);
 #endif
 #if IM_UIM_USE_NEW_PAGE_HANDLING
-static GSList *get_page_candidates(IMUIMContext *uic, guint page, guint nr, guint display_limit);
-static void free_candidates(GSList *candidates);
+static GSList *get_page_candidates(IMUIMContext *uic, guint page, guint nr, guint display_limit, uim_candidate **cands);
+static void free_candidates(GSList *candidates, uim_candidate *cands);
 #endif
 static void send_im_list(void);
 static UIMCandWinGtk *im_uim_create_cand_win_gtk(void);
@@ -510,9 +510,11 @@ index_changed_cb(UIMCandWinGtk *cwin, IMUIMContext *uic)
      */
     guint nr = uic->cwin->nr_candidates;
     guint display_limit = uic->cwin->display_limit;
-    GSList *list = get_page_candidates(uic, new_page, nr, display_limit);
+    uim_candidate *cands;
+    GSList *list = get_page_candidates(uic, new_page, nr, display_limit,
+				       &cands);
     uim_cand_win_gtk_set_page_candidates(uic->cwin, new_page, list);
-    free_candidates(list);
+    free_candidates(list, cands);
   }
 #endif /* IM_UIM_USE_NEW_PAGE_HANDLING */
 }
@@ -639,20 +641,28 @@ clear_cb(void *ptr)
 }
 
 static void
-pushback_cb(void *ptr, int attr, const char *str)
+replace_cb(void *ptr, int first, int nr_removed, int nr_added,
+	   const int *attrs, const char *const *strs)
 {
   IMUIMContext *uic = (IMUIMContext *)ptr;
-  g_return_if_fail(str);
+  int i, nr_psegs;
 
-  if (!strcmp(str, "")
-      && !(attr & (UPreeditAttr_Cursor | UPreeditAttr_Separator)))
-    return;
+  /* libuim leaves out the empty segments that pushback_cb used to skip */
+  for (i = first; i < first + nr_removed; i++)
+    g_free(uic->pseg[i].str);
 
-  uic->pseg = realloc(uic->pseg,
-		      sizeof(struct preedit_segment) * (uic->nr_psegs + 1));
-  uic->pseg[uic->nr_psegs].str = g_strdup(str);
-  uic->pseg[uic->nr_psegs].attr = attr;
-  uic->nr_psegs++;
+  nr_psegs = uic->nr_psegs - nr_removed + nr_added;
+  if (nr_added > nr_removed)
+    uic->pseg = realloc(uic->pseg, sizeof(struct preedit_segment) * nr_psegs);
+  memmove(&uic->pseg[first + nr_added], &uic->pseg[first + nr_removed],
+	  sizeof(struct preedit_segment)
+	  * (uic->nr_psegs - first - nr_removed));
+
+  for (i = 0; i < nr_added; i++) {
+    uic->pseg[first + i].str = g_strdup(strs[i]);
+    uic->pseg[first + i].attr = attrs[i];
+  }
+  uic->nr_psegs = nr_psegs;
 }
 
 static void
@@ -732,7 +742,8 @@ static GSList *
 get_page_candidates(IMUIMContext *uic,
 		    guint page,
 		    guint nr,
-		    guint display_limit)
+		    guint display_limit,
+		    uim_candidate **cands)
 {
   gint i, page_nr, start;
   GSList *list = NULL;
@@ -743,21 +754,20 @@ get_page_candidates(IMUIMContext *uic,
   else
     page_nr = nr - start;
 
-  for (i = start; i < (start + page_nr); i++) {
-    uim_candidate cand = uim_get_candidate(uic->uc, i,
-		    display_limit ? (int)(i % display_limit) : i);
-    list = g_slist_prepend(list, cand);
-  }
-  list = g_slist_reverse(list);
+  /* the whole page in one call; the list refers into *cands */
+  *cands = uim_get_candidates(uic->uc, start, page_nr, display_limit);
+  for (i = page_nr - 1; *cands && i >= 0; i--)
+    list = g_slist_prepend(list, (*cands)[i]);
 
   return list;
 }
 
 static void
-free_candidates(GSList *candidates)
+free_candidates(GSList *candidates, uim_candidate *cands)
 {
-  g_slist_foreach(candidates, (GFunc)uim_candidate_free, NULL);
   g_slist_free(candidates);
+  if (cands)
+    uim_candidates_free(cands);
 }
 #endif /* IM_UIM_USE_NEW_PAGE_HANDLING */
  
@@ -766,8 +776,8 @@ cand_activate_cb(void *ptr, int nr, int display_limit)
 {
   IMUIMContext *uic = (IMUIMContext *)ptr;
   GSList *list = NULL;
+  uim_candidate *cands;
 #if !IM_UIM_USE_NEW_PAGE_HANDLING
-  uim_candidate cand;
   gint i;
 #endif
 
@@ -778,25 +788,24 @@ cand_activate_cb(void *ptr, int nr, int display_limit)
   uic->cwin_is_active = TRUE;
 
 #if !IM_UIM_USE_NEW_PAGE_HANDLING
-  for (i = 0; i < nr; i++) {
-    cand = uim_get_candidate(uic->uc, i, display_limit ? i % display_limit : i);
-    list = g_slist_prepend(list, cand);
-  }
-  list = g_slist_reverse(list);
+  cands = uim_get_candidates(uic->uc, 0, nr, display_limit);
+  for (i = nr - 1; cands && i >= 0; i--)
+    list = g_slist_prepend(list, cands[i]);
 
   uim_cand_win_gtk_set_candidates(uic->cwin, display_limit, list);
 
-  g_slist_foreach(list, (GFunc)uim_candidate_free, NULL);
   g_slist_free(list);
+  if (cands)
+    uim_candidates_free(cands);
 #else
-  list = get_page_candidates(uic, 0, nr, display_limit);
+  list = get_page_candidates(uic, 0, nr, display_limit, &cands);
 
   uim_cand_win_gtk_set_nr_candidates(uic->cwin, nr, display_limit);
   uic->cwin->candidate_index = -1; /* Don't select any candidate at first */
   uim_cand_win_gtk_set_page_candidates(uic->cwin, 0, list);
   uim_cand_win_gtk_set_page(uic->cwin, 0);
 
-  free_candidates(list);
+  free_candidates(list, cands);
 #endif /* IM_UIM_USE_NEW_PAGE_HANDLING */
 
   layout_candwin(uic);
@@ -868,9 +877,11 @@ cand_select_cb(void *ptr, int index)
   if (!uic->cwin->stores->pdata[new_page]) {
     guint nr = uic->cwin->nr_candidates;
     guint display_limit = uic->cwin->display_limit;
-    GSList *list = get_page_candidates(uic, new_page, nr, display_limit);
+    uim_candidate *cands;
+    GSList *list = get_page_candidates(uic, new_page, nr, display_limit,
+				       &cands);
     uim_cand_win_gtk_set_page_candidates(uic->cwin, new_page, list);
-    free_candidates(list);
+    free_candidates(list, cands);
   }
 #endif /* IM_UIM_USE_NEW_PAGE_HANDLING */
   g_signal_handlers_block_by_func(uic->cwin, (gpointer)(uintptr_t)index_changed_cb, uic);
@@ -896,9 +907,11 @@ cand_shift_page_cb(void *ptr, int direction)
   if (!uic->cwin->stores->pdata[new_page]) {
     guint nr = uic->cwin->nr_candidates;
     guint display_limit = uic->cwin->display_limit;
-    GSList *list = get_page_candidates(uic, new_page, nr, display_limit);
+    uim_candidate *cands;
+    GSList *list = get_page_candidates(uic, new_page, nr, display_limit,
+				       &cands);
     uim_cand_win_gtk_set_page_candidates(uic->cwin, new_page, list);
-    free_candidates(list);
+    free_candidates(list, cands);
   }
 #endif /* IM_UIM_USE_NEW_PAGE_HANDLING */
   uim_cand_win_gtk_shift_page(uic->cwin, direction);
@@ -1241,6 +1254,15 @@ parse_helper_str(const char *str)
       }
       g_strfreev(lines);
     }
+  } else if (g_str_has_prefix(str, "custom_update_batch") == TRUE) {
+    const gchar *customs = strchr(str, '\n');
+
+    /* all custom variables are global */
+    if (customs && context_list.next != &context_list) {
+      uim_prop_update_customs(context_list.next->uc, customs + 1);
+      update_candwin_pos_type();
+      update_candwin_style();
+    }
   } else if (g_str_has_prefix(str, "custom_reload_notify") == TRUE) {
     uim_prop_reload_configs();
     update_candwin_pos_type();
@@ -1464,6 +1486,7 @@ im_uim_reset(GtkIMContext *ic)
 #if !defined(WORKAROUND_BROKEN_RESET_IN_GTK)
   uim_reset_context(uic->uc);
   clear_cb(uic);
+  uim_reset_preedit_diff(uic->uc);
   update_cb(uic);
 #else
   if (uic == focused_context) {
@@ -1472,6 +1495,7 @@ im_uim_reset(GtkIMContext *ic)
   } else {
     uim_reset_context(uic->uc);
     clear_cb(uic);
+    uim_reset_preedit_diff(uic->uc);
     update_cb(uic);
   }
 #endif
@@ -1683,7 +1707,7 @@ im_module_create(const gchar *context_id)
 
   check_helper_connection();
 
-  uim_set_preedit_cb(uic->uc, clear_cb, pushback_cb, update_cb);
+  uim_set_preedit_diff_cb(uic->uc, replace_cb, update_cb);
   uim_set_prop_list_update_cb(uic->uc, update_prop_list_cb);
   uim_set_candidate_selector_cb(uic->uc, cand_activate_cb, cand_select_cb,
 				cand_shift_page_cb, cand_deactivate_cb);
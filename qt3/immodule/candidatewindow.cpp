@@ -101,16 +101,11 @@ CandidateWindow::CandidateWindow( QWidget *parent, const char * name )
 
 CandidateWindow::~CandidateWindow()
 {
-    if ( !stores.isEmpty() )
-    {
-        // clear stored candidate datas
-        for ( unsigned int i = 0; i < stores.size(); i++ )
-	{
-	    if ( stores[ i ] )
-		uim_candidate_free( stores[ i ] );
-	}
-        stores.clear();
-    }
+    // clear stored candidate datas
+    stores.clear();
+    for ( unsigned int i = 0; i < pages.size(); i++ )
+        uim_candidates_free( pages[ i ] );
+    pages.clear();
 }
 
 void CandidateWindow::popup()
@@ -145,12 +140,10 @@ void CandidateWindow::clearCandidates()
     nrCandidates = 0;
 
     // clear stored candidate datas
-    for ( unsigned int i = 0; i < stores.size(); i++ )
-    {
-	if ( stores[ i ] )
-	    uim_candidate_free( stores[ i ] );
-    }
     stores.clear();
+    for ( unsigned int i = 0; i < pages.size(); i++ )
+        uim_candidates_free( pages[ i ] );
+    pages.clear();
 }
 
 
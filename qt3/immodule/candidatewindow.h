@@ -72,6 +72,7 @@ public:
 
     void setNrCandidates( int nrCands, int dLimit );
     void setPageCandidates( int page, const QValueList<uim_candidate> &candidates );
+    void addCandidateBlock( uim_candidate *cands ) { pages.append( cands ); }
 
     void setQUimInputContext( QUimInputContext* m_ic ) { ic = m_ic; }
 
@@ -98,6 +99,8 @@ protected:
     QLabel *numLabel;
 
     QValueList<uim_candidate> stores;
+    // blocks from uim_get_candidates() that stores points into
+    QValueList<uim_candidate *> pages;
 
     bool isAlwaysLeft;
 
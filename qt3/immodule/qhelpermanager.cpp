@@ -161,6 +161,18 @@ void QUimHelperManager::parseHelperStr( const QString &str )
             }
         }
     }
+    else if ( str.startsWith( "custom_update_batch" ) )
+    {
+        // for custom api
+        QUimInputContext * cc = contextList.first();
+        int eol = str.find( '\n' );
+        if ( cc && eol >= 0 )
+        {
+            /* all custom variables are global */
+            uim_prop_update_customs( cc->uimContext(),
+                                     str.mid( eol + 1 ).utf8() );
+        }
+    }
     else if ( str.startsWith( "custom_reload_notify" ) )
     {
         uim_prop_reload_configs();
@@ -688,7 +688,7 @@ void QUimInputContext::prepare_page_candidates( int page )
 	return;
 
     /* set page candidates */
-    uim_candidate cand;
+    uim_candidate *cands;
     int pageNr, start, nrCandidates, displayLimit;
 
     nrCandidates = cwin->nrCandidates;
@@ -700,13 +700,13 @@ void QUimInputContext::prepare_page_candidates( int page )
     else
 	pageNr = nrCandidates - start;
 
-    for ( int i = start; i < ( pageNr + start ); i++ )
-    {
-        cand = uim_get_candidate( m_uc, i, displayLimit ? i % displayLimit : i );
-        list.append( cand );
-    }
+    cands = uim_get_candidates( m_uc, start, pageNr, displayLimit );
+    for ( int i = 0; cands && i < pageNr; i++ )
+        list.append( cands[ i ] );
     pageFilled[ page ] = true;
     cwin->setPageCandidates( page, list );
+    if ( cands )
+        cwin->addCandidateBlock( cands );
 }
 #endif
 
@@ -719,13 +719,12 @@ void QUimInputContext::candidateActivate( int nr, int displayLimit )
     cwin->activateCandwin( displayLimit );
 
     /* set candidates */
-    uim_candidate cand;
-    for ( int i = 0; i < nr; i++ )
-    {
-        cand = uim_get_candidate( m_uc, i, displayLimit ? i % displayLimit : i );
-        list.append( cand );
-    }
+    uim_candidate *cands = uim_get_candidates( m_uc, 0, nr, displayLimit );
+    for ( int i = 0; cands && i < nr; i++ )
+        list.append( cands[ i ] );
     cwin->setCandidates( displayLimit, list );
+    if ( cands )
+        cwin->addCandidateBlock( cands );
 
 #else /* !UIM_QT_USE_NEW_PAGE_HANDLING */
     nrPages = displayLimit ? ( nr - 1 ) / displayLimit + 1 : 1;
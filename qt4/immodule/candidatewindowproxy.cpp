@@ -78,11 +78,9 @@ CandidateWindowProxy::CandidateWindowProxy()
 CandidateWindowProxy::~CandidateWindowProxy()
 {
     // clear stored candidate data
-    while (!stores.isEmpty()) {
-        uim_candidate cand = stores.takeFirst();
-        if (cand)
-            uim_candidate_free(cand);
-    }
+    stores.clear();
+    while (!pages.isEmpty())
+        uim_candidates_free(pages.takeFirst());
     process->close();
 }
 
@@ -107,11 +105,9 @@ void CandidateWindowProxy::clearCandidates()
     nrCandidates = 0;
 
     // clear stored candidate data
-    while (!stores.isEmpty()) {
-        uim_candidate cand = stores.takeFirst();
-        if (cand)
-            uim_candidate_free(cand);
-    }
+    stores.clear();
+    while (!pages.isEmpty())
+        uim_candidates_free(pages.takeFirst());
 }
 
 void CandidateWindowProxy::popup()
@@ -149,12 +145,13 @@ void CandidateWindowProxy::candidateActivate(int nr, int displayLimit)
     activateCandwin(displayLimit);
 
     // set candidates
-    for (int i = 0; i < nr; i++) {
-        cand = uim_get_candidate(ic->uimContext(), i,
-                displayLimit ? i % displayLimit : i);
-        list.append(cand);
-    }
+    uim_candidate *cands
+        = uim_get_candidates(ic->uimContext(), 0, nr, displayLimit);
+    for (int i = 0; cands && i < nr; i++)
+        list.append(cands[i]);
     setCandidates(displayLimit, list);
+    if (cands)
+        pages.append(cands);
 
 #else /* !UIM_QT_USE_NEW_PAGE_HANDLING */
     nrPages = displayLimit ? (nr - 1) / displayLimit + 1 : 1;
@@ -543,14 +540,14 @@ void CandidateWindowProxy::preparePageCandidates(int page)
     else
         pageNr = nrCandidates - start;
 
-    for (int i = start; i < pageNr + start; i++) {
-        // set page candidates
-        uim_candidate cand = uim_get_candidate(ic->uimContext(), i,
-                displayLimit ? i % displayLimit : i);
-        list.append(cand);
-    }
+    uim_candidate *cands
+        = uim_get_candidates(ic->uimContext(), start, pageNr, displayLimit);
+    for (int i = 0; cands && i < pageNr; i++)
+        list.append(cands[i]);
     pageFilled[page] = true;
     setPageCandidates(page, list);
+    if (cands)
+        pages.append(cands);
 }
 #endif /* UIM_QT_USE_NEW_PAGE_HANDLING */
 
@@ -127,6 +127,8 @@ class CandidateWindowProxy : public QObject
 
         // candidate data
         QList<uim_candidate> stores;
+        // blocks from uim_get_candidates() that stores points into
+        QList<uim_candidate *> pages;
         int nrCandidates;
         int displayLimit;
         int candidateIndex;
@@ -185,6 +185,27 @@ void QUimHelperManager::parseHelperStr( const QString &str )
             }
         }
     }
+    else if ( str.startsWith( QLatin1String( "custom_update_batch" ) ) )
+    {
+        // for custom api
+        int eol = str.indexOf( '\n' );
+        if ( eol >= 0 && !contextList.isEmpty() )
+        {
+            /* all custom variables are global */
+            uim_prop_update_customs( contextList.first()->uimContext(),
+                                     str.mid( eol + 1 ).toUtf8().data() );
+#if QT_VERSION < 0x050000
+            QList<QUimInputContext *>::iterator it;
+#else
+            QList<QUimPlatformInputContext *>::iterator it;
+#endif
+            for ( it = contextList.begin(); it != contextList.end(); ++it )
+            {
+                ( *it )->updatePosition();
+                ( *it )->updateStyle();
+            }
+        }
+    }
     else if ( str.startsWith( QLatin1String( "custom_reload_notify" ) ) )
     {
         uim_prop_reload_configs();
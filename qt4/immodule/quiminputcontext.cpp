@@ -69,7 +69,7 @@ QList<QUimInputContext*> contextList;
 
 QUimHelperManager * QUimInputContext::m_HelperManager = 0;
 #ifdef Q_WS_X11
-DefTree *QUimInputContext::mTreeTop = 0;
+uim_x_compose_table *QUimInputContext::mComposeTable = 0;
 #endif
 
 static int unicodeToUKey(ushort c);
@@ -100,9 +100,9 @@ QUimInputContext::QUimInputContext( const char *imname )
     createCandidateWindow();
 
 #ifdef Q_WS_X11
-    if ( !mTreeTop )
+    if ( !mComposeTable )
         create_compose_tree();
-    mCompose = new Compose( mTreeTop, this );
+    mCompose = new Compose( mComposeTable, this );
 #endif
     mTextUtil = new QUimTextUtil( this );
 
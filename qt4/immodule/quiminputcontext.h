@@ -54,7 +54,8 @@ class CaretStateIndicator;
 class QUimHelperManager;
 class QUimTextUtil;
 #ifdef Q_WS_X11
-typedef struct _DefTree DefTree;
+typedef struct uim_x_compose_table uim_x_compose_table;
+typedef struct uim_x_compose_builder uim_x_compose_builder;
 class Compose;
 #endif
 
@@ -153,13 +154,16 @@ private:
 
 #ifdef Q_WS_X11
     // for X11 Compose
-    static DefTree *mTreeTop;
+    static uim_x_compose_table *mComposeTable;
     static void create_compose_tree( void );
     static int get_compose_filename( char *filename, size_t len );
     static int TransFileName( char *transname, const char *name, size_t len );
-    static void ParseComposeStringFile( FILE *fp );
-    static void FreeComposeTree( DefTree *top );
-    static int parse_compose_line( FILE *fp, char **tokenbuf, size_t *buflen );
+    static void ParseComposeStringFile( uim_x_compose_builder *builder,
+                                        FILE *fp );
+    static void parse_compose_file( uim_x_compose_builder *builder,
+                                    void *fp );
+    static int parse_compose_line( uim_x_compose_builder *builder, FILE *fp,
+                                   char **tokenbuf, size_t *buflen );
     static int get_mb_string( char *buf, unsigned int ks );
     static const char *get_encoding( void );
     static int get_lang_region( char *lang_region, size_t len );
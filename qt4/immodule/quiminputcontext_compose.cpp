@@ -56,6 +56,7 @@
 #include <X11/keysym.h>
 
 #include "uim/uim.h"
+#include "uim/uim-x-util.h"
 
 #if QT_VERSION < 0x050000
 #include "quiminputcontext.h"
@@ -78,15 +79,14 @@ static int parse_line(char *line, char **argv, int argsize);
 static unsigned int KeySymToUcs4(KeySym keysym);
 
 #if QT_VERSION < 0x050000
-Compose::Compose(DefTree *top, QUimInputContext *ic)
+Compose::Compose(uim_x_compose_table *table, QUimInputContext *ic)
 #else
-Compose::Compose(DefTree *top, QUimPlatformInputContext *ic)
+Compose::Compose(uim_x_compose_table *table, QUimPlatformInputContext *ic)
 #endif
 {
     m_ic = ic;
-    m_composed = 0;
-    m_top = top;
-    m_context = top;
+    m_table = table;
+    m_context = UIM_X_COMPOSE_ROOT;
 }
 
 Compose::~Compose()
@@ -239,45 +239,39 @@ bool Compose::handle_qkey(const QKeyEvent *event)
 
 bool Compose::handleKey(KeySym xkeysym, int xkeystate, bool is_push)
 {
-    if ((is_push == false)  || m_top == 0)
+    if ((is_push == false)  || m_table == 0)
         return false;
 
     if (IsModifierKey(xkeysym))
         return false;
 
-    DefTree *p;
-    for (p = m_context; p ; p = p->next) {
-        if (((xkeystate & p->modifier_mask) == p->modifier) &&
-                (xkeysym == p->keysym)) {
-            break;
-        }
-    }
+    int p = uim_x_compose_table_lookup(m_table, m_context, xkeysym,
+                                       xkeystate);
 
-    if (p) { // Matched
-        if (p->succession) { // Intermediate
-            m_context = p->succession;
+    if (p != -1) { // Matched
+        if (!uim_x_compose_table_is_leaf(m_table, p)) { // Intermediate
+            m_context = p;
             return true;
         } else { // Terminate (reached to leaf)
-            m_composed = p;
             // commit string here
-            m_ic->commitString(QString::fromUtf8(m_composed->utf8));
+            m_ic->commitString(
+                QString::fromUtf8(uim_x_compose_table_utf8(m_table, p)));
             // initialize internal state for next key sequence
-            m_context = m_top;
+            m_context = UIM_X_COMPOSE_ROOT;
             return true;
         }
     } else { // Unmatched
-        if (m_context == m_top)
+        if (m_context == UIM_X_COMPOSE_ROOT)
             return false;
         // Error (Sequence Unmatch occurred)
-        m_context = m_top;
+        m_context = UIM_X_COMPOSE_ROOT;
         return true;
     }
 }
 
 void Compose::reset()
 {
-    m_context = m_top;
-    m_composed = 0;
+    m_context = UIM_X_COMPOSE_ROOT;
 }
 
 static int
@@ -630,14 +624,9 @@ static const unsigned AllMask = (ShiftMask | LockMask | ControlMask | Mod1Mask);
 #define SEQUENCE_MAX    10
 
 int
-QUimInputContext::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
+QUimInputContext::parse_compose_line(uim_x_compose_builder *builder, FILE *fp,
+                                     char **tokenbuf, size_t *buflen)
 {
-    struct DefBuffer {
-        unsigned modifier_mask;
-        unsigned modifier;
-        KeySym keysym;
-    };
-
     int token;
     int lastch = 0;
     do {
@@ -658,11 +647,9 @@ QUimInputContext::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
     char *rhs_string_mb;
     int l;
     char local_mb_buf[MB_LEN_MAX + 1];
-    struct DefBuffer buf[SEQUENCE_MAX];
+    struct uim_x_compose_key buf[SEQUENCE_MAX];
     int n = 0;
 
-    DefTree **top = &mTreeTop;
-    DefTree *p = 0;
     do {
         if ((token == KEY) && (strcmp("include", *tokenbuf) == 0)) {
             char filename[MAXPATHLEN];
@@ -676,7 +663,8 @@ QUimInputContext::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
             infp = fopen(filename, "r");
             if (infp == 0)
                 goto error;
-            ParseComposeStringFile(infp);
+            uim_x_compose_builder_add_source(builder, filename);
+            ParseComposeStringFile(builder, infp);
             fclose(infp);
             return 0;
         } else if ((token == KEY) && (strcmp("None", *tokenbuf) == 0)) {
@@ -787,45 +775,13 @@ QUimInputContext::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
         goto error;
     }
 
-    for (int i = 0; i < n; i++) {
-        for (p = *top; p; p = p->next) {
-            if (buf[i].keysym == p->keysym &&
-                buf[i].modifier == p->modifier &&
-                buf[i].modifier_mask == p->modifier_mask) {
-                break;
-            }
-        }
-        if (p) {
-            top = &p->succession;
-        } else {
-            if ((p = (DefTree*)malloc(sizeof(DefTree))) == 0) {
-                free(rhs_string_mb);
-                goto error;
-            }
-            p->keysym = buf[i].keysym;
-            p->modifier = buf[i].modifier;
-            p->modifier_mask = buf[i].modifier_mask;
-            p->succession = 0;
-            p->next = *top;
-            p->mb = 0;
-            p->utf8 = 0;
-            p->ks = NoSymbol;
-            *top = p;
-            top = &p->succession;
-        }
-    }
-
-    free(p->mb);
-    p->mb = rhs_string_mb;
-    free(p->utf8);
     {
         QTextCodec *codec = QTextCodec::codecForLocale();
         QString qs = codec->toUnicode(rhs_string_mb);
-        char *rhs_string_utf8 = strdup(qs.toUtf8().data());
-        p->utf8 = rhs_string_utf8;
+        free(rhs_string_mb);
+        return uim_x_compose_builder_add(builder, buf, n,
+                                         qs.toUtf8().data());
     }
-    p->ks = rhs_keysym;
-    return n;
 error:
     while (token != ENDOFLINE && token != ENDOFFILE) {
         token = nexttoken(fp, tokenbuf, &lastch, buflen);
@@ -834,22 +790,8 @@ error:
 }
 
 void
-QUimInputContext::FreeComposeTree(DefTree *top)
-{
-    if (!top)
-        return;
-
-    if (top->succession)
-        FreeComposeTree(top->succession);
-    if (top->next)
-        FreeComposeTree(top->next);
-    free(top->mb);
-    free(top->utf8);
-    free(top);
-}
-
-void
-QUimInputContext::ParseComposeStringFile(FILE *fp)
+QUimInputContext::ParseComposeStringFile(uim_x_compose_builder *builder,
+                                         FILE *fp)
 {
     char *tbp, *p[1];
     struct stat st;
@@ -861,13 +803,19 @@ QUimInputContext::ParseComposeStringFile(FILE *fp)
         tbp = (char *)malloc(buflen);
         p[0] = tbp;
         if (tbp != 0) {
-            while (parse_compose_line(fp, p, &buflen) >= 0) {
+            while (parse_compose_line(builder, fp, p, &buflen) >= 0) {
             }
             free(p[0]);
         }
     }
 }
 
+void
+QUimInputContext::parse_compose_file(uim_x_compose_builder *builder, void *fp)
+{
+    ParseComposeStringFile(builder, (FILE *)fp);
+}
+
 void QUimInputContext::create_compose_tree()
 {
     char *compose_env = getenv("XCOMPOSEFILE");
@@ -903,8 +851,12 @@ void QUimInputContext::create_compose_tree()
         fclose(fp);
         return;
     }
+    char locale[BUFSIZ];
+    snprintf(locale, sizeof(locale), "%s.%s", lang_region, encoding);
 
-    ParseComposeStringFile(fp);
+    // parsed only if the cached table is missing or stale
+    mComposeTable = uim_x_compose_table_open(name, locale,
+                                             parse_compose_file, fp);
     fclose(fp);
 }
 
@@ -47,17 +47,7 @@
 
 class QKeyEvent;
 
-typedef struct _DefTree {
-    struct _DefTree *next;                /* another Key definition */
-    struct _DefTree *succession;        /* successive Key Sequence */
-                                        /* Key definitions */
-    unsigned modifier_mask;
-    unsigned modifier;
-    KeySym keysym;                        /* leaf only */
-    char *mb;
-    char *utf8;                                /* make from mb */
-    KeySym ks;
-} DefTree;
+typedef struct uim_x_compose_table uim_x_compose_table;
 
 #include <QtCore/QtGlobal>
 
@@ -69,9 +59,9 @@ class QUimPlatformInputContext;
 class Compose {
 public:
 #if QT_VERSION < 0x050000
-    Compose(DefTree *, QUimInputContext *);
+    Compose(uim_x_compose_table *, QUimInputContext *);
 #else
-    Compose(DefTree *, QUimPlatformInputContext *);
+    Compose(uim_x_compose_table *, QUimPlatformInputContext *);
 #endif
     ~Compose();
     bool handle_qkey(const QKeyEvent *event);
@@ -83,9 +73,8 @@ private:
 #else
     QUimPlatformInputContext *m_ic;
 #endif
-    DefTree *m_top;
-    DefTree *m_context;
-    DefTree *m_composed;
+    uim_x_compose_table *m_table;
+    int m_context; // node of m_table
 };
 
 #endif
@@ -53,162 +53,140 @@
 (define (canna-lib-initialize socket user)
   (let* ((canna-var&user (canna-var&user-fmt user))
          (canna-var&user-len (+ 1 (string-length canna-var&user))))
-    (file-write socket
-                (u8list->string-buf
-                 (u8list-pack '(u32 u32 s8)
-                              canna-lib-initialize-op canna-var&user-len canna-var&user)))
-    (call-with-u8list-unpack
-     '(u16 u16) (string-buf->u8list (file-read socket 4))
+    (file-write-packed socket '(u32 u32 s8)
+                       (list canna-lib-initialize-op canna-var&user-len canna-var&user))
+    (call-with-file-read-unpacked
+     socket 4 '(u16 u16)
      (lambda (major minor)
        (not (and (= major 65535) (= major 65535)))))))
 
 (define (canna-lib-finalize socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16)
-                            canna-lib-finalize-op 0 0)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
+  (file-write-packed socket '(u8 u8 u16)
+                     (list canna-lib-finalize-op 0 0))
+  (call-with-file-read-unpacked
+   socket 5 '(u32 u8)
         (lambda (dummy result)
           (= result 0))))
 
 (define (canna-lib-create-context socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16)
-                            canna-lib-create-context-op 0 0)))
-  (call-with-u8list-unpack
-   '(u32 u16) (string-buf->u8list (file-read socket 6))
+  (file-write-packed socket '(u8 u8 u16)
+                     (list canna-lib-create-context-op 0 0))
+  (call-with-file-read-unpacked
+   socket 6 '(u32 u16)
    (lambda (dummy context-id)
      (and (not (= context-id 65535))
           context-id))))
 
 (define (canna-lib-close-context socket context-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16)
-                            canna-lib-close-context-op 0 2 context-id)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
+  (file-write-packed socket '(u8 u8 u16 u16)
+                     (list canna-lib-close-context-op 0 2 context-id))
+  (call-with-file-read-unpacked
+   socket 5 '(u32 u8)
    (lambda (dummy result)
      (not (= result 255)))))
 
 (define (canna-lib-get-dictionary-list socket context-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16)
-                            canna-lib-get-dictionary-list-op 0 4 context-id 1024)))
-  (call-with-u8list-unpack
-   '(u32 u16) (string-buf->u8list (file-read socket 6))
-   (lambda (dummy result)
+  (file-write-packed socket '(u8 u8 u16 u16 u16)
+                     (list canna-lib-get-dictionary-list-op 0 4 context-id 1024))
+  ;; len counts the 2 bytes of result
+  (call-with-file-read-unpacked
+   socket 6 '(u16 u16 u16)
+   (lambda (dummy len result)
      (and (not (= result 65535))
-          (call-with-u8list-unpack
-           (make-list result 's8) (string-buf->u8list (file-read socket 1024))
+          (call-with-file-read-unpacked
+           socket (- len 2) (make-list result 's8)
            (lambda dict-list
              dict-list))))))
 
 (define (canna-lib-mount-dictionary socket context-id dict mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s8)
-                            canna-lib-mount-dictionary-op
-                            0
-                            (+ (string-length dict) 7)
-                            mode context-id dict)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
+  (file-write-packed socket '(u8 u8 u16 u32 u16 s8)
+                     (list canna-lib-mount-dictionary-op
+                           0
+                           (+ (string-length dict) 7)
+                           mode context-id dict))
+  (call-with-file-read-unpacked
+   socket 5 '(u32 u8)
    (lambda (dummy result)
      (not (= result 255)))))
 
 (define (canna-lib-unmount-dictionary socket context-id dict mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s8)
-                            canna-lib-unmount-dictionary-op
-                            0
-                            (+ (string-length dict) 7)
-                            mode context-id dict)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
+  (file-write-packed socket '(u8 u8 u16 u32 u16 s8)
+                     (list canna-lib-unmount-dictionary-op
+                           0
+                           (+ (string-length dict) 7)
+                           mode context-id dict))
+  (call-with-file-read-unpacked
+   socket 5 '(u32 u8)
    (lambda (dummy result)
      (not (= result 255)))))
 
 (define (canna-lib-begin-convert socket context-id yomi mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u32 u16 s16)
-                            canna-lib-begin-convert-op
-                            0
-                            (+ (string-length yomi) 8)
-                            mode context-id yomi)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
+  (file-write-packed socket '(u8 u8 u16 u32 u16 s16)
+                     (list canna-lib-begin-convert-op
+                           0
+                           (+ (string-length yomi) 8)
+                           mode context-id yomi))
+  (call-with-file-read-unpacked
+   socket 6 '(u16 u16 u16)
    (lambda (dummy len bunsetsu)
      (and (not (= bunsetsu 65535))
-          (call-with-u8list-unpack
-           (make-list bunsetsu 's16) (string-buf->u8list (file-read socket len))
+          (call-with-file-read-unpacked
+           socket (- len 2) (make-list bunsetsu 's16)
            (lambda conv
              conv))))))
 
 (define (canna-lib-end-convert socket context-id cands mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u32 u16list)
-                            canna-lib-end-convert-op
-                            0
-                            (+ (* 2 (length cands)) 8)
-                            context-id (length cands) mode
-                            cands)))
-  (call-with-u8list-unpack
-   '(u32 u8) (string-buf->u8list (file-read socket 5))
+  (file-write-packed socket '(u8 u8 u16 u16 u16 u32 u16list)
+                     (list canna-lib-end-convert-op
+                           0
+                           (+ (* 2 (length cands)) 8)
+                           context-id (length cands) mode
+                           cands))
+  (call-with-file-read-unpacked
+   socket 5 '(u32 u8)
    (lambda (dummy result)
      (not (= result 255)))))
 
 (define (canna-lib-get-candidacy-list socket context-id bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-get-candidacy-list-op
-                            0
-                            6
-                            context-id bunsetsu-pos 1024)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
+  (file-write-packed socket '(u8 u8 u16 u16 u16 u16)
+                     (list canna-lib-get-candidacy-list-op
+                           0
+                           6
+                           context-id bunsetsu-pos 1024))
+  (call-with-file-read-unpacked
+   socket 6 '(u16 u16 u16)
    (lambda (dummy len cands)
-     (call-with-u8list-unpack
-      (make-list cands 's16) (string-buf->u8list (file-read socket len))
+     (call-with-file-read-unpacked
+      socket (- len 2) (make-list cands 's16)
       (lambda cand-list
         cand-list)))))
 
 (define (canna-lib-get-yomi socket context-id bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-get-yomi-op
-                            0
-                            6
-                            context-id bunsetsu-pos 1024)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
+  (file-write-packed socket '(u8 u8 u16 u16 u16 u16)
+                     (list canna-lib-get-yomi-op
+                           0
+                           6
+                           context-id bunsetsu-pos 1024))
+  (call-with-file-read-unpacked
+   socket 6 '(u16 u16 u16)
    (lambda (dummy len yomi-len)
-     (call-with-u8list-unpack
-      '(s16) (string-buf->u8list (file-read socket len))
+     (call-with-file-read-unpacked
+      socket (- len 2) '(s16)
       (lambda (conv)
         conv)))))
 
 (define (canna-lib-resize-pause socket context-id yomi-length bunsetsu-pos)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u8 u8 u16 u16 u16 u16)
-                            canna-lib-resize-pause-op
-                            0
-                            6
-                            context-id bunsetsu-pos yomi-length)))
-  (call-with-u8list-unpack
-   '(u16 u16 u16) (string-buf->u8list (file-read socket 6))
+  (file-write-packed socket '(u8 u8 u16 u16 u16 u16)
+                     (list canna-lib-resize-pause-op
+                           0
+                           6
+                           context-id bunsetsu-pos yomi-length))
+  (call-with-file-read-unpacked
+   socket 6 '(u16 u16 u16)
    (lambda (dummy len bunsetsu)
      (and (not (= bunsetsu 65535))
-          (let loop ((s16list (string-buf->u8list (file-read socket len)))
+          (let loop ((s16list (car (file-read-unpacked socket (- len 2)
+                                                       '(u8list))))
                      (rest '()))
             (if (equal? s16list '(0 0))
                 (reverse rest)
@@ -40,119 +40,61 @@
 
 (require-dynlib "look")
 
+;; returns a list of (residual-key . candidates) in the order of the table
+(define ct-table-search
+  (lambda (seq table max)
+    (or (look-lib-table-search
+          (string-append (sys-pkgdatadir) "/tables/" table)
+          (apply string-append seq)
+          max)
+        '())))
+
 (define ct-lib-find-seq
   (lambda (seq table)
-    (let ((looked (look-lib-look
-                    #f
-                    #f
-                    1
-                    (string-append (sys-pkgdatadir) "/tables/" table)
-                    (apply string-append seq))))
+    (let ((looked (ct-table-search seq table 1)))
       (if (and
-            looked
             (not (null? looked))
-            (= (string-contains (car looked) " " 0) 0))
-        (list (list seq) (read-from-string (car looked)))
+            (string=? (caar looked) ""))
+        (list (list seq) (cdar looked))
         #f))))
 
 ;; return a rule of partial match 
 (define ct-lib-find-partial-seq
   (lambda (seq table)
-    ;; search 2 entries matching (including partial match) with look
-    (let ((looked (look-lib-look
-                    #f
-                    #f
-                    2
-                    (string-append (sys-pkgdatadir) "/tables/" table)
-                    (apply string-append seq))))
-      (if (and
-            looked
-            (not (null? looked)))
-        (let ((first (car looked))
-              (second (if (null? (cdr looked))
-                        '()
-                        (car (cdr looked)))))
-          (cond
-            ;; second one is partial
-            ((and
-                (not (null? second))
-                (string=? (substring first 0 1) " "))
-             (let ((partial
-                     (reverse
-                       (string-to-list (car (string-split second " ")))))
-                   (cands
-                     (apply string-append (cdr (string-split second " ")))))
-               (list (list (append seq partial)) (read-from-string cands))))
-            ;; first one is partial
-            ((not (string=? (substring first 0 1) " "))
-             (let ((partial
-                     (reverse
-                       (string-to-list (car (string-split first " ")))))
-                   (cands
-                     (apply string-append (cdr (string-split first " ")))))
-               (list (list (append seq partial)) (read-from-string cands))))
-            (else
-              #f)))
+    ;; search 2 entries since the first one may be an exact match
+    (let ((partial (find (lambda (x)
+                           (not (string=? (car x) "")))
+                         (ct-table-search seq table 2))))
+      (if partial
+        (list (list (append seq (reverse (string-to-list (car partial)))))
+              (cdr partial))
         #f))))
 
 (define ct-lib-expect-key-for-seq?
   (lambda (seq table str)
-    (let* ((lst (ct-find-cands-incl-minimal-partial seq table))
-           (residuals
-             (filter-map (lambda (x) (if (string=? (cdr x) "")
-                                       #f
-                                       (substring (cdr x) 0 1))) lst)))
-      (if (member str residuals)
-        #t
-        #f))))
+    (if (member str (ct-lib-expect-seq seq table))
+      #t
+      #f)))
 
 (define ct-lib-expect-seq
-  (lambda (seq table keystr)
-    (let* ((lst (ct-find-cands-incl-minimal-partial seq table))
-           (residuals
-             (filter-map (lambda (x) (if (string=? (cdr x) "")
-                                       #f
-                                       (substring (cdr x) 0 1))) lst)))
-    residuals)))
+  (lambda (seq table)
+    (let ((lst (ct-find-cands-incl-minimal-partial seq table)))
+      (filter-map (lambda (x) (if (string=? (cdr x) "")
+                                #f
+                                (substring (cdr x) 0 1))) lst))))
 
 (define ct-find-cands-incl-minimal-partial
   (lambda (seq table)
-    (let ((looked (look-lib-look
-                    #f
-                    #f
-                    5000 ;; is it sufficient enough?
-                    (string-append (sys-pkgdatadir) "/tables/" table)
-                    (apply string-append seq))))
-      (if (and
-            looked
-            (not (null? looked)))
-        (let* ((min-partial-pos
-                 (lambda (lst)
-                   (let ((maxlen (apply max (map string-length lst))))
-                     (let loop ((n 1))
-                       (if (= maxlen n)
-                         0 ;; not found
-                         (if (not
-                               (null?
-                                 (filter
-                                   (lambda (x)
-                                     (string=? (substring x n (+ n 1)) " "))
-                                   lst)))
-                           n
-                           (loop (+ n 1))))))))
-               (pos (min-partial-pos looked))
-               (match
-                 (filter
-                   (lambda (x)
-                     (or (string=? (substring x pos (+ pos 1)) " ")
-                         (string=? (substring x 0 1) " ")))
-                   looked))
-               (str (map (lambda (x) (string-split x " ")) match))
-               (residual (map (lambda (x) (car  x)) str))
-               (cands
-                 (map
-                   (lambda (x)
-                     (read-from-string (apply string-append (cdr x)))) str))
-               (lst (map (lambda (x y) (cons x y)) cands residual)))
-          lst)
-        '()))))
+    (let* ((looked (ct-table-search seq table 5000)) ;; is it sufficient enough?
+           (min-len (fold (lambda (x len)
+                            (let ((l (string-length (car x))))
+                              (if (and (> l 0)
+                                       (or (= len 0) (< l len)))
+                                l
+                                len)))
+                          0 looked))
+           (match (filter (lambda (x)
+                            (let ((l (string-length (car x))))
+                              (or (= l 0) (= l min-len))))
+                          looked)))
+      (map (lambda (x) (cons (cdr x) (car x))) match))))
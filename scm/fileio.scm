@@ -59,44 +59,21 @@
   (string->list str))
 (define (file-buf->string buf)
   (list->string buf))
-(define (file-read-string s len)
-  (let ((ret (file-read s len)))
-    (if (eof-object? ret)
-        ret
-        (file-buf->string ret))))
-(define (file-write-string s str)
-  (file-write s (string->file-buf str)))
+;; file-read-string and file-write-string are native
 
 (define (file-read-string-with-terminate-char socket term-char)
-  (let loop ((c (file-read socket 1))
-             (rest '()))
-    (cond ((eof-object? c)
-           (uim-notify-fatal (N_ "unexpected terminate string."))
-           "")
-          ((eq? (car c) term-char)
-           (file-buf->string (reverse rest)))
-          (else
-           (loop (file-read socket 1) (cons (car c) rest))))))
+  (let ((ret (file-read-delimited socket term-char)))
+    (if (string? ret)
+        ret
+        (begin
+          (uim-notify-fatal (N_ "unexpected terminate string."))
+          ""))))
 
 (define (file-read-string-with-terminate-chars socket term-chars)
-  (let ((buf (file-read socket (length term-chars))))
-    (cond ((eof-object? buf)
-           (raise (N_ "unexpected terminate string.")))
-          ((equal? term-chars buf)
-           "")
-          (else
-           (let loop ((c (file-read socket 1))
-                      (buf buf)
-                      (rest '()))
-             (cond ((eof-object? c)
-                    (raise (N_ "unexpected terminate string.")))
-                   ((equal? term-chars (append (cdr buf) c))
-                    (file-buf->string (append rest (list (car buf)))))
-                   (else
-                    ;; enqueue
-                    (loop (file-read socket 1)
-                          (append (cdr buf) c)
-                          (append rest (list (car buf)))))))))))
+  (let ((ret (file-read-delimited socket (list->string term-chars))))
+    (if (string? ret)
+        ret
+        (raise (N_ "unexpected terminate string.")))))
 
 (define (file-read-string-with-terminate socket term-char)
   (if (char? term-char)
@@ -112,10 +89,17 @@
   (read     read?     read!)
   (write    write?    write!))
 
+;; ports on a plain descriptor keep their input in a native buffer;
+;; other ports (e.g. openssl) buffer a list of characters
 (define (open-file-port fd)
-  (make-file-port fd fd file-bufsiz '() file-read file-write))
+  (make-file-port fd fd file-bufsiz (file-inbuf-new) file-read file-write))
+
+(define (file-port-native? port)
+  (eq? (read? port) file-read))
 
 (define (close-file-port port)
+  (if (file-port-native? port)
+      (file-inbuf-free! (inbuf? port)))
   (inbuf! port '())
   (file-close (context? port))
   (context! port #f)
@@ -124,61 +108,79 @@
 (define (call-with-open-file-port fd thunk)
   (and (not (null? fd))
        (< 0 fd)
-       (let ((ret (thunk (open-file-port fd))))
-         (file-close fd)
+       (let* ((port (open-file-port fd))
+              (ret (thunk port)))
+         (close-file-port port)
          ret)))
 
 (define (file-read-char port)
-  (if (null? (inbuf? port))
+  (if (file-port-native? port)
+      (file-inbuf-read-char (context? port) (inbuf? port))
       (begin
-        ;; XXX: block
-        (file-ready? (list (fd? port)) -1)
-        (inbuf! port ((read? port) (context? port) (inbufsiz? port)))))
-  (let ((buf (inbuf? port)))
-    (if (or (eof-object? buf) ;; disconnect?
-            (not buf))
-        buf
-        (let ((c (car buf)))
-          (inbuf! port (cdr buf))
-          c))))
+        (if (null? (inbuf? port))
+            (begin
+              ;; XXX: block
+              (file-ready? (list (fd? port)) -1)
+              (inbuf! port ((read? port) (context? port) (inbufsiz? port)))))
+        (let ((buf (inbuf? port)))
+          (if (or (eof-object? buf) ;; disconnect?
+                  (not buf))
+              buf
+              (let ((c (car buf)))
+                (inbuf! port (cdr buf))
+                c))))))
 
 (define (file-peek-char port)
-  (if (null? (inbuf? port))
-      (inbuf! port ((read? port) (context? port) (inbufsiz? port))))
-  (let ((buf (inbuf? port)))
-    (if (or (eof-object? buf) ;; disconnect?
-            (not buf))
-        buf
-        (let ((c (car buf)))
-          c))))
+  (if (file-port-native? port)
+      (file-inbuf-peek-char (context? port) (inbuf? port))
+      (begin
+        (if (null? (inbuf? port))
+            (inbuf! port ((read? port) (context? port) (inbufsiz? port))))
+        (let ((buf (inbuf? port)))
+          (if (or (eof-object? buf) ;; disconnect?
+                  (not buf))
+              buf
+              (let ((c (car buf)))
+                c))))))
+
+(define (file-port-write-string port str)
+  (if (file-port-native? port)
+      (file-write-string (context? port) str)
+      ((write? port) (context? port) (string->file-buf str))))
 
 (define (file-display str port)
-  ((write? port) (context? port) (string->file-buf str)))
+  (file-port-write-string port str))
 
 (define (file-newline port)
-  ((write? port) (context? port) (string->file-buf (list->string '(#\newline)))))
+  (file-port-write-string port (list->string '(#\newline))))
 
 (define (file-read-line port)
-  (let loop ((c (file-read-char port))
-             (rest '()))
-    (cond ((eq? #\newline c)
-           (list->string (reverse rest)))
-          ((or (eof-object? c) ;; disconnect?
-               (not c))
-           (if (null? rest)
-             c
-             (list->string (reverse rest))))
-          (else
-           (loop (file-read-char port) (cons c rest))))))
+  (if (file-port-native? port)
+      (file-inbuf-read-delimited (context? port) (inbuf? port) #\newline)
+      (let loop ((c (file-read-char port))
+                 (rest '()))
+        (cond ((eq? #\newline c)
+               (list->string (reverse rest)))
+              ((or (eof-object? c) ;; disconnect?
+                   (not c))
+               (if (null? rest)
+                   c
+                   (list->string (reverse rest))))
+              (else
+               (loop (file-read-char port) (cons c rest)))))))
 
 (define (file-read-buffer port len)
-  (list->string (map (lambda (i) (file-read-char port)) (iota len))))
+  (if (file-port-native? port)
+      (file-inbuf-read-exact (context? port) (inbuf? port) len)
+      (list->string (map (lambda (i) (file-read-char port)) (iota len)))))
 
 (define (file-get-buffer port)
-  (file-buf->string (inbuf? port)))
+  (if (file-port-native? port)
+      (file-inbuf-string (inbuf? port))
+      (file-buf->string (inbuf? port))))
 
 (define (file-write-sexp l port)
-  ((write? port) (context? port) (string->file-buf (write-to-string l))))
+  (file-port-write-string port (write-to-string l)))
 
 ;; XXX: multi ports are not considered
 (define %*file-reading* #f)
@@ -71,10 +71,7 @@
             (http:encode-uri-string (fromconv str)) opts))
   (define (parse str)
     (receive (cars cdrs)
-        (unzip2 (call-with-input-string
-                 str
-                 (lambda (port)
-                   (json-read port))))
+        (unzip2 (json-read-string str))
       (cons (map toconv cars)
             (map (lambda (x) (map toconv x)) cdrs))))
   (let* ((proxy (make-http-proxy-from-custom))
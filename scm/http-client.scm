@@ -35,7 +35,15 @@
 (require "input-parse.scm")
 (require "openssl.scm")
 
+(guard (err (else #f))
+       (require-dynlib "http"))
+
 (define (http:encode-uri-string str)
+  (if (provided? "http")
+      (http-native-encode-uri-string str)
+      (http:encode-uri-string-internal str)))
+
+(define (http:encode-uri-string-internal str)
   (define hex '("0" "1" "2" "3" "4" "5" "6" "7" "8" "9" "A" "B" "C" "D" "E" "F"))
   (define (hex-format2 x)
     (string-append "%"
@@ -186,38 +194,47 @@
                         (proxy #f)
                         (ssl #f)
                         (request-alist '()))
-    (let* ((with-ssl? (and (provided? "openssl")
-                           (http-ssl? ssl)
-                           (method? ssl)))
-           (call-with-open-file-port-function
-            (if with-ssl?
-                ;; cut
-                (lambda (file thunk)
-                  (call-with-open-openssl-file-port file (method? ssl) thunk))
-                call-with-open-file-port))
-           (file (if (http-proxy? proxy)
-                     (tcp-connect (hostname? proxy) (port? proxy))
-                     (if with-ssl?
-                         (tcp-connect hostname (port? ssl))
-                         (tcp-connect hostname servname)))))
-      (if (not file)
-          (uim-notify-fatal (N_ "cannot connect server")))
-      (call-with-open-file-port-function
-       file
-       (lambda (port)
-         (and-let* ((request (http:make-get-request-string hostname path servname proxy request-alist))
-                    (nr (file-display request port))
-                    (ready? (file-ready? (list (fd? port)) http-timeout))
-                    (proxy-header (if proxy
-                                      (http:read-header port)
-                                      '()))
-                    (header (http:read-header port))
-                    (parsed-header (http:parse-header header)))
-             (let ((content-length (http:content-length? parsed-header)))
-               (cond (content-length
-                      (file-read-buffer port content-length))
-                     ((http:chunked? parsed-header)
-                      (http:read-chunk port))
-                     (else
-                      (file-get-buffer port))))))))))
-
+    (let ((with-ssl? (and (provided? "openssl")
+                          (http-ssl? ssl)
+                          (method? ssl))))
+      ;; the native client pools connections and caches responses, but
+      ;; talks neither to proxies nor over SSL
+      (if (and (provided? "http")
+               (not (http-proxy? proxy))
+               (not with-ssl?))
+          (http-native-get hostname servname path request-alist)
+          (http:get-internal hostname path servname proxy ssl
+                             with-ssl? request-alist)))))
+
+(define (http:get-internal hostname path servname proxy ssl with-ssl? request-alist)
+  (let* ((call-with-open-file-port-function
+          (if with-ssl?
+              ;; cut
+              (lambda (file thunk)
+                (call-with-open-openssl-file-port file (method? ssl) thunk))
+              call-with-open-file-port))
+         (file (if (http-proxy? proxy)
+                   (tcp-connect (hostname? proxy) (port? proxy))
+                   (if with-ssl?
+                       (tcp-connect hostname (port? ssl))
+                       (tcp-connect hostname servname)))))
+    (if (not file)
+        (uim-notify-fatal (N_ "cannot connect server")))
+    (call-with-open-file-port-function
+     file
+     (lambda (port)
+       (and-let* ((request (http:make-get-request-string hostname path servname proxy request-alist))
+                  (nr (file-display request port))
+                  (ready? (file-ready? (list (fd? port)) http-timeout))
+                  (proxy-header (if proxy
+                                    (http:read-header port)
+                                    '()))
+                  (header (http:read-header port))
+                  (parsed-header (http:parse-header header)))
+           (let ((content-length (http:content-length? parsed-header)))
+             (cond (content-length
+                    (file-read-buffer port content-length))
+                   ((http:chunked? parsed-header)
+                    (http:read-chunk port))
+                   (else
+                    (file-get-buffer port)))))))))
@@ -700,6 +700,12 @@
   (N_ "Timeout (msec)")
   (N_ "Timeout of http connection (msec)."))
 
+(define-custom 'http-cache-size 32
+  '(http)
+  '(integer 0 1024)
+  (N_ "Number of cached responses")
+  (N_ "Number of http responses kept to answer repeated requests. 0 disables the cache."))
+
 (load "predict-custom.scm")
 
 
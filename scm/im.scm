@@ -514,6 +514,32 @@
   (lambda (uc custom-sym custom-val)
     (invoke-handler im-custom-set-handler uc custom-sym custom-val)))
 
+;; customs: list of (custom-sym . custom-val)
+(define custom-set-handlers
+  (lambda (uc customs)
+    (for-each (lambda (ent)
+		(custom-set-handler uc (car ent) (cdr ent)))
+	      customs)))
+
+;; batch: "custom-sym\ncustom-val\n" repeated, as carried by a
+;; custom_update_batch helper message. An unterminated entry is ignored.
+(define custom-batch->alist
+  (lambda (batch)
+    (let loop ((lines (string-split batch "\n"))
+	       (customs '()))
+      (if (or (null? lines)
+	      (string=? (car lines) "")
+	      (null? (cdr lines))
+	      (null? (cddr lines)))
+	  (reverse customs)
+	  (loop (cddr lines)
+		(cons (cons (string->symbol (car lines)) (cadr lines))
+		      customs))))))
+
+(define custom-set-batch-handler
+  (lambda (uc batch)
+    (custom-set-handlers uc (custom-batch->alist batch))))
+
 (define get-candidate
   (lambda (uc idx accel-enum-hint)
     (let ((c (invoke-handler im-get-candidate-handler uc idx accel-enum-hint)))
@@ -524,6 +550,18 @@
                (set-cdr! (cdr c) (list (annotation-get-text (car c) (uim-context-encoding uc))))))
       c)))
 
+(define get-candidates
+  (lambda (uc first count display-limit)
+    (let loop ((idx first)
+               (res '()))
+      (if (>= idx (+ first count))
+          (reverse! res)
+          (loop (+ idx 1)
+                (cons (get-candidate uc idx (if (= display-limit 0)
+                                                idx
+                                                (remainder idx display-limit)))
+                      res))))))
+
 (define set-candidate-index
   (lambda (uc idx)
     (invoke-handler im-set-candidate-index-handler uc idx)))
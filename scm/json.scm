@@ -33,6 +33,12 @@
 (require "packrat.scm")
 (require "json-parser-expanded.scm")
 
+(guard (err (else #f))
+       (require-dynlib "json"))
+
+(define json-null (guard (err (else #f))
+                    (void)))
+
 (define (hashtable->vector ht)
   (list->vector (hash-table->alist ht)) )
 
@@ -117,3 +123,8 @@
     (lambda maybe-port
       (read-any (if (pair? maybe-port) (car maybe-port) (current-input-port))))))
 
+;; Decodes str like json-read does.
+(define (json-read-string str)
+  (if (provided? "json")
+      (json-native-read-string str json-null)
+      (call-with-input-string str json-read)))
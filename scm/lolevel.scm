@@ -86,6 +86,14 @@
 (define (call-with-u8list-unpack fmt arg thunk)
   (apply thunk (u8list-unpack fmt arg)))
 
+;; native counterpart of
+;; (call-with-u8list-unpack fmt (string-buf->u8list (file-read fd nbytes)) thunk)
+;; that reads exactly nbytes
+(define (call-with-file-read-unpacked fd nbytes fmt thunk)
+  (let ((l (file-read-unpacked fd nbytes fmt)))
+    (and (list? l)
+         (apply thunk l))))
+
 (define (u8list->string-buf l)
   (map integer->char l))
 (define (string-buf->u8list l)
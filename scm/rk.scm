@@ -53,35 +53,58 @@
     (expect-key-for-seq? #f)))
 (define rk-context-new-internal rk-context-new)
 
+;; a rule name ending with ".rkt" names a compiled rule table in
+;; tables/ (see rktable.scm)
+(define rk-compiled-table-name?
+  (lambda (rule)
+    (and (string? rule)
+         (let ((len (string-length rule)))
+           (and (> len 4)
+                (string=? (substring rule (- len 4) len) ".rkt"))))))
+
 (define rk-context-new
   (lambda (rule immediate-commit back)
-    (if (string? rule)
-      (require "ct.scm"))
-    (let* ((use-table? (string? rule))
-           (find-seq (if use-table?
-                       ct-lib-find-seq
-                       rk-lib-find-seq))
-           (find-partial-seq (if use-table?
+    (cond
+     ((and (rk-compiled-table-name? rule)
+           (begin
+             (require "rktable.scm")
+             (rktable-open rule)))
+      => (lambda (table)
+           (rk-context-new-internal table
+                                    ()
+                                    immediate-commit
+                                    back
+                                    rktable-lib-find-seq
+                                    rktable-lib-find-partial-seq
+                                    rktable-find-cands-incl-minimal-partial
+                                    rktable-lib-expect-seq
+                                    rktable-lib-expect-key-for-seq?)))
+     ((string? rule)
+      (require "ct.scm")
+      (rk-context-new-internal (if (rk-compiled-table-name? rule)
+                                 ;; fall back to the text table
+                                 (string-append
+                                  (substring rule 0 (- (string-length rule) 4))
+                                  ".table")
+                                 rule)
+                               ()
+                               immediate-commit
+                               back
+                               ct-lib-find-seq
                                ct-lib-find-partial-seq
-                               rk-lib-find-partial-seq))
-           (find-cands-incl-minimal-partial (if use-table?
-                                              ct-find-cands-incl-minimal-partial
-                                              rk-find-cands-incl-minimal-partial))
-           (expect-seq (if use-table?
-                         ct-lib-expect-seq
-                         rk-lib-expect-seq))
-           (expect-key-for-seq? (if use-table?
-                                  ct-lib-expect-key-for-seq?
-                                  rk-lib-expect-key-for-seq?)))
-    (rk-context-new-internal rule
-                             ()
-                             immediate-commit
-                             back
-                             find-seq
-                             find-partial-seq
-                             find-cands-incl-minimal-partial
-                             expect-seq
-                             expect-key-for-seq?))))
+                               ct-find-cands-incl-minimal-partial
+                               ct-lib-expect-seq
+                               ct-lib-expect-key-for-seq?))
+     (else
+      (rk-context-new-internal rule
+                               ()
+                               immediate-commit
+                               back
+                               rk-lib-find-seq
+                               rk-lib-find-partial-seq
+                               rk-find-cands-incl-minimal-partial
+                               rk-lib-expect-seq
+                               rk-lib-expect-key-for-seq?)))))
 
 ;; back match
 (define rk-find-longest-back-match
@@ -393,35 +416,41 @@
     (let ((find-cands (rk-context-find-cands-incl-minimal-partial rkc)))
       (find-cands (reverse (rk-context-seq rkc)) (rk-context-rule rkc)))))
 
-;;
+;; returns a find-cands-incl-minimal-partial procedure built on the
+;; equivalents of rk-lib-find-seq and rk-lib-find-partial-seqs
+(define rk-make-find-cands-incl-minimal-partial
+  (lambda (find-seq find-partial-seqs)
+    (lambda (seq rule)
+      (let* ((exact (find-seq seq rule))
+             (partial-seqs (find-partial-seqs seq rule))
+             (seqlen (length seq))
+             (min-size
+               (if (not (null? partial-seqs))
+                 (apply min (filter-map
+                              (lambda (x)
+                                (let ((len (length (caar x))))
+                                  (if (<= len seqlen)
+                                    #f
+                                    len))) partial-seqs))
+                 0))
+             (partial
+               (filter (lambda (x)
+                         (= (length (caar x)) min-size))
+                       partial-seqs))
+             (exact-cands (if exact (cons (cadr exact) "") #f))
+             (pseqs
+               (map (lambda (x) (caar x)) partial))
+             (pseqs-residual-str
+               (map (lambda (y)
+                      (substring (apply string-append y)
+                                 (length seq) (length y))) pseqs))
+             (pcands (map (lambda (x) (cadr x)) partial))
+             (plst (map (lambda (x y) (cons x y)) pcands pseqs-residual-str))
+             )
+        (if exact-cands
+          (cons exact-cands plst)
+          plst)))))
+
 (define rk-find-cands-incl-minimal-partial
-  (lambda (seq rule)
-    (let* ((exact (rk-lib-find-seq seq rule))
-           (partial-seqs (rk-lib-find-partial-seqs seq rule))
-           (seqlen (length seq))
-           (min-size
-             (if (not (null? partial-seqs))
-               (apply min (filter-map
-                            (lambda (x)
-                              (let ((len (length (caar x))))
-                                (if (<= len seqlen)
-                                  #f
-                                  len))) partial-seqs))
-               0))
-           (partial
-             (filter (lambda (x)
-                       (= (length (caar x)) min-size))
-                     partial-seqs))
-           (exact-cands (if exact (cons (cadr exact) "") #f))
-           (pseqs
-             (map (lambda (x) (caar x)) partial))
-           (pseqs-residual-str
-             (map (lambda (y)
-                    (substring (apply string-append y)
-                               (length seq) (length y))) pseqs))
-           (pcands (map (lambda (x) (cadr x)) partial))
-           (plst (map (lambda (x y) (cons x y)) pcands pseqs-residual-str))
-           )
-      (if exact-cands
-        (cons exact-cands plst)
-        plst))))
+  (rk-make-find-cands-incl-minimal-partial rk-lib-find-seq
+                                           rk-lib-find-partial-seqs))
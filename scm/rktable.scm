@@ -0,0 +1,57 @@
+;;;
+;;; Copyright (c) 2010-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;;
+
+;; rktable.scm: provides rk-lib equivalent functions using compiled
+;; rule tables
+;;
+;; A compiled rule table is an mmap(2)-able image of an rk rule list
+;; generated at build time by rktable-lib-compile (see
+;; tables/Makefile.am). rk-context-new uses it when the rule is given as
+;; a table name ending with ".rkt".
+;;
+;; following functions are implemented within C
+;;   rktable-lib-compile
+;;   rktable-lib-open
+;;   rktable-lib-find-seq
+;;   rktable-lib-find-partial-seq
+;;   rktable-lib-find-partial-seqs
+;;   rktable-lib-expect-seq
+;;   rktable-lib-expect-key-for-seq?
+
+(require-dynlib "rktable")
+
+;; returns #f if the table is not available
+(define rktable-open
+  (lambda (name)
+    (rktable-lib-open (string-append (sys-pkgdatadir) "/tables/" name))))
+
+(define rktable-find-cands-incl-minimal-partial
+  (rk-make-find-cands-incl-minimal-partial rktable-lib-find-seq
+                                           rktable-lib-find-partial-seqs))
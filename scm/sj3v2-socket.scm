@@ -116,199 +116,182 @@
 ;; sj3 protocol api
 ;;
 (define (sj3-lib-connect socket user)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8 s8 s8)
-                            $SJ3_CONNECT sj3-protocol-version
-                            "unix" user (format "~a.uim-sj3" (current-process-id)))))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 u32 s8 s8 s8)
+                     (list $SJ3_CONNECT sj3-protocol-version
+                           "unix" user (format "~a.uim-sj3" (current-process-id))))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= -2 (u32->s32 result)))))
 
 (define (sj3-lib-disconnect socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_DISCONNECT)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32)
+                     (list $SJ3_DISCONNECT))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= 0 result))))
 
 (define (sj3-lib-opendict socket dictionary-name passwd)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8) $SJ3_OPENDICT
-                            dictionary-name passwd)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 s8)
+                     (list $SJ3_OPENDICT
+                           dictionary-name passwd))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
+          (call-with-file-read-unpacked
+           socket 4 '(u32)
            (lambda (result)
              result))))))
 
 (define (sj3-lib-closedict socket dict-id)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32) $SJ3_CLOSEDICT dict-id)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 u32)
+                     (list $SJ3_CLOSEDICT dict-id))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= 0 result))))
 
 (define (sj3-lib-openstdy socket stdy-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8) $SJ3_OPENSTDY stdy-name "")))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 s8)
+                     (list $SJ3_OPENSTDY stdy-name ""))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      result)))
 
 (define (sj3-lib-closestdy socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_CLOSESTDY)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32)
+                     (list $SJ3_CLOSESTDY))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      result)))
 
 (define (sj3-lib-stdy-size socket)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32) $SJ3_STDYSIZE)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32)
+                     (list $SJ3_STDYSIZE))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
+          (call-with-file-read-unpacked
+           socket 4 '(u32)
            (lambda (result)
              result))))))
 
 (define (sj3-lib-study socket stdy)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u8list) $SJ3_STUDY stdy)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 u8list)
+                     (list $SJ3_STUDY stdy))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      result)))
 
 (define (sj3-lib-makedict socket dictionary-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32 u32 u32) $SJ3_MAKEDICT
-                            dictionary-name
-                            2048  ; Index length
-                            2048  ; Length
-                            256   ; Number
-                            )))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 u32 u32 u32)
+                     (list $SJ3_MAKEDICT
+                           dictionary-name
+                           2048  ; Index length
+                           2048  ; Length
+                           256   ; Number
+                           ))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= 0 result))))
 
 (define (sj3-lib-makestdy socket stdy-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32 u32 u32) $SJ3_MAKESTDY
-                            stdy-name
-                            2048  ; Number
-                            1     ; Step
-                            2048  ; Length
-                            )))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 u32 u32 u32)
+                     (list $SJ3_MAKESTDY
+                           stdy-name
+                           2048  ; Number
+                           1     ; Step
+                           2048  ; Length
+                           ))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= 0 result))))
 
 (define (sj3-lib-makedir socket directory-name)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8) $SJ3_MAKEDIR directory-name)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8)
+                     (list $SJ3_MAKEDIR directory-name))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      result)))
 
 (define (sj3-lib-access? socket directory-name mode)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 u32) $SJ3_ACCESS
-                            directory-name
-                            mode)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 u32)
+                     (list $SJ3_ACCESS
+                           directory-name
+                           mode))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (= 0 result))))
 
 (define (sj3-lib-ph2knj-euc socket stdy-size yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8) $SJ3_PH2KNJ_EUC yomi)))
-  (call-with-u8list-unpack
-   '(u32 u32) (string-buf->u8list (file-read socket 8))
+  (file-write-packed socket '(u32 s8)
+                     (list $SJ3_PH2KNJ_EUC yomi))
+  (call-with-file-read-unpacked
+   socket 8 '(u32 u32)
    (lambda (result yomi-length)
      (and (= result 0)
-          (let loop ((yomi-len (cons (car (string-buf->u8list (file-read socket 1)))
+          (let loop ((yomi-len (cons (car (file-read-unpacked socket 1 '(u8)))
                                      '()))
                      (rest-stdy '())
                      (rest-kouho '()))
             (if (<= (car yomi-len) 0)
                 (values (reverse yomi-len) (reverse rest-stdy) (reverse rest-kouho))
-                (let* ((new-stdy (string-buf->u8list (file-read socket stdy-size)))
+                (let* ((new-stdy (car (file-read-unpacked socket stdy-size '(u8list))))
                        (new-kouho (file-read-string-with-terminate socket #\nul)))
-                  (loop (cons (car (string-buf->u8list (file-read socket 1)))
+                  (loop (cons (car (file-read-unpacked socket 1 '(u8)))
                               yomi-len)
                         (cons new-stdy rest-stdy)
                         (cons new-kouho rest-kouho)))))))))
 
 (define (sj3-lib-cl2knj-all-euc socket stdy-size len yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8) $SJ3_CL2KNJ_ALL_EUC len yomi)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 u32 s8)
+                     (list $SJ3_CL2KNJ_ALL_EUC len yomi))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (and (= result 0)
           (let loop ((yomi-len
-                      (cons (u8list->u32 (string-buf->u8list (file-read socket 4)))
+                      (cons (car (file-read-unpacked socket 4 '(u32)))
                             '()))
                      (rest-stdy '())
                      (rest-kouho '()))
             (if (<= (car yomi-len) 0)
                 (values (reverse yomi-len) (reverse rest-stdy) (reverse rest-kouho))
-                (let* ((new-stdy (string-buf->u8list (file-read socket stdy-size)))
+                (let* ((new-stdy (car (file-read-unpacked socket stdy-size '(u8list))))
                        (new-kouho (file-read-string-with-terminate socket #\nul)))
-                  (loop (cons (u8list->u32 (string-buf->u8list (file-read socket 4)))
+                  (loop (cons (car (file-read-unpacked socket 4 '(u32)))
                               yomi-len)
                         (cons new-stdy rest-stdy)
                         (cons new-kouho rest-kouho)))))))))
 
 (define (sj3-lib-cl2knj-cnt-euc socket stdy-size len yomi)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 u32 s8) $SJ3_CL2KNJ_CNT_EUC len yomi)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 u32 s8)
+                     (list $SJ3_CL2KNJ_CNT_EUC len yomi))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      (and (= result 0)
-          (call-with-u8list-unpack
-           '(u32) (string-buf->u8list (file-read socket 4))
+          (call-with-file-read-unpacked
+           socket 4 '(u32)
            (lambda (result)
              result))))))
 
 (define (sj3-lib-clstudy-euc socket yomi1 yomi2 stdy)
-  (file-write socket
-              (u8list->string-buf
-               (u8list-pack '(u32 s8 s8 u8list) $SJ3_CLSTUDY_EUC
-                            yomi1 yomi2 stdy)))
-  (call-with-u8list-unpack
-   '(u32) (string-buf->u8list (file-read socket 4))
+  (file-write-packed socket '(u32 s8 s8 u8list)
+                     (list $SJ3_CLSTUDY_EUC
+                           yomi1 yomi2 stdy))
+  (call-with-file-read-unpacked
+   socket 4 '(u32)
    (lambda (result)
      result)))
 
@@ -372,6 +372,17 @@
 		 (lambda ()
 		   skk-skkserv-enable-completion?))
 
+(define-custom 'skk-skkserv-timeout 1000
+  '(skk-dict skkserv)
+  '(integer -1 65535)
+  (N_ "Timeout for skkserv lookup (msec)")
+  (N_ "long description will be here."))
+
+(custom-add-hook 'skk-skkserv-timeout
+		 'custom-activity-hooks
+		 (lambda ()
+		   skk-use-skkserv?))
+
 (define-custom 'skk-skkserv-use-env? #t
   '(skk-dict skkserv)
   '(boolean)
@@ -428,6 +439,17 @@
   (N_ "System dictionary file")
   (N_ "long description will be here."))
 
+(define-custom 'skk-dic-enable-completion? #f
+  '(skk-dict dict-files)
+  '(boolean)
+  (N_ "Complete with entries of system dictionary file")
+  (N_ "long description will be here."))
+
+(custom-add-hook 'skk-dic-enable-completion?
+		 'custom-activity-hooks
+		 (lambda ()
+		   (not skk-use-skkserv?)))
+
 (define-custom 'skk-personal-dic-filename
   (string-append (or (home-directory (user-name)) "") "/.skk-jisyo")
   '(skk-dict dict-files)
@@ -39,13 +39,16 @@
 (define toolbar-help-url-locale-alist
   '(("ja" . "http://code.google.com/p/uim-doc-ja/wiki/")))
 
+;; closes fd
 (define (uim-help-set-branch! fd)
   (let ((port (open-file-port fd)))
     (let loop ((line (file-read-line port)))
-      (let ((ret (string-split line "\t")))
-        (if (string=? (car ret) "branch")
-            (set! uim-help-branch (string->symbol (list-ref ret 1)))
-            (loop (file-read-line port)))))))
+      (if (string? line)
+          (let ((ret (string-split line "\t")))
+            (if (string=? (car ret) "branch")
+                (set! uim-help-branch (string->symbol (list-ref ret 1)))
+                (loop (file-read-line port))))))
+    (close-file-port port)))
 
 (define (make-wikiname im)
   (apply string-append
@@ -32,7 +32,7 @@
 ;;
 (define zm-init-handler
   (lambda (id im arg)
-    (generic-context-new id im "zm.table" #f)))
+    (generic-context-new id im "zm.rkt" #f)))
 
 (generic-register-im
  'zm
@@ -44,7 +44,7 @@
 
 (define wb86-init-handler
   (lambda (id im arg)
-    (generic-context-new id im "wb86.table" #f)))
+    (generic-context-new id im "wb86.rkt" #f)))
 
 (generic-register-im
  'wb86
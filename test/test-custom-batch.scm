@@ -0,0 +1,114 @@
+;;; -*- coding: utf-8 -*-
+;;;
+;;; Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.custom-batch
+  (use test.unit.test-case)
+  (use test.uim-test)
+  (use file.util))
+(select-module test.custom-batch)
+
+(define customs-dir (uim-test-build-path "test" "customs"))
+
+(define (setup)
+  (make-directory* customs-dir)
+  (with-output-to-file (build-path customs-dir "custom-test-batch.scm")
+    (lambda ()
+      (write '(define test-batch-var 42))))
+  (uim-test-setup)
+  (uim-eval '(require "im.scm")))
+
+(define (teardown)
+  (uim-test-teardown)
+  (remove-directory* customs-dir))
+
+(define (test-custom-batch->alist)
+  (assert-uim-equal '((anthy-nr-candidate-max . "10")
+                      (toolbar-show-action-based-switcher-button? . "#f")
+                      (enabled-im-list . "'(anthy skk)"))
+                    '(custom-batch->alist
+                      (string-append "anthy-nr-candidate-max\n10\n"
+                                     "toolbar-show-action-based-switcher-button?\n#f\n"
+                                     "enabled-im-list\n'(anthy skk)\n")))
+  ;; values may be empty strings
+  (assert-uim-equal '((skk-dic-file-name . "\"\""))
+                    '(custom-batch->alist "skk-dic-file-name\n\"\"\n"))
+  (assert-uim-equal '()
+                    '(custom-batch->alist ""))
+  ;; an unterminated entry is ignored
+  (assert-uim-equal '((anthy-nr-candidate-max . "10"))
+                    '(custom-batch->alist "anthy-nr-candidate-max\n10\nskk-use-candidate-window?\n#t"))
+  (assert-uim-equal '((anthy-nr-candidate-max . "10"))
+                    '(custom-batch->alist "anthy-nr-candidate-max\n10\nskk-use-candidate-window?\n"))
+  #f)
+
+(define (test-custom-set-batch-handler)
+  (uim-eval '(begin
+               (define test-applied '())
+               (define custom-set-handler
+                 (lambda (uc custom-sym custom-val)
+                   (set! test-applied
+                         (cons (list uc custom-sym custom-val) test-applied))))))
+  (uim-eval '(custom-set-batch-handler
+              'test-uc
+              "anthy-nr-candidate-max\n10\nskk-use-candidate-window?\n#t\n"))
+  (assert-uim-equal '((test-uc anthy-nr-candidate-max "10")
+                      (test-uc skk-use-candidate-window? "#t"))
+                    '(reverse test-applied))
+  #f)
+
+;; A process without an input context, such as a toolbar, picks up the
+;; customs saved by uim-pref through custom_reload_notify
+;; (uim_prop_reload_configs()), which also runs every custom hook.
+(define (test-reload-without-context)
+  (uim-eval
+   `(begin
+      (define test-hook-called? #f)
+      (define-custom 'test-batch-var 1
+        '(test-batch)
+        '(integer 0 100)
+        "test batch var"
+        "long description will be here.")
+      (custom-add-hook 'test-batch-var 'custom-set-hooks
+                       (lambda ()
+                         (set! test-hook-called? #t)))
+      (define custom-file-path
+        (lambda (gsym)
+          (string-append ,customs-dir "/custom-" (symbol->string gsym) ".scm")))
+      ;; cancels LIBUIM_VANILLA=1
+      (unsetenv "LIBUIM_VANILLA")))
+  (assert-uim-equal 1 'test-batch-var)
+  (assert-uim-false 'test-hook-called?)
+  (uim-eval '(custom-reload-user-configs))
+  (assert-uim-equal 42 'test-batch-var)
+  (assert-uim-true 'test-hook-called?)
+  #f)
+
+(provide "test/custom-batch")
@@ -0,0 +1,126 @@
+;;; -*- coding: utf-8 -*-
+;;;
+;;; Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.fileio
+  (use test.unit.test-case)
+  (use test.uim-test))
+(select-module test.fileio)
+
+(define (setup)
+  (uim-test-setup)
+  (uim-eval '(require "fileio.scm"))
+  (uim-eval '(begin
+               (define test-pipe (create-pipe))
+               (define (test-close-writer)
+                 (file-close (cdr test-pipe))
+                 (set-cdr! test-pipe -1)))))
+
+(define (teardown)
+  (uim-eval '(begin
+               (if (<= 0 (car test-pipe))
+                   (file-close (car test-pipe)))
+               (if (<= 0 (cdr test-pipe))
+                   (file-close (cdr test-pipe)))))
+  (uim-test-teardown))
+
+(define (test-file-write-string)
+  (assert-uim-equal 11
+                    '(file-write-string (cdr test-pipe) "hello world"))
+  (assert-uim-equal "hello"
+                    '(file-read-string (car test-pipe) 5))
+  (assert-uim-equal " world"
+                    '(file-read-string (car test-pipe) 64))
+  (uim-eval '(test-close-writer))
+  (assert-uim-true '(eof-object? (file-read-string (car test-pipe) 64)))
+  #f)
+
+(define (test-file-read-delimited)
+  (uim-eval '(file-write-string (cdr test-pipe) "abc\ndef\r\nghi"))
+  ;; the delimiter is consumed, and nothing after it
+  (assert-uim-equal "abc"
+                    '(file-read-delimited (car test-pipe) #\newline))
+  (assert-uim-equal "def"
+                    '(file-read-delimited (car test-pipe) "\r\n"))
+  (assert-uim-equal "gh"
+                    '(file-read-string (car test-pipe) 2))
+  (uim-eval '(test-close-writer))
+  ;; no delimiter before EOF
+  (assert-uim-true '(eof-object? (file-read-delimited (car test-pipe)
+                                                      #\newline)))
+  #f)
+
+(define (test-file-port)
+  (uim-eval '(begin
+               (file-write-string (cdr test-pipe) "line1\nline2\n0123456789rest")
+               (test-close-writer)
+               (define test-port (open-file-port (car test-pipe)))))
+  (assert-uim-equal #\l
+                    '(file-peek-char test-port))
+  (assert-uim-equal "line1"
+                    '(file-read-line test-port))
+  (assert-uim-equal #\l
+                    '(file-read-char test-port))
+  (assert-uim-equal "ine2"
+                    '(file-read-line test-port))
+  (assert-uim-equal "0123"
+                    '(file-read-buffer test-port 4))
+  (assert-uim-equal "456789rest"
+                    '(file-get-buffer test-port))
+  (assert-uim-equal "456789"
+                    '(file-read-buffer test-port 6))
+  ;; a partial line at EOF
+  (assert-uim-equal "rest"
+                    '(file-read-line test-port))
+  (assert-uim-true '(eof-object? (file-read-line test-port)))
+  (uim-eval '(begin
+               (close-file-port test-port)
+               ;; closed by the port
+               (set-car! test-pipe -1)))
+  (assert-uim-false '(fd? test-port))
+  #f)
+
+(define (test-file-port-growth)
+  ;; longer than the native buffer
+  (uim-eval '(begin
+               (define test-long-line (make-string 10000 #\a))
+               (file-write-string (cdr test-pipe) test-long-line)
+               (file-write-string (cdr test-pipe) "\nb\n")
+               (test-close-writer)
+               (define test-port (open-file-port (car test-pipe)))))
+  (assert-uim-true '(string=? test-long-line (file-read-line test-port)))
+  (assert-uim-equal "b"
+                    '(file-read-line test-port))
+  (uim-eval '(begin
+               (close-file-port test-port)
+               (set-car! test-pipe -1)))
+  #f)
+
+(provide "test/fileio")
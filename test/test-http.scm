@@ -0,0 +1,166 @@
+;;; -*- coding: utf-8 -*-
+;;;
+;;; Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.http
+  (use gauche.net)
+  (use srfi-13)
+  (use test.unit.test-case)
+  (use test.uim-test))
+(select-module test.http)
+
+(define *server-pid* #f)
+(define *server-port* #f)
+
+;; A stand-in server run in a child process.  It serves one connection
+;; at a time and answers each request with the number of the connection
+;; and of the request, so that reuse of pooled connections and cached
+;; responses can be told apart.  After "/drop-next" it keeps the
+;; connection alive but closes it on the next request without an
+;; answer, as a server timing out an idle connection would.
+(define (serve-connection client conn-count request-count)
+  (let ((in (socket-input-port client))
+        (out (socket-output-port client)))
+    (define (respond status-line headers body)
+      (display (string-append status-line "\r\n" headers "\r\n" body) out)
+      (flush out))
+    (let loop ((request-count request-count)
+               (drop? #f))
+      (let ((line (read-line in)))
+        (if (or (eof-object? line) drop?)
+            (begin
+              (socket-close client)
+              request-count)
+            (let ((path (cadr (string-split line #\space)))
+                  (body (format "conn ~d request ~d" conn-count request-count)))
+              (let skip-headers ()
+                (let ((header (read-line in)))
+                  (if (not (or (eof-object? header)
+                               (string-null? (string-trim-right header))))
+                      (skip-headers))))
+              (cond
+               ((string=? path "/chunked")
+                (respond "HTTP/1.1 200 OK"
+                         "Transfer-Encoding: chunked\r\n"
+                         "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n")
+                (loop (+ request-count 1) #f))
+               ((string=? path "/close")
+                (respond "HTTP/1.0 200 OK" "" body)
+                (socket-close client)
+                (+ request-count 1))
+               (else
+                (respond "HTTP/1.1 200 OK"
+                         (format "Content-Length: ~d\r\n"
+                                 (string-length body))
+                         body)
+                (loop (+ request-count 1)
+                      (string=? path "/drop-next"))))))))))
+
+(define (start-server)
+  (let ((server (make-server-socket 'inet 0 :reuse-addr? #t)))
+    (set! *server-port* (sockaddr-port (socket-address server)))
+    (let ((pid (sys-fork)))
+      (if (zero? pid)
+          (let loop ((conn-count 1)
+                     (request-count 1))
+            (loop (+ conn-count 1)
+                  (serve-connection (socket-accept server)
+                                    conn-count request-count)))
+          (begin
+            (socket-close server)
+            (set! *server-pid* pid))))))
+
+(define (stop-server)
+  (sys-kill *server-pid* SIGTERM)
+  (sys-waitpid *server-pid*)
+  (set! *server-pid* #f))
+
+(define (setup)
+  ;; before uim-sh starts so that the server does not hold its pipes
+  (start-server)
+  (uim-test-setup)
+  (uim-eval '(begin
+               (define http-timeout 3000)
+               (define http-cache-size 32)
+               (require "http-client.scm")))
+  (uim-eval `(define test-port ,*server-port*)))
+
+(define (teardown)
+  (uim-test-teardown)
+  (stop-server))
+
+(define (test-http-get)
+  (assert-uim-true '(provided? "http"))
+  (assert-uim-equal "conn 1 request 1"
+                    '(http:get "127.0.0.1" "/a" test-port))
+  ;; the connection is pooled
+  (assert-uim-equal "conn 1 request 2"
+                    '(http:get "127.0.0.1" "/b" test-port))
+  ;; the response is cached
+  (assert-uim-equal "conn 1 request 1"
+                    '(http:get "127.0.0.1" "/a" test-port))
+  ;; extra header fields bypass the cache
+  (assert-uim-equal "conn 1 request 3"
+                    '(http:get "127.0.0.1" "/a" test-port #f #f
+                               '(("X-Test" . "1"))))
+  (assert-uim-equal "hello world"
+                    '(http:get "127.0.0.1" "/chunked" test-port))
+  #f)
+
+(define (test-http-get-close)
+  (assert-uim-equal "conn 1 request 1"
+                    '(http:get "127.0.0.1" "/close" test-port))
+  ;; a new connection once the server has closed the last one
+  (assert-uim-equal "conn 2 request 2"
+                    '(http:get "127.0.0.1" "/a" test-port))
+  (uim-eval '(http-native-flush!))
+  (assert-uim-equal "conn 3 request 3"
+                    '(http:get "127.0.0.1" "/a" test-port))
+  #f)
+
+(define (test-http-get-stale)
+  (assert-uim-equal "conn 1 request 1"
+                    '(http:get "127.0.0.1" "/drop-next" test-port))
+  ;; the pooled connection is closed once the request is sent: the
+  ;; request is retried on a new one
+  (assert-uim-equal "conn 2 request 2"
+                    '(http:get "127.0.0.1" "/a" test-port))
+  (assert-uim-equal "conn 2 request 3"
+                    '(http:get "127.0.0.1" "/b" test-port))
+  #f)
+
+(define (test-http-encode-uri-string)
+  (assert-uim-equal "%61%20%2F"
+                    '(http:encode-uri-string "a /"))
+  (assert-uim-equal ""
+                    '(http:encode-uri-string ""))
+  #f)
+
+(provide "test/http")
@@ -29,8 +29,6 @@
 ;;; SUCH DAMAGE.
 ;;;
 
-;; These tests are passed at revision 6605 (new repository)
-
 (define-module test.iconv
   (use gauche.charconv)
   (use test.unit.test-case)
@@ -56,4 +54,51 @@
                   "eucJP" "utf-8")))
   #f)
 
+(define (test-conv-ascii)
+  (uim-eval '(set! iconv (iconv-open "eucJP" "utf-8")))
+  (assert-uim-equal "abc 123"
+                    '(iconv-code-conv iconv "abc 123"))
+  (assert-uim-equal ""
+                    '(iconv-code-conv iconv ""))
+  #f)
+
+(define (test-conv-long)
+  ;; longer than the scratch buffer kept between conversions
+  (let ((str (apply string-append
+                    (make-list 2000 "あいうえおabc"))))
+    (uim-eval '(set! iconv (iconv-open "eucJP" "utf-8")))
+    (uim-eval `(define test-str ,str))
+    (assert-equal str
+                  (uim-read-from-string
+                   (ces-convert (uim-eval '(iconv-code-conv iconv test-str))
+                                "eucJP" "utf-8")))
+    (assert-equal "かきくけこ"
+                  (uim-read-from-string
+                   (ces-convert (uim-eval '(iconv-code-conv iconv "かきくけこ"))
+                                "eucJP" "utf-8"))))
+  #f)
+
+(define (test-conv-after-error)
+  (uim-eval '(begin
+               (set! iconv (iconv-open "ISO-2022-JP" "UTF-8"))
+               (define test-iconv (iconv-open "ISO-2022-JP" "UTF-8"))))
+  ;; not in JIS X 0208
+  (assert-uim-equal ""
+                    '(iconv-code-conv iconv "あ①"))
+  ;; no shift state is left over from the failed conversion
+  (assert-uim-true '(string=? (iconv-code-conv test-iconv "あ")
+                              (iconv-code-conv iconv "あ")))
+  (uim-eval '(iconv-release test-iconv))
+  #f)
+
+(define (test-open)
+  ;; aliases of the same encoding need no converter
+  (assert-uim-false '(iconv-open "EUC-JP" "eucJP"))
+  (assert-uim-false '(iconv-open "UTF-8" "UTF-8"))
+  (assert-uim-false '(iconv-open "no-such-encoding" "UTF-8"))
+  (assert-uim-true '(begin
+                      (set! iconv (iconv-open "EUC-JP" "UTF-8"))
+                      (and iconv #t)))
+  #f)
+
 (provide "test/iconv")
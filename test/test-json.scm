@@ -0,0 +1,77 @@
+;;; -*- coding: utf-8 -*-
+;;;
+;;; Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.json
+  (use test.unit.test-case)
+  (use test.uim-test))
+(select-module test.json)
+
+(define (setup)
+  (uim-test-setup)
+  (uim-eval '(require "json.scm"))
+  (uim-eval '(define (test-json-same? str)
+               (equal? (json-native-read-string str json-null)
+                       (call-with-input-string str json-read)))))
+
+(define (teardown)
+  (uim-test-teardown))
+
+;; a response of the Google CGI API for Japanese Input
+(define test-google-response
+  "[[\"ここでは\",[\"ここでは\",\"個々では\",\"此処では\"]],[\"きものを\",[\"着物を\",\"きものを\",\"キモノを\"]],[\"ぬぐ\",[\"脱ぐ\",\"ヌグ\",\"ぬぐ\"]]]")
+
+(define (test-json-read-string)
+  (assert-uim-true '(provided? "json"))
+  (uim-eval `(define test-response ,test-google-response))
+  (assert-uim-true '(test-json-same? test-response))
+  (assert-uim-equal '(("ここでは" "個々では" "此処では")
+                      ("着物を" "きものを" "キモノを")
+                      ("脱ぐ" "ヌグ" "ぬぐ"))
+                    '(map cadr (json-read-string test-response)))
+  #f)
+
+(define (test-json-native-read-string)
+  (assert-uim-true '(test-json-same?
+                     "{\"a\": [1, -2, true, false, null], \"b\": {}}"))
+  (assert-uim-true '(test-json-same? "[\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"]"))
+  (assert-uim-true '(test-json-same? "[\"\\u3042\\u0041\"]"))
+  (assert-uim-true '(test-json-same? "/* comment */ [] // comment"))
+  (assert-uim-equal '(1 "a" #t)
+                    '(json-native-read-string "[1, \"a\", true]" json-null))
+  (assert-uim-equal "あA"
+                    '(json-native-read-string "\"\\u3042\\u0041\"" json-null))
+  (assert-uim-true '(vector?
+                     (json-native-read-string "{\"a\": 1}" json-null)))
+  (assert-uim-error '(json-native-read-string "[1, 2" json-null))
+  (assert-uim-error '(json-native-read-string "{\"a\" 1}" json-null))
+  #f)
+
+(provide "test/json")
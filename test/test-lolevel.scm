@@ -0,0 +1,157 @@
+;;; -*- coding: utf-8 -*-
+;;;
+;;; Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.lolevel
+  (use test.unit.test-case)
+  (use test.uim-test))
+(select-module test.lolevel)
+
+(define (setup)
+  (uim-test-setup)
+  (uim-eval '(begin
+               (require "fileio.scm")
+               (require "lolevel.scm")
+               (define test-pipe (create-pipe))
+               (define (test-close-writer)
+                 (file-close (cdr test-pipe))
+                 (set-cdr! test-pipe -1))
+               (define (test-pack-unpack pack unpack fmt args)
+                 (let* ((p (pack fmt args))
+                        (ret (unpack (car p) (cdr p) fmt)))
+                   (free (car p))
+                   ret))
+               (define (test-pack->u8list pack fmt args)
+                 (let* ((p (pack fmt args))
+                        (ret (pointer->u8list (car p) (cdr p))))
+                   (free (car p))
+                   ret)))))
+
+(define (teardown)
+  (uim-eval '(begin
+               (file-close (car test-pipe))
+               (if (<= 0 (cdr test-pipe))
+                   (file-close (cdr test-pipe)))))
+  (uim-test-teardown))
+
+(define (test-pointer-pack)
+  (assert-uim-equal '(1 0 2 0 0 0 3 97 98 0 99 0 0 4 5)
+                    '(test-pack->u8list pointer-pack
+                                        '(u8 u16 u32 s8 s16 u8list)
+                                        '(1 2 3 "ab" "c" (4 5))))
+  (assert-uim-equal '(2 0 3 0 0 0 0 1 1 0)
+                    '(test-pack->u8list pointer-pack-le
+                                        '(u16 u32 u16list)
+                                        '(2 3 (256 1))))
+  ;; same bytes as the Scheme implementation
+  (assert-uim-true '(equal? (u8list-pack '(u16 u32 s8 u8list)
+                                         513 65536 "xyz" '(7))
+                            (test-pack->u8list pointer-pack
+                                               '(u16 u32 s8 u8list)
+                                               '(513 65536 "xyz" (7)))))
+  #f)
+
+(define (test-pointer-unpack)
+  (assert-uim-equal '(1 2 3 "ab" "c" (4 5))
+                    '(test-pack-unpack pointer-pack pointer-unpack
+                                       '(u8 u16 u32 s8 s16 u8list)
+                                       '(1 2 3 "ab" "c" (4 5))))
+  (assert-uim-equal '(65535 305419896)
+                    '(test-pack-unpack pointer-pack-le pointer-unpack-le
+                                       '(u16 u32)
+                                       '(65535 305419896)))
+  ;; too short for the format
+  (uim-eval '(define (test-unpack-as pack-fmt args fmt)
+               (let* ((p (pointer-pack pack-fmt args))
+                      (ret (pointer-unpack (car p) (cdr p) fmt)))
+                 (free (car p))
+                 ret)))
+  (assert-uim-false '(test-unpack-as '(u16) '(1) '(u32)))
+  (assert-uim-false '(test-unpack-as '(u8list) '((97 98)) '(s8)))
+  (assert-uim-equal '("ab")
+                    '(test-unpack-as '(u8list) '((97 98 0)) '(s8)))
+  #f)
+
+(define (test-file-read-unpacked)
+  (uim-eval '(file-write-packed (cdr test-pipe) '(u32 u8 s8)
+                                '(70000 255 "dic")))
+  (assert-uim-equal '(70000 255)
+                    '(file-read-unpacked (car test-pipe) 5 '(u32 u8)))
+  (assert-uim-equal '("dic")
+                    '(file-read-unpacked (car test-pipe) 4 '(s8)))
+  (assert-uim-equal '(7 (1 2))
+                    '(begin
+                       (file-write-packed-le (cdr test-pipe) '(u16 u8list)
+                                             '(7 (1 2)))
+                       (file-read-unpacked-le (car test-pipe) 4
+                                              '(u16 u8list))))
+  (assert-uim-equal 3
+                    '(call-with-file-read-unpacked
+                      (begin
+                        (file-write-packed (cdr test-pipe) '(u8 u8) '(1 2))
+                        (car test-pipe))
+                      2 '(u8 u8) +))
+  ;; a reply cut short by EOF
+  (uim-eval '(begin
+               (file-write-packed (cdr test-pipe) '(u16) '(1))
+               (test-close-writer)))
+  (assert-uim-false '(file-read-unpacked (car test-pipe) 4 '(u32)))
+  (assert-uim-true '(eof-object? (file-read-unpacked (car test-pipe) 4
+                                                     '(u32))))
+  #f)
+
+;; Canna replies: (u8 op, u8 0, u16 len, u16 n) and len - 2 more bytes,
+;; where a list of s16 strings ends with another two NULs
+(define (test-file-read-unpacked-replies)
+  (uim-eval '(begin
+               (file-write-packed (cdr test-pipe)
+                                  '(u8 u8 u16 u16 s16 s16 u16)
+                                  '(17 0 12 2 "ab" "cd" 0))
+               (file-write-packed (cdr test-pipe)
+                                  '(u8 u8 u16 u16 s16 u16)
+                                  '(17 0 8 1 "ef" 0))
+               (define (test-read-cands)
+                 (call-with-file-read-unpacked
+                  (car test-pipe) 6 '(u16 u16 u16)
+                  (lambda (dummy len n)
+                    (call-with-file-read-unpacked
+                     (car test-pipe) (- len 2) (make-list n 's16)
+                     list))))))
+  (assert-uim-equal '("ab" "cd")
+                    '(test-read-cands))
+  ;; the terminator of the first reply is not taken for the second
+  (assert-uim-equal '("ef")
+                    '(test-read-cands))
+  (uim-eval '(test-close-writer))
+  (assert-uim-true '(eof-object? (file-read-unpacked (car test-pipe) 6
+                                                     '(u16 u16 u16))))
+  #f)
+
+(provide "test/lolevel")
@@ -0,0 +1,334 @@
+/*
+
+  Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Checks the preedit callbacks of uim_set_preedit_diff_cb().  A model
+ * bridge applies each replacement to its own segment list, which must
+ * then equal the segments pushed back by the IM, less the empty ones
+ * that mark no position.  Updates are driven through the Scheme
+ * procedures an IM calls.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+
+#define MAX_SEGS 12
+#define NR_ROUNDS 20000
+
+struct seg {
+  int attr;
+  const char *str;
+};
+
+/* the preedit as known to the bridge */
+struct model {
+  int nr_segs;
+  int attrs[MAX_SEGS];
+  char *strs[MAX_SEGS];
+  int nr_replaced;
+  int nr_updated;
+};
+
+static int nr_failures;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);	\
+      nr_failures++;							\
+    }									\
+  } while (0)
+
+static const int attr_samples[] = {
+  UPreeditAttr_None,
+  UPreeditAttr_UnderLine,
+  UPreeditAttr_Reverse,
+  UPreeditAttr_Cursor,
+  UPreeditAttr_Separator,
+  UPreeditAttr_UnderLine | UPreeditAttr_Cursor
+};
+
+static const char *const str_samples[] = {
+  "", "a", "b", "ab", "\xe3\x81\x82"  /* HIRAGANA LETTER A */
+};
+
+#define NR_SAMPLES(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static void
+replace_cb(void *ptr, int first, int nr_removed, int nr_added,
+	   const int *attrs, const char *const *strs)
+{
+  struct model *m = ptr;
+  int i;
+
+  m->nr_replaced++;
+  CHECK(first >= 0 && nr_removed >= 0 && nr_added >= 0);
+  CHECK(first + nr_removed <= m->nr_segs);
+  CHECK(m->nr_segs - nr_removed + nr_added <= MAX_SEGS);
+  CHECK(strs[nr_added] == NULL);
+  if (nr_failures)
+    return;
+
+  for (i = first; i < first + nr_removed; i++)
+    free(m->strs[i]);
+  memmove(&m->attrs[first + nr_added], &m->attrs[first + nr_removed],
+	  sizeof(m->attrs[0]) * (m->nr_segs - first - nr_removed));
+  memmove(&m->strs[first + nr_added], &m->strs[first + nr_removed],
+	  sizeof(m->strs[0]) * (m->nr_segs - first - nr_removed));
+  for (i = 0; i < nr_added; i++) {
+    m->attrs[first + i] = attrs[i];
+    m->strs[first + i] = strdup(strs[i]);
+  }
+  m->nr_segs += nr_added - nr_removed;
+}
+
+static void
+update_cb(void *ptr)
+{
+  struct model *m = ptr;
+
+  m->nr_updated++;
+}
+
+static void
+commit_cb(void *ptr, const char *str)
+{
+}
+
+static int
+shown(int attr, const char *str)
+{
+  return (strcmp(str, "")
+	  || (attr & (UPreeditAttr_Cursor | UPreeditAttr_Separator)));
+}
+
+/* whether the bridge holds exactly the shown segments of segs */
+static int
+model_equal(const struct model *m, const struct seg *segs, int nr_segs)
+{
+  int i, j;
+
+  for (i = j = 0; i < nr_segs; i++) {
+    if (!shown(segs[i].attr, segs[i].str))
+      continue;
+    if (j == m->nr_segs || m->attrs[j] != segs[i].attr
+	|| strcmp(m->strs[j], segs[i].str))
+      return 0;
+    j++;
+  }
+  return (j == m->nr_segs);
+}
+
+static void
+model_release(struct model *m)
+{
+  int i;
+
+  for (i = 0; i < m->nr_segs; i++)
+    free(m->strs[i]);
+  m->nr_segs = 0;
+}
+
+static void
+clear(uim_context uc)
+{
+  uim_scm_callf("im-clear-preedit", "p", uc);
+}
+
+static void
+pushback(uim_context uc, int attr, const char *str)
+{
+  uim_scm_callf("im-pushback-preedit", "pis", uc, attr, str);
+}
+
+static void
+update(uim_context uc)
+{
+  uim_scm_callf("im-update-preedit", "p", uc);
+}
+
+static void
+random_seg(struct seg *seg)
+{
+  seg->attr = attr_samples[rand() % NR_SAMPLES(attr_samples)];
+  seg->str = str_samples[rand() % NR_SAMPLES(str_samples)];
+}
+
+/* edits the preedit at random, mostly in a way that keeps both ends */
+static int
+random_edit(struct seg *segs, int nr_segs)
+{
+  int i, pos;
+
+  switch (rand() % 4) {
+  case 0:
+    nr_segs = rand() % (MAX_SEGS / 2);
+    for (i = 0; i < nr_segs; i++)
+      random_seg(&segs[i]);
+    break;
+  case 1:
+    if (nr_segs < MAX_SEGS / 2) {
+      pos = rand() % (nr_segs + 1);
+      memmove(&segs[pos + 1], &segs[pos], sizeof(segs[0]) * (nr_segs - pos));
+      random_seg(&segs[pos]);
+      nr_segs++;
+    }
+    break;
+  case 2:
+    if (nr_segs) {
+      pos = rand() % nr_segs;
+      memmove(&segs[pos], &segs[pos + 1],
+	      sizeof(segs[0]) * (nr_segs - pos - 1));
+      nr_segs--;
+    }
+    break;
+  default:
+    if (nr_segs)
+      random_seg(&segs[rand() % nr_segs]);
+    break;
+  }
+  return nr_segs;
+}
+
+static void
+check_fixed(uim_context uc, struct model *m)
+{
+  int nr_replaced;
+
+  clear(uc);
+  pushback(uc, UPreeditAttr_UnderLine, "a");
+  pushback(uc, UPreeditAttr_None, "");
+  pushback(uc, UPreeditAttr_Reverse, "b");
+  pushback(uc, UPreeditAttr_Cursor, "");
+  update(uc);
+  CHECK(m->nr_segs == 3 && m->attrs[2] == UPreeditAttr_Cursor);
+
+  /* an unchanged preedit is not delivered */
+  nr_replaced = m->nr_replaced;
+  clear(uc);
+  pushback(uc, UPreeditAttr_UnderLine, "a");
+  pushback(uc, UPreeditAttr_Reverse, "b");
+  pushback(uc, UPreeditAttr_Cursor, "");
+  update(uc);
+  CHECK(m->nr_replaced == nr_replaced);
+
+  /* only the changed segment is */
+  clear(uc);
+  pushback(uc, UPreeditAttr_UnderLine, "a");
+  pushback(uc, UPreeditAttr_Reverse, "c");
+  pushback(uc, UPreeditAttr_Cursor, "");
+  update(uc);
+  CHECK(m->nr_replaced == nr_replaced + 1);
+  CHECK(m->nr_segs == 3 && !strcmp(m->strs[1], "c"));
+
+  /* a bridge that dropped its preedit gets the whole of it again */
+  model_release(m);
+  uim_reset_preedit_diff(uc);
+  clear(uc);
+  pushback(uc, UPreeditAttr_UnderLine, "a");
+  pushback(uc, UPreeditAttr_Reverse, "c");
+  pushback(uc, UPreeditAttr_Cursor, "");
+  update(uc);
+  CHECK(m->nr_segs == 3);
+
+  clear(uc);
+  update(uc);
+  CHECK(m->nr_segs == 0);
+}
+
+static void
+check_random(uim_context uc, struct model *m)
+{
+  struct seg segs[MAX_SEGS];
+  int nr_segs, nr_appended, round, i, nr_replaced, nr_updated;
+
+  nr_segs = 0;
+  srand(1);
+  for (round = 0; round < NR_ROUNDS && !nr_failures; round++) {
+    nr_replaced = m->nr_replaced;
+    nr_updated = m->nr_updated;
+    if (rand() % 8) {
+      nr_segs = random_edit(segs, nr_segs);
+      clear(uc);
+      for (i = 0; i < nr_segs; i++)
+	pushback(uc, segs[i].attr, segs[i].str);
+    } else {
+      /* appends to the preedit without clearing it */
+      nr_appended = rand() % (MAX_SEGS - nr_segs + 1);
+      for (i = nr_segs; i < nr_segs + nr_appended; i++) {
+	random_seg(&segs[i]);
+	pushback(uc, segs[i].attr, segs[i].str);
+      }
+      nr_segs += nr_appended;
+    }
+    update(uc);
+    CHECK(model_equal(m, segs, nr_segs));
+    CHECK(m->nr_replaced - nr_replaced <= 1);
+    CHECK(m->nr_updated - nr_updated == m->nr_replaced - nr_replaced);
+  }
+}
+
+int
+main(void)
+{
+  struct model m;
+  uim_context uc;
+
+  if (uim_init() < 0) {
+    fprintf(stderr, "uim_init() failed\n");
+    return 1;
+  }
+  memset(&m, 0, sizeof(m));
+  uc = uim_create_context(&m, "UTF-8", NULL, "direct", NULL, commit_cb);
+  if (!uc) {
+    fprintf(stderr, "uim_create_context() failed\n");
+    uim_quit();
+    return 1;
+  }
+  uim_set_preedit_diff_cb(uc, replace_cb, update_cb);
+
+  check_fixed(uc, &m);
+  check_random(uc, &m);
+
+  model_release(&m);
+  uim_release_context(uc);
+  uim_quit();
+
+  return nr_failures ? 1 : 0;
+}
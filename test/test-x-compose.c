@@ -0,0 +1,237 @@
+/*
+
+  Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Checks the compiled Compose table of uim-x-compose.c: lookups,
+ * reuse of the cache, and its invalidation when a source file or the
+ * locale changes.  The cache is kept in a temporary directory.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+
+#include "uim.h"
+#include "uim-x-util.h"
+
+struct parse_args {
+  const char *include;
+  int nr_parsed;
+};
+
+static int nr_failures;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);	\
+      nr_failures++;							\
+    }									\
+  } while (0)
+
+static void
+add(uim_x_compose_builder *b, KeySym k1, KeySym k2, KeySym k3,
+    const char *utf8)
+{
+  struct uim_x_compose_key seq[3];
+  KeySym keys[3];
+  int i, n;
+
+  keys[0] = k1;
+  keys[1] = k2;
+  keys[2] = k3;
+  for (n = 0; n < 3 && keys[n] != NoSymbol; n++) {
+    seq[n].modifier_mask = 0;
+    seq[n].modifier = 0;
+    seq[n].keysym = keys[n];
+  }
+  uim_x_compose_builder_add(b, seq, n, utf8);
+  /* the same sequence with Shift held is told apart by its modifier */
+  for (i = 0; i < n; i++) {
+    seq[i].modifier_mask = ShiftMask;
+    seq[i].modifier = ShiftMask;
+  }
+  uim_x_compose_builder_add(b, seq, n, "shift");
+}
+
+static void
+parse(uim_x_compose_builder *b, void *closure)
+{
+  struct parse_args *args = closure;
+
+  args->nr_parsed++;
+  uim_x_compose_builder_add_source(b, args->include);
+  add(b, XK_dead_acute, XK_a, NoSymbol, "\xc3\xa1");
+  add(b, XK_dead_acute, XK_e, NoSymbol, "\xc3\xa9");
+  add(b, XK_Multi_key, XK_o, XK_c, "\xc2\xa9");
+}
+
+static const char *
+compose(const uim_x_compose_table *table, KeySym k1, KeySym k2, KeySym k3,
+	unsigned int state)
+{
+  KeySym keys[3];
+  int i, node = UIM_X_COMPOSE_ROOT;
+
+  keys[0] = k1;
+  keys[1] = k2;
+  keys[2] = k3;
+  for (i = 0; i < 3 && keys[i] != NoSymbol; i++) {
+    if (uim_x_compose_table_is_leaf(table, node))
+      return NULL;
+    if ((node = uim_x_compose_table_lookup(table, node, keys[i], state)) < 0)
+      return NULL;
+  }
+  return uim_x_compose_table_is_leaf(table, node) ?
+    uim_x_compose_table_utf8(table, node) : NULL;
+}
+
+static void
+check_table(const uim_x_compose_table *table)
+{
+  const char *s;
+
+  CHECK(table != NULL);
+  if (!table)
+    return;
+  CHECK((s = compose(table, XK_dead_acute, XK_a, NoSymbol, 0))
+	&& strcmp(s, "\xc3\xa1") == 0);
+  CHECK((s = compose(table, XK_dead_acute, XK_e, NoSymbol, 0))
+	&& strcmp(s, "\xc3\xa9") == 0);
+  CHECK((s = compose(table, XK_Multi_key, XK_o, XK_c, 0))
+	&& strcmp(s, "\xc2\xa9") == 0);
+  CHECK((s = compose(table, XK_dead_acute, XK_a, NoSymbol, ShiftMask))
+	&& strcmp(s, "shift") == 0);
+  CHECK(!compose(table, XK_dead_acute, XK_b, NoSymbol, 0));
+  CHECK(!compose(table, XK_Multi_key, XK_o, NoSymbol, 0));
+  CHECK(uim_x_compose_table_lookup(table, UIM_X_COMPOSE_ROOT, XK_z, 0) < 0);
+}
+
+static void
+touch(const char *filename)
+{
+  FILE *fp;
+
+  /* grow the file so that the change is seen even within a second */
+  if ((fp = fopen(filename, "a"))) {
+    fputs("\n", fp);
+    fclose(fp);
+  }
+}
+
+static void
+remove_tree(const char *path)
+{
+  char child[MAXPATHLEN];
+  struct dirent *ent;
+  DIR *dirp;
+
+  if ((dirp = opendir(path))) {
+    while ((ent = readdir(dirp))) {
+      if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+	continue;
+      snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+      remove_tree(child);
+    }
+    closedir(dirp);
+    rmdir(path);
+  } else
+    unlink(path);
+}
+
+int
+main(void)
+{
+  char dir[] = "/tmp/uim-test-x-compose.XXXXXX";
+  char filename[MAXPATHLEN], include[MAXPATHLEN], cache[MAXPATHLEN];
+  struct parse_args args;
+  uim_x_compose_table *table;
+
+  if (!mkdtemp(dir))
+    return 1;
+  snprintf(filename, sizeof(filename), "%s/Compose", dir);
+  snprintf(include, sizeof(include), "%s/Compose.include", dir);
+  snprintf(cache, sizeof(cache), "%s/cache", dir);
+  /* keep the caches away from ~/.uim.d */
+  setenv("LIBUIM_COMPOSE_CACHE_DIR", cache, 1);
+  touch(filename);
+  touch(include);
+  args.include = include;
+  args.nr_parsed = 0;
+
+  /* compiled from the parser */
+  table = uim_x_compose_table_open(filename, "en_US.UTF-8", parse, &args);
+  CHECK(args.nr_parsed == 1);
+  check_table(table);
+  uim_x_compose_table_close(table);
+
+  /* loaded from the cache */
+  table = uim_x_compose_table_open(filename, "en_US.UTF-8", parse, &args);
+  CHECK(args.nr_parsed == 1);
+  check_table(table);
+  uim_x_compose_table_close(table);
+
+  /* the locale is a part of the key */
+  table = uim_x_compose_table_open(filename, "C", parse, &args);
+  CHECK(args.nr_parsed == 2);
+  check_table(table);
+  uim_x_compose_table_close(table);
+
+  /* a changed file, or an included one, invalidates the cache */
+  touch(filename);
+  table = uim_x_compose_table_open(filename, "en_US.UTF-8", parse, &args);
+  CHECK(args.nr_parsed == 3);
+  uim_x_compose_table_close(table);
+  touch(include);
+  table = uim_x_compose_table_open(filename, "en_US.UTF-8", parse, &args);
+  CHECK(args.nr_parsed == 4);
+  check_table(table);
+  uim_x_compose_table_close(table);
+  table = uim_x_compose_table_open(filename, "en_US.UTF-8", parse, &args);
+  CHECK(args.nr_parsed == 4);
+  uim_x_compose_table_close(table);
+
+  remove_tree(dir);
+
+  return nr_failures ? 1 : 0;
+}
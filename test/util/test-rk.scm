@@ -61,7 +61,16 @@
                            ((("s" "e"). ()) ("せ" "セ" "ｾ"))
                            ((("s" "o"). ()) ("そ" "ソ" "ｿ"))
 
-                           ((("p" "p"). ("p")) ("っ" "ッ" "ｯ"))))))
+                           ((("p" "p"). ("p")) ("っ" "ッ" "ｯ")))))
+  ;; long enough to be compiled into a trie
+  (uim-eval
+   '(define test-rk-long-rule
+      (append test-rk-rule
+              (map (lambda (i)
+                     (list (list (list "x" (number->string i)))
+                           (list (number->string i))))
+                   (iota 64))
+              '(((("a"). ()) ("ア")))))))
 
 (define (teardown)
   (uim-test-teardown))
@@ -181,4 +190,37 @@
                     '(rk-lib-expect-seq '("p" "p") test-rk-rule))
   #f)
 
+(define (test-rk-lib-long-rule)
+  ;; the compiled rule must behave as same as the linear search
+  (for-each
+   (lambda (seq)
+     (assert-uim-equal (uim `(rk-lib-find-seq ',seq test-rk-rule))
+                       `(rk-lib-find-seq ',seq test-rk-long-rule))
+     (assert-uim-equal (uim `(rk-lib-find-partial-seq ',seq test-rk-rule))
+                       `(rk-lib-find-partial-seq ',seq test-rk-long-rule))
+     (assert-uim-equal (uim `(rk-lib-find-partial-seqs ',seq test-rk-rule))
+                       `(rk-lib-find-partial-seqs ',seq test-rk-long-rule))
+     (assert-uim-equal (uim `(rk-lib-expect-seq ',seq test-rk-rule))
+                       `(rk-lib-expect-seq ',seq test-rk-long-rule))
+     (assert-uim-equal (uim `(rk-lib-expect-key-for-seq? ',seq test-rk-rule
+                                                          "a"))
+                       `(rk-lib-expect-key-for-seq? ',seq test-rk-long-rule
+                                                    "a")))
+   '(("k") ("k" "y") ("k" "y" "a") ("s") ("s" "s") ("p") ("z")))
+
+  ;; first rule in the list order wins
+  (assert-uim-equal '((("a"). ())("あ" "ア" "ｱ"))
+                    '(rk-lib-find-seq '("a") test-rk-long-rule))
+  (assert-uim-equal '((("x" "3"). ())("3"))
+                    '(rk-lib-find-seq '("x" "3") test-rk-long-rule))
+  (assert-uim-equal '((("x" "0"). ())("0"))
+                    '(rk-lib-find-partial-seq '("x") test-rk-long-rule))
+  (assert-uim-equal 64
+                    '(length (rk-lib-expect-seq '("x") test-rk-long-rule)))
+  (assert-uim-true  '(rk-lib-expect-key-for-seq? '("x") test-rk-long-rule
+                                                 "63"))
+  (assert-uim-false '(rk-lib-expect-key-for-seq? '("x") test-rk-long-rule
+                                                 "64"))
+  #f)
+
 (provide "test/util/test-rk")
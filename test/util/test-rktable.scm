@@ -0,0 +1,120 @@
+;;; Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;
+
+(define-module test.util.test-rktable
+  (use file.util)
+  (use test.unit.test-case)
+  (use test.uim-test))
+(select-module test.util.test-rktable)
+
+(define rkt-path (uim-test-build-path "test" "test-rktable.rkt"))
+
+(define (setup)
+  (uim-test-setup)
+  (uim-eval '(require "rk.scm"))
+  (uim-eval '(require "rktable.scm"))
+  (uim-eval
+   '(define test-rk-rule '(((("a"). ()) ("あ" "ア" "ｱ"))
+                           ((("i"). ()) ("い" "イ" "ｲ"))
+                           ((("u"). ()) ("う" "ウ" "ｳ"))
+                           ((("e"). ()) ("え" "エ" "ｴ"))
+                           ((("o"). ()) ("お" "オ" "ｵ"))
+
+                           ((("k" "a"). ()) ("か" "カ" "ｶ"))
+                           ((("k" "i"). ()) ("き" "キ" "ｷ"))
+                           ((("k" "u"). ()) ("く" "ク" "ｸ"))
+                           ((("k" "e"). ()) ("け" "ケ" "ｹ"))
+                           ((("k" "o"). ()) ("こ" "コ" "ｺ"))
+                           ((("k" "y" "a"). ()) ("きゃ" "キャ" "ｷｬ"))
+                           ((("k" "y" "i"). ()) ("きぃ" "キィ" "ｷｨ"))
+                           ((("k" "y" "u"). ()) ("きゅ" "キュ" "ｷｭ"))
+                           ((("k" "y" "e"). ()) ("きぇ" "キェ" "ｷｪ"))
+                           ((("k" "y" "o"). ()) ("きょ" "キョ" "ｷｮ"))
+
+                           ((("s" "s"). ("s")) ("っ" "ッ" "ｯ"))
+                           ((("s" "a"). ()) ("さ" "サ" "ｻ"))
+                           ((("s" "i"). ()) ("し" "シ" "ｼ"))
+                           ((("s" "u"). ()) ("す" "ス" "ｽ"))
+                           ((("s" "e"). ()) ("せ" "セ" "ｾ"))
+                           ((("s" "o"). ()) ("そ" "ソ" "ｿ"))
+
+                           ((("p" "p"). ("p")) ("っ" "ッ" "ｯ"))
+                           ;; shadowed by the first rule for "a"
+                           ((("a"). ()) ("ア"))))))
+
+(define (teardown)
+  (uim-test-teardown)
+  (if (file-exists? rkt-path)
+      (sys-unlink rkt-path)))
+
+(define (test-rktable-lib-compile)
+  (assert-uim-true `(rktable-lib-compile test-rk-rule ,rkt-path))
+  (assert-equal "UIMRKT01"
+                (call-with-input-file rkt-path
+                  (lambda (port)
+                    (read-block 8 port))))
+  (assert-uim-error `(rktable-lib-compile '(("a" "b")) ,rkt-path))
+  #f)
+
+(define (test-rktable-lib-open)
+  (uim-eval `(rktable-lib-compile test-rk-rule ,rkt-path))
+  (assert-uim-true `(rktable-lib-open ,rkt-path))
+  (assert-uim-false `(rktable-lib-open ,(string-append rkt-path ".none")))
+  #f)
+
+(define (test-rktable-lib-lookup)
+  (uim-eval `(rktable-lib-compile test-rk-rule ,rkt-path))
+  (uim-eval `(define test-rkt (rktable-lib-open ,rkt-path)))
+  ;; the compiled table must behave as same as the linear search
+  (for-each
+   (lambda (seq)
+     (assert-uim-equal (uim `(rk-lib-find-seq ',seq test-rk-rule))
+                       `(rktable-lib-find-seq ',seq test-rkt))
+     (assert-uim-equal (uim `(rk-lib-find-partial-seq ',seq test-rk-rule))
+                       `(rktable-lib-find-partial-seq ',seq test-rkt))
+     (assert-uim-equal (uim `(rk-lib-find-partial-seqs ',seq test-rk-rule))
+                       `(rktable-lib-find-partial-seqs ',seq test-rkt))
+     (assert-uim-equal (uim `(rk-lib-expect-seq ',seq test-rk-rule))
+                       `(rktable-lib-expect-seq ',seq test-rkt))
+     (for-each
+      (lambda (key)
+        (assert-uim-equal (uim `(rk-lib-expect-key-for-seq? ',seq test-rk-rule
+                                                            ,key))
+                          `(rktable-lib-expect-key-for-seq? ',seq test-rkt
+                                                            ,key)))
+      '("a" "y" "s" "p")))
+   '(() ("a") ("k") ("k" "y") ("k" "y" "a") ("k" "y" "a" "a")
+     ("s") ("s" "s") ("s" "s" "s") ("p") ("p" "p") ("z")))
+
+  ;; first rule in the list order wins
+  (assert-uim-equal '((("a"). ())("あ" "ア" "ｱ"))
+                    '(rktable-lib-find-seq '("a") test-rkt))
+  #f)
+
+(provide "test/util/test-rktable")
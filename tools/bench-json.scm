@@ -0,0 +1,129 @@
+;;; bench-json.scm: time the JSON decoders on web conversion responses
+;;;
+;;; Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+;;;
+;;; All rights reserved.
+;;;
+;;; Redistribution and use in source and binary forms, with or without
+;;; modification, are permitted provided that the following conditions
+;;; are met:
+;;; 1. Redistributions of source code must retain the above copyright
+;;;    notice, this list of conditions and the following disclaimer.
+;;; 2. Redistributions in binary form must reproduce the above copyright
+;;;    notice, this list of conditions and the following disclaimer in the
+;;;    documentation and/or other materials provided with the distribution.
+;;; 3. Neither the name of authors nor the names of its contributors
+;;;    may be used to endorse or promote products derived from this software
+;;;    without specific prior written permission.
+;;;
+;;; THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+;;; ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+;;; IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+;;; ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+;;; FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+;;; DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+;;; OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+;;; HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+;;; LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+;;; OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+;;; SUCH DAMAGE.
+;;;;
+
+;; usage: uim-sh `pwd`/tools/bench-json.scm [seconds]
+;;
+;; Compares json-native-read-string with the packrat json-read on
+;; responses shaped like those of google-cgiapi-jp and baidu-olime-jp.
+;; Each decoder reads each response over and over for at least the
+;; given number of seconds (10 by default).  (time) counts whole
+;; seconds, so a longer run gives finer figures.
+
+(require-extension (srfi 1))
+(require "json.scm")
+
+;; [["segment",["candidate",...]],...]
+(define bench-json-google-response
+  (lambda (nr-segments nr-candidates)
+    (define (quote-str str)
+      (string-append "\"" str "\""))
+    (define (segment i)
+      (string-append
+       "[" (quote-str (string-append "ぶんせつ" (number->string i))) ",["
+       (string-join (map (lambda (j)
+			   (quote-str (string-append "候補"
+						     (number->string i)
+						     "-"
+						     (number->string j))))
+			 (iota nr-candidates))
+		    ",")
+       "]]"))
+    (string-append "["
+		   (string-join (map segment (iota nr-segments)) ",")
+		   "]")))
+
+;; the segments come first, as baidu-olime-jp takes the car
+(define bench-json-baidu-response
+  (lambda (nr-segments nr-candidates)
+    (string-append "["
+		   (bench-json-google-response nr-segments nr-candidates)
+		   ",\"\"]")))
+
+(define bench-json-corpus
+  (list
+   (cons "google 3x3" (bench-json-google-response 3 3))
+   (cons "google 10x20" (bench-json-google-response 10 20))
+   (cons "google 30x40" (bench-json-google-response 30 40))
+   (cons "baidu 30x40" (bench-json-baidu-response 30 40))))
+
+(define bench-json-decoders
+  (list
+   (cons "native" (lambda (str)
+		    (json-native-read-string str json-null)))
+   (cons "packrat" (lambda (str)
+		     (call-with-input-string str json-read)))))
+
+;; returns microseconds per call
+(define bench-json-run
+  (lambda (read str seconds)
+    (let* ((tick (time))
+	   (start (let wait ()
+		    (let ((now (time)))
+		      (if (= now tick)
+			  (wait)
+			  now)))))
+      (let loop ((calls 1))
+	(read str)
+	(let ((elapsed (- (time) start)))
+	  (if (< elapsed seconds)
+	      (loop (+ calls 1))
+	      (quotient (* elapsed 1000000) calls)))))))
+
+(define main
+  (lambda (args)
+    (let ((seconds (or (and (pair? (cdr args))
+			    (string->number (cadr args)))
+		       10)))
+      (if (not (provided? "json"))
+	  (begin
+	    (display "libuim-json is not available")
+	    (newline)
+	    1)
+	  (begin
+	    (for-each
+	     (lambda (sample)
+	       (let ((name (car sample))
+		     (str (cdr sample)))
+		 (if (not (equal? ((cdr (assoc "native" bench-json-decoders))
+				   str)
+				  ((cdr (assoc "packrat" bench-json-decoders))
+				   str)))
+		     (error "decoders disagree on" name))
+		 (format #t "~a (~a chars):" name (string-length str))
+		 (for-each
+		  (lambda (decoder)
+		    (format #t " ~a ~a us/call"
+			    (car decoder)
+			    (bench-json-run (cdr decoder) str seconds)))
+		  bench-json-decoders)
+		 (newline)))
+	     bench-json-corpus)
+	    0)))))
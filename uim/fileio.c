@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -178,11 +179,9 @@ c_file_read_internal(struct c_file_read_args *args)
   uim_lisp ret_ = uim_scm_null();
   const unsigned char *p = args->buf;
 
-  ret_ = uim_scm_null();
-  for (i = 0; i < args->nr; i++) {
-    ret_ = CONS(MAKE_CHAR(*p), ret_);
-    p++;
-  }
+  /* cons from the tail so that no reverse is needed */
+  for (i = args->nr - 1; i >= 0; i--)
+    ret_ = CONS(MAKE_CHAR(p[i]), ret_);
   return ret_;
 }
 
@@ -206,7 +205,7 @@ c_file_read(uim_lisp d_, uim_lisp nbytes_)
   ret_ = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)c_file_read_internal,
 						    (void *)&args);
   free(buf);
-  return uim_scm_callf("reverse", "o", ret_);
+  return ret_;
 }
 
 static uim_lisp
@@ -228,6 +227,331 @@ c_file_write(uim_lisp d_, uim_lisp buf_)
   return ret_;
 }
 
+static uim_lisp
+make_buf_str(const char *buf, size_t len)
+{
+  char *str;
+
+  str = uim_malloc(len + 1);
+  memcpy(str, buf, len);
+  str[len] = '\0';
+  return MAKE_STR_DIRECTLY(str);
+}
+
+/* wait for input on a non-blocking descriptor */
+static int
+wait_readable(int fd)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, -1);
+}
+
+static ssize_t
+read_retry(int fd, void *buf, size_t len, int flags)
+{
+  ssize_t nr;
+
+  for (;;) {
+    if (flags)
+      nr = recv(fd, buf, len, flags);
+    else
+      nr = read(fd, buf, len);
+    if (nr >= 0)
+      return nr;
+    if (errno == EINTR)
+      continue;
+    if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_readable(fd) >= 0)
+      continue;
+    return -1;
+  }
+}
+
+static uim_lisp
+c_file_read_string(uim_lisp d_, uim_lisp nbytes_)
+{
+  char *buf;
+  int nbytes = C_INT(nbytes_);
+  int nr;
+
+  buf = uim_malloc(nbytes + 1);
+  if ((nr = read(C_INT(d_), buf, nbytes)) <= 0) {
+    free(buf);
+    return nr == 0 ? uim_scm_eof() : uim_scm_f();
+  }
+  buf[nr] = '\0';
+  return MAKE_STR_DIRECTLY(buf);
+}
+
+static uim_lisp
+c_file_write_string(uim_lisp d_, uim_lisp str_)
+{
+  const char *str = REFER_C_STR(str_);
+  size_t len = strlen(str), done = 0;
+  ssize_t nw;
+
+  while (done < len) {
+    nw = write(C_INT(d_), str + done, len - done);
+    if (nw < 0) {
+      if (errno == EINTR)
+	continue;
+      if (done == 0)
+	return MAKE_INT(-1);
+      break;
+    }
+    done += nw;
+  }
+  return MAKE_INT(done);
+}
+
+/* delimiter given as a character (possibly #\nul) or a string */
+static const char *
+delimiter_bytes(uim_lisp delim_, char *c, size_t *len)
+{
+  if (CHARP(delim_)) {
+    *c = (char)C_CHAR(delim_);
+    *len = 1;
+    return c;
+  }
+  *len = strlen(REFER_C_STR(delim_));
+  return REFER_C_STR(delim_);
+}
+
+static const char *
+find_delimiter(const char *buf, size_t len, const char *delim, size_t dlen)
+{
+  const char *p, *end;
+
+  if (dlen == 0 || len < dlen)
+    return NULL;
+  end = buf + len - dlen + 1;
+  for (p = buf; (p = memchr(p, delim[0], end - p)) != NULL; p++)
+    if (memcmp(p, delim, dlen) == 0)
+      return p;
+  return NULL;
+}
+
+#define FILE_READ_CHUNK 1024
+
+/*
+ * Read up to the delimiter from an unbuffered descriptor.  Sockets are
+ * peeked first so that no byte after the delimiter is consumed; other
+ * descriptors are read a byte at a time.
+ */
+static uim_lisp
+c_file_read_delimited(uim_lisp d_, uim_lisp delim_)
+{
+  int fd = C_INT(d_);
+  char c;
+  const char *delim, *found = NULL;
+  size_t dlen, len = 0, size = FILE_READ_CHUNK, scan = 0, take;
+  ssize_t nr;
+  char *buf;
+  int peek = MSG_PEEK;
+  uim_lisp ret_;
+
+  delim = delimiter_bytes(delim_, &c, &dlen);
+  buf = uim_malloc(size);
+
+  while (!found) {
+    if (size - len < FILE_READ_CHUNK) {
+      size *= 2;
+      buf = uim_realloc(buf, size);
+    }
+    nr = peek ? read_retry(fd, buf + len, FILE_READ_CHUNK, peek) : -1;
+    if (nr < 0 && peek && errno == ENOTSOCK) {
+      peek = 0;
+      continue;
+    }
+    if (!peek)
+      nr = read_retry(fd, buf + len, 1, 0);
+    if (nr <= 0) {
+      free(buf);
+      return nr == 0 ? uim_scm_eof() : uim_scm_f();
+    }
+
+    found = find_delimiter(buf + scan, len + nr - scan, delim, dlen);
+    take = found ? (size_t)(found - buf) + dlen - len : (size_t)nr;
+    if (peek && read_retry(fd, buf + len, take, 0) != (ssize_t)take) {
+      free(buf);
+      return uim_scm_f();
+    }
+    len += take;
+    scan = len >= dlen ? len - dlen + 1 : 0;
+  }
+
+  ret_ = make_buf_str(buf, found - buf);
+  free(buf);
+  return ret_;
+}
+
+/*
+ * Input buffer of a file port.  Its lifetime is managed by
+ * open-file-port and close-file-port.
+ */
+struct file_inbuf {
+  char *buf;
+  size_t start;
+  size_t len;
+  size_t size;
+};
+
+#define FILE_INBUF_SIZE 4096
+
+static uim_lisp
+c_file_inbuf_new(void)
+{
+  struct file_inbuf *ib = uim_malloc(sizeof(struct file_inbuf));
+
+  ib->size = FILE_INBUF_SIZE;
+  ib->buf = uim_malloc(ib->size);
+  ib->start = ib->len = 0;
+  return MAKE_PTR(ib);
+}
+
+static uim_lisp
+c_file_inbuf_free(uim_lisp ib_)
+{
+  struct file_inbuf *ib = C_PTR(ib_);
+
+  if (ib) {
+    free(ib->buf);
+    free(ib);
+    uim_scm_nullify_c_ptr(ib_);
+  }
+  return uim_scm_t();
+}
+
+static void
+inbuf_consume(struct file_inbuf *ib, size_t n)
+{
+  ib->start += n;
+  ib->len -= n;
+  if (ib->len == 0)
+    ib->start = 0;
+}
+
+/* read whatever is available, at least FILE_READ_CHUNK bytes of room */
+static ssize_t
+inbuf_fill(int fd, struct file_inbuf *ib)
+{
+  ssize_t nr;
+
+  if (ib->start + ib->len + FILE_READ_CHUNK > ib->size) {
+    memmove(ib->buf, ib->buf + ib->start, ib->len);
+    ib->start = 0;
+    while (ib->len + FILE_READ_CHUNK > ib->size)
+      ib->size *= 2;
+    ib->buf = uim_realloc(ib->buf, ib->size);
+  }
+
+  nr = read_retry(fd, ib->buf + ib->start + ib->len,
+		  ib->size - ib->start - ib->len, 0);
+  if (nr > 0)
+    ib->len += nr;
+  return nr;
+}
+
+static uim_lisp
+inbuf_char(uim_lisp d_, uim_lisp ib_, int consume)
+{
+  struct file_inbuf *ib = C_PTR(ib_);
+  ssize_t nr;
+  unsigned char c;
+
+  if (ib->len == 0 && (nr = inbuf_fill(C_INT(d_), ib)) <= 0)
+    return nr == 0 ? uim_scm_eof() : uim_scm_f();
+
+  c = (unsigned char)ib->buf[ib->start];
+  if (consume)
+    inbuf_consume(ib, 1);
+  return MAKE_CHAR(c);
+}
+
+static uim_lisp
+c_file_inbuf_read_char(uim_lisp d_, uim_lisp ib_)
+{
+  return inbuf_char(d_, ib_, 1);
+}
+
+static uim_lisp
+c_file_inbuf_peek_char(uim_lisp d_, uim_lisp ib_)
+{
+  return inbuf_char(d_, ib_, 0);
+}
+
+/*
+ * Returns the string before the delimiter, dropping the delimiter.  At
+ * EOF the rest is returned, or the EOF object if nothing is left.
+ */
+static uim_lisp
+c_file_inbuf_read_delimited(uim_lisp d_, uim_lisp ib_, uim_lisp delim_)
+{
+  struct file_inbuf *ib = C_PTR(ib_);
+  const char *delim, *found;
+  char c;
+  size_t dlen, scan = 0;
+  ssize_t nr = 0;
+  uim_lisp ret_;
+
+  delim = delimiter_bytes(delim_, &c, &dlen);
+
+  while ((found = find_delimiter(ib->buf + ib->start + scan, ib->len - scan,
+				 delim, dlen)) == NULL) {
+    scan = ib->len >= dlen ? ib->len - dlen + 1 : 0;
+    if ((nr = inbuf_fill(C_INT(d_), ib)) <= 0)
+      break;
+  }
+
+  if (found) {
+    size_t n = found - (ib->buf + ib->start);
+
+    ret_ = make_buf_str(ib->buf + ib->start, n);
+    inbuf_consume(ib, n + dlen);
+    return ret_;
+  }
+
+  if (ib->len == 0)
+    return nr == 0 ? uim_scm_eof() : uim_scm_f();
+  ret_ = make_buf_str(ib->buf + ib->start, ib->len);
+  inbuf_consume(ib, ib->len);
+  return ret_;
+}
+
+/* Returns len bytes, fewer at EOF, or the EOF object if nothing is left. */
+static uim_lisp
+c_file_inbuf_read_exact(uim_lisp d_, uim_lisp ib_, uim_lisp len_)
+{
+  struct file_inbuf *ib = C_PTR(ib_);
+  size_t len = C_INT(len_);
+  ssize_t nr = 0;
+  uim_lisp ret_;
+
+  while (ib->len < len)
+    if ((nr = inbuf_fill(C_INT(d_), ib)) <= 0)
+      break;
+
+  if (ib->len == 0 && len > 0)
+    return nr == 0 ? uim_scm_eof() : uim_scm_f();
+  if (len > ib->len)
+    len = ib->len;
+  ret_ = make_buf_str(ib->buf + ib->start, len);
+  inbuf_consume(ib, len);
+  return ret_;
+}
+
+/* what has been buffered but not read yet */
+static uim_lisp
+c_file_inbuf_string(uim_lisp ib_)
+{
+  struct file_inbuf *ib = C_PTR(ib_);
+
+  return make_buf_str(ib->buf + ib->start, ib->len);
+}
+
 const static opt_args position_whence[] = {
   { SEEK_SET, "$SEEK_SET" },
   { SEEK_CUR, "$SEEK_CUR" },
@@ -378,6 +702,16 @@ uim_plugin_instance_init(void)
   uim_scm_init_proc1("file-close", c_file_close);
   uim_scm_init_proc2("file-read", c_file_read);
   uim_scm_init_proc2("file-write", c_file_write);
+  uim_scm_init_proc2("file-read-string", c_file_read_string);
+  uim_scm_init_proc2("file-write-string", c_file_write_string);
+  uim_scm_init_proc2("file-read-delimited", c_file_read_delimited);
+  uim_scm_init_proc0("file-inbuf-new", c_file_inbuf_new);
+  uim_scm_init_proc1("file-inbuf-free!", c_file_inbuf_free);
+  uim_scm_init_proc2("file-inbuf-read-char", c_file_inbuf_read_char);
+  uim_scm_init_proc2("file-inbuf-peek-char", c_file_inbuf_peek_char);
+  uim_scm_init_proc3("file-inbuf-read-delimited", c_file_inbuf_read_delimited);
+  uim_scm_init_proc3("file-inbuf-read-exact", c_file_inbuf_read_exact);
+  uim_scm_init_proc1("file-inbuf-string", c_file_inbuf_string);
   uim_scm_init_proc3("file-position-set!", c_file_position_set);
   uim_scm_init_proc0("file-position-whence?", c_file_position_whence);
   uim_lisp_position_whence = make_arg_list(position_whence);
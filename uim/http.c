@@ -0,0 +1,634 @@
+/*
+
+  Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * A small HTTP/1.1 client for the web conversion IMs.
+ *
+ * Idle keep-alive connections are pooled per "hostname:servname" and
+ * responses to plain GET requests are kept in a small LRU cache keyed
+ * by the request URI, so repeated conversions of the same string cost
+ * neither a connection setup nor a round trip.  Proxies and SSL are
+ * still handled by http-client.scm.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
+
+#include "uim.h"
+#include "uim-internal.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "uim-notify.h"
+#include "gettext.h"
+#include "dynlib.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define HTTP_POOL_SIZE     4
+#define HTTP_IDLE_TIMEOUT  30	/* sec */
+#define HTTP_BUF_SIZE      4096
+#define HTTP_LINE_MAX      2048
+
+/* results of http_request() */
+#define HTTP_OK     0
+#define HTTP_ERROR  -1
+#define HTTP_STALE  -2	/* closed before any response: retry once */
+
+struct http_conn {
+  char *key;		/* "hostname:servname" */
+  int fd;
+  time_t idle_since;
+};
+
+struct http_cache_entry {
+  char *uri;
+  char *body;
+  struct http_cache_entry *next;
+};
+
+struct http_reader {
+  int fd;
+  int timeout;		/* msec, -1 for none */
+  size_t pos, len;
+  char buf[HTTP_BUF_SIZE];
+};
+
+struct http_body {
+  char *str;
+  size_t len, size;
+};
+
+struct http_get_args {
+  uim_lisp hostname_;
+  uim_lisp servname_;
+  uim_lisp path_;
+  uim_lisp headers_;
+};
+
+static struct http_conn pool[HTTP_POOL_SIZE];
+/* most recently used first */
+static struct http_cache_entry *cache;
+
+void uim_plugin_instance_init(void);
+void uim_plugin_instance_quit(void);
+
+
+static void
+pool_drop(struct http_conn *conn)
+{
+  close(conn->fd);
+  free(conn->key);
+  conn->fd = -1;
+  conn->key = NULL;
+}
+
+/* an idle connection must not be readable: that means EOF or garbage */
+static int
+conn_idle_p(int fd)
+{
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  return poll(&pfd, 1, 0) == 0;
+}
+
+static int
+pool_take(const char *key)
+{
+  time_t now = time(NULL);
+  int i, fd;
+
+  for (i = 0; i < HTTP_POOL_SIZE; i++) {
+    struct http_conn *conn = &pool[i];
+
+    if (conn->fd < 0)
+      continue;
+    if (now - conn->idle_since > HTTP_IDLE_TIMEOUT || !conn_idle_p(conn->fd)) {
+      pool_drop(conn);
+      continue;
+    }
+    if (strcmp(conn->key, key) == 0) {
+      fd = conn->fd;
+      free(conn->key);
+      conn->fd = -1;
+      conn->key = NULL;
+      return fd;
+    }
+  }
+  return -1;
+}
+
+static void
+pool_put(const char *key, int fd)
+{
+  struct http_conn *conn = &pool[0];
+  int i;
+
+  for (i = 0; i < HTTP_POOL_SIZE; i++) {
+    if (pool[i].fd < 0) {
+      conn = &pool[i];
+      break;
+    }
+    if (pool[i].idle_since < conn->idle_since)
+      conn = &pool[i];
+  }
+  if (conn->fd >= 0)
+    pool_drop(conn);
+  conn->key = uim_strdup(key);
+  conn->fd = fd;
+  conn->idle_since = time(NULL);
+}
+
+static void
+pool_clear(void)
+{
+  int i;
+
+  for (i = 0; i < HTTP_POOL_SIZE; i++)
+    if (pool[i].fd >= 0)
+      pool_drop(&pool[i]);
+}
+
+static const char *
+cache_lookup(const char *uri)
+{
+  struct http_cache_entry *ent, **prevp;
+
+  for (prevp = &cache; (ent = *prevp); prevp = &ent->next) {
+    if (strcmp(ent->uri, uri) == 0) {
+      *prevp = ent->next;
+      ent->next = cache;
+      cache = ent;
+      return ent->body;
+    }
+  }
+  return NULL;
+}
+
+static void
+cache_trim(int size)
+{
+  struct http_cache_entry *ent, **prevp = &cache;
+
+  while (*prevp && size-- > 0)
+    prevp = &(*prevp)->next;
+  while ((ent = *prevp)) {
+    *prevp = ent->next;
+    free(ent->uri);
+    free(ent->body);
+    free(ent);
+  }
+}
+
+static void
+cache_add(const char *uri, const char *body, int size)
+{
+  struct http_cache_entry *ent;
+
+  if (size <= 0)
+    return;
+  ent = uim_malloc(sizeof(struct http_cache_entry));
+  ent->uri = uim_strdup(uri);
+  ent->body = uim_strdup(body);
+  ent->next = cache;
+  cache = ent;
+  cache_trim(size);
+}
+
+static int
+http_connect(const char *hostname, const char *servname)
+{
+  struct addrinfo hints, *res, *ai;
+  int fd = -1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = PF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  /* the caller notifies the failure */
+  if (getaddrinfo(hostname, servname, &hints, &res) != 0)
+    return -1;
+  for (ai = res; ai; ai = ai->ai_next) {
+    if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+      continue;
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    if ((n = send(fd, buf, len, MSG_NOSIGNAL)) < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* returns the number of buffered bytes, 0 on EOF, -1 on error or timeout */
+static ssize_t
+reader_fill(struct http_reader *r)
+{
+  struct pollfd pfd;
+  ssize_t n;
+  int rc;
+
+  if (r->pos < r->len)
+    return r->len - r->pos;
+
+  r->pos = r->len = 0;
+  pfd.fd = r->fd;
+  pfd.events = POLLIN;
+  for (;;) {
+    if ((rc = poll(&pfd, 1, r->timeout)) < 0 && errno == EINTR)
+      continue;
+    if (rc <= 0)
+      return -1;
+    if ((n = read(r->fd, r->buf, sizeof(r->buf))) < 0
+	&& (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n < 0)
+      return -1;
+    r->len = n;
+    return n;
+  }
+}
+
+/* reads a line without its CR LF; returns its length, -1 at EOF or error */
+static int
+reader_getline(struct http_reader *r, char *line, size_t size)
+{
+  size_t n = 0;
+  char c;
+
+  for (;;) {
+    if (reader_fill(r) <= 0) {
+      if (n == 0)
+	return -1;
+      break;
+    }
+    c = r->buf[r->pos++];
+    if (c == '\n')
+      break;
+    if (n < size - 1)
+      line[n++] = c;
+  }
+  if (n > 0 && line[n - 1] == '\r')
+    n--;
+  line[n] = '\0';
+  return n;
+}
+
+static void
+body_append(struct http_body *b, const char *s, size_t len)
+{
+  if (b->len + len + 1 > b->size) {
+    b->size = (b->size * 2 > b->len + len + 1) ? b->size * 2 : b->len + len + 1;
+    b->str = uim_realloc(b->str, b->size);
+  }
+  memcpy(b->str + b->len, s, len);
+  b->len += len;
+  b->str[b->len] = '\0';
+}
+
+static int
+read_exact(struct http_reader *r, struct http_body *b, size_t len)
+{
+  size_t n;
+
+  while (len > 0) {
+    if (reader_fill(r) <= 0)
+      return HTTP_ERROR;
+    n = r->len - r->pos;
+    if (n > len)
+      n = len;
+    body_append(b, r->buf + r->pos, n);
+    r->pos += n;
+    len -= n;
+  }
+  return HTTP_OK;
+}
+
+static int
+read_until_close(struct http_reader *r, struct http_body *b)
+{
+  ssize_t n;
+
+  while ((n = reader_fill(r)) > 0) {
+    body_append(b, r->buf + r->pos, n);
+    r->pos += n;
+  }
+  return n < 0 ? HTTP_ERROR : HTTP_OK;
+}
+
+static int
+read_chunked(struct http_reader *r, struct http_body *b)
+{
+  char line[HTTP_LINE_MAX], *end;
+  unsigned long size;
+  int n;
+
+  for (;;) {
+    if (reader_getline(r, line, sizeof(line)) < 0)
+      return HTTP_ERROR;
+    size = strtoul(line, &end, 16);
+    if (end == line)
+      return HTTP_ERROR;
+    if (size == 0)
+      break;
+    if (read_exact(r, b, size) != HTTP_OK
+	|| reader_getline(r, line, sizeof(line)) != 0)
+      return HTTP_ERROR;
+  }
+  /* trailer */
+  while ((n = reader_getline(r, line, sizeof(line))) > 0)
+    ;
+  return n < 0 ? HTTP_ERROR : HTTP_OK;
+}
+
+static void
+downcase(char *s)
+{
+  for (; *s; s++)
+    *s = tolower((unsigned char)*s);
+}
+
+static int
+http_request(int fd, const char *req, int timeout, struct http_body *b,
+	     int *status, int *keep_alive)
+{
+  struct http_reader r;
+  char line[HTTP_LINE_MAX], *val;
+  long content_length;
+  int minor, chunked, conn_close, n, rc;
+
+  *keep_alive = 0;
+  r.fd = fd;
+  r.timeout = timeout;
+  r.pos = r.len = 0;
+  if (write_all(fd, req, strlen(req)) < 0)
+    return HTTP_STALE;
+
+  /* skip "100 Continue" and friends */
+  do {
+    content_length = -1;
+    chunked = 0;
+    if (reader_getline(&r, line, sizeof(line)) < 0)
+      return HTTP_STALE;
+    if (sscanf(line, "HTTP/1.%d %d", &minor, status) != 2)
+      return HTTP_ERROR;
+    conn_close = (minor == 0);
+    while ((n = reader_getline(&r, line, sizeof(line))) > 0) {
+      if (!(val = strchr(line, ':')))
+	continue;
+      *val++ = '\0';
+      while (*val == ' ' || *val == '\t')
+	val++;
+      downcase(val);
+      if (strcasecmp(line, "content-length") == 0)
+	content_length = strtol(val, NULL, 10);
+      else if (strcasecmp(line, "transfer-encoding") == 0)
+	chunked = (strstr(val, "chunked") != NULL);
+      else if (strcasecmp(line, "connection") == 0)
+	conn_close = (strstr(val, "close") != NULL
+		      || (minor == 0 && !strstr(val, "keep-alive")));
+    }
+    if (n < 0)
+      return HTTP_ERROR;
+  } while (*status / 100 == 1);
+
+  if (*status == 204 || *status == 304)
+    rc = HTTP_OK;
+  else if (chunked)
+    rc = read_chunked(&r, b);
+  else if (content_length >= 0)
+    rc = read_exact(&r, b, content_length);
+  else {
+    conn_close = 1;
+    rc = read_until_close(&r, b);
+  }
+
+  /* leftovers mean we have lost track of the stream */
+  *keep_alive = (rc == HTTP_OK && !conn_close && r.pos == r.len);
+  return rc;
+}
+
+static char *
+make_request(const char *hostname, const char *path, uim_lisp headers_)
+{
+  static const char fmt[] =
+    "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: uim/%s\r\n";
+  uim_lisp h_;
+  size_t size, len;
+  char *req;
+
+  size = sizeof(fmt) + strlen(path) + strlen(hostname) + strlen(PACKAGE_VERSION)
+    + sizeof("\r\n");
+  for (h_ = headers_; !NULLP(h_); h_ = CDR(h_))
+    size += strlen(REFER_C_STR(CAR(CAR(h_))))
+      + strlen(REFER_C_STR(CDR(CAR(h_)))) + sizeof(": \r\n");
+
+  req = uim_malloc(size);
+  len = snprintf(req, size, fmt, path, hostname, PACKAGE_VERSION);
+  for (h_ = headers_; !NULLP(h_); h_ = CDR(h_))
+    len += snprintf(req + len, size - len, "%s: %s\r\n",
+		    REFER_C_STR(CAR(CAR(h_))), REFER_C_STR(CDR(CAR(h_))));
+  snprintf(req + len, size - len, "\r\n");
+  return req;
+}
+
+static void *
+http_get_internal(struct http_get_args *args)
+{
+  const char *hostname = REFER_C_STR(args->hostname_);
+  const char *path = REFER_C_STR(args->path_);
+  const char *cached;
+  char servname[NI_MAXSERV], *key, *uri, *req;
+  struct http_body b;
+  int fd, reused, rc, status, keep_alive, timeout, cache_size;
+  uim_lisp ret_;
+
+  if (INTP(args->servname_))
+    snprintf(servname, sizeof(servname), "%ld", C_INT(args->servname_));
+  else
+    strlcpy(servname, REFER_C_STR(args->servname_), sizeof(servname));
+
+  key = uim_malloc(strlen(hostname) + strlen(servname) + 2);
+  sprintf(key, "%s:%s", hostname, servname);
+  uri = uim_malloc(strlen(key) + strlen(path) + 1);
+  sprintf(uri, "%s%s", key, path);
+
+  /* extra request headers may change the response: don't cache */
+  cache_size = NULLP(args->headers_) ?
+    uim_scm_symbol_value_int("http-cache-size") : 0;
+  cache_trim(cache_size);
+  if (cache_size > 0 && (cached = cache_lookup(uri))) {
+    free(key);
+    free(uri);
+    return (void *)MAKE_STR(cached);
+  }
+
+  timeout = uim_scm_symbol_value_int("http-timeout");
+  if (timeout <= 0)
+    timeout = -1;
+  req = make_request(hostname, path, args->headers_);
+  memset(&b, 0, sizeof(b));
+
+  fd = pool_take(key);
+  reused = (fd >= 0);
+  for (;;) {
+    if (fd < 0 && (fd = http_connect(hostname, servname)) < 0) {
+      uim_notify_fatal(N_("cannot connect server"));
+      rc = HTTP_ERROR;
+      break;
+    }
+    rc = http_request(fd, req, timeout, &b, &status, &keep_alive);
+    if (rc == HTTP_STALE && reused) {
+      /* the server has dropped the pooled connection */
+      close(fd);
+      fd = -1;
+      reused = 0;
+      continue;
+    }
+    if (keep_alive)
+      pool_put(key, fd);
+    else
+      close(fd);
+    break;
+  }
+
+  if (rc == HTTP_OK) {
+    if (status == 200)
+      cache_add(uri, b.str ? b.str : "", cache_size);
+    ret_ = MAKE_STR(b.str ? b.str : "");
+  } else
+    ret_ = uim_scm_f();
+
+  free(b.str);
+  free(req);
+  free(key);
+  free(uri);
+  return (void *)ret_;
+}
+
+static uim_lisp
+c_http_native_get(uim_lisp hostname_, uim_lisp servname_, uim_lisp path_,
+		  uim_lisp headers_)
+{
+  struct http_get_args args;
+
+  args.hostname_ = hostname_;
+  args.servname_ = servname_;
+  args.path_ = path_;
+  args.headers_ = headers_;
+  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)http_get_internal,
+						    (void *)&args);
+}
+
+static uim_lisp
+c_http_native_flush(void)
+{
+  pool_clear();
+  cache_trim(0);
+  return uim_scm_t();
+}
+
+static uim_lisp
+c_http_native_encode_uri_string(uim_lisp str_)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  const unsigned char *s = (const unsigned char *)REFER_C_STR(str_);
+  char *buf, *p;
+
+  p = buf = uim_malloc(strlen((const char *)s) * 3 + 1);
+  for (; *s; s++) {
+    *p++ = '%';
+    *p++ = hex[*s >> 4];
+    *p++ = hex[*s & 0xf];
+  }
+  *p = '\0';
+  return MAKE_STR_DIRECTLY(buf);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  int i;
+
+  for (i = 0; i < HTTP_POOL_SIZE; i++) {
+    pool[i].fd = -1;
+    pool[i].key = NULL;
+  }
+  cache = NULL;
+
+  uim_scm_init_proc4("http-native-get", c_http_native_get);
+  uim_scm_init_proc0("http-native-flush!", c_http_native_flush);
+  uim_scm_init_proc1("http-native-encode-uri-string",
+		     c_http_native_encode_uri_string);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  pool_clear();
+  cache_trim(0);
+}
@@ -52,6 +52,28 @@
 
 #define MBCHAR_LEN_MAX 6  /* assumes CESU-8 */
 
+#define ALIAS_TAB_SIZE 1024  /* power of 2, > 2 * number of aliases */
+#define CONVERTIBLE_CACHE_SIZE 64  /* power of 2 */
+/* larger scratch buffers are released after use */
+#define SCRATCH_KEEP_MAX 65536
+
+struct uim_iconv_conv {
+  iconv_t cd;
+  /* both sides encode ASCII as ASCII without shift states */
+  uim_bool ascii_transparent;
+};
+
+struct alias_entry {
+  const char *name;
+  const char **alias;
+};
+
+struct convertible_entry {
+  char *tocode;
+  char *fromcode;
+  uim_bool convertible;
+};
+
 static void *uim_iconv_open(const char *tocode, const char *fromcode);
 static int uim_iconv_is_convertible(const char *tocode, const char *fromcode);
 static void *uim_iconv_create(const char *tocode, const char *fromcode);
@@ -60,7 +82,11 @@ static void uim_iconv_release(void *obj);
 
 static int check_encoding_equivalence(const char *tocode,
                                       const char *fromcode);
+static unsigned int hash_str(const char *str, unsigned int h);
+static void init_alias_tab(void);
 static const char **uim_get_encoding_alias(const char *encoding);
+static uim_bool ascii_transparentp(const char *encoding);
+static uim_bool ascii_onlyp(const char *str);
 
 
 static struct uim_code_converter uim_iconv_tbl = {
@@ -73,6 +99,46 @@ struct uim_code_converter *uim_iconv = &uim_iconv_tbl;
 
 #include "encoding-table.c"
 
+/* encodings which represent US-ASCII as is, without any shift state */
+static const char **const ascii_transparent_encodings[] = {
+  alias_us,
+  alias_utf8,
+  alias_eucjp,
+  alias_euckr,
+  alias_euctw,
+  alias_gb18030,
+  alias_gb2312,
+  alias_gbk,
+  alias_big5,
+  alias_hkscs,
+  alias_iso88591,
+  alias_iso88592,
+  alias_iso88593,
+  alias_iso88594,
+  alias_iso88595,
+  alias_iso88596,
+  alias_iso88597,
+  alias_iso88598,
+  alias_iso88599,
+  alias_iso885913,
+  alias_iso885914,
+  alias_iso885915,
+  alias_iso885916,
+  alias_koi8r,
+  alias_koi8u,
+  alias_cp1251,
+  alias_cp1255,
+  alias_tis620,
+  NULL
+};
+
+static struct alias_entry alias_tab[ALIAS_TAB_SIZE];
+static uim_bool alias_tab_initialized;
+static struct convertible_entry convertible_cache[CONVERTIBLE_CACHE_SIZE];
+/* reused by uim_iconv_code_conv() */
+static char *scratch;
+static size_t scratch_size;
+
 
 static int
 check_encoding_equivalence(const char *tocode, const char *fromcode)
@@ -126,6 +192,7 @@ uim_iconv_is_convertible(const char *tocode, const char *fromcode)
 {
   iconv_t ic;
   uim_bool result;
+  struct convertible_entry *ent;
 
   if (UIM_CATCH_ERROR_BEGIN())
     return UIM_FALSE;
@@ -133,13 +200,20 @@ uim_iconv_is_convertible(const char *tocode, const char *fromcode)
   assert(tocode);
   assert(fromcode);
 
+  ent = &convertible_cache[hash_str(fromcode, hash_str(tocode, 0))
+			   & (CONVERTIBLE_CACHE_SIZE - 1)];
+  if (ent->tocode
+      && !strcmp(ent->tocode, tocode) && !strcmp(ent->fromcode, fromcode)) {
+    UIM_CATCH_ERROR_END();
+    return ent->convertible;
+  }
+
   do {
     if (check_encoding_equivalence(tocode, fromcode)) {
       result = UIM_TRUE;
       break;
     }
 
-    /* TODO cache the result */
     ic = (iconv_t)uim_iconv_open(tocode, fromcode);
     if (ic == (iconv_t)-1) {
       result = UIM_FALSE;
@@ -149,28 +223,95 @@ uim_iconv_is_convertible(const char *tocode, const char *fromcode)
     result = UIM_TRUE;
   } while (/* CONSTCOND */ 0);
 
+  /* replaces the entry of another pair on collision */
+  free(ent->tocode);
+  free(ent->fromcode);
+  ent->tocode = uim_strdup(tocode);
+  ent->fromcode = uim_strdup(fromcode);
+  ent->convertible = result;
+
   UIM_CATCH_ERROR_END();
 
   return result;
 }
 
-static const char **
-uim_get_encoding_alias(const char *encoding)
+static unsigned int
+hash_str(const char *str, unsigned int h)
 {
-  int i, j;
-  const char **alias;
+  for (; *str; str++)
+    h = h * 31 + (unsigned char)*str;
 
-  assert(encoding);
+  return h;
+}
+
+static void
+init_alias_tab(void)
+{
+  const char **alias;
+  unsigned int h;
+  int i, j;
 
   for (i = 0; (alias = uim_encoding_list[i]); i++) {
     for (j = 0; alias[j]; j++) {
-      if (!strcmp(alias[j], encoding))
-        return alias;
+      h = hash_str(alias[j], 0) & (ALIAS_TAB_SIZE - 1);
+      while (alias_tab[h].name && strcmp(alias_tab[h].name, alias[j]))
+	h = (h + 1) & (ALIAS_TAB_SIZE - 1);
+      /* the first group listing the name takes precedence */
+      if (!alias_tab[h].name) {
+	alias_tab[h].name = alias[j];
+	alias_tab[h].alias = alias;
+      }
     }
   }
+  alias_tab_initialized = UIM_TRUE;
+}
+
+static const char **
+uim_get_encoding_alias(const char *encoding)
+{
+  unsigned int h;
+
+  assert(encoding);
+
+  if (!alias_tab_initialized)
+    init_alias_tab();
+
+  h = hash_str(encoding, 0) & (ALIAS_TAB_SIZE - 1);
+  while (alias_tab[h].name) {
+    if (!strcmp(alias_tab[h].name, encoding))
+      return alias_tab[h].alias;
+    h = (h + 1) & (ALIAS_TAB_SIZE - 1);
+  }
   return NULL;
 }
 
+static uim_bool
+ascii_transparentp(const char *encoding)
+{
+  const char **alias;
+  int i;
+
+  alias = uim_get_encoding_alias(encoding);
+  if (!alias)
+    return UIM_FALSE;
+
+  for (i = 0; ascii_transparent_encodings[i]; i++) {
+    if (ascii_transparent_encodings[i] == alias)
+      return UIM_TRUE;
+  }
+  return UIM_FALSE;
+}
+
+static uim_bool
+ascii_onlyp(const char *str)
+{
+  for (; *str; str++) {
+    if ((unsigned char)*str & 0x80)
+      return UIM_FALSE;
+  }
+  return UIM_TRUE;
+}
+
 static void *
 uim_iconv_open(const char *tocode, const char *fromcode)
 {
@@ -222,6 +363,7 @@ uim_iconv_open(const char *tocode, const char *fromcode)
 static void *
 uim_iconv_create(const char *tocode, const char *fromcode)
 {
+  struct uim_iconv_conv *conv;
   iconv_t ic;
 
   if (UIM_CATCH_ERROR_BEGIN())
@@ -230,36 +372,36 @@ uim_iconv_create(const char *tocode, const char *fromcode)
   assert(tocode);
   assert(fromcode);
 
+  conv = NULL;
   do {
-    if (check_encoding_equivalence(tocode, fromcode)) {
-      ic = (iconv_t)0;
+    if (check_encoding_equivalence(tocode, fromcode))
       break;
-    }
 
     ic = (iconv_t)uim_iconv_open(tocode, fromcode);
-    if (ic == (iconv_t)-1) {
-      /* since iconv_t is not explicit pointer, use 0 instead of NULL */
-      ic = (iconv_t)0;
-    }
+    if (ic == (iconv_t)-1)
+      break;
+
+    conv = uim_malloc(sizeof(*conv));
+    conv->cd = ic;
+    conv->ascii_transparent = (ascii_transparentp(tocode)
+			       && ascii_transparentp(fromcode));
   } while (/* CONSTCOND */ 0);
 
   UIM_CATCH_ERROR_END();
 
-  return (void *)ic;
+  return conv;
 }
 
 static char *
 uim_iconv_code_conv(void *obj, const char *instr)
 {
-  iconv_t cd = (iconv_t)obj;
+  struct uim_iconv_conv *conv = obj;
   size_t ins;
   const char *in;
-  size_t outbufsiz, outs;
-  char   *outbuf = NULL, *out;
+  size_t outs, len;
+  char *out;
   size_t ret = 0;
-  size_t nconv = 0;
-  size_t idx = 0;
-  char *str = NULL;
+  char *str;
 
   if (UIM_CATCH_ERROR_BEGIN())
     return NULL;
@@ -267,7 +409,7 @@ uim_iconv_code_conv(void *obj, const char *instr)
   if (!instr)
     goto err;
 
-  if (!obj) {
+  if (!conv || (conv->ascii_transparent && ascii_onlyp(instr))) {
     UIM_CATCH_ERROR_END();
     return uim_strdup(instr);
   }
@@ -275,68 +417,50 @@ uim_iconv_code_conv(void *obj, const char *instr)
   ins = strlen(instr);
   in = instr;
 
-  outbufsiz = (ins + sizeof("")) * MBCHAR_LEN_MAX;
-  out = outbuf = uim_malloc(outbufsiz);
+  if (scratch_size < (ins + sizeof("")) * MBCHAR_LEN_MAX) {
+    scratch = uim_realloc(scratch, (ins + sizeof("")) * MBCHAR_LEN_MAX);
+    scratch_size = (ins + sizeof("")) * MBCHAR_LEN_MAX;
+  }
+  len = 0;
 
   while (ins > 0) {
-    out = outbuf;
-    outs = outbufsiz;
+    out = &scratch[len];
+    outs = scratch_size - len;
 
-    ret = iconv(cd, (ICONV_CONST char **)&in, &ins, &out, &outs);
-    nconv = outbufsiz - outs;
+    ret = iconv(conv->cd, (ICONV_CONST char **)&in, &ins, &out, &outs);
+    len = out - scratch;
     if (ret == (size_t)-1) {
-      switch (errno) {
-      case EINVAL:
-	goto err;
-      case E2BIG:
-	outbufsiz *= 2;
-	out = uim_realloc(outbuf, outbufsiz);
-	outbuf = out;
-	break;
-      default:
+      if (errno != E2BIG)
 	goto err;
-      }
+      scratch = uim_realloc(scratch, scratch_size * 2);
+      scratch_size *= 2;
     } else {
       /* XXX: irreversible characters */
     }
-    if (nconv > 0) {
-      if (str == NULL)
-	str = uim_malloc(nconv + 1);
-      else
-	str = uim_realloc(str, idx + nconv + 1);
-      memcpy(&str[idx], outbuf, nconv);
-      idx += nconv;
-    }
   }
   do {
-    out = outbuf;
-    outs = outbufsiz;
-
-    ret = iconv(cd, NULL, NULL, &out, &outs);
-    nconv = outbufsiz - outs;
+    out = &scratch[len];
+    outs = scratch_size - len;
 
+    ret = iconv(conv->cd, NULL, NULL, &out, &outs);
+    len = out - scratch;
     if (ret == (size_t)-1) {
-      outbufsiz *= 2;
-      out = uim_realloc(outbuf, outbufsiz);
-      outbuf = out;
-    } else {
-      /* XXX: irreversible characters */
-    }
-    if (nconv > 0) {
-      if (str == NULL)
-	str = uim_malloc(nconv + 1);
-      else
-	str = uim_realloc(str, idx + nconv + 1);
-      memcpy(&str[idx], outbuf, nconv);
-      idx += nconv;
+      if (errno != E2BIG)
+	goto err;
+      scratch = uim_realloc(scratch, scratch_size * 2);
+      scratch_size *= 2;
     }
   } while (ret == (size_t)-1);
 
-  if (str == NULL)
-    str = uim_strdup("");
-  else
-    str[idx] = '\0';
-  free(outbuf);
+  str = uim_malloc(len + 1);
+  memcpy(str, scratch, len);
+  str[len] = '\0';
+
+  if (scratch_size > SCRATCH_KEEP_MAX) {
+    free(scratch);
+    scratch = NULL;
+    scratch_size = 0;
+  }
 
   UIM_CATCH_ERROR_END();
 
@@ -344,8 +468,9 @@ uim_iconv_code_conv(void *obj, const char *instr)
 
  err:
 
-  free(str);
-  free(outbuf);
+  /* return to the initial state for the next conversion */
+  if (conv)
+    iconv(conv->cd, NULL, NULL, NULL, NULL);
 
   UIM_CATCH_ERROR_END();
 
@@ -355,11 +480,15 @@ uim_iconv_code_conv(void *obj, const char *instr)
 static void
 uim_iconv_release(void *obj)
 {
+  struct uim_iconv_conv *conv = obj;
+
   if (UIM_CATCH_ERROR_BEGIN())
     return;
 
-  if (obj)
-    iconv_close((iconv_t)obj);
+  if (conv) {
+    iconv_close(conv->cd);
+    free(conv);
+  }
 
   UIM_CATCH_ERROR_END();
 }
@@ -369,7 +498,7 @@ uim_ext_iconv_open(uim_lisp tocode_, uim_lisp fromcode_)
 {
   const char *tocode = REFER_C_STR(tocode_);
   const char *fromcode = REFER_C_STR(fromcode_);
-  iconv_t ic;
+  void *ic;
 
   ic = uim_iconv_create(tocode, fromcode);
   if (!ic)
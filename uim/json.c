@@ -0,0 +1,345 @@
+/*
+
+  Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * A JSON decoder producing the representation of json-read in json.scm:
+ * objects become vectors of (key . value) pairs, arrays become lists,
+ * true and false become #t and #f, and null becomes the object given by
+ * the caller.  Comments are skipped as the packrat parser does.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+#define JSON_MAX_DEPTH 256
+
+struct json_reader {
+  const char *str;
+  const char *p;
+  const char *err;
+  uim_lisp null_;
+  char *buf;		/* scratch for strings */
+  size_t bufsize;
+};
+
+struct json_read_args {
+  uim_lisp str_;
+  uim_lisp null_;
+};
+
+void uim_plugin_instance_init(void);
+void uim_plugin_instance_quit(void);
+
+static uim_lisp read_value(struct json_reader *r, int depth);
+
+
+static uim_lisp
+json_error(struct json_reader *r, const char *msg)
+{
+  if (!r->err)
+    r->err = msg;
+  return uim_scm_f();
+}
+
+static void
+skip_white(struct json_reader *r)
+{
+  for (;;) {
+    while (isspace((unsigned char)*r->p))
+      r->p++;
+    if (r->p[0] != '/')
+      return;
+    if (r->p[1] == '*') {
+      const char *end = strstr(r->p + 2, "*/");
+
+      r->p = end ? end + 2 : r->p + strlen(r->p);
+    } else if (r->p[1] == '/') {
+      r->p += strcspn(r->p, "\r\n");
+    } else
+      return;
+  }
+}
+
+static void
+buf_put(struct json_reader *r, size_t *len, int c)
+{
+  if (*len + 1 >= r->bufsize) {
+    r->bufsize = r->bufsize ? r->bufsize * 2 : 256;
+    r->buf = uim_realloc(r->buf, r->bufsize);
+  }
+  r->buf[(*len)++] = c;
+}
+
+static int
+hex_value(int c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static uim_lisp
+read_string(struct json_reader *r)
+{
+  size_t len = 0;
+  int c, i, h, u;
+
+  r->p++;	/* '"' */
+  while ((c = (unsigned char)*r->p++) != '"') {
+    if (c == '\0') {
+      r->p--;
+      return json_error(r, "unterminated string");
+    }
+    if (c != '\\') {
+      buf_put(r, &len, c);
+      continue;
+    }
+    switch (c = (unsigned char)*r->p++) {
+    case 'b': buf_put(r, &len, '\b'); break;
+    case 'f': buf_put(r, &len, '\f'); break;
+    case 'n': buf_put(r, &len, '\n'); break;
+    case 'r': buf_put(r, &len, '\r'); break;
+    case 't': buf_put(r, &len, '\t'); break;
+    case 'u':
+      for (u = 0, i = 0; i < 4; i++) {
+	if ((h = hex_value((unsigned char)*r->p)) < 0)
+	  return json_error(r, "invalid \\u escape");
+	u = u * 16 + h;
+	r->p++;
+      }
+      /* Scheme strings cannot hold NUL */
+      if (u == 0)
+	break;
+      if (u < 0x80) {
+	buf_put(r, &len, u);
+      } else if (u < 0x800) {
+	buf_put(r, &len, 0xc0 | (u >> 6));
+	buf_put(r, &len, 0x80 | (u & 0x3f));
+      } else {
+	buf_put(r, &len, 0xe0 | (u >> 12));
+	buf_put(r, &len, 0x80 | ((u >> 6) & 0x3f));
+	buf_put(r, &len, 0x80 | (u & 0x3f));
+      }
+      break;
+    case '\0':
+      r->p--;
+      return json_error(r, "unterminated string");
+    default:
+      buf_put(r, &len, c);
+      break;
+    }
+  }
+  buf_put(r, &len, '\0');
+  return MAKE_STR(r->buf);
+}
+
+static uim_lisp
+read_number(struct json_reader *r)
+{
+  const char *start = r->p;
+  char *end;
+  size_t len;
+  long n;
+
+  len = strspn(r->p, "-+0123456789.eE");
+  r->p += len;
+
+  /* plain integers are by far the most common */
+  errno = 0;
+  n = strtol(start, &end, 10);
+  if (end == r->p && errno == 0)
+    return MAKE_INT(n);
+
+  /* leave the rest to string->number as the packrat parser does */
+  if (len + 1 > r->bufsize) {
+    r->bufsize = len + 1;
+    r->buf = uim_realloc(r->buf, r->bufsize);
+  }
+  memcpy(r->buf, start, len);
+  r->buf[len] = '\0';
+  return uim_scm_callf("string->number", "s", r->buf);
+}
+
+static uim_lisp
+read_array(struct json_reader *r, int depth)
+{
+  uim_lisp lst_ = uim_scm_null(), val_;
+
+  r->p++;	/* '[' */
+  skip_white(r);
+  if (*r->p == ']') {
+    r->p++;
+    return lst_;
+  }
+  for (;;) {
+    val_ = read_value(r, depth);
+    if (r->err)
+      return uim_scm_f();
+    lst_ = CONS(val_, lst_);
+    skip_white(r);
+    if (*r->p == ',') {
+      r->p++;
+    } else if (*r->p == ']') {
+      r->p++;
+      break;
+    } else
+      return json_error(r, "',' or ']' expected");
+  }
+  return uim_scm_callf("reverse", "o", lst_);
+}
+
+static uim_lisp
+read_object(struct json_reader *r, int depth)
+{
+  uim_lisp lst_ = uim_scm_null(), key_, val_;
+
+  r->p++;	/* '{' */
+  skip_white(r);
+  if (*r->p != '}') {
+    for (;;) {
+      skip_white(r);
+      if (*r->p != '"')
+	return json_error(r, "string expected");
+      key_ = read_string(r);
+      skip_white(r);
+      if (r->err || *r->p != ':')
+	return json_error(r, "':' expected");
+      r->p++;
+      val_ = read_value(r, depth);
+      if (r->err)
+	return uim_scm_f();
+      lst_ = CONS(CONS(key_, val_), lst_);
+      skip_white(r);
+      if (*r->p == ',')
+	r->p++;
+      else if (*r->p == '}')
+	break;
+      else
+	return json_error(r, "',' or '}' expected");
+    }
+  }
+  r->p++;
+  lst_ = uim_scm_callf("reverse", "o", lst_);
+  return uim_scm_callf("list->vector", "o", lst_);
+}
+
+static uim_lisp
+read_value(struct json_reader *r, int depth)
+{
+  skip_white(r);
+  if (depth >= JSON_MAX_DEPTH)
+    return json_error(r, "nested too deeply");
+
+  switch (*r->p) {
+  case '{':
+    return read_object(r, depth + 1);
+  case '[':
+    return read_array(r, depth + 1);
+  case '"':
+    return read_string(r);
+  case '-': case '+': case '.':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    return read_number(r);
+  }
+  if (strncmp(r->p, "true", 4) == 0) {
+    r->p += 4;
+    return uim_scm_t();
+  }
+  if (strncmp(r->p, "false", 5) == 0) {
+    r->p += 5;
+    return uim_scm_f();
+  }
+  if (strncmp(r->p, "null", 4) == 0) {
+    r->p += 4;
+    return r->null_;
+  }
+  return json_error(r, "value expected");
+}
+
+static void *
+json_read_string_internal(struct json_read_args *args)
+{
+  struct json_reader r;
+  uim_lisp ret_;
+  long pos;
+
+  r.str = r.p = REFER_C_STR(args->str_);
+  r.err = NULL;
+  r.null_ = args->null_;
+  r.buf = NULL;
+  r.bufsize = 0;
+
+  ret_ = read_value(&r, 0);
+  free(r.buf);
+  if (r.err) {
+    pos = r.p - r.str;
+    ERROR_OBJ(r.err, MAKE_INT(pos));
+  }
+  return (void *)ret_;
+}
+
+static uim_lisp
+c_json_native_read_string(uim_lisp str_, uim_lisp null_)
+{
+  struct json_read_args args;
+
+  args.str_ = str_;
+  args.null_ = null_;
+  return (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)json_read_string_internal,
+						    (void *)&args);
+}
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc2("json-native-read-string", c_json_native_read_string);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+}
@@ -37,6 +37,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
 #include <sys/types.h>
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
@@ -403,9 +405,389 @@ c_u32_to_s32(uim_lisp u32_)
   return MAKE_INT((int32_t)u32);
 }
 
+/*
+ * Binary codec for the dictionary server protocols.  A format is a list
+ * of the symbols below, as taken by u8list-pack in lolevel.scm:
+ *
+ *   u8 u16 u32  integers
+ *   s8          NUL terminated string
+ *   s16         string terminated by two NULs
+ *   u8list      list of bytes (the rest of the data when unpacking)
+ *   u16list     list of u16 (packing only)
+ */
+enum pack_type {
+  PACK_U8,
+  PACK_U16,
+  PACK_U32,
+  PACK_S8,
+  PACK_S16,
+  PACK_U8LIST,
+  PACK_U16LIST,
+  PACK_NR_TYPES
+};
+
+static const char *pack_type_names[PACK_NR_TYPES] = {
+  "u8", "u16", "u32", "s8", "s16", "u8list", "u16list"
+};
+static uim_lisp pack_type_syms[PACK_NR_TYPES];
+
+static enum pack_type
+pack_type(uim_lisp sym_)
+{
+  int i;
+
+  for (i = 0; i < PACK_NR_TYPES; i++)
+    if (EQ(sym_, pack_type_syms[i]))
+      return i;
+  ERROR_OBJ("unknown byte operator", sym_);
+  return PACK_NR_TYPES;
+}
+
+static void
+put_u16(unsigned char *p, uint16_t v, int big)
+{
+  if (big) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+  } else {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+  }
+}
+
+static void
+put_u32(unsigned char *p, uint32_t v, int big)
+{
+  if (big) {
+    put_u16(p, v >> 16, 1);
+    put_u16(p + 2, v & 0xffff, 1);
+  } else {
+    put_u16(p, v & 0xffff, 0);
+    put_u16(p + 2, v >> 16, 0);
+  }
+}
+
+static uint16_t
+get_u16(const unsigned char *p, int big)
+{
+  return big ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+static uint32_t
+get_u32(const unsigned char *p, int big)
+{
+  return big
+    ? ((uint32_t)get_u16(p, 1) << 16) | get_u16(p + 2, 1)
+    : get_u16(p, 0) | ((uint32_t)get_u16(p + 2, 0) << 16);
+}
+
+static size_t
+pack_size(uim_lisp fmt_, uim_lisp args_)
+{
+  size_t size = 0;
+
+  for (; !NULLP(fmt_) && !NULLP(args_); fmt_ = CDR(fmt_), args_ = CDR(args_)) {
+    switch (pack_type(CAR(fmt_))) {
+    case PACK_U8:
+      size += 1;
+      break;
+    case PACK_U16:
+      size += 2;
+      break;
+    case PACK_U32:
+      size += 4;
+      break;
+    case PACK_S8:
+      size += strlen(REFER_C_STR(CAR(args_))) + 1;
+      break;
+    case PACK_S16:
+      size += strlen(REFER_C_STR(CAR(args_))) + 2;
+      break;
+    case PACK_U8LIST:
+      size += uim_scm_length(CAR(args_));
+      break;
+    case PACK_U16LIST:
+      size += 2 * uim_scm_length(CAR(args_));
+      break;
+    default:
+      break;
+    }
+  }
+  return size;
+}
+
+static void
+pack_into(unsigned char *p, uim_lisp fmt_, uim_lisp args_, int big)
+{
+  uim_lisp arg_, l_;
+  size_t len;
+
+  for (; !NULLP(fmt_) && !NULLP(args_); fmt_ = CDR(fmt_), args_ = CDR(args_)) {
+    arg_ = CAR(args_);
+    switch (pack_type(CAR(fmt_))) {
+    case PACK_U8:
+      *p++ = C_INT(arg_);
+      break;
+    case PACK_U16:
+      put_u16(p, C_INT(arg_), big);
+      p += 2;
+      break;
+    case PACK_U32:
+      put_u32(p, C_INT(arg_), big);
+      p += 4;
+      break;
+    case PACK_S8:
+    case PACK_S16:
+      len = strlen(REFER_C_STR(arg_));
+      memcpy(p, REFER_C_STR(arg_), len);
+      p += len;
+      *p++ = '\0';
+      if (pack_type(CAR(fmt_)) == PACK_S16)
+	*p++ = '\0';
+      break;
+    case PACK_U8LIST:
+      for (l_ = arg_; !NULLP(l_); l_ = CDR(l_))
+	*p++ = C_INT(CAR(l_));
+      break;
+    case PACK_U16LIST:
+      for (l_ = arg_; !NULLP(l_); l_ = CDR(l_)) {
+	put_u16(p, C_INT(CAR(l_)), big);
+	p += 2;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/*
+ * Bytes of buf taken by fmt, or -1 if buf is too short.  u8list takes
+ * the rest of buf.
+ */
+static long
+unpack_size(const unsigned char *buf, size_t len, uim_lisp fmt_)
+{
+  size_t off = 0;
+  const unsigned char *end;
+
+  for (; !NULLP(fmt_); fmt_ = CDR(fmt_)) {
+    switch (pack_type(CAR(fmt_))) {
+    case PACK_U8:
+      off += 1;
+      break;
+    case PACK_U16:
+      off += 2;
+      break;
+    case PACK_U32:
+      off += 4;
+      break;
+    case PACK_S8:
+    case PACK_S16:
+      if (off >= len
+	  || (end = memchr(buf + off, '\0', len - off)) == NULL)
+	return -1;
+      off = end - buf + (pack_type(CAR(fmt_)) == PACK_S16 ? 2 : 1);
+      break;
+    case PACK_U8LIST:
+      off = len;
+      break;
+    default:
+      ERROR_OBJ("cannot unpack", CAR(fmt_));
+      break;
+    }
+    if (off > len)
+      return -1;
+  }
+  return off;
+}
+
+struct unpack_args {
+  const unsigned char *buf;
+  size_t len;
+  uim_lisp fmt;
+  int big;
+};
+
+static uim_lisp
+unpack_internal(struct unpack_args *args)
+{
+  const unsigned char *p = args->buf, *end;
+  uim_lisp fmt_, ret_ = uim_scm_null(), l_;
+  char *str;
+  size_t len;
+
+  for (fmt_ = args->fmt; !NULLP(fmt_); fmt_ = CDR(fmt_)) {
+    switch (pack_type(CAR(fmt_))) {
+    case PACK_U8:
+      ret_ = CONS(MAKE_INT(*p), ret_);
+      p += 1;
+      break;
+    case PACK_U16:
+      ret_ = CONS(MAKE_INT(get_u16(p, args->big)), ret_);
+      p += 2;
+      break;
+    case PACK_U32:
+      ret_ = CONS(MAKE_INT(get_u32(p, args->big)), ret_);
+      p += 4;
+      break;
+    case PACK_S8:
+    case PACK_S16:
+      end = memchr(p, '\0', args->buf + args->len - p);
+      len = end - p;
+      str = uim_malloc(len + 1);
+      memcpy(str, p, len + 1);
+      ret_ = CONS(MAKE_STR_DIRECTLY(str), ret_);
+      p = end + (pack_type(CAR(fmt_)) == PACK_S16 ? 2 : 1);
+      break;
+    case PACK_U8LIST:
+      end = args->buf + args->len;
+      l_ = uim_scm_null();
+      while (end > p)
+	l_ = CONS(MAKE_INT(*--end), l_);
+      ret_ = CONS(l_, ret_);
+      p = args->buf + args->len;
+      break;
+    default:
+      break;
+    }
+  }
+  return ret_;
+}
+
+static uim_lisp
+unpack(const unsigned char *buf, size_t len, uim_lisp fmt_, int big)
+{
+  struct unpack_args args;
+  uim_lisp ret_;
+
+  if (unpack_size(buf, len, fmt_) < 0)
+    return uim_scm_f();
+
+  args.buf = buf;
+  args.len = len;
+  args.fmt = fmt_;
+  args.big = big;
+  ret_ = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)unpack_internal,
+						    (void *)&args);
+  return uim_scm_callf("reverse", "o", ret_);
+}
+
+/* (pointer . length) of newly allocated memory */
+static uim_lisp
+pointer_pack(uim_lisp fmt_, uim_lisp args_, int big)
+{
+  size_t size = pack_size(fmt_, args_);
+  unsigned char *p = malloc(size ? size : 1);
+
+  pack_into(p, fmt_, args_, big);
+  return CONS(MAKE_PTR(p), MAKE_INT(size));
+}
+
+static uim_lisp
+c_pointer_pack(uim_lisp fmt_, uim_lisp args_)
+{
+  return pointer_pack(fmt_, args_, 1);
+}
+static uim_lisp
+c_pointer_pack_le(uim_lisp fmt_, uim_lisp args_)
+{
+  return pointer_pack(fmt_, args_, 0);
+}
+
+static uim_lisp
+c_pointer_unpack(uim_lisp pointer_, uim_lisp len_, uim_lisp fmt_)
+{
+  return unpack(C_PTR(pointer_), C_INT(len_), fmt_, 1);
+}
+static uim_lisp
+c_pointer_unpack_le(uim_lisp pointer_, uim_lisp len_, uim_lisp fmt_)
+{
+  return unpack(C_PTR(pointer_), C_INT(len_), fmt_, 0);
+}
+
+static uim_lisp
+file_write_packed(uim_lisp fd_, uim_lisp fmt_, uim_lisp args_, int big)
+{
+  unsigned char stack_buf[256], *buf;
+  size_t size = pack_size(fmt_, args_), done = 0;
+  ssize_t nw;
+
+  buf = size > sizeof(stack_buf) ? uim_malloc(size) : stack_buf;
+  pack_into(buf, fmt_, args_, big);
+
+  while (done < size) {
+    if ((nw = write(C_INT(fd_), buf + done, size - done)) < 0) {
+      if (errno == EINTR)
+	continue;
+      break;
+    }
+    done += nw;
+  }
+
+  if (buf != stack_buf)
+    free(buf);
+  return MAKE_INT(done < size && done == 0 ? -1 : (long)done);
+}
+
+static uim_lisp
+c_file_write_packed(uim_lisp fd_, uim_lisp fmt_, uim_lisp args_)
+{
+  return file_write_packed(fd_, fmt_, args_, 1);
+}
+static uim_lisp
+c_file_write_packed_le(uim_lisp fd_, uim_lisp fmt_, uim_lisp args_)
+{
+  return file_write_packed(fd_, fmt_, args_, 0);
+}
+
+/*
+ * Read exactly nbytes, a whole reply or the rest of one, and unpack fmt
+ * from them.  Bytes after what fmt describes, such as the terminator of
+ * a list of strings, are consumed too so that the next reply starts in
+ * sync.  Returns the unpacked list, the EOF object or #f.
+ */
+static uim_lisp
+file_read_unpacked(uim_lisp fd_, uim_lisp nbytes_, uim_lisp fmt_, int big)
+{
+  size_t nbytes = C_INT(nbytes_), len = 0;
+  unsigned char *buf;
+  ssize_t nr;
+  uim_lisp ret_;
+
+  buf = uim_malloc(nbytes ? nbytes : 1);
+  while (len < nbytes) {
+    nr = read(C_INT(fd_), buf + len, nbytes - len);
+    if (nr < 0 && errno == EINTR)
+      continue;
+    if (nr <= 0) {
+      free(buf);
+      return nr == 0 && len == 0 ? uim_scm_eof() : uim_scm_f();
+    }
+    len += nr;
+  }
+
+  ret_ = unpack(buf, len, fmt_, big);
+  free(buf);
+  return ret_;
+}
+
+static uim_lisp
+c_file_read_unpacked(uim_lisp fd_, uim_lisp nbytes_, uim_lisp fmt_)
+{
+  return file_read_unpacked(fd_, nbytes_, fmt_, 1);
+}
+static uim_lisp
+c_file_read_unpacked_le(uim_lisp fd_, uim_lisp nbytes_, uim_lisp fmt_)
+{
+  return file_read_unpacked(fd_, nbytes_, fmt_, 0);
+}
+
 void
 uim_plugin_instance_init(void)
 {
+  int i;
+
   uim_scm_init_proc1("allocate", c_allocate);
   uim_scm_init_proc1("free",     c_free);
 
@@ -481,11 +863,28 @@ uim_plugin_instance_init(void)
   uim_scm_init_proc1("u8list->string", c_u8list_to_string);
 
   uim_scm_init_proc1("u32->s32", c_u32_to_s32);
+
+  for (i = 0; i < PACK_NR_TYPES; i++) {
+    pack_type_syms[i] = MAKE_SYM(pack_type_names[i]);
+    uim_scm_gc_protect(&pack_type_syms[i]);
+  }
+  uim_scm_init_proc2("pointer-pack",    c_pointer_pack);
+  uim_scm_init_proc2("pointer-pack-le", c_pointer_pack_le);
+  uim_scm_init_proc3("pointer-unpack",    c_pointer_unpack);
+  uim_scm_init_proc3("pointer-unpack-le", c_pointer_unpack_le);
+  uim_scm_init_proc3("file-write-packed",    c_file_write_packed);
+  uim_scm_init_proc3("file-write-packed-le", c_file_write_packed_le);
+  uim_scm_init_proc3("file-read-unpacked",    c_file_read_unpacked);
+  uim_scm_init_proc3("file-read-unpacked-le", c_file_read_unpacked_le);
 }
 
 void
 uim_plugin_instance_quit(void)
 {
+  int i;
+
+  for (i = 0; i < PACK_NR_TYPES; i++)
+    uim_scm_gc_unprotect(&pack_type_syms[i]);
 #ifdef HAVE_MMAP
   uim_scm_gc_unprotect(&uim_lisp_mmap_prot_flags);
   uim_scm_gc_unprotect(&uim_lisp_mmap_flags);
@@ -30,8 +30,15 @@
 
 */
 
+#include <config.h>
+
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "uim.h"
 #include "uim-scm.h"
@@ -115,13 +122,286 @@ uim_look_look(uim_lisp isdict_, uim_lisp iscase_, uim_lisp words_, uim_lisp dict
   return uim_scm_callf("reverse", "o", ret_);
 }
 
+/*
+ * Composing tables
+ *
+ * A composing table (see ct.scm) is a sorted text file whose lines are
+ * "key (\"cand\" ...)". Tables are looked up on every keystroke, so
+ * each table is kept mmap(2)ed with an index of line offsets until the
+ * file is replaced, and the candidates are returned already parsed.
+ */
+struct look_table {
+  char *path;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+
+  char *base;
+  size_t len;
+  size_t *lines;    /* offsets of the beginnings of lines */
+  size_t nlines;
+
+  struct look_table *next;
+};
+
+static struct look_table *look_tables;
+
+static void
+look_table_free(struct look_table *t)
+{
+  if (t->base)
+    munmap(t->base, t->len);
+  free(t->lines);
+  free(t->path);
+  free(t);
+}
+
+static struct look_table *
+look_table_open(const char *path, const struct stat *st)
+{
+  struct look_table *t;
+  size_t i, n;
+  int fd;
+
+  t = uim_calloc(1, sizeof(struct look_table));
+  t->dev = st->st_dev;
+  t->ino = st->st_ino;
+  t->size = st->st_size;
+  t->mtime = st->st_mtime;
+  t->len = (size_t)st->st_size;
+
+  if (t->len) {
+    if ((fd = open(path, O_RDONLY)) < 0) {
+      free(t);
+      return NULL;
+    }
+    t->base = mmap(NULL, t->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (t->base == MAP_FAILED) {
+      free(t);
+      return NULL;
+    }
+  }
+
+  for (i = 0, n = 0; i < t->len; i++) {
+    if (i == 0 || t->base[i - 1] == '\n')
+      n++;
+  }
+  t->lines = uim_malloc((n + 1) * sizeof(size_t));
+  for (i = 0, n = 0; i < t->len; i++) {
+    if (i == 0 || t->base[i - 1] == '\n')
+      t->lines[n++] = i;
+  }
+  t->nlines = n;
+  t->path = uim_strdup(path);
+
+  return t;
+}
+
+static struct look_table *
+look_table_get(const char *path)
+{
+  struct look_table *t, **prev;
+  struct stat st;
+
+  if (stat(path, &st) < 0)
+    return NULL;
+
+  for (prev = &look_tables; (t = *prev); prev = &t->next) {
+    if (strcmp(t->path, path) == 0) {
+      if (t->dev == st.st_dev && t->ino == st.st_ino
+	  && t->size == st.st_size && t->mtime == st.st_mtime)
+	return t;
+      /* replaced */
+      *prev = t->next;
+      look_table_free(t);
+      break;
+    }
+  }
+
+  t = look_table_open(path, &st);
+  if (t) {
+    t->next = look_tables;
+    look_tables = t;
+  }
+  return t;
+}
+
+static size_t
+look_table_line_len(struct look_table *t, size_t i)
+{
+  const char *line = t->base + t->lines[i];
+  const char *end = memchr(line, '\n', t->len - t->lines[i]);
+
+  return (end) ? (size_t)(end - line) : t->len - t->lines[i];
+}
+
+/* compares the line with the prefix as if the line is cut at its length */
+static int
+look_table_compare(struct look_table *t, size_t i, const char *prefix,
+		   size_t plen)
+{
+  size_t len = look_table_line_len(t, i);
+  int cmp;
+
+  cmp = memcmp(t->base + t->lines[i], prefix, (len < plen) ? len : plen);
+  if (cmp == 0 && len < plen)
+    return -1;
+  return cmp;
+}
+
+/* parses the written form of a list of strings */
+static uim_lisp
+look_table_parse_cands(const char *p, const char *end)
+{
+  uim_lisp ret_ = uim_scm_null();
+  char *buf, *q;
+
+  if (p == end || *p++ != '(')
+    return uim_scm_f();
+
+  buf = uim_malloc(end - p + 1);
+  for (;;) {
+    while (p < end && *p == ' ')
+      p++;
+    if (p == end)
+      goto err;
+    if (*p == ')')
+      break;
+    if (*p++ != '"')
+      goto err;
+    for (q = buf; p < end && *p != '"'; p++) {
+      if (*p != '\\') {
+	*q++ = *p;
+	continue;
+      }
+      if (++p == end)
+	goto err;
+      switch (*p) {
+      case '"':
+      case '\\':
+	*q++ = *p;
+	break;
+      case 'n':
+	*q++ = '\n';
+	break;
+      case 't':
+	*q++ = '\t';
+	break;
+      case 'r':
+	*q++ = '\r';
+	break;
+      default:
+	goto err;
+      }
+    }
+    if (p == end)
+      goto err;
+    p++;
+    *q = '\0';
+    ret_ = CONS(MAKE_STR(buf), ret_);
+  }
+  free(buf);
+
+  return uim_scm_callf("reverse", "o", ret_);
+
+ err:
+  free(buf);
+  return uim_scm_f();
+}
+
+/*
+ * (look-lib-table-search dict prefix max)
+ *
+ * Returns at most max (or all if max is not an integer) entries whose
+ * keys start with prefix, in the order of the table, as a list of
+ * (residual-key . candidates). The residual key of the exact match is
+ * "". Returns #f if the table can't be opened.
+ */
+static uim_lisp
+uim_look_table_search(uim_lisp dict_, uim_lisp prefix_, uim_lisp max_)
+{
+  const char *prefix = REFER_C_STR(prefix_);
+  size_t plen = strlen(prefix);
+  struct look_table *t;
+  uim_lisp ret_ = uim_scm_null(), cands_;
+  size_t lo, hi, mid, first, last, i;
+  long max = -1;
+
+  t = look_table_get(REFER_C_STR(dict_));
+  if (!t)
+    return uim_scm_f();
+
+  if (INTP(max_))
+    max = C_INT(max_);
+
+  /* lower bound of the lines starting with the prefix */
+  lo = 0;
+  hi = t->nlines;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (look_table_compare(t, mid, prefix, plen) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  first = lo;
+  for (last = first;
+       last < t->nlines && (max < 0 || (long)(last - first) < max)
+	 && look_table_compare(t, last, prefix, plen) == 0;
+       last++)
+    ;
+
+  for (i = last; i > first; i--) {
+    const char *line = t->base + t->lines[i - 1];
+    const char *end = line + look_table_line_len(t, i - 1);
+    const char *key_end, *cands;
+    char *residual;
+
+    key_end = memchr(line, ' ', end - line);
+    if (!key_end)
+      key_end = end;
+    /* a prefix with a space may run past the key into the candidates */
+    if (key_end < line + plen)
+      continue;
+    for (cands = key_end; cands < end && *cands == ' '; cands++)
+      ;
+
+    cands_ = look_table_parse_cands(cands, end);
+    if (FALSEP(cands_)) {
+      char *str = uim_malloc(end - cands + 1);
+
+      memcpy(str, cands, end - cands);
+      str[end - cands] = '\0';
+      cands_ = uim_scm_callf("read-from-string", "s", str);
+      free(str);
+    }
+
+    residual = uim_malloc(key_end - line - plen + 1);
+    memcpy(residual, line + plen, key_end - line - plen);
+    residual[key_end - line - plen] = '\0';
+    ret_ = CONS(CONS(MAKE_STR_DIRECTLY(residual), cands_), ret_);
+  }
+
+  return ret_;
+}
+
 void
 uim_plugin_instance_init(void)
 {
   uim_scm_init_proc5("look-lib-look", uim_look_look);
+  uim_scm_init_proc3("look-lib-table-search", uim_look_table_search);
 }
 
 void
 uim_plugin_instance_quit(void)
 {
+  struct look_table *t, *next;
+
+  for (t = look_tables; t; t = next) {
+    next = t->next;
+    look_table_free(t);
+  }
+  look_tables = NULL;
 }
@@ -33,6 +33,7 @@
 
 #include <config.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "uim-internal.h"
@@ -96,9 +97,381 @@ str_seq_partial(uim_lisp seq, uim_lisp rule)
   return uim_scm_f();
 }
 
+/*
+ * Compiled rule tries
+ *
+ * Rule lists of table IMs (zm.scm, wb86.scm, tutcode-rule.scm, ...) have
+ * tens of thousands of entries, so walking them on every keystroke is
+ * too slow. A long rule list is compiled into a trie keyed by its
+ * sequence elements on first use, and the trie is cached by identity
+ * of the list. Rule lists are treated as immutable once they are
+ * passed to rk-lib-*: rebuild the list (e.g. by append) to change it.
+ *
+ * Each node records the first rule (in list order) whose key ends at
+ * the node, and the rules whose keys strictly extend it in list order,
+ * so that all results keep the order of the linear search.
+ */
+#define RK_TRIE_MIN_RULES  32
+#define RK_TRIE_CACHE_SIZE 4
+
+struct rk_trie_node {
+  long exact;        /* index of the first rule exactly matched, or -1 */
+  long nbelow;       /* number of rules strictly below this node */
+  long *below;       /* indices of them in list order */
+};
+
+struct rk_trie_edge {
+  long parent;
+  long label;
+  long child;        /* -1 for an empty slot */
+};
+
+struct rk_trie {
+  uim_lisp rules;    /* GC protected */
+  uim_lisp *rule_objs;
+  long nrules;
+
+  struct rk_trie_node *nodes;
+  long nnodes, nodes_cap;
+  long *below_pool;
+
+  char **labels;
+  long nlabels, labels_cap;
+  long *label_tab;   /* label index + 1, 0 for an empty slot */
+  long label_tab_size;
+
+  struct rk_trie_edge *edge_tab;
+  long nedges, edge_tab_size;
+};
+
+static struct rk_trie *rk_trie_cache[RK_TRIE_CACHE_SIZE];
+
+static unsigned long
+rk_str_hash(const char *str)
+{
+  unsigned long h = 5381;
+
+  while (*str)
+    h = h * 33 + (unsigned char)*str++;
+
+  return h;
+}
+
+static unsigned long
+rk_edge_hash(long parent, long label)
+{
+  return (unsigned long)parent * 2654435761UL + (unsigned long)label;
+}
+
+static long
+rk_trie_label_find(struct rk_trie *trie, const char *str)
+{
+  unsigned long i, mask = trie->label_tab_size - 1;
+  long idx;
+
+  for (i = rk_str_hash(str) & mask; (idx = trie->label_tab[i]); i = (i + 1) & mask) {
+    if (strcmp(trie->labels[idx - 1], str) == 0)
+      return idx - 1;
+  }
+  return -1;
+}
+
+static void
+rk_trie_label_tab_insert(struct rk_trie *trie, long idx)
+{
+  unsigned long i, mask = trie->label_tab_size - 1;
+
+  for (i = rk_str_hash(trie->labels[idx]) & mask;
+       trie->label_tab[i];
+       i = (i + 1) & mask)
+    ;
+  trie->label_tab[i] = idx + 1;
+}
+
+static long
+rk_trie_label_intern(struct rk_trie *trie, const char *str)
+{
+  long idx;
+
+  idx = rk_trie_label_find(trie, str);
+  if (idx >= 0)
+    return idx;
+
+  if (trie->nlabels == trie->labels_cap) {
+    trie->labels_cap *= 2;
+    trie->labels = uim_realloc(trie->labels,
+			       trie->labels_cap * sizeof(char *));
+  }
+  idx = trie->nlabels++;
+  trie->labels[idx] = uim_strdup(str);
+
+  /* keep the load factor under 1/2 */
+  if (trie->nlabels * 2 > trie->label_tab_size) {
+    long i;
+
+    free(trie->label_tab);
+    trie->label_tab_size *= 2;
+    trie->label_tab = uim_calloc(trie->label_tab_size, sizeof(long));
+    for (i = 0; i < trie->nlabels; i++)
+      rk_trie_label_tab_insert(trie, i);
+  } else {
+    rk_trie_label_tab_insert(trie, idx);
+  }
+
+  return idx;
+}
+
+static struct rk_trie_edge *
+rk_trie_edge_slot(struct rk_trie_edge *tab, long size, long parent, long label)
+{
+  unsigned long i, mask = size - 1;
+
+  for (i = rk_edge_hash(parent, label) & mask;
+       tab[i].child >= 0;
+       i = (i + 1) & mask)
+  {
+    if (tab[i].parent == parent && tab[i].label == label)
+      break;
+  }
+  return &tab[i];
+}
+
+static long
+rk_trie_child(struct rk_trie *trie, long parent, long label)
+{
+  return rk_trie_edge_slot(trie->edge_tab, trie->edge_tab_size,
+			   parent, label)->child;
+}
+
+static struct rk_trie_edge *
+rk_trie_edge_tab_new(long size)
+{
+  struct rk_trie_edge *tab;
+  long i;
+
+  tab = uim_malloc(size * sizeof(struct rk_trie_edge));
+  for (i = 0; i < size; i++)
+    tab[i].child = -1;
+
+  return tab;
+}
+
+static long
+rk_trie_add_child(struct rk_trie *trie, long parent, long label)
+{
+  struct rk_trie_edge *slot;
+  long child;
+
+  slot = rk_trie_edge_slot(trie->edge_tab, trie->edge_tab_size,
+			   parent, label);
+  if (slot->child >= 0)
+    return slot->child;
+
+  if (trie->nnodes == trie->nodes_cap) {
+    trie->nodes_cap *= 2;
+    trie->nodes = uim_realloc(trie->nodes,
+			      trie->nodes_cap * sizeof(struct rk_trie_node));
+  }
+  child = trie->nnodes++;
+  trie->nodes[child].exact = -1;
+  trie->nodes[child].nbelow = 0;
+  trie->nodes[child].below = NULL;
+
+  slot->parent = parent;
+  slot->label = label;
+  slot->child = child;
+
+  if (++trie->nedges * 2 > trie->edge_tab_size) {
+    struct rk_trie_edge *old = trie->edge_tab, *new_slot;
+    long i, old_size = trie->edge_tab_size;
+
+    trie->edge_tab_size *= 2;
+    trie->edge_tab = rk_trie_edge_tab_new(trie->edge_tab_size);
+    for (i = 0; i < old_size; i++) {
+      if (old[i].child < 0)
+	continue;
+      new_slot = rk_trie_edge_slot(trie->edge_tab, trie->edge_tab_size,
+				   old[i].parent, old[i].label);
+      *new_slot = old[i];
+    }
+    free(old);
+  }
+
+  return child;
+}
+
+static void
+rk_trie_free(struct rk_trie *trie)
+{
+  long i;
+
+  if (!trie)
+    return;
+
+  uim_scm_gc_unprotect(&trie->rules);
+  for (i = 0; i < trie->nlabels; i++)
+    free(trie->labels[i]);
+  free(trie->labels);
+  free(trie->label_tab);
+  free(trie->edge_tab);
+  free(trie->below_pool);
+  free(trie->nodes);
+  free(trie->rule_objs);
+  free(trie);
+}
+
+static uim_bool
+rk_trie_valid_rulep(uim_lisp rule)
+{
+  uim_lisp key;
+
+  if (!CONSP(rule) || !CONSP(CAR(rule)))
+    return UIM_FALSE;
+
+  for (key = CAR(CAR(rule)); CONSP(key); key = CDR(key)) {
+    if (!STRP(CAR(key)) && !SYMP(CAR(key)))
+      return UIM_FALSE;
+  }
+  return NULLP(key);
+}
+
+/* returns NULL if the rules have an unexpected shape */
+static struct rk_trie *
+rk_trie_compile(uim_lisp rules)
+{
+  struct rk_trie *trie;
+  uim_lisp cur, key;
+  long i, node, label, nbelow_total;
+  long *pos;
+
+  trie = uim_calloc(1, sizeof(struct rk_trie));
+  trie->rules = rules;
+  uim_scm_gc_protect(&trie->rules);
+
+  trie->nrules = uim_scm_length(rules);
+  trie->rule_objs = uim_malloc(trie->nrules * sizeof(uim_lisp));
+  trie->nodes_cap = trie->nrules + 1;
+  trie->nodes = uim_malloc(trie->nodes_cap * sizeof(struct rk_trie_node));
+  trie->nnodes = 1;
+  trie->nodes[0].exact = -1;
+  trie->nodes[0].nbelow = 0;
+  trie->nodes[0].below = NULL;
+  trie->labels_cap = 64;
+  trie->labels = uim_malloc(trie->labels_cap * sizeof(char *));
+  trie->label_tab_size = 128;
+  trie->label_tab = uim_calloc(trie->label_tab_size, sizeof(long));
+  trie->edge_tab_size = 256;
+  trie->edge_tab = rk_trie_edge_tab_new(trie->edge_tab_size);
+
+  /* first pass: build nodes and count the rules below each node */
+  nbelow_total = 0;
+  for (i = 0, cur = rules; i < trie->nrules; i++, cur = CDR(cur)) {
+    uim_lisp rule = CAR(cur);
+
+    if (!rk_trie_valid_rulep(rule)) {
+      rk_trie_free(trie);
+      return NULL;
+    }
+    trie->rule_objs[i] = rule;
+    node = 0;
+    for (key = CAR(CAR(rule)); !NULLP(key); key = CDR(key)) {
+      trie->nodes[node].nbelow++;
+      nbelow_total++;
+      label = rk_trie_label_intern(trie, REFER_C_STR(CAR(key)));
+      node = rk_trie_add_child(trie, node, label);
+    }
+    if (trie->nodes[node].exact < 0)
+      trie->nodes[node].exact = i;
+  }
+
+  /* second pass: fill the below lists from a single pool */
+  trie->below_pool = uim_malloc((nbelow_total + 1) * sizeof(long));
+  pos = uim_malloc(trie->nnodes * sizeof(long));
+  for (node = 0, nbelow_total = 0; node < trie->nnodes; node++) {
+    trie->nodes[node].below = &trie->below_pool[nbelow_total];
+    pos[node] = 0;
+    nbelow_total += trie->nodes[node].nbelow;
+  }
+  for (i = 0; i < trie->nrules; i++) {
+    node = 0;
+    for (key = CAR(CAR(trie->rule_objs[i])); !NULLP(key); key = CDR(key)) {
+      trie->nodes[node].below[pos[node]++] = i;
+      label = rk_trie_label_find(trie, REFER_C_STR(CAR(key)));
+      node = rk_trie_child(trie, node, label);
+    }
+  }
+  free(pos);
+
+  return trie;
+}
+
+/* returns the cached trie for the rules, or NULL for short rule lists */
+static struct rk_trie *
+rk_trie_get(uim_lisp rules)
+{
+  struct rk_trie *trie;
+  uim_lisp cur;
+  long i, len;
+
+  for (i = 0; i < RK_TRIE_CACHE_SIZE && rk_trie_cache[i]; i++) {
+    trie = rk_trie_cache[i];
+    if (EQ(trie->rules, rules)) {
+      /* move to front */
+      memmove(&rk_trie_cache[1], &rk_trie_cache[0],
+	      i * sizeof(struct rk_trie *));
+      rk_trie_cache[0] = trie;
+      return trie;
+    }
+  }
+
+  /* linear search is fast enough for short lists */
+  for (len = 0, cur = rules; len < RK_TRIE_MIN_RULES && CONSP(cur); len++)
+    cur = CDR(cur);
+  if (len < RK_TRIE_MIN_RULES)
+    return NULL;
+
+  trie = rk_trie_compile(rules);
+  if (!trie)
+    return NULL;
+
+  rk_trie_free(rk_trie_cache[RK_TRIE_CACHE_SIZE - 1]);
+  memmove(&rk_trie_cache[1], &rk_trie_cache[0],
+	  (RK_TRIE_CACHE_SIZE - 1) * sizeof(struct rk_trie *));
+  rk_trie_cache[0] = trie;
+
+  return trie;
+}
+
+/* returns the node reached by seq, or -1 */
+static long
+rk_trie_lookup(struct rk_trie *trie, uim_lisp seq)
+{
+  long node, label;
+
+  for (node = 0; CONSP(seq); seq = CDR(seq)) {
+    label = rk_trie_label_find(trie, REFER_C_STR(CAR(seq)));
+    if (label < 0)
+      return -1;
+    node = rk_trie_child(trie, node, label);
+    if (node < 0)
+      return -1;
+  }
+  return node;
+}
+
 static uim_lisp
 rk_find_seq(uim_lisp seq, uim_lisp rules)
 {
+  struct rk_trie *trie;
+  long node;
+
+  if ((trie = rk_trie_get(rules))) {
+    node = rk_trie_lookup(trie, seq);
+    if (node < 0 || trie->nodes[node].exact < 0)
+      return uim_scm_f();
+    return trie->rule_objs[trie->nodes[node].exact];
+  }
+
   for (; !uim_scm_nullp(rules); rules = uim_scm_cdr(rules)) {
     uim_lisp rule = uim_scm_car(rules);
     uim_lisp key = uim_scm_car(uim_scm_car(rule));
@@ -112,6 +485,16 @@ rk_find_seq(uim_lisp seq, uim_lisp rules)
 static uim_lisp
 rk_find_partial_seq(uim_lisp seq, uim_lisp rules)
 {
+  struct rk_trie *trie;
+  long node;
+
+  if ((trie = rk_trie_get(rules))) {
+    node = rk_trie_lookup(trie, seq);
+    if (node < 0 || !trie->nodes[node].nbelow)
+      return uim_scm_f();
+    return trie->rule_objs[trie->nodes[node].below[0]];
+  }
+
   for (; !uim_scm_nullp(rules); rules = uim_scm_cdr(rules)) {
     uim_lisp rule = uim_scm_car(rules);
     uim_lisp key = uim_scm_car(uim_scm_car(rule));
@@ -126,6 +509,17 @@ static uim_lisp
 rk_find_partial_seqs(uim_lisp seq, uim_lisp rules)
 {
   uim_lisp ret = uim_scm_null();
+  struct rk_trie *trie;
+  long node, i;
+
+  if ((trie = rk_trie_get(rules))) {
+    node = rk_trie_lookup(trie, seq);
+    if (node < 0)
+      return ret;
+    for (i = trie->nodes[node].nbelow - 1; i >= 0; i--)
+      ret = uim_scm_cons(trie->rule_objs[trie->nodes[node].below[i]], ret);
+    return ret;
+  }
 
   for (; !uim_scm_nullp(rules); rules = uim_scm_cdr(rules)) {
     uim_lisp rule = uim_scm_car(rules);
@@ -145,6 +539,23 @@ static uim_lisp
 rk_expect_seq(uim_lisp seq, uim_lisp rules)
 {
   uim_lisp cur, res = uim_scm_null();
+  struct rk_trie *trie;
+  long node, sl, i, j;
+
+  if ((trie = rk_trie_get(rules))) {
+    node = rk_trie_lookup(trie, seq);
+    if (node < 0)
+      return res;
+    sl = uim_scm_length(seq);
+    for (i = 0; i < trie->nodes[node].nbelow; i++) {
+      cur = CAR(CAR(trie->rule_objs[trie->nodes[node].below[i]]));
+      for (j = 0; j < sl; j++)
+	cur = CDR(cur);
+      res = uim_scm_cons(CAR(cur), res);
+    }
+    return res;
+  }
+
   for (cur = rules; !uim_scm_nullp(cur); cur = uim_scm_cdr(cur)) {
     uim_lisp rule = uim_scm_car(cur);
     uim_lisp key = CAR(CAR(rule));
@@ -165,6 +576,17 @@ static uim_lisp
 rk_expect_key_for_seq(uim_lisp seq, uim_lisp rules, uim_lisp key)
 {
   uim_lisp cur;
+  struct rk_trie *trie;
+  long node, label;
+
+  if ((trie = rk_trie_get(rules))) {
+    node = rk_trie_lookup(trie, seq);
+    if (node < 0)
+      return uim_scm_f();
+    label = rk_trie_label_find(trie, REFER_C_STR(key));
+    return MAKE_BOOL(label >= 0 && rk_trie_child(trie, node, label) >= 0);
+  }
+
   for (cur = rules; !uim_scm_nullp(cur); cur = uim_scm_cdr(cur)) {
     uim_lisp rule = uim_scm_car(cur);
     uim_lisp seq_in_rule = CAR(CAR(rule));
@@ -188,3 +610,14 @@ uim_init_rk_subrs(void)
   uim_scm_init_proc2("rk-lib-expect-seq", rk_expect_seq);
   uim_scm_init_proc3("rk-lib-expect-key-for-seq?", rk_expect_key_for_seq);
 }
+
+void
+uim_quit_rk(void)
+{
+  int i;
+
+  for (i = 0; i < RK_TRIE_CACHE_SIZE; i++) {
+    rk_trie_free(rk_trie_cache[i]);
+    rk_trie_cache[i] = NULL;
+  }
+}
@@ -0,0 +1,761 @@
+/*
+
+  Copyright (c) 2003-2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "uim.h"
+#include "uim-scm.h"
+#include "uim-scm-abbrev.h"
+#include "dynlib.h"
+
+
+/*
+ * Compiled rule tables
+ *
+ * A compiled rule table is a read-only image of an rk rule list (such
+ * as zm-rule) laid out as a trie and a string pool. It is generated at
+ * build time by rktable-lib-compile and mmap(2)ed at run time, so that
+ * huge table IMs don't need to read and keep their rules as Scheme
+ * objects. The lookup procedures behave like rk-lib-* in rk.c.
+ *
+ * All integers are 32-bit big-endian.
+ *
+ *   header   "UIMRKT01", nnodes, nedges, nrules, nbelow, nstrlist, poolsize
+ *   nodes    nnodes * (edge_first, edge_count, exact, below_first,
+ *                      below_count)
+ *   edges    nedges * (label, child), sorted by label in each node
+ *   below    nbelow * rule index, in the order of the source list
+ *   rules    nrules * (key, rest, value) as offsets into strlist
+ *   strlist  nstrlist words: (count, string offset ...) for each list
+ *   pool     NUL-terminated strings
+ */
+
+
+#define RKTABLE_MAGIC      "UIMRKT01"
+#define RKTABLE_MAGIC_LEN  8
+#define RKTABLE_HEADER_LEN (RKTABLE_MAGIC_LEN + 6 * 4)
+#define RKTABLE_NONE       0xffffffffU
+
+#define NODE_WORDS 5
+#define EDGE_WORDS 2
+#define RULE_WORDS 3
+
+struct rktable {
+  char *path;
+  unsigned char *base;
+  size_t len;
+
+  uint32_t nnodes, nedges, nrules, nbelow, nstrlist, poolsize;
+  const unsigned char *nodes, *edges, *below, *rules, *strlist;
+  const char *pool;
+
+  struct rktable *next;
+};
+
+static struct rktable *opened_tables;
+
+static uint32_t
+get_u32(const unsigned char *p)
+{
+  return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16
+	  | (uint32_t)p[2] << 8 | (uint32_t)p[3]);
+}
+
+static void
+put_u32(unsigned char *p, uint32_t v)
+{
+  p[0] = (v >> 24) & 0xff;
+  p[1] = (v >> 16) & 0xff;
+  p[2] = (v >> 8) & 0xff;
+  p[3] = v & 0xff;
+}
+
+#define NODE(t, i, field) get_u32((t)->nodes + ((i) * NODE_WORDS + (field)) * 4)
+#define NODE_EDGE_FIRST  0
+#define NODE_EDGE_COUNT  1
+#define NODE_EXACT       2
+#define NODE_BELOW_FIRST 3
+#define NODE_BELOW_COUNT 4
+#define EDGE(t, i, field) get_u32((t)->edges + ((i) * EDGE_WORDS + (field)) * 4)
+#define EDGE_LABEL 0
+#define EDGE_CHILD 1
+#define BELOW(t, i) get_u32((t)->below + (i) * 4)
+#define RULE(t, i, field) get_u32((t)->rules + ((i) * RULE_WORDS + (field)) * 4)
+#define RULE_KEY   0
+#define RULE_REST  1
+#define RULE_VALUE 2
+#define STRLIST(t, i) get_u32((t)->strlist + (i) * 4)
+
+
+/*
+ * reader
+ */
+
+static uim_bool
+rktable_validp(struct rktable *t)
+{
+  uint32_t i, j, n;
+
+  if (t->poolsize == 0 || t->pool[t->poolsize - 1] != '\0' || t->nnodes == 0)
+    return UIM_FALSE;
+
+  for (i = 0; i < t->nnodes; i++) {
+    if ((uint64_t)NODE(t, i, NODE_EDGE_FIRST) + NODE(t, i, NODE_EDGE_COUNT)
+	> t->nedges
+	|| (uint64_t)NODE(t, i, NODE_BELOW_FIRST) + NODE(t, i, NODE_BELOW_COUNT)
+	> t->nbelow
+	|| (NODE(t, i, NODE_EXACT) != RKTABLE_NONE
+	    && NODE(t, i, NODE_EXACT) >= t->nrules))
+      return UIM_FALSE;
+  }
+  for (i = 0; i < t->nedges; i++) {
+    if (EDGE(t, i, EDGE_LABEL) >= t->poolsize
+	|| EDGE(t, i, EDGE_CHILD) >= t->nnodes)
+      return UIM_FALSE;
+  }
+  for (i = 0; i < t->nbelow; i++) {
+    if (BELOW(t, i) >= t->nrules)
+      return UIM_FALSE;
+  }
+  for (i = 0; i < t->nrules * RULE_WORDS; i++) {
+    uint32_t off = get_u32(t->rules + i * 4);
+
+    if (off >= t->nstrlist)
+      return UIM_FALSE;
+    n = STRLIST(t, off);
+    if ((uint64_t)off + n >= t->nstrlist)
+      return UIM_FALSE;
+    for (j = 1; j <= n; j++) {
+      if (STRLIST(t, off + j) >= t->poolsize)
+	return UIM_FALSE;
+    }
+  }
+  return UIM_TRUE;
+}
+
+static struct rktable *
+rktable_open(const char *path)
+{
+  struct rktable *t;
+  struct stat st;
+  const unsigned char *p;
+  uint64_t expected;
+  void *base;
+  int fd;
+
+  for (t = opened_tables; t; t = t->next) {
+    if (strcmp(t->path, path) == 0)
+      return t;
+  }
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || st.st_size < RKTABLE_HEADER_LEN) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  t = uim_malloc(sizeof(struct rktable));
+  t->base = base;
+  t->len = (size_t)st.st_size;
+
+  p = t->base;
+  if (memcmp(p, RKTABLE_MAGIC, RKTABLE_MAGIC_LEN) != 0)
+    goto err;
+  p += RKTABLE_MAGIC_LEN;
+  t->nnodes = get_u32(p);
+  t->nedges = get_u32(p + 4);
+  t->nrules = get_u32(p + 8);
+  t->nbelow = get_u32(p + 12);
+  t->nstrlist = get_u32(p + 16);
+  t->poolsize = get_u32(p + 20);
+
+  expected = RKTABLE_HEADER_LEN
+    + ((uint64_t)t->nnodes * NODE_WORDS + (uint64_t)t->nedges * EDGE_WORDS
+       + t->nbelow + (uint64_t)t->nrules * RULE_WORDS + t->nstrlist) * 4
+    + t->poolsize;
+  if (expected != t->len)
+    goto err;
+
+  t->nodes = t->base + RKTABLE_HEADER_LEN;
+  t->edges = t->nodes + t->nnodes * NODE_WORDS * 4;
+  t->below = t->edges + t->nedges * EDGE_WORDS * 4;
+  t->rules = t->below + t->nbelow * 4;
+  t->strlist = t->rules + t->nrules * RULE_WORDS * 4;
+  t->pool = (const char *)(t->strlist + t->nstrlist * 4);
+
+  if (!rktable_validp(t))
+    goto err;
+
+  t->path = uim_strdup(path);
+  t->next = opened_tables;
+  opened_tables = t;
+
+  return t;
+
+ err:
+  munmap(t->base, t->len);
+  free(t);
+  return NULL;
+}
+
+/* returns the child of the node labeled str, or RKTABLE_NONE */
+static uint32_t
+rktable_child(struct rktable *t, uint32_t node, const char *str)
+{
+  uint32_t lo, hi, mid;
+  int cmp;
+
+  lo = NODE(t, node, NODE_EDGE_FIRST);
+  hi = lo + NODE(t, node, NODE_EDGE_COUNT);
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    cmp = strcmp(str, t->pool + EDGE(t, mid, EDGE_LABEL));
+    if (cmp == 0)
+      return EDGE(t, mid, EDGE_CHILD);
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return RKTABLE_NONE;
+}
+
+static uint32_t
+rktable_lookup(struct rktable *t, uim_lisp seq)
+{
+  uint32_t node = 0;
+
+  for (; CONSP(seq) && node != RKTABLE_NONE; seq = CDR(seq))
+    node = rktable_child(t, node, REFER_C_STR(CAR(seq)));
+
+  return node;
+}
+
+static uim_lisp
+make_str_list(struct rktable *t, uint32_t off)
+{
+  uim_lisp lst = uim_scm_null();
+  uint32_t i;
+
+  for (i = STRLIST(t, off); i > 0; i--)
+    lst = CONS(MAKE_STR(t->pool + STRLIST(t, off + i)), lst);
+
+  return lst;
+}
+
+/* ((key . rest) value) */
+static uim_lisp
+make_rule(struct rktable *t, uint32_t idx)
+{
+  uim_lisp key, rest, value;
+
+  key = make_str_list(t, RULE(t, idx, RULE_KEY));
+  rest = make_str_list(t, RULE(t, idx, RULE_REST));
+  value = make_str_list(t, RULE(t, idx, RULE_VALUE));
+
+  return LIST2(CONS(key, rest), value);
+}
+
+static struct rktable *
+table_ptr(uim_lisp table_)
+{
+  struct rktable *t;
+
+  ENSURE_TYPE(ptr, table_);
+  t = C_PTR(table_);
+  ENSURE_OBJ(t, "rktable: closed table", table_);
+
+  return t;
+}
+
+static uim_lisp
+rktable_lib_open(uim_lisp path_)
+{
+  struct rktable *t;
+
+  t = rktable_open(REFER_C_STR(path_));
+  if (!t)
+    return uim_scm_f();
+
+  return MAKE_PTR(t);
+}
+
+static uim_lisp
+rktable_find_seq(uim_lisp seq_, uim_lisp table_)
+{
+  struct rktable *t = table_ptr(table_);
+  uint32_t node;
+
+  node = rktable_lookup(t, seq_);
+  if (node == RKTABLE_NONE || NODE(t, node, NODE_EXACT) == RKTABLE_NONE)
+    return uim_scm_f();
+
+  return make_rule(t, NODE(t, node, NODE_EXACT));
+}
+
+static uim_lisp
+rktable_find_partial_seq(uim_lisp seq_, uim_lisp table_)
+{
+  struct rktable *t = table_ptr(table_);
+  uint32_t node;
+
+  node = rktable_lookup(t, seq_);
+  if (node == RKTABLE_NONE || NODE(t, node, NODE_BELOW_COUNT) == 0)
+    return uim_scm_f();
+
+  return make_rule(t, BELOW(t, NODE(t, node, NODE_BELOW_FIRST)));
+}
+
+static uim_lisp
+rktable_find_partial_seqs(uim_lisp seq_, uim_lisp table_)
+{
+  struct rktable *t = table_ptr(table_);
+  uim_lisp ret = uim_scm_null();
+  uint32_t node, first, i;
+
+  node = rktable_lookup(t, seq_);
+  if (node == RKTABLE_NONE)
+    return ret;
+
+  first = NODE(t, node, NODE_BELOW_FIRST);
+  for (i = NODE(t, node, NODE_BELOW_COUNT); i > 0; i--)
+    ret = CONS(make_rule(t, BELOW(t, first + i - 1)), ret);
+
+  return ret;
+}
+
+static uim_lisp
+rktable_expect_seq(uim_lisp seq_, uim_lisp table_)
+{
+  struct rktable *t = table_ptr(table_);
+  uim_lisp ret = uim_scm_null();
+  uint32_t node, first, i, key, depth;
+
+  node = rktable_lookup(t, seq_);
+  if (node == RKTABLE_NONE)
+    return ret;
+
+  depth = uim_scm_length(seq_);
+  first = NODE(t, node, NODE_BELOW_FIRST);
+  for (i = 0; i < NODE(t, node, NODE_BELOW_COUNT); i++) {
+    key = RULE(t, BELOW(t, first + i), RULE_KEY);
+    ret = CONS(MAKE_STR(t->pool + STRLIST(t, key + 1 + depth)), ret);
+  }
+  return ret;
+}
+
+static uim_lisp
+rktable_expect_key_for_seq(uim_lisp seq_, uim_lisp table_, uim_lisp key_)
+{
+  struct rktable *t = table_ptr(table_);
+  uint32_t node;
+
+  node = rktable_lookup(t, seq_);
+  if (node == RKTABLE_NONE)
+    return uim_scm_f();
+
+  return MAKE_BOOL(rktable_child(t, node, REFER_C_STR(key_)) != RKTABLE_NONE);
+}
+
+
+/*
+ * compiler
+ */
+
+struct u32buf {
+  uint32_t *v;
+  size_t n, cap;
+};
+
+struct rkt_src_rule {
+  uint32_t idx;
+  uint32_t keylen;
+  uint32_t key, rest, value;   /* offsets into strlist */
+};
+
+struct rkt_compiler {
+  struct rkt_src_rule *rules;
+  uint32_t nrules;
+  uint32_t *order;             /* rule indices sorted by key */
+
+  struct u32buf nodes, edges, below, strlist;
+
+  char *pool;
+  size_t poolsize, poolcap;
+  uint32_t *pool_tab;          /* string offset + 1, 0 for an empty slot */
+  size_t pool_tab_size, npool_strs;
+};
+
+/* for qsort(3) which has no closure argument */
+static struct rkt_compiler *sorting_compiler;
+
+static void
+u32buf_push(struct u32buf *buf, uint32_t v)
+{
+  if (buf->n == buf->cap) {
+    buf->cap = (buf->cap) ? buf->cap * 2 : 256;
+    buf->v = uim_realloc(buf->v, buf->cap * sizeof(uint32_t));
+  }
+  buf->v[buf->n++] = v;
+}
+
+static unsigned long
+str_hash(const char *str)
+{
+  unsigned long h = 5381;
+
+  while (*str)
+    h = h * 33 + (unsigned char)*str++;
+
+  return h;
+}
+
+static void
+pool_tab_insert(struct rkt_compiler *c, uint32_t off)
+{
+  size_t i, mask = c->pool_tab_size - 1;
+
+  for (i = str_hash(c->pool + off) & mask; c->pool_tab[i]; i = (i + 1) & mask)
+    ;
+  c->pool_tab[i] = off + 1;
+}
+
+static uint32_t
+pool_intern(struct rkt_compiler *c, const char *str)
+{
+  size_t i, mask = c->pool_tab_size - 1, len;
+  uint32_t off;
+
+  for (i = str_hash(str) & mask; c->pool_tab[i]; i = (i + 1) & mask) {
+    if (strcmp(c->pool + c->pool_tab[i] - 1, str) == 0)
+      return c->pool_tab[i] - 1;
+  }
+
+  len = strlen(str) + 1;
+  if (c->poolsize + len > c->poolcap) {
+    while (c->poolsize + len > c->poolcap)
+      c->poolcap *= 2;
+    c->pool = uim_realloc(c->pool, c->poolcap);
+  }
+  off = c->poolsize;
+  memcpy(c->pool + off, str, len);
+  c->poolsize += len;
+
+  if (++c->npool_strs * 2 > c->pool_tab_size) {
+    size_t j;
+    uint32_t *old = c->pool_tab;
+
+    c->pool_tab_size *= 2;
+    c->pool_tab = uim_calloc(c->pool_tab_size, sizeof(uint32_t));
+    for (j = 0; j < c->pool_tab_size / 2; j++) {
+      if (old[j])
+	pool_tab_insert(c, old[j] - 1);
+    }
+    free(old);
+  }
+  pool_tab_insert(c, off);
+
+  return off;
+}
+
+/* returns the offset in strlist, or RKTABLE_NONE if lst isn't a string list */
+static uint32_t
+add_str_list(struct rkt_compiler *c, uim_lisp lst)
+{
+  uim_lisp elm;
+  uint32_t off, n = 0;
+
+  off = c->strlist.n;
+  u32buf_push(&c->strlist, 0);
+  for (; CONSP(lst); lst = CDR(lst), n++) {
+    elm = CAR(lst);
+    if (!STRP(elm) && !SYMP(elm))
+      return RKTABLE_NONE;
+    u32buf_push(&c->strlist, pool_intern(c, REFER_C_STR(elm)));
+  }
+  if (!NULLP(lst))
+    return RKTABLE_NONE;
+  c->strlist.v[off] = n;
+
+  return off;
+}
+
+static const char *
+rule_label(struct rkt_compiler *c, uint32_t rule, uint32_t depth)
+{
+  return c->pool + c->strlist.v[c->rules[rule].key + 1 + depth];
+}
+
+static int
+compare_rule_key(const void *a, const void *b)
+{
+  struct rkt_compiler *c = sorting_compiler;
+  uint32_t ra = *(const uint32_t *)a, rb = *(const uint32_t *)b;
+  uint32_t i, la = c->rules[ra].keylen, lb = c->rules[rb].keylen;
+  int cmp;
+
+  for (i = 0; i < la && i < lb; i++) {
+    cmp = strcmp(rule_label(c, ra, i), rule_label(c, rb, i));
+    if (cmp)
+      return cmp;
+  }
+  if (la != lb)
+    return (la < lb) ? -1 : 1;
+  return (ra < rb) ? -1 : (ra > rb);
+}
+
+static int
+compare_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/* builds the node for order[lo..hi) which share a key prefix of depth */
+static uint32_t
+build_node(struct rkt_compiler *c, size_t lo, size_t hi, uint32_t depth)
+{
+  uint32_t node, exact = RKTABLE_NONE, edge_first, nchildren, child;
+  size_t i, j, below_first, n;
+
+  node = c->nodes.n / NODE_WORDS;
+  for (n = 0; n < NODE_WORDS; n++)
+    u32buf_push(&c->nodes, 0);
+
+  /* shorter keys are sorted first */
+  for (i = lo; i < hi && c->rules[c->order[i]].keylen == depth; i++) {
+    if (c->order[i] < exact)
+      exact = c->order[i];
+  }
+
+  below_first = c->below.n;
+  for (j = i; j < hi; j++)
+    u32buf_push(&c->below, c->order[j]);
+  qsort(c->below.v + below_first, hi - i, sizeof(uint32_t), compare_u32);
+
+  nchildren = 0;
+  for (j = i; j < hi; j++) {
+    if (j == i || strcmp(rule_label(c, c->order[j], depth),
+			 rule_label(c, c->order[j - 1], depth)) != 0)
+      nchildren++;
+  }
+  edge_first = c->edges.n / EDGE_WORDS;
+  for (n = 0; n < nchildren * EDGE_WORDS; n++)
+    u32buf_push(&c->edges, 0);
+
+  c->nodes.v[node * NODE_WORDS + NODE_EDGE_FIRST] = edge_first;
+  c->nodes.v[node * NODE_WORDS + NODE_EDGE_COUNT] = nchildren;
+  c->nodes.v[node * NODE_WORDS + NODE_EXACT] = exact;
+  c->nodes.v[node * NODE_WORDS + NODE_BELOW_FIRST] = below_first;
+  c->nodes.v[node * NODE_WORDS + NODE_BELOW_COUNT] = hi - i;
+
+  for (n = 0; i < hi; n++, i = j) {
+    const char *label = rule_label(c, c->order[i], depth);
+
+    for (j = i + 1;
+	 j < hi && strcmp(rule_label(c, c->order[j], depth), label) == 0;
+	 j++)
+      ;
+    child = build_node(c, i, j, depth + 1);
+    c->edges.v[(edge_first + n) * EDGE_WORDS + EDGE_LABEL]
+      = c->strlist.v[c->rules[c->order[i]].key + 1 + depth];
+    c->edges.v[(edge_first + n) * EDGE_WORDS + EDGE_CHILD] = child;
+  }
+
+  return node;
+}
+
+static uim_bool
+write_table(struct rkt_compiler *c, const char *path)
+{
+  unsigned char *buf, *p;
+  size_t len, i;
+  uim_bool ret;
+  FILE *fp;
+
+  len = RKTABLE_HEADER_LEN
+    + (c->nodes.n + c->edges.n + c->below.n + c->nrules * RULE_WORDS
+       + c->strlist.n) * 4
+    + c->poolsize;
+  p = buf = uim_malloc(len);
+
+  memcpy(p, RKTABLE_MAGIC, RKTABLE_MAGIC_LEN);
+  p += RKTABLE_MAGIC_LEN;
+  put_u32(p, c->nodes.n / NODE_WORDS);
+  put_u32(p + 4, c->edges.n / EDGE_WORDS);
+  put_u32(p + 8, c->nrules);
+  put_u32(p + 12, c->below.n);
+  put_u32(p + 16, c->strlist.n);
+  put_u32(p + 20, c->poolsize);
+  p += 24;
+
+  for (i = 0; i < c->nodes.n; i++, p += 4)
+    put_u32(p, c->nodes.v[i]);
+  for (i = 0; i < c->edges.n; i++, p += 4)
+    put_u32(p, c->edges.v[i]);
+  for (i = 0; i < c->below.n; i++, p += 4)
+    put_u32(p, c->below.v[i]);
+  for (i = 0; i < c->nrules; i++, p += RULE_WORDS * 4) {
+    put_u32(p, c->rules[i].key);
+    put_u32(p + 4, c->rules[i].rest);
+    put_u32(p + 8, c->rules[i].value);
+  }
+  for (i = 0; i < c->strlist.n; i++, p += 4)
+    put_u32(p, c->strlist.v[i]);
+  memcpy(p, c->pool, c->poolsize);
+
+  ret = UIM_FALSE;
+  if ((fp = fopen(path, "wb"))) {
+    ret = (fwrite(buf, 1, len, fp) == len);
+    ret = (fclose(fp) == 0) && ret;
+  }
+  free(buf);
+
+  return ret;
+}
+
+static void
+compiler_free(struct rkt_compiler *c)
+{
+  free(c->rules);
+  free(c->order);
+  free(c->nodes.v);
+  free(c->edges.v);
+  free(c->below.v);
+  free(c->strlist.v);
+  free(c->pool);
+  free(c->pool_tab);
+}
+
+/*
+ * (rktable-lib-compile rules path)
+ *
+ * Rules must be a list of ((key . rest) value) whose key, rest and value
+ * are lists of strings.
+ */
+static uim_lisp
+rktable_lib_compile(uim_lisp rules_, uim_lisp path_)
+{
+  struct rkt_compiler c;
+  uim_lisp cur, rule, head;
+  uim_bool ret;
+  uint32_t i;
+
+  memset(&c, 0, sizeof(c));
+  c.nrules = uim_scm_length(rules_);
+  c.rules = uim_malloc((c.nrules + 1) * sizeof(struct rkt_src_rule));
+  c.order = uim_malloc((c.nrules + 1) * sizeof(uint32_t));
+  c.poolcap = 4096;
+  c.pool = uim_malloc(c.poolcap);
+  c.pool_tab_size = 1024;
+  c.pool_tab = uim_calloc(c.pool_tab_size, sizeof(uint32_t));
+
+  for (i = 0, cur = rules_; i < c.nrules; i++, cur = CDR(cur)) {
+    rule = CAR(cur);
+    if (!CONSP(rule) || !CONSP(CAR(rule)) || !CONSP(CDR(rule)))
+      goto err;
+    head = CAR(rule);
+    c.rules[i].idx = i;
+    c.rules[i].keylen = uim_scm_length(CAR(head));
+    if ((c.rules[i].key = add_str_list(&c, CAR(head))) == RKTABLE_NONE
+	|| (c.rules[i].rest = add_str_list(&c, CDR(head))) == RKTABLE_NONE
+	|| (c.rules[i].value = add_str_list(&c, CAR(CDR(rule))))
+	== RKTABLE_NONE)
+      goto err;
+    c.order[i] = i;
+  }
+
+  sorting_compiler = &c;
+  qsort(c.order, c.nrules, sizeof(uint32_t), compare_rule_key);
+  sorting_compiler = NULL;
+
+  build_node(&c, 0, c.nrules, 0);
+
+  ret = write_table(&c, REFER_C_STR(path_));
+  compiler_free(&c);
+  if (!ret)
+    ERROR_OBJ("rktable-lib-compile: cannot write", path_);
+
+  return uim_scm_t();
+
+ err:
+  compiler_free(&c);
+  ERROR_OBJ("rktable-lib-compile: unsupported rule", rule);
+  return uim_scm_f();
+}
+
+
+void
+uim_plugin_instance_init(void)
+{
+  uim_scm_init_proc2("rktable-lib-compile", rktable_lib_compile);
+  uim_scm_init_proc1("rktable-lib-open", rktable_lib_open);
+  uim_scm_init_proc2("rktable-lib-find-seq", rktable_find_seq);
+  uim_scm_init_proc2("rktable-lib-find-partial-seq", rktable_find_partial_seq);
+  uim_scm_init_proc2("rktable-lib-find-partial-seqs",
+		     rktable_find_partial_seqs);
+  uim_scm_init_proc2("rktable-lib-expect-seq", rktable_expect_seq);
+  uim_scm_init_proc3("rktable-lib-expect-key-for-seq?",
+		     rktable_expect_key_for_seq);
+}
+
+void
+uim_plugin_instance_quit(void)
+{
+  struct rktable *t, *next;
+
+  /* pointer objects referring the tables must not be used after here */
+  for (t = opened_tables; t; t = next) {
+    next = t->next;
+    munmap(t->base, t->len);
+    free(t->path);
+    free(t);
+  }
+  opened_tables = NULL;
+}
@@ -49,6 +49,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netdb.h>
 #include <sys/param.h>
 #ifdef HAVE_STRINGS_H
@@ -125,6 +126,12 @@ struct skk_line {
   int state;
   /* link to next entry in the list */
   struct skk_line *next;
+  /* link to previous entry in the list. valid while the cache is indexed */
+  struct skk_line *prev;
+  /* link to next entry in the same bucket of the cache index */
+  struct skk_line *hash_next;
+  /* larger value for more recently used line */
+  unsigned long lru_stamp;
 };
 
 /* skk dictionary file */
@@ -135,10 +142,24 @@ typedef struct dic_info_ {
   int first;
   /* byte offset of first okuri-nasi entry */
   int border;
+  /* byte offsets of okuri-ari and okuri-nasi lines, in file order */
+  int *okuri_ari_lines;
+  int nr_okuri_ari_lines;
+  int *okuri_nasi_lines;
+  int nr_okuri_nasi_lines;
   /* size of dictionary file */
   int size;
   /* head of cached skk dictionary line list. LRU ordered */
   struct skk_line head;
+  /* hash index of cached lines keyed on (head, okuri_head) */
+  struct skk_line **cache_tab;
+  int cache_tab_size;
+  /* source of lru_stamp */
+  unsigned long lru_clock;
+  /* okuri-nasi cached lines sorted by head, for completion */
+  struct skk_line **comp_index;
+  int comp_index_len;
+  int comp_index_dirty;
   /* timestamp of personal dictionary */
   time_t personal_dic_timestamp;
   /* whether cached lines are modified or not */
@@ -155,6 +176,8 @@ typedef struct dic_info_ {
   int skkserv_family;
   /* timeout (milisec) for skkserv completion */
   int skkserv_completion_timeout;
+  /* timeout (milisec) for skkserv lookup */
+  int skkserv_timeout;
 } dic_info;
 
 /* completion */
@@ -194,13 +217,40 @@ static char *quote_word(const char *word, const char *prefix);
 #define SKK_SERV_USE	(1<<0)
 #define SKK_SERV_CONNECTED	(1<<1)
 #define SKK_SERV_TRY_COMPLETION	(1<<2)
+/* the last lookup gave up waiting for the reply */
+#define SKK_SERV_TIMEDOUT	(1<<3)
+/* replies kept for requests nobody is waiting for any more */
+#define SKK_SERV_MAX_UNCLAIMED_REPLIES	16
+
+/*
+ * Requests are pipelined: they are written as soon as they are known and
+ * the replies, which skkserv sends in order, are matched to them later.
+ */
+struct skkserv_request {
+  /* '1' for lookup, '4' for completion */
+  char cmd;
+  char *key;
+  /* reply line without the newline. NULL until it arrives */
+  char *reply;
+  struct skkserv_request *next;
+};
 
 static int skkservsock = -1;
-static FILE *rserv, *wserv;
+/* pending and answered requests in the order they were sent */
+static struct skkserv_request *skkserv_queue;
+/* received bytes not yet terminated by a newline */
+static char *skkserv_rbuf;
+static size_t skkserv_rbuf_len, skkserv_rbuf_size;
 /* prototype */
 static int open_skkserv(const char *hostname, int portnum, int family);
 static void close_skkserv(void);
 static void skkserv_disconnected(dic_info *di);
+static int skkserv_ensure_connected(dic_info *di);
+static struct skkserv_request *skkserv_send_request(dic_info *di, char cmd,
+						    const char *key);
+static int skkserv_wait_reply(dic_info *di, struct skkserv_request *req,
+			      int timeout);
+static char *skkserv_take_reply(struct skkserv_request *req);
 
 static int use_look = 0;
 static uim_look_ctx *skk_look_ctx = NULL;
@@ -262,6 +312,208 @@ find_border(dic_info *di)
   return di->size - 1;
 }
 
+static int
+line_len_at(dic_info *di, int off)
+{
+  const char *s = di->addr;
+  const char *p = memchr(&s[off], '\n', di->size - off);
+
+  return p ? p - &s[off] : di->size - off;
+}
+
+/*
+ * Record where each entry of the mmap'ed dictionary starts so that the
+ * lookup can bisect over whole lines instead of byte ranges.
+ */
+static void
+build_line_index(dic_info *di)
+{
+  const char *s = di->addr;
+  int off, l, nr_lines = 0;
+
+  di->okuri_ari_lines = di->okuri_nasi_lines = NULL;
+  di->nr_okuri_ari_lines = di->nr_okuri_nasi_lines = 0;
+  if (!s)
+    return;
+
+  for (off = di->first; off < di->size; off += l + 1) {
+    l = line_len_at(di, off);
+    if (l > 0 && s[off] != ';')
+      nr_lines++;
+  }
+  if (!nr_lines)
+    return;
+
+  di->okuri_ari_lines = uim_malloc(sizeof(int) * nr_lines);
+  for (off = di->first; off < di->size; off += l + 1) {
+    l = line_len_at(di, off);
+    if (l == 0 || s[off] == ';')
+      continue;
+    if (off < di->border)
+      di->okuri_ari_lines[di->nr_okuri_ari_lines++] = off;
+    else
+      di->okuri_ari_lines[di->nr_okuri_ari_lines
+			  + di->nr_okuri_nasi_lines++] = off;
+  }
+  /* okuri-nasi entries share the array, following okuri-ari ones */
+  di->okuri_nasi_lines = &di->okuri_ari_lines[di->nr_okuri_ari_lines];
+}
+
+static void
+init_dic_cache(dic_info *di)
+{
+  di->head.next = NULL;
+  di->cache_len = 0;
+  di->cache_tab = NULL;
+  di->cache_tab_size = 0;
+  di->lru_clock = 0;
+  di->comp_index = NULL;
+  di->comp_index_len = 0;
+  di->comp_index_dirty = 1;
+}
+
+static unsigned int
+line_hash(const char *head, char okuri_head)
+{
+  unsigned int h = (unsigned char)okuri_head;
+
+  while (*head)
+    h = h * 33 + (unsigned char)*head++;
+
+  return h;
+}
+
+static void
+cache_index_insert(dic_info *di, struct skk_line *sl)
+{
+  unsigned int i;
+
+  i = line_hash(sl->head, sl->okuri_head) & (di->cache_tab_size - 1);
+  sl->hash_next = di->cache_tab[i];
+  di->cache_tab[i] = sl;
+}
+
+/*
+ * Rebuild the hash index, the prev links and the LRU stamps of the cache
+ * after the list is rearranged.
+ */
+static void
+rebuild_cache_index(dic_info *di)
+{
+  struct skk_line *sl, *prev;
+  int size, n;
+
+  for (sl = di->head.next, n = 0; sl; sl = sl->next)
+    n++;
+
+  for (size = 256; size < n * 2; size *= 2)
+    ;
+  free(di->cache_tab);
+  di->cache_tab = uim_calloc(size, sizeof(struct skk_line *));
+  di->cache_tab_size = size;
+
+  di->lru_clock += n;
+  for (sl = di->head.next, prev = NULL; sl; prev = sl, sl = sl->next) {
+    sl->prev = prev;
+    sl->lru_stamp = di->lru_clock--;
+    cache_index_insert(di, sl);
+  }
+  di->lru_clock += n;
+  di->comp_index_dirty = 1;
+}
+
+static void
+free_cache_index(dic_info *di)
+{
+  free(di->cache_tab);
+  di->cache_tab = NULL;
+  di->cache_tab_size = 0;
+  free(di->comp_index);
+  di->comp_index = NULL;
+  di->comp_index_len = 0;
+  di->comp_index_dirty = 1;
+}
+
+static int
+compare_line_head(const void *a, const void *b)
+{
+  const struct skk_line *p = *(struct skk_line * const *)a;
+  const struct skk_line *q = *(struct skk_line * const *)b;
+
+  return strcmp(p->head, q->head);
+}
+
+static int
+compare_line_recency(const void *a, const void *b)
+{
+  const struct skk_line *p = *(struct skk_line * const *)a;
+  const struct skk_line *q = *(struct skk_line * const *)b;
+
+  if (p->lru_stamp == q->lru_stamp)
+    return 0;
+  return (p->lru_stamp > q->lru_stamp) ? -1 : 1;
+}
+
+/*
+ * Return okuri-nasi lines for completion whose head starts with s but
+ * differs from s, in LRU order. The array must be freed by the caller.
+ */
+static struct skk_line **
+find_comp_lines(dic_info *di, const char *s, int *nr_lines)
+{
+  struct skk_line *sl, **lines = NULL;
+  size_t len = strlen(s);
+  int lo, hi, mid, i, n = 0;
+
+  *nr_lines = 0;
+  if (!di->cache_tab)
+    rebuild_cache_index(di);
+
+  if (di->comp_index_dirty) {
+    for (sl = di->head.next, n = 0; sl; sl = sl->next) {
+      if (sl->okuri_head == '\0')
+	n++;
+    }
+    di->comp_index = uim_realloc(di->comp_index,
+				 sizeof(struct skk_line *) * (n + 1));
+    di->comp_index_len = 0;
+    for (sl = di->head.next; sl; sl = sl->next) {
+      if (sl->okuri_head == '\0')
+	di->comp_index[di->comp_index_len++] = sl;
+    }
+    qsort(di->comp_index, di->comp_index_len, sizeof(struct skk_line *),
+	  compare_line_head);
+    di->comp_index_dirty = 0;
+  }
+
+  /* lower bound of s */
+  lo = 0;
+  hi = di->comp_index_len;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (strcmp(di->comp_index[mid]->head, s) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (i = lo, n = 0; i < di->comp_index_len; i++) {
+    sl = di->comp_index[i];
+    if (strncmp(sl->head, s, len))
+      break;
+    if (sl->head[len] == '\0' || !(sl->state & SKK_LINE_USE_FOR_COMPLETION))
+      continue;
+    if (!lines)
+      lines = uim_malloc(sizeof(struct skk_line *) * (di->comp_index_len - i));
+    lines[n++] = sl;
+  }
+  if (n > 1)
+    qsort(lines, n, sizeof(struct skk_line *), compare_line_recency);
+
+  *nr_lines = n;
+  return lines;
+}
+
 static dic_info *
 open_dic(const char *fn, uim_bool use_skkserv, const char *skkserv_hostname,
 	 int skkserv_portnum, int skkserv_family)
@@ -283,6 +535,7 @@ open_dic(const char *fn, uim_bool use_skkserv, const char *skkserv_hostname,
 						    skkserv_portnum,
 						    skkserv_family);
     di->skkserv_completion_timeout = uim_scm_symbol_value_int("skk-skkserv-completion-timeout");
+    di->skkserv_timeout = uim_scm_symbol_value_int("skk-skkserv-timeout");
   } else {
     di->skkserv_state = 0;
     fd = open(fn, O_RDONLY);
@@ -301,70 +554,62 @@ open_dic(const char *fn, uim_bool use_skkserv, const char *skkserv_hostname,
   di->size = mmap_done ? st.st_size : 0;
   di->first = mmap_done ? find_first_line(di) : 0;
   di->border = mmap_done ? find_border(di) : 0;
+  build_line_index(di);
 
-  di->head.next = NULL;
+  init_dic_cache(di);
   di->personal_dic_timestamp = 0;
   di->cache_modified = 0;
-  di->cache_len = 0;
 
   return di;
 }
 
-static const char *
-find_line(dic_info *di, int off)
+/* compare s with the index (text before the first space) of a line */
+static int
+compare_line_index(const char *s, const char *line, int len)
 {
-  char *ptr = di->addr;
-  while (off > 0 && (ptr[off] != '\n' || ptr[off + 1] == ';'))
-    off--;
-
-  if (off)
-    off++;
+  int i;
 
-  return &ptr[off];
+  for (i = 0; i < len && line[i] != ' ' && line[i] != '\n'; i++) {
+    if (s[i] != line[i])
+      return (unsigned char)s[i] - (unsigned char)line[i];
+  }
+  return (unsigned char)s[i];
 }
 
-static char *
-extract_line_index(dic_info *di, int off, char *buf, int len)
+/* whether s is a proper prefix of the index of a line */
+static int
+is_line_index_prefix(const char *s, int slen, const char *line, int len)
 {
-  const char *p = find_line(di, off);
-  int i;
-  if (p[0] == ';')
-    return NULL;
-
-  for (i = 0; i < len && p[i] != ' '; i++)
-    buf[i] = p[i];
-  buf[i] = '\0';
-
-  return buf;
+  return slen < len && line[slen] != ' ' && line[slen] != '\n'
+    && !memcmp(s, line, slen);
 }
 
+/*
+ * Bisect the line offsets for s.  d is 1 for an ascending section and
+ * -1 for a descending one.  Returns the index of the first line not
+ * ordered before s, and sets *found if that line matches s.
+ */
 static int
-do_search_line(dic_info *di, const char *s, int min,
-	       int max, int d)
+bisect_line_index(dic_info *di, const int *lines, int nr_lines,
+		  const char *s, int d, int *found)
 {
-  char buf[256];
-  char *r;
-  int idx = ((unsigned int)min + (unsigned int)max) >> 1;
-  int c = 0;
-
-  if (abs(max - min) < 4)
-    return -1;
-
-  r = extract_line_index(di, idx, buf, 256);
-  if (r)
-    c = strcmp(s, r);
-  else
-    return -1;
-
-  if (!c)
-    return idx;
-
-  if (c * d > 0)
-    return do_search_line(di, s, idx, max, d);
-  else
-    return do_search_line(di, s, min, idx, d);
+  const char *addr = di->addr;
+  int lo = 0, hi = nr_lines, mid, c;
+
+  *found = 0;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    c = compare_line_index(s, &addr[lines[mid]], di->size - lines[mid]) * d;
+    if (c > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < nr_lines
+      && !compare_line_index(s, &addr[lines[lo]], di->size - lines[lo]))
+    *found = 1;
 
-  return -1;
+  return lo;
 }
 
 /* This function name is temporary. I want a better name. */
@@ -483,6 +728,8 @@ free_skk_dic(dic_info *skk_dic)
       sl = sl->next;
       free_skk_line(tmp);
     }
+    free_cache_index(skk_dic);
+    free(skk_dic->okuri_ari_lines);
 
     if (skk_dic->skkserv_state & SKK_SERV_CONNECTED)
       close_skkserv();
@@ -687,6 +934,10 @@ alloc_skk_line(const char *word, char okuri_head)
   sl->cands[0].nr_real_cands = 0;
   sl->cands[0].is_used = 0;
   sl->cands[0].line = sl;
+  sl->next = NULL;
+  sl->prev = NULL;
+  sl->hash_next = NULL;
+  sl->lru_stamp = 0;
   return sl;
 }
 
@@ -719,6 +970,9 @@ copy_skk_line(struct skk_line *p)
     ca->line = sl;
   }
   sl->next = NULL;
+  sl->prev = NULL;
+  sl->hash_next = NULL;
+  sl->lru_stamp = 0;
   return sl;
 }
 
@@ -741,26 +995,41 @@ static void
 add_line_to_cache_head(dic_info *di, struct skk_line *sl)
 {
   sl->next = di->head.next;
+  sl->prev = NULL;
+  if (di->head.next)
+    di->head.next->prev = sl;
   di->head.next = sl;
+  sl->lru_stamp = ++di->lru_clock;
 
   di->cache_len++;
   di->cache_modified = 1;
+
+  /* the index is built lazily by search_line_from_cache() */
+  if (di->cache_tab) {
+    if (di->cache_len * 2 > di->cache_tab_size)
+      rebuild_cache_index(di);
+    else
+      cache_index_insert(di, sl);
+  }
+  di->comp_index_dirty = 1;
 }
 
 static void
 move_line_to_cache_head(dic_info *di, struct skk_line *sl)
 {
-  struct skk_line *prev;
+  if (!di->cache_tab)
+    rebuild_cache_index(di);
 
+  sl->lru_stamp = ++di->lru_clock;
   if (di->head.next == sl)
     return;
 
-  prev = di->head.next;
-  while (prev->next != sl) {
-    prev = prev->next;
-  }
-  prev->next = sl->next;
+  sl->prev->next = sl->next;
+  if (sl->next)
+    sl->next->prev = sl->prev;
   sl->next = di->head.next;
+  sl->prev = NULL;
+  di->head.next->prev = sl;
   di->head.next = sl;
 
   di->cache_modified = 1;
@@ -791,81 +1060,49 @@ add_line_to_cache_last(dic_info *di, struct skk_line *sl)
 static struct skk_line *
 search_line_from_server(dic_info *di, const char *s, char okuri_head)
 {
-  char r;
+  struct skkserv_request *req;
   struct skk_line *sl;
-  int n = 0, ret, len;
-  char buf[SKK_SERV_BUFSIZ];
-  char *line, *idx;
-  ssize_t nr;
+  int ret;
+  char *line, *idx, *reply;
 
-  if (!(di->skkserv_state & SKK_SERV_CONNECTED)) {
-    if (!((di->skkserv_state |= open_skkserv(di->skkserv_hostname,
-					     di->skkserv_portnum,
-					     di->skkserv_family)) &
-	  SKK_SERV_CONNECTED))
-      return NULL;
-  }
+  if (!skkserv_ensure_connected(di))
+    return NULL;
 
   uim_asprintf(&idx, "%s%c", s, okuri_head);
-
-  fprintf(wserv, "1%s \n", idx);
-  ret = fflush(wserv);
-  if (ret != 0 && errno == EPIPE) {
+  req = skkserv_send_request(di, '1', idx);
+  if (!req) {
     free(idx);
-    skkserv_disconnected(di);
     return NULL;
   }
 
-  uim_asprintf(&line, "%s ", idx);
-  free(idx);
-
-  if ((nr = read(skkservsock, &r, 1)) == -1 || nr == 0) {
-    skkserv_disconnected(di);
-    free(line);
+  ret = skkserv_wait_reply(di, req, di->skkserv_timeout);
+  if (ret <= 0) {
+    /* the reply is kept for the next lookup if it comes late */
+    if (ret == 0)
+      di->skkserv_state |= SKK_SERV_TIMEDOUT;
+    free(idx);
     return NULL;
   }
 
-  if (r == '1') {  /* succeeded */
-    while (1) {
-      if ((nr = read(skkservsock, &r, 1)) == -1 || nr == 0) {
-	skkserv_disconnected(di);
-	free(line);
-	return NULL;
-      }
-
-      if (r == '\n') {
-	len = strlen(line) + n;
-	line = uim_realloc(line, len + 1);
-	strlcat(line, buf, len + 1);
-	break;
-      }
-
-      buf[n] = r;
-      buf[n + 1] = '\0';
-      if (n == SKK_SERV_BUFSIZ - 2) {
-	len = strlen(line) + n + 1;
-	line = uim_realloc(line, len + 1);
-	strlcat(line, buf, len + 1);
-	n = 0;
-      } else {
-	n++;
-      }
-    }
-    sl = compose_line(di, s, okuri_head, line);
-    free(line);
-    return sl;
-  } else {
-    while ((nr = read(skkservsock, &r, 1)) != -1 && nr != 0 && r != '\n')
-      ;
-    free(line);
+  reply = skkserv_take_reply(req);
+  if (reply[0] != '1') {  /* not found */
+    free(reply);
+    free(idx);
     return NULL;
   }
+
+  uim_asprintf(&line, "%s %s", idx, &reply[1]);
+  free(reply);
+  free(idx);
+  sl = compose_line(di, s, okuri_head, line);
+  free(line);
+  return sl;
 }
 
 static struct skk_line *
 search_line_from_file(dic_info *di, const char *s, char okuri_head)
 {
-  int n;
+  int n, found;
   const char *p;
   int len;
   char *line, *idx;
@@ -876,22 +1113,26 @@ search_line_from_file(dic_info *di, const char *s, char okuri_head)
 
   uim_asprintf(&idx, "%s%c", s, okuri_head);
 
-  if (okuri_head)
-    n = do_search_line(di, idx, di->first, di->border - 1, -1);
-  else
-    n = do_search_line(di, idx, di->border, di->size - 1, 1);
+  if (okuri_head) {
+    n = bisect_line_index(di, di->okuri_ari_lines, di->nr_okuri_ari_lines,
+			  idx, -1, &found);
+    n = found ? di->okuri_ari_lines[n] : -1;
+  } else {
+    n = bisect_line_index(di, di->okuri_nasi_lines, di->nr_okuri_nasi_lines,
+			  idx, 1, &found);
+    n = found ? di->okuri_nasi_lines[n] : -1;
+  }
 
   free(idx);
 
   if (n == -1)
     return NULL;
 
-  p = find_line(di, n);
-  len = calc_line_len(p);
+  p = (const char *)di->addr + n;
+  len = line_len_at(di, n);
   line = uim_malloc(len + 1);
-  /* strncat is used intentionally because *p is too long string */
-  line[0] = '\0';
-  strncat(line, p, len);
+  memcpy(line, p, len);
+  line[len] = '\0';
   sl = compose_line(di, s, okuri_head, line);
   free(line);
   return sl;
@@ -900,17 +1141,39 @@ search_line_from_file(dic_info *di, const char *s, char okuri_head)
 static struct skk_line *
 search_line_from_cache(dic_info *di, const char *s, char okuri_head)
 {
-  struct skk_line *sl;
+  struct skk_line *sl, *found = NULL;
+  unsigned int i;
 
   if (!di)
     return NULL;
 
-  /* search from cache */
-  for (sl = di->head.next; sl; sl = sl->next) {
-    if (!strcmp(sl->head, s) && sl->okuri_head == okuri_head)
-      return sl;
+  if (!di->cache_tab)
+    rebuild_cache_index(di);
+
+  /* the most recently used one wins if the cache has duplicated lines */
+  i = line_hash(s, okuri_head) & (di->cache_tab_size - 1);
+  for (sl = di->cache_tab[i]; sl; sl = sl->hash_next) {
+    if (sl->okuri_head == okuri_head && !strcmp(sl->head, s)
+	&& (!found || sl->lru_stamp > found->lru_stamp))
+      found = sl;
   }
-  return NULL;
+  return found;
+}
+
+/* send a lookup ahead so that its reply shares the round trip */
+static void
+prefetch_line_from_server(dic_info *di, const char *s, char okuri_head)
+{
+  char *idx;
+
+  if (!(di->skkserv_state & SKK_SERV_USE)
+      || search_line_from_cache(di, s, okuri_head)
+      || !skkserv_ensure_connected(di))
+    return;
+
+  uim_asprintf(&idx, "%s%c", s, okuri_head);
+  skkserv_send_request(di, '1', idx);
+  free(idx);
 }
 
 
@@ -926,6 +1189,7 @@ find_cand_array(dic_info *di, const char *s,
   if (!di)
     return NULL;
 
+  di->skkserv_state &= ~SKK_SERV_TIMEDOUT;
   sl = search_line_from_cache(di, s, okuri_head);
   if (!sl) {
     if (di->skkserv_state & SKK_SERV_USE)
@@ -957,6 +1221,9 @@ find_cand_array(dic_info *di, const char *s,
       free_skk_line(sl_file);
     }
   }
+  /* ask the server again next time */
+  if (di->skkserv_state & SKK_SERV_TIMEDOUT)
+    ca->is_used = 0;
 
   return ca;
 }
@@ -990,6 +1257,11 @@ find_cand_array_lisp(dic_info *skk_dic, uim_lisp head_, uim_lisp okuri_head_,
   if (!rs)
     ca = find_cand_array(skk_dic, hs, o, okuri, create_if_not_found);
   else {
+    /* the caller falls back to hs when rs has no entry */
+    if (skk_dic) {
+      prefetch_line_from_server(skk_dic, rs, o);
+      prefetch_line_from_server(skk_dic, hs, o);
+    }
     ca = find_cand_array(skk_dic, rs, o, okuri, create_if_not_found);
     free(rs);
   }
@@ -1882,11 +2154,96 @@ skk_get_nr_candidates(uim_lisp skk_dic_, uim_lisp head_, uim_lisp okuri_head_, u
   return MAKE_INT(nr_cands);
 }
 
+/*
+ * Find the okuri-nasi lines of the dictionary file whose index s is a
+ * proper prefix of.  Returns the number of candidate lines from *start;
+ * a line equal to s may lead the range and has to be skipped.
+ */
+static int
+find_comp_range_from_file(dic_info *di, const char *s, int *start)
+{
+  const char *addr = di->addr;
+  const int *lines = di->okuri_nasi_lines;
+  int i, found, slen = strlen(s);
+
+  *start = 0;
+  if (!addr || !uim_scm_symbol_value_bool("skk-dic-enable-completion?"))
+    return 0;
+
+  *start = bisect_line_index(di, lines, di->nr_okuri_nasi_lines, s, 1,
+			     &found);
+  for (i = *start + found; i < di->nr_okuri_nasi_lines; i++) {
+    if (!is_line_index_prefix(s, slen, &addr[lines[i]],
+			      di->size - lines[i]))
+      break;
+  }
+  return i - *start;
+}
+
+static char *
+dup_line_index(dic_info *di, int off)
+{
+  const char *p = (const char *)di->addr + off;
+  int len = line_len_at(di, off);
+  char *sp = memchr(p, ' ', len);
+  char *str;
+
+  if (sp)
+    len = sp - p;
+  str = uim_malloc(len + 1);
+  memcpy(str, p, len);
+  str[len] = '\0';
+  return str;
+}
+
+static void
+append_comp_array_from_file(struct skk_comp_array *ca, dic_info *di,
+			    const char *s)
+{
+  struct skk_line *sl;
+  char *head;
+  int i, start, nr;
+
+  nr = find_comp_range_from_file(di, s, &start);
+  if (!nr)
+    return;
+
+  ca->comps = uim_realloc(ca->comps, sizeof(char *) * (ca->nr_comps + nr));
+  for (i = start; i < start + nr; i++) {
+    head = dup_line_index(di, di->okuri_nasi_lines[i]);
+    /* skip the word itself and words already taken from the cache */
+    sl = search_line_from_cache(di, head, '\0');
+    if (!strcmp(head, s)
+	|| (sl && (sl->state & SKK_LINE_USE_FOR_COMPLETION))) {
+      free(head);
+      continue;
+    }
+    ca->comps[ca->nr_comps++] = head;
+  }
+}
+
+static char *
+find_top_comp_from_file(dic_info *di, const char *s)
+{
+  char *head;
+  int i, start, nr;
+
+  nr = find_comp_range_from_file(di, s, &start);
+  for (i = start; i < start + nr; i++) {
+    head = dup_line_index(di, di->okuri_nasi_lines[i]);
+    if (strcmp(head, s))
+      return head;
+    free(head);
+  }
+  return NULL;
+}
+
 static struct skk_comp_array *
 make_comp_array_from_cache(dic_info *di, const char *s, uim_lisp use_look_)
 {
-  struct skk_line *sl;
+  struct skk_line **lines;
   struct skk_comp_array *ca;
+  int i, nr_lines;
 
   if (!di)
     return NULL;
@@ -1899,23 +2256,22 @@ make_comp_array_from_cache(dic_info *di, const char *s, uim_lisp use_look_)
   ca->next = NULL;
 
   /* search from cache */
-  for (sl = di->head.next; sl; sl = sl->next) {
-    if (/* string 's' is part of sl->head */
-	!strncmp(sl->head, s, strlen(s)) && strcmp(sl->head, s) &&
-	/* and sl is okuri-nasi line */
-	sl->okuri_head == '\0' &&
-	/* exclude some entries */
-	sl->state & SKK_LINE_USE_FOR_COMPLETION) {
-      ca->nr_comps++;
-      ca->comps = uim_realloc(ca->comps, sizeof(char *) * ca->nr_comps);
-      ca->comps[ca->nr_comps - 1] = uim_strdup(sl->head);
-    }
+  lines = find_comp_lines(di, s, &nr_lines);
+  if (nr_lines) {
+    ca->comps = uim_malloc(sizeof(char *) * nr_lines);
+    for (i = 0; i < nr_lines; i++)
+      ca->comps[i] = uim_strdup(lines[i]->head);
+    ca->nr_comps = nr_lines;
   }
+  free(lines);
+
+  append_comp_array_from_file(ca, di, s);
 
   if (TRUEP(use_look_))
     look_get_comp(ca, s);
 
   if (ca->nr_comps == 0) {
+    free(ca->comps);
     free(ca);
     ca = NULL;
   } else {
@@ -1929,118 +2285,76 @@ make_comp_array_from_cache(dic_info *di, const char *s, uim_lisp use_look_)
 static struct skk_comp_array *
 append_comp_array_from_server(struct skk_comp_array *ca, dic_info *di, const char *s, uim_lisp use_look_)
 {
-  char r;
+  struct skkserv_request *req, *r;
   struct skk_line *sl;
-  int n = 0, ret, len;
-  int i;
-  char buf[SKK_SERV_BUFSIZ];
-  char *line;
-  ssize_t nr;
-  struct pollfd pfd[1];
+  int i, ret;
+  char *line, *reply, *p;
 
-  if (!di) {
+  if (!di || !skkserv_ensure_connected(di))
     return ca;
-  }
-  if (!(di->skkserv_state & SKK_SERV_CONNECTED)) {
-    if (!((di->skkserv_state |= open_skkserv(di->skkserv_hostname,
-					     di->skkserv_portnum,
-					     di->skkserv_family)) &
-	  SKK_SERV_CONNECTED))
-      return ca;
-  }
 
-  fprintf(wserv, "4%s \n", s);
-  ret = fflush(wserv);
-  if (ret != 0 && errno == EPIPE) {
-    skkserv_disconnected(di);
+  req = skkserv_send_request(di, '4', s);
+  if (!req)
     return ca;
-  }
 
-  /* check server response to see the capability of completion */
-  pfd[0].fd = skkservsock;
-  pfd[0].events = POLLIN;
-  ret = poll(pfd, 1, di->skkserv_completion_timeout);
-  if (ret == -1) {
-    skkserv_disconnected(di);
+  ret = skkserv_wait_reply(di, req, di->skkserv_completion_timeout);
+  if (ret == -1)
     return ca;
-  } else if (ret == 0) {
-    uim_notify_info(N_("SKK server without completion capability\n"));
-    /* don't try server completion further any more */
-    di->skkserv_state &= ~SKK_SERV_TRY_COMPLETION;
+  if (ret == 0) {
+    for (r = skkserv_queue; r != req && r->reply; r = r->next)
+      ;
+    /* replies to earlier requests came but not this one */
+    if (r == req) {
+      uim_notify_info(N_("SKK server without completion capability\n"));
+      /* don't try server completion further any more */
+      di->skkserv_state &= ~SKK_SERV_TRY_COMPLETION;
+      /* a late reply would be taken for the next one's */
+      skkserv_disconnected(di);
+    }
     return ca;
   }
 
-  if ((nr = read(skkservsock, &r, 1)) == -1 || nr == 0) {
-    skkserv_disconnected(di);
+  reply = skkserv_take_reply(req);
+  if (reply[0] != '1') {
+    free(reply);
     return ca;
   }
 
-  if (r == '1') {
-    char sep = '\0';
-    uim_asprintf(&line, "%s ", s);
-    while (1) {
-      if ((nr = read(skkservsock, &r, 1)) == -1 || nr == 0) {
-        skkserv_disconnected(di);
-        free(line);
-        return ca;
-      }
-
-      if (r == '\n') {
-        len = strlen(line) + n;
-        line = uim_realloc(line, len + 1);
-        strlcat(line, buf, len + 1);
-        break;
-      }
-
-      /* FIXME: should handle word with '/' properly */
-      if (n == 0 && sep == '\0') {
-	sep = r;
-      } else {
-	if (sep == ' ' && r == ' ') {
-	  r = '/';
-	}
-      }
-
-      buf[n] = r;
-      buf[n + 1] = '\0';
-      if (n == SKK_SERV_BUFSIZ - 2) {
-        len = strlen(line) + n + 1;
-        line = uim_realloc(line, len + 1);
-        strlcat(line, buf, len + 1);
-        n = 0;
-      } else {
-        n++;
-      }
+  /* FIXME: should handle word with '/' properly */
+  if (reply[1] == ' ') {
+    for (p = &reply[2]; *p; p++) {
+      if (*p == ' ')
+	*p = '/';
     }
-    sl = compose_line(di, s, '\0', line);
-    free(line);
-
-    if (!ca) {
-      ca = uim_malloc(sizeof(struct skk_comp_array));
-      ca->nr_comps = 0;
-      ca->refcount = 0;
-      ca->comps = NULL;
-      ca->head = NULL;
-      ca->next = NULL;
-    }
-    for (i = 0; i < sl->cands[0].nr_cands; i++) {
-      if (strcmp(s, sl->cands[0].cands[i]) != 0) {
-        ca->nr_comps++;
-        ca->comps = uim_realloc(ca->comps, sizeof(char *) * ca->nr_comps);
-        ca->comps[ca->nr_comps - 1] = uim_strdup(sl->cands[0].cands[i]);
-      }
-    }
-    free_skk_line(sl);
-    if (ca->nr_comps == 0) {
-      free(ca);
-      ca = NULL;
-    } else if (ca->head == NULL) {
-      ca->head = uim_strdup(s);
-      ca->next = skk_comp;
-      skk_comp = ca;
+  }
+  uim_asprintf(&line, "%s %s", s, &reply[1]);
+  free(reply);
+  sl = compose_line(di, s, '\0', line);
+  free(line);
+
+  if (!ca) {
+    ca = uim_malloc(sizeof(struct skk_comp_array));
+    ca->nr_comps = 0;
+    ca->refcount = 0;
+    ca->comps = NULL;
+    ca->head = NULL;
+    ca->next = NULL;
+  }
+  for (i = 0; i < sl->cands[0].nr_cands; i++) {
+    if (strcmp(s, sl->cands[0].cands[i]) != 0) {
+      ca->nr_comps++;
+      ca->comps = uim_realloc(ca->comps, sizeof(char *) * ca->nr_comps);
+      ca->comps[ca->nr_comps - 1] = uim_strdup(sl->cands[0].cands[i]);
     }
-  } else {
-    while ((nr = read(skkservsock, &r, 1)) != -1 && nr != 0 && r != '\n');
+  }
+  free_skk_line(sl);
+  if (ca->nr_comps == 0) {
+    free(ca);
+    ca = NULL;
+  } else if (ca->head == NULL) {
+    ca->head = uim_strdup(s);
+    ca->next = skk_comp;
+    skk_comp = ca;
   }
 
   return ca;
@@ -2082,6 +2396,20 @@ find_comp_array_lisp(dic_info *skk_dic, uim_lisp head_, uim_lisp numeric_conv_,
   if (!rs)
     ca = find_comp_array(skk_dic, hs, use_look_);
   else {
+    /*
+     * The caller falls back to hs when rs has no completion.  Only ask
+     * ahead if rs is waited for, so that a server ignoring completion
+     * requests is still detected by the timeout.
+     */
+    for (ca = skk_comp; ca; ca = ca->next) {
+      if (!strcmp(ca->head, rs))
+	break;
+    }
+    if (!ca && skk_dic && (skk_dic->skkserv_state & SKK_SERV_TRY_COMPLETION)
+	&& strlen(rs) > 0 && skkserv_ensure_connected(skk_dic)) {
+      skkserv_send_request(skk_dic, '4', rs);
+      skkserv_send_request(skk_dic, '4', hs);
+    }
     ca = find_comp_array(skk_dic, rs, use_look_);
     free(rs);
   }
@@ -2263,10 +2591,10 @@ static uim_lisp
 skk_get_dcomp_word(uim_lisp skk_dic_, uim_lisp head_, uim_lisp numeric_conv_, uim_lisp use_look_)
 {
   const char *hs;
-  struct skk_line *sl;
-  int len;
+  struct skk_line **lines;
+  int len, nr_lines;
   uim_lisp numlst_, look_;
-  char *rs = NULL;
+  char *rs = NULL, *word;
   dic_info *skk_dic = NULL;
 
   if (PTRP(skk_dic_))
@@ -2287,25 +2615,32 @@ skk_get_dcomp_word(uim_lisp skk_dic_, uim_lisp head_, uim_lisp numeric_conv_, ui
   if (len != 0) {
     /* Search from cache using same way as in make_comp_array_from_cache(). */
     if (!rs) {
-      for (sl = skk_dic->head.next; sl; sl = sl->next) {
-	if (!strncmp(sl->head, hs, len) && strcmp(sl->head, hs) &&
-			sl->okuri_head == '\0' &&
-			sl->state & SKK_LINE_USE_FOR_COMPLETION)
-	  return MAKE_STR(sl->head);
+      lines = find_comp_lines(skk_dic, hs, &nr_lines);
+      if (nr_lines) {
+	look_ = MAKE_STR(lines[0]->head);
+	free(lines);
+	return look_;
       }
+      if ((word = find_top_comp_from_file(skk_dic, hs)))
+	return MAKE_STR_DIRECTLY(word);
       if (TRUEP(use_look_)) {
 	look_ = look_get_top_word(hs);
 	if (TRUEP(look_))
 	  return look_;
       }
     } else {
-      for (sl = skk_dic->head.next; sl; sl = sl->next) {
-	if (!strncmp(sl->head, rs, len) && strcmp(sl->head, rs) &&
-			sl->okuri_head == '\0' &&
-			sl->state & SKK_LINE_USE_FOR_COMPLETION) {
-	  free(rs);
-	  return restore_numeric(sl->head, numlst_);
-	}
+      lines = find_comp_lines(skk_dic, rs, &nr_lines);
+      if (nr_lines) {
+	free(rs);
+	look_ = restore_numeric(lines[0]->head, numlst_);
+	free(lines);
+	return look_;
+      }
+      if ((word = find_top_comp_from_file(skk_dic, rs))) {
+	free(rs);
+	look_ = restore_numeric(word, numlst_);
+	free(word);
+	return look_;
       }
       if (TRUEP(use_look_)) {
 	look_ = look_get_top_word(rs);
@@ -3343,8 +3678,7 @@ update_personal_dictionary_cache_with_file(dic_info *skk_dic, const char *fn,
   int i, diff_len = 0;
 
   di = (dic_info *)uim_malloc(sizeof(dic_info));
-  di->cache_len = 0;
-  di->head.next = NULL;
+  init_dic_cache(di);
 
   if (!read_dictionary_file(di, fn, is_personal)) {
     free(di);
@@ -3357,6 +3691,8 @@ update_personal_dictionary_cache_with_file(dic_info *skk_dic, const char *fn,
     skk_dic->cache_len = di->cache_len;
     skk_dic->cache_modified = di->cache_modified;
     skk_dic->personal_dic_timestamp = di->personal_dic_timestamp;
+    rebuild_cache_index(skk_dic);
+    free_cache_index(di);
     free(di);
     return;
   }
@@ -3409,6 +3745,7 @@ update_personal_dictionary_cache_with_file(dic_info *skk_dic, const char *fn,
   }
 
   skk_dic->cache_modified = 1;
+  rebuild_cache_index(skk_dic);
 
   sl = di->head.next;
   while (sl) {
@@ -3416,6 +3753,7 @@ update_personal_dictionary_cache_with_file(dic_info *skk_dic, const char *fn,
     sl = sl->next;
     free_skk_line(tmp);
   }
+  free_cache_index(di);
   free(di);
   free(cache_array);
 }
@@ -3834,9 +4172,9 @@ open_skkserv(const char *hostname, int portnum, int family)
 #if 0
   uim_notify_info("uim-skk: SKKSERVER=%s", hostname);
 #endif
+  /* never stall the input context on the socket */
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
   skkservsock = sock;
-  rserv = fdopen(sock, "r");
-  wserv = fdopen(sock, "w");
 
   enable_completion =
     uim_scm_symbol_value_bool("skk-skkserv-enable-completion?") ?
@@ -3847,12 +4185,228 @@ open_skkserv(const char *hostname, int portnum, int family)
 static void
 close_skkserv()
 {
+  struct skkserv_request *req;
+
   if (skkservsock >= 0) {
-    fprintf(wserv, "0\n");
-    fflush(wserv);
+    (void)write(skkservsock, "0\n", 2);
     close(skkservsock);
     skkservsock = -1;
   }
+
+  while (skkserv_queue) {
+    req = skkserv_queue;
+    skkserv_queue = req->next;
+    free(req->key);
+    free(req->reply);
+    free(req);
+  }
+  free(skkserv_rbuf);
+  skkserv_rbuf = NULL;
+  skkserv_rbuf_len = skkserv_rbuf_size = 0;
+}
+
+static int
+skkserv_ensure_connected(dic_info *di)
+{
+  if (!(di->skkserv_state & SKK_SERV_CONNECTED))
+    di->skkserv_state |= open_skkserv(di->skkserv_hostname,
+				      di->skkserv_portnum,
+				      di->skkserv_family);
+
+  return di->skkserv_state & SKK_SERV_CONNECTED;
+}
+
+/* milliseconds left until the deadline, or -1 for no deadline */
+static int
+skkserv_time_left(const struct timeval *start, int timeout)
+{
+  struct timeval now;
+  long elapsed;
+
+  if (timeout < 0)
+    return -1;
+
+  gettimeofday(&now, NULL);
+  elapsed = (now.tv_sec - start->tv_sec) * 1000
+    + (now.tv_usec - start->tv_usec) / 1000;
+
+  return elapsed >= timeout ? 0 : timeout - elapsed;
+}
+
+/*
+ * Write all of buf, waiting at most timeout milliseconds (-1 for ever)
+ * for the socket to drain.  A request cut short leaves the stream out
+ * of sync, so the caller drops the connection on failure.
+ */
+static int
+skkserv_write(const char *buf, size_t len, int timeout)
+{
+  struct timeval start;
+  struct pollfd pfd[1];
+  ssize_t nr;
+  int ret;
+
+  gettimeofday(&start, NULL);
+  while (len > 0) {
+    nr = write(skkservsock, buf, len);
+    if (nr == -1) {
+      if (errno == EINTR)
+	continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+	return -1;
+      pfd[0].fd = skkservsock;
+      pfd[0].events = POLLOUT;
+      ret = poll(pfd, 1, skkserv_time_left(&start, timeout));
+      if (ret == 0 || (ret == -1 && errno != EINTR))
+	return -1;
+      continue;
+    }
+    buf += nr;
+    len -= nr;
+  }
+  return 0;
+}
+
+/*
+ * Send a request unless the same one is already waiting for or holding
+ * its reply.  Returns NULL if the connection is lost.
+ */
+static struct skkserv_request *
+skkserv_send_request(dic_info *di, char cmd, const char *key)
+{
+  struct skkserv_request *req, **tail;
+  char *msg;
+  int len, nr_unclaimed = 0;
+
+  for (tail = &skkserv_queue; *tail; tail = &(*tail)->next) {
+    req = *tail;
+    if (req->cmd == cmd && !strcmp(req->key, key))
+      return req;
+    if (req->reply)
+      nr_unclaimed++;
+  }
+
+  /* answered requests always precede unanswered ones */
+  while (nr_unclaimed-- > SKK_SERV_MAX_UNCLAIMED_REPLIES) {
+    req = skkserv_queue;
+    skkserv_queue = req->next;
+    if (tail == &req->next)
+      tail = &skkserv_queue;
+    free(req->key);
+    free(req->reply);
+    free(req);
+  }
+
+  len = uim_asprintf(&msg, "%c%s \n", cmd, key);
+  if (len < 0 || skkserv_write(msg, len, di->skkserv_timeout) == -1) {
+    free(msg);
+    skkserv_disconnected(di);
+    return NULL;
+  }
+  free(msg);
+
+  req = uim_malloc(sizeof(struct skkserv_request));
+  req->cmd = cmd;
+  req->key = uim_strdup(key);
+  req->reply = NULL;
+  req->next = NULL;
+  *tail = req;
+
+  return req;
+}
+
+/* hand complete reply lines to the requests in order */
+static int
+skkserv_read_replies(void)
+{
+  struct skkserv_request *req;
+  char *nl, *line;
+  ssize_t nr;
+  size_t consumed;
+
+  for (;;) {
+    if (skkserv_rbuf_size - skkserv_rbuf_len < SKK_SERV_BUFSIZ) {
+      skkserv_rbuf_size += SKK_SERV_BUFSIZ;
+      skkserv_rbuf = uim_realloc(skkserv_rbuf, skkserv_rbuf_size);
+    }
+    nr = read(skkservsock, skkserv_rbuf + skkserv_rbuf_len,
+	      skkserv_rbuf_size - skkserv_rbuf_len - 1);
+    if (nr == 0)
+      return -1;
+    if (nr == -1) {
+      if (errno == EINTR)
+	continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+	break;
+      return -1;
+    }
+    skkserv_rbuf_len += nr;
+  }
+
+  consumed = 0;
+  req = skkserv_queue;
+  while ((nl = memchr(skkserv_rbuf + consumed, '\n',
+		      skkserv_rbuf_len - consumed))) {
+    while (req && req->reply)
+      req = req->next;
+    line = skkserv_rbuf + consumed;
+    consumed = nl - skkserv_rbuf + 1;
+    /* a reply nobody asked for means the stream is out of sync */
+    if (!req)
+      return -1;
+    req->reply = uim_malloc(nl - line + 1);
+    memcpy(req->reply, line, nl - line);
+    req->reply[nl - line] = '\0';
+  }
+  memmove(skkserv_rbuf, skkserv_rbuf + consumed, skkserv_rbuf_len - consumed);
+  skkserv_rbuf_len -= consumed;
+
+  return 0;
+}
+
+/*
+ * Wait at most timeout milliseconds (-1 for ever) for the reply to req.
+ * Returns 1 if it arrived, 0 on timeout and -1 if the connection is lost.
+ */
+static int
+skkserv_wait_reply(dic_info *di, struct skkserv_request *req, int timeout)
+{
+  struct timeval start;
+  struct pollfd pfd[1];
+  int ret;
+
+  gettimeofday(&start, NULL);
+  while (!req->reply) {
+    pfd[0].fd = skkservsock;
+    pfd[0].events = POLLIN;
+    ret = poll(pfd, 1, skkserv_time_left(&start, timeout));
+    if (ret == -1 && errno == EINTR)
+      continue;
+    if (ret == 0)
+      return 0;
+    if (ret == -1 || skkserv_read_replies() == -1) {
+      skkserv_disconnected(di);
+      return -1;
+    }
+  }
+  return 1;
+}
+
+/* remove an answered request from the queue and return its reply */
+static char *
+skkserv_take_reply(struct skkserv_request *req)
+{
+  struct skkserv_request **p;
+  char *reply;
+
+  for (p = &skkserv_queue; *p != req; p = &(*p)->next)
+    ;
+  *p = req->next;
+
+  reply = req->reply;
+  free(req->key);
+  free(req);
+  return reply;
 }
 
 static void
@@ -3874,6 +4428,7 @@ reset_is_used_flag_of_cache(dic_info *di)
 static void
 skkserv_disconnected(dic_info *di)
 {
+  close_skkserv();
   di->skkserv_state &= ~SKK_SERV_CONNECTED;
   reset_is_used_flag_of_cache(di);
 }
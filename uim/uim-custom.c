@@ -180,7 +180,6 @@ static char *literalize_string_internal(const char *str);
 
 static char *c_list_to_str(const void *const *list, char *(*mapper)(const void *elem), const char *sep);
 
-static int uim_custom_type_eq(const char *custom_sym, const char *custom_type);
 static int uim_custom_type(const char *custom_sym);
 static int uim_custom_is_active(const char *custom_sym);
 static const char *uim_custom_get_str(const char *custom_sym,
@@ -237,6 +236,7 @@ struct custom_cb_add_args {
 static void *custom_cb_add_internal(struct custom_cb_add_args *args);
 
 static void helper_disconnect_cb(void);
+static void custom_mark_dirty(const char *custom_sym);
 static char *uim_conf_path(const char *subpath);
 static char *custom_file_path(const char *group, pid_t pid);
 static uim_bool prepare_dir(const char *dir);
@@ -248,9 +248,15 @@ static const char *uim_custom_get_primary_group_by_custom(const char *custom_sym
 
 static const char str_list_arg[] = "uim-custom-c-str-list-arg";
 static const char custom_subdir[] = "customs";
-static const char custom_msg_tmpl[] = "prop_update_custom\n%s\n%s\n";
+static const char custom_batch_msg_head[] = "custom_update_batch\n";
+static const char custom_batch_msg_tmpl[] = "%s\n%s\n";
 static int helper_fd = -1;
+/* customs changed by uim_custom_set() since the last broadcast */
+static char **dirty_customs;
+static size_t nr_dirty_customs;
 static uim_lisp return_val;
+/* handles of the accessors queried for every custom variable */
+static uim_lisp custom_type_proc, custom_active_proc;
 static uim_lisp uim_scm_last_val;
 
 
@@ -420,44 +426,47 @@ c_list_to_str(const void *const *list, char *(*mapper)(const void *elem), const
   return buf;
 }
 
-static int
-uim_custom_type_eq(const char *custom_sym, const char *custom_type)
-{
-  UIM_EVAL_FSTRING2(NULL, "(eq? (custom-type '%s) '%s)",
-		    custom_sym, custom_type);
-
-  return uim_scm_c_bool(uim_scm_return_value());
-}
-
 static int
 uim_custom_type(const char *custom_sym)
 {
-  if (uim_custom_type_eq(custom_sym, "boolean")) {
-    return UCustom_Bool;
-  } else if (uim_custom_type_eq(custom_sym, "integer")) {
-    return UCustom_Int;
-  } else if (uim_custom_type_eq(custom_sym, "string")) {
-    return UCustom_Str;
-  } else if (uim_custom_type_eq(custom_sym, "pathname")) {
-    return UCustom_Pathname;
-  } else if (uim_custom_type_eq(custom_sym, "choice")) {
-    return UCustom_Choice;
-  } else if (uim_custom_type_eq(custom_sym, "ordered-list")) {
-    return UCustom_OrderedList;
-  } else if (uim_custom_type_eq(custom_sym, "key")) {
-    return UCustom_Key;
-  } else if (uim_custom_type_eq(custom_sym, "table")) {
-    return UCustom_Table;
-  } else {
+  static const struct {
+    const char *name;
+    int type;
+  } types[] = {
+    {"boolean",      UCustom_Bool},
+    {"integer",      UCustom_Int},
+    {"string",       UCustom_Str},
+    {"pathname",     UCustom_Pathname},
+    {"choice",       UCustom_Choice},
+    {"ordered-list", UCustom_OrderedList},
+    {"key",          UCustom_Key},
+    {"table",        UCustom_Table}
+  };
+  char *type_sym;
+  size_t i;
+  int type;
+
+  return_val = uim_scm_call_handle(custom_type_proc, "y", custom_sym);
+  if (!uim_scm_symbolp(return_val))
     return UCustom_Bool;
+
+  type = UCustom_Bool;
+  type_sym = uim_scm_c_symbol(return_val);
+  for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    if (strcmp(type_sym, types[i].name) == 0) {
+      type = types[i].type;
+      break;
+    }
   }
+  free(type_sym);
+
+  return type;
 }
 
 static int
 uim_custom_is_active(const char *custom_sym)
 {
-  UIM_EVAL_FSTRING1(NULL, "(custom-active? '%s)", custom_sym);
-  return_val = uim_scm_return_value();
+  return_val = uim_scm_call_handle(custom_active_proc, "y", custom_sym);
 
   return uim_scm_c_bool(return_val);
 }
@@ -465,8 +474,7 @@ uim_custom_is_active(const char *custom_sym)
 static const char *
 uim_custom_get_str(const char *custom_sym, const char *proc)
 {
-  UIM_EVAL_FSTRING2(NULL, "(%s '%s)", proc, custom_sym);
-  return_val = uim_scm_return_value();
+  return_val = uim_scm_callf(proc, "y", custom_sym);
 
   return uim_scm_refer_c_str(return_val);
 }
@@ -1036,6 +1044,21 @@ helper_disconnect_cb(void)
   helper_fd = -1;
 }
 
+static void
+custom_mark_dirty(const char *custom_sym)
+{
+  size_t i;
+
+  for (i = 0; i < nr_dirty_customs; i++)
+    if (strcmp(dirty_customs[i], custom_sym) == 0)
+      return;
+
+  dirty_customs = uim_realloc(dirty_customs,
+			      sizeof(char *) * (nr_dirty_customs + 2));
+  dirty_customs[nr_dirty_customs++] = uim_strdup(custom_sym);
+  dirty_customs[nr_dirty_customs] = NULL;
+}
+
 /**
  * Enables use of custom API. This function must be called before
  * uim_custom_*() functions are called. uim_init() must be called before this
@@ -1078,6 +1101,11 @@ uim_custom_init(void)
 
   uim_scm_require_file("custom.scm");
 
+  custom_type_proc = uim_scm_proc_ref("custom-type");
+  uim_scm_gc_protect(&custom_type_proc);
+  custom_active_proc = uim_scm_proc_ref("custom-active?");
+  uim_scm_gc_protect(&custom_active_proc);
+
   /* temporary solution to control key definition expantion */
   UIM_EVAL_STRING(NULL, "(define uim-custom-expand-key? #t)");
 
@@ -1105,6 +1133,12 @@ uim_custom_quit(void)
   uim_custom_group_cb_remove(NULL);
   uim_custom_global_cb_remove();
 
+  if (dirty_customs) {
+    uim_custom_symbol_list_free(dirty_customs);
+    dirty_customs = NULL;
+    nr_dirty_customs = 0;
+  }
+
   return UIM_TRUE;
 }
 
@@ -1384,9 +1418,10 @@ uim_custom_save_custom(const char *custom_sym)
 
 /**
  * Broadcasts custom variable configurations to other uim-enabled application
- * processes via uim-helper-server. This function broadcasts current custom
- * variable values to other uim-enabled application processes via
- * uim-helper-server. The received processes updates custom variables
+ * processes via uim-helper-server. This function broadcasts the values of
+ * custom variables changed by uim_custom_set() since the last broadcast as
+ * one custom_update_batch message, or all custom variables if no change
+ * has been recorded. The received processes updates custom variables
  * dynamically. This enables dynamic re-configuration of input methods.
  *
  * @retval UIM_TRUE succeeded
@@ -1396,34 +1431,40 @@ uim_bool
 uim_custom_broadcast(void)
 {
   char **custom_syms, **sym;
-  char *value, *msg;
+  char *value, *msg, *ent;
+  size_t len;
 
   if (helper_fd < 0) {
     helper_fd = uim_helper_init_client_fd(helper_disconnect_cb);
   }
 
-  custom_syms = uim_custom_collect_by_group(NULL);
+  if (dirty_customs) {
+    custom_syms = dirty_customs;
+    dirty_customs = NULL;
+    nr_dirty_customs = 0;
+  } else {
+    custom_syms = uim_custom_collect_by_group(NULL);
+  }
+
+  msg = uim_strdup(custom_batch_msg_head);
+  len = strlen(msg);
   for (sym = custom_syms; *sym; sym++) {
     value = uim_custom_value_as_literal(*sym);
     if (value) {
-#if 1
-      uim_asprintf(&msg, custom_msg_tmpl, *sym, value);
-#else
-      /* old behavior: useless since other memory exhaustions disable uim */
-      if (asprintf(&msg, custom_msg_tmpl, *sym, value) < 0 || !msg) {
-	free(msg);
-	free(value);
-	uim_custom_symbol_list_free(custom_syms);
-	return UIM_FALSE;
-      }
-#endif
-      uim_helper_send_message(helper_fd, msg);
-      free(msg);
+      uim_asprintf(&ent, custom_batch_msg_tmpl, *sym, value);
+      msg = uim_realloc(msg, len + strlen(ent) + 1);
+      strcpy(msg + len, ent);
+      len += strlen(ent);
+      free(ent);
       free(value);
     }
   }
   uim_custom_symbol_list_free(custom_syms);
 
+  if (len > sizeof(custom_batch_msg_head) - 1)
+    uim_helper_send_message(helper_fd, msg);
+  free(msg);
+
   if (helper_fd != -1) {
     uim_helper_close_client_fd(helper_fd);
   }
@@ -1507,11 +1548,14 @@ uim_custom_get(const char *custom_sym)
 uim_bool
 uim_custom_set(const struct uim_custom *custom)
 {
-  char *literal;
+  char *literal, *prev_literal;
+  uim_bool succeeded;
 
   if (!custom)
     return UIM_FALSE;
 
+  prev_literal = uim_custom_value_as_literal(custom->symbol);
+
   switch (custom->type) {
   case UCustom_Bool:
     UIM_EVAL_FSTRING2(NULL, "(custom-set-value! '%s #%s)",
@@ -1563,9 +1607,21 @@ uim_custom_set(const struct uim_custom *custom)
     }
     break;
   default:
+    free(prev_literal);
     return UIM_FALSE;
   }
-  return uim_scm_c_bool(uim_scm_return_value());
+  succeeded = uim_scm_c_bool(uim_scm_return_value());
+
+  /* only actual changes are broadcasted by uim_custom_broadcast() */
+  if (succeeded) {
+    literal = uim_custom_value_as_literal(custom->symbol);
+    if (!literal || !prev_literal || strcmp(literal, prev_literal) != 0)
+      custom_mark_dirty(custom->symbol);
+    free(literal);
+  }
+  free(prev_literal);
+
+  return succeeded;
 }
 
 /**
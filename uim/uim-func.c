@@ -88,14 +88,157 @@ im_convertiblep(uim_lisp uc_, uim_lisp im_encoding_)
   return MAKE_BOOL(convertiblep);
 }
 
+static void
+preedit_buf_clear(struct uim_preedit_buf *buf)
+{
+  buf->nr_segs = 0;
+  buf->pool_len = 0;
+}
+
+static void
+preedit_buf_append(struct uim_preedit_buf *buf, int attr, const char *str)
+{
+  size_t len;
+
+  len = strlen(str) + 1;
+  if (buf->nr_segs == buf->segs_capacity) {
+    buf->segs_capacity = (buf->segs_capacity) ? buf->segs_capacity * 2 : 16;
+    buf->segs = uim_realloc(buf->segs,
+			    sizeof(*buf->segs) * buf->segs_capacity);
+  }
+  if (buf->pool_len + len > buf->pool_capacity) {
+    if (!buf->pool_capacity)
+      buf->pool_capacity = 256;
+    while (buf->pool_len + len > buf->pool_capacity)
+      buf->pool_capacity *= 2;
+    buf->pool = uim_realloc(buf->pool, buf->pool_capacity);
+  }
+
+  buf->segs[buf->nr_segs].attr = attr;
+  buf->segs[buf->nr_segs].off = buf->pool_len;
+  buf->nr_segs++;
+  memcpy(&buf->pool[buf->pool_len], str, len);
+  buf->pool_len += len;
+}
+
+static void
+preedit_buf_copy(struct uim_preedit_buf *dst,
+		 const struct uim_preedit_buf *src)
+{
+  int i;
+
+  preedit_buf_clear(dst);
+  for (i = 0; i < src->nr_segs; i++)
+    preedit_buf_append(dst, src->segs[i].attr, &src->pool[src->segs[i].off]);
+}
+
+static uim_bool
+preedit_seg_equal(const struct uim_preedit_buf *a, int i,
+		  const struct uim_preedit_buf *b, int j)
+{
+  return (a->segs[i].attr == b->segs[j].attr
+	  && !strcmp(&a->pool[a->segs[i].off], &b->pool[b->segs[j].off]));
+}
+
+/*
+ * Delivers the difference between the preedit known to the bridge and the
+ * one pushed back since the last clear. Segments shared at the beginning
+ * and the end of both are neither converted nor passed to the bridge.
+ */
+static void
+preedit_diff_update(uim_context uc)
+{
+  struct uim_preedit_buf *shown, *pending, tmp;
+  int first, nr_tail, nr_common, nr_removed, nr_added, i;
+  int *attrs;
+  char **strs;
+
+  if (!uc->preedit_pending_valid)
+    return;  /* nothing has been pushed back since the last update */
+
+  shown = &uc->preedit_shown;
+  pending = &uc->preedit_pending;
+
+  first = nr_tail = 0;
+  if (uc->preedit_shown_valid) {
+    nr_common = (shown->nr_segs < pending->nr_segs) ? shown->nr_segs
+						     : pending->nr_segs;
+    while (first < nr_common
+	   && preedit_seg_equal(shown, first, pending, first))
+      first++;
+    while (nr_tail < nr_common - first
+	   && preedit_seg_equal(shown, shown->nr_segs - 1 - nr_tail,
+				pending, pending->nr_segs - 1 - nr_tail))
+      nr_tail++;
+  }
+  nr_removed = shown->nr_segs - first - nr_tail;
+  nr_added = pending->nr_segs - first - nr_tail;
+
+  /* The pending segments become the shown ones before any callback runs,
+   * since a bridge may update the preedit again from inside them. */
+  tmp = *shown;
+  *shown = *pending;
+  *pending = tmp;
+  preedit_buf_clear(pending);
+  uc->preedit_pending_valid = UIM_FALSE;
+  uc->preedit_shown_valid = UIM_TRUE;
+
+  if (!nr_removed && !nr_added)
+    return;
+
+  attrs = uim_malloc(sizeof(*attrs) * (nr_added + 1));
+  strs = uim_malloc(sizeof(*strs) * (nr_added + 1));
+  for (i = 0; i < nr_added; i++) {
+    attrs[i] = shown->segs[first + i].attr;
+    strs[i] = uc->conv_if->convert(uc->outbound_conv,
+				   &shown->pool[shown->segs[first + i].off]);
+  }
+  strs[nr_added] = NULL;
+
+  uc->preedit_replace_cb(uc->ptr, first, nr_removed, nr_added,
+			 attrs, (const char *const *)strs);
+  for (i = 0; i < nr_added; i++)
+    free(strs[i]);
+  free(strs);
+  free(attrs);
+
+  if (uc->preedit_update_cb)
+    uc->preedit_update_cb(uc->ptr);
+}
+
+/* the bridge has discarded its preedit by itself */
+void
+uim_preedit_diff_reset(uim_context uc)
+{
+  preedit_buf_clear(&uc->preedit_shown);
+  preedit_buf_clear(&uc->preedit_pending);
+  uc->preedit_pending_valid = UIM_FALSE;
+  uc->preedit_shown_valid = UIM_TRUE;
+}
+
+void
+uim_preedit_diff_release(uim_context uc)
+{
+  free(uc->preedit_shown.segs);
+  free(uc->preedit_shown.pool);
+  free(uc->preedit_pending.segs);
+  free(uc->preedit_pending.pool);
+  memset(&uc->preedit_shown, 0, sizeof(uc->preedit_shown));
+  memset(&uc->preedit_pending, 0, sizeof(uc->preedit_pending));
+}
+
 static uim_lisp
 im_clear_preedit(uim_lisp uc_)
 {
   uim_context uc;
 
   uc = retrieve_uim_context(uc_);
-  if (uc->preedit_clear_cb)
+  if (uc->preedit_replace_cb) {
+    preedit_buf_clear(&uc->preedit_pending);
+    uc->preedit_pending_valid = UIM_TRUE;
+  } else if (uc->preedit_clear_cb) {
     uc->preedit_clear_cb(uc->ptr);
+  }
 
   return uim_scm_f();
 }
@@ -112,6 +255,21 @@ im_pushback_preedit(uim_lisp uc_, uim_lisp attr_, uim_lisp str_)
   attr = C_INT(attr_);
   str = REFER_C_STR(str_);
 
+  if (uc->preedit_replace_cb) {
+    /* an empty segment shows nothing unless it marks a position */
+    if (!strcmp(str, "")
+	&& !(attr & (UPreeditAttr_Cursor | UPreeditAttr_Separator)))
+      return uim_scm_f();
+    /* appending to the preedit without clearing it first */
+    if (!uc->preedit_pending_valid) {
+      preedit_buf_copy(&uc->preedit_pending, &uc->preedit_shown);
+      uc->preedit_pending_valid = UIM_TRUE;
+    }
+    /* conversion is deferred until the segment turns out to be changed */
+    preedit_buf_append(&uc->preedit_pending, attr, str);
+    return uim_scm_f();
+  }
+
   converted_str = uc->conv_if->convert(uc->outbound_conv, str);
   if (uc->preedit_pushback_cb)
     uc->preedit_pushback_cb(uc->ptr, attr, converted_str);
@@ -126,7 +284,9 @@ im_update_preedit(uim_lisp uc_)
   uim_context uc;
 
   uc = retrieve_uim_context(uc_);
-  if (uc->preedit_update_cb)
+  if (uc->preedit_replace_cb)
+    preedit_diff_update(uc);
+  else if (uc->preedit_update_cb)
     uc->preedit_update_cb(uc->ptr);
 
   return uim_scm_f();
@@ -182,6 +342,9 @@ uim_set_encoding(uim_context uc, const char *enc)
     uc->outbound_conv = uc->conv_if->create(uc->client_encoding, enc);
     uc->inbound_conv  = uc->conv_if->create(enc, uc->client_encoding);
   }
+
+  /* segments pushed back in another encoding cannot be compared */
+  uc->preedit_shown_valid = UIM_FALSE;
 }
 
 static uim_lisp
@@ -58,7 +58,8 @@ uim_help_get_current_branch(void)
   /* TODO: trap signal */
   uim_scm_callf("uim-help-set-branch!", "o", MAKE_INT(uim_fd));
 
-  uim_helper_close_client_fd(uim_fd);
+  /* the port has closed uim_fd */
+  uim_helper_close_client_fd(-1);
   return 1;
 }
 
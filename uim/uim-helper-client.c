@@ -60,7 +60,7 @@
 /*Common buffer for some functions's temporary buffer.
   Pay attention for use.*/
 static char uim_recv_buf[RECV_BUFFER_SIZE];
-static char *uim_read_buf;
+static struct uim_helper_msgbuf uim_read_buf;
 
 static int uim_fd = -1;
 static void (*uim_disconnect_cb)(void);
@@ -125,8 +125,6 @@ int uim_helper_init_client_fd(void (*disconnect_cb)(void))
   if (uim_helper_check_connection_fd(fd))
     goto error;
 
-  if (!uim_read_buf)
-    uim_read_buf = uim_strdup("");
   uim_disconnect_cb = disconnect_cb;
   uim_fd = fd;
 
@@ -188,7 +186,7 @@ uim_helper_read_proc(int fd)
       uim_helper_close_client_fd(fd);
       return;
     } else if (rc > 0) {
-      uim_read_buf = uim_helper_buffer_append(uim_read_buf, uim_recv_buf, rc);
+      uim_helper_msgbuf_append(&uim_read_buf, uim_recv_buf, rc);
     }
   }
 }
@@ -196,5 +194,5 @@ uim_helper_read_proc(int fd)
 char *
 uim_helper_get_message(void)
 {
-  return uim_helper_buffer_get_message(uim_read_buf);
+  return uim_helper_msgbuf_get_message(&uim_read_buf, NULL);
 }
@@ -48,36 +48,135 @@
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #include "uim.h"
 #include "uim-internal.h"
 #include "uim-helper.h"
 
 
+/* a message shared by the write queues of all clients receiving it */
+struct message {
+  int refcount;
+  size_t len;
+  char str[1];
+};
+
 struct client {
   int fd;
-  char *rbuf;
-  char *wbuf;
+  struct uim_helper_msgbuf rbuf;
+  /* ring of messages waiting to be written */
+  struct message **wq;
+  int wq_size;
+  int wq_head;
+  int wq_len;
+  /* bytes of the first queued message already written */
+  size_t wq_off;
+  /* link in the list of clients closed while handling events */
+  struct client *next_closed;
 };
 
 #define MAX_CLIENT 32
 #define BUFFER_SIZE 1024
+#define WRITE_QUEUE_INITIAL_SIZE 16
+#define MAX_IOV 16
+#define MAX_EVENTS 32
 
 #ifndef SUN_LEN
 #define SUN_LEN(su)							\
   (sizeof(*(su)) - sizeof((su)->sun_path) + strlen((su)->sun_path))
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+static int s_epoll_fd = -1;
+#else
 static fd_set s_fdset_read;
 static fd_set s_fdset_write;
 static int s_max_fd;
+#endif
+/* connected clients */
+static int nr_clients;
 static int nr_client_slots;
-static struct client *clients;
+static struct client **clients;
+static struct client *closed_clients;
 static char read_buf[BUFFER_SIZE];
 
+#ifdef HAVE_SYS_EPOLL_H
+static int
+watch_fd(int fd, void *ptr)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = ptr;
+  return epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void
+unwatch_fd(int fd)
+{
+  struct epoll_event ev;
+
+  /* non-NULL event for kernels before 2.6.9 */
+  epoll_ctl(s_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static void
+watch_writable(struct client *cl, uim_bool on)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = on ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  ev.data.ptr = cl;
+  epoll_ctl(s_epoll_fd, EPOLL_CTL_MOD, cl->fd, &ev);
+}
+#else
+static int
+watch_fd(int fd, void *ptr)
+{
+  if (fd >= FD_SETSIZE)
+    return -1;
+
+  FD_SET(fd, &s_fdset_read);
+  if (fd > s_max_fd)
+    s_max_fd = fd;
+  return 0;
+}
+
+/* fd may be the one watch_fd() refused: never touch an fd_set with it */
+static void
+unwatch_fd(int fd)
+{
+  if (fd >= FD_SETSIZE)
+    return;
+
+  FD_CLR(fd, &s_fdset_read);
+  FD_CLR(fd, &s_fdset_write);
+  if (fd == s_max_fd)
+    s_max_fd--;
+}
+
+static void
+watch_writable(struct client *cl, uim_bool on)
+{
+  if (cl->fd >= FD_SETSIZE)
+    return;
+
+  if (on)
+    FD_SET(cl->fd, &s_fdset_write);
+  else
+    FD_CLR(cl->fd, &s_fdset_write);
+}
+#endif
+
 static int
 init_server_fd(char *path)
 {
@@ -86,6 +185,14 @@ init_server_fd(char *path)
   struct passwd *pw;
   char *logname;
 
+#ifdef HAVE_SYS_EPOLL_H
+  s_epoll_fd = epoll_create(MAX_CLIENT);
+  if (s_epoll_fd < 0) {
+    perror("failed in epoll_create()");
+    return -1;
+  }
+#endif
+
   fd = socket(PF_UNIX, SOCK_STREAM, 0);
   if (fd < 0) {
     perror("failed in socket()");
@@ -126,58 +233,129 @@ init_server_fd(char *path)
     return -1;
   }
 
-  FD_SET(fd, &s_fdset_read);
-  s_max_fd = fd;
+  /* the server socket is told apart by its NULL event pointer */
+  if (watch_fd(fd, NULL) < 0) {
+    perror("failed to watch server socket");
+    close(fd);
+    return -1;
+  }
 
   return fd;
 }
 
 static struct client *
-get_unused_client(void)
+new_client(int fd)
 {
-  int i;
+  struct client *cl;
 
-  for (i = 0; i < nr_client_slots; i++) {
-    if (clients[i].fd == -1)
-      return &clients[i];
+  if (nr_clients == nr_client_slots) {
+    nr_client_slots = nr_client_slots ? nr_client_slots * 2 : MAX_CLIENT;
+    clients = uim_realloc(clients, sizeof(struct client *) * nr_client_slots);
   }
 
-  nr_client_slots++;
-  clients = uim_realloc(clients, sizeof(struct client) * nr_client_slots);
-  clients[nr_client_slots - 1].rbuf = uim_strdup("");
-  clients[nr_client_slots - 1].wbuf = uim_strdup("");
+  cl = uim_malloc(sizeof(struct client));
+  cl->fd = fd;
+  uim_helper_msgbuf_init(&cl->rbuf);
+  cl->wq_size = WRITE_QUEUE_INITIAL_SIZE;
+  cl->wq = uim_malloc(sizeof(struct message *) * cl->wq_size);
+  cl->wq_head = cl->wq_len = 0;
+  cl->wq_off = 0;
+  cl->next_closed = NULL;
+  clients[nr_clients++] = cl;
+
+  return cl;
+}
 
-  return &clients[nr_client_slots - 1];
+static void
+unref_message(struct message *m)
+{
+  if (--m->refcount == 0)
+    free(m);
 }
 
+/*
+ * The client is only unlinked here.  It is freed by free_closed_clients()
+ * since pending events may still point to it.
+ */
 static void
 close_client(struct client *cl)
 {
+  int i;
+
+  unwatch_fd(cl->fd);
   close(cl->fd);
-  if (cl->rbuf) {
-    free(cl->rbuf);
-    cl->rbuf = uim_strdup("");
+  cl->fd = -1;
+
+  for (i = 0; i < nr_clients; i++) {
+    if (clients[i] == cl) {
+      clients[i] = clients[--nr_clients];
+      break;
+    }
   }
-  if (cl->wbuf) {
-    free(cl->wbuf);
-    cl->wbuf = uim_strdup("");
+
+  uim_helper_msgbuf_release(&cl->rbuf);
+  for (; cl->wq_len > 0; cl->wq_len--) {
+    unref_message(cl->wq[cl->wq_head]);
+    cl->wq_head = (cl->wq_head + 1) & (cl->wq_size - 1);
   }
-  cl->fd = -1;
+  free(cl->wq);
+  cl->wq = NULL;
+
+  cl->next_closed = closed_clients;
+  closed_clients = cl;
 }
 
 static void
-distribute_message(char *msg, struct client *cl)
+free_closed_clients(void)
 {
+  struct client *cl;
+
+  while ((cl = closed_clients)) {
+    closed_clients = cl->next_closed;
+    free(cl);
+  }
+}
+
+static void
+enqueue_message(struct client *cl, struct message *m)
+{
+  struct message **wq;
   int i;
-  size_t msg_len;
 
-  msg_len = strlen(msg);
+  if (cl->wq_len == cl->wq_size) {
+    /* unroll the ring into a larger one */
+    wq = uim_malloc(sizeof(struct message *) * cl->wq_size * 2);
+    for (i = 0; i < cl->wq_len; i++)
+      wq[i] = cl->wq[(cl->wq_head + i) & (cl->wq_size - 1)];
+    free(cl->wq);
+    cl->wq = wq;
+    cl->wq_size *= 2;
+    cl->wq_head = 0;
+  }
 
-  for (i = 0; i < nr_client_slots; i++) {
-    if (clients[i].fd != -1 && clients[i].fd != cl->fd) {
-      clients[i].wbuf = uim_helper_buffer_append(clients[i].wbuf, msg, msg_len);
-      FD_SET(clients[i].fd, &s_fdset_write);
-    }
+  cl->wq[(cl->wq_head + cl->wq_len) & (cl->wq_size - 1)] = m;
+  if (cl->wq_len++ == 0)
+    watch_writable(cl, UIM_TRUE);
+}
+
+static void
+distribute_message(char *msg, size_t msg_len, struct client *cl)
+{
+  struct message *m;
+  int i;
+
+  if (nr_clients < 2)
+    return;
+
+  /* one copy of the message is shared by all the receivers */
+  m = uim_malloc(sizeof(struct message) + msg_len);
+  m->refcount = nr_clients - 1;
+  m->len = msg_len;
+  memcpy(m->str, msg, msg_len + 1);
+
+  for (i = 0; i < nr_clients; i++) {
+    if (clients[i] != cl)
+      enqueue_message(clients[i], m);
   }
 }
 
@@ -185,6 +363,7 @@ static int
 reflect_message_fragment(struct client *cl)
 {
   ssize_t rc;
+  size_t msg_len;
   char *msg;
 
   /* do read */
@@ -196,10 +375,10 @@ reflect_message_fragment(struct client *cl)
   } else if (rc == 0)
     return -1;
 
-  cl->rbuf = uim_helper_buffer_append(cl->rbuf, read_buf, rc);
+  uim_helper_msgbuf_append(&cl->rbuf, read_buf, rc);
 
-  while ((msg = uim_helper_buffer_get_message(cl->rbuf))) {
-    distribute_message(msg, cl);
+  while ((msg = uim_helper_msgbuf_get_message(&cl->rbuf, &msg_len))) {
+    distribute_message(msg, msg_len, cl);
     free(msg);
   }
 
@@ -210,14 +389,7 @@ static uim_bool
 check_session_alive(void)
 {
   /* If there's no connection, we can assume user logged out. */
-  int i;
-
-  for (i = 0; i < nr_client_slots; i++) {
-    if (clients[i].fd != -1)
-      return UIM_TRUE;
-  }
-
-  return UIM_FALSE; /* User already logged out */
+  return nr_clients > 0;
 }
 
 
@@ -248,21 +420,17 @@ accept_new_connection(int server_fd)
     return UIM_FALSE;
   }
 
-  cl = get_unused_client();
-  if (!cl) {
-    close(new_fd);
+  cl = new_client(new_fd);
+  if (watch_fd(cl->fd, cl) < 0) {
+    close_client(cl);
     return UIM_FALSE;
   }
-  cl->fd = new_fd;
 #ifdef LOCAL_CREDS	/* for NetBSD */
   {
     char buf[1] = { '\0' };
     write(cl->fd, buf, 1);
   }
 #endif
-  FD_SET(cl->fd, &s_fdset_read);
-  if (cl->fd > s_max_fd)
-    s_max_fd = cl->fd;
 
   return UIM_TRUE;
 }
@@ -270,41 +438,53 @@ accept_new_connection(int server_fd)
 static void
 write_message(struct client *cl)
 {
-  int ret, message_len, out_len;
-  char *out;
-  
-  out = cl->wbuf;
-  message_len = out_len = strlen(cl->wbuf);
-  while (out_len > 0) {
-    if ((ret = write(cl->fd, out, out_len)) < 0) {
-      if (errno == EAGAIN) {
+  struct iovec iov[MAX_IOV];
+  struct message *m;
+  ssize_t ret;
+  size_t len;
+  int i, nr_iov;
+
+  while (cl->wq_len > 0) {
+    /* gather as many queued messages as possible into one write */
+    nr_iov = cl->wq_len < MAX_IOV ? cl->wq_len : MAX_IOV;
+    for (i = 0; i < nr_iov; i++) {
+      m = cl->wq[(cl->wq_head + i) & (cl->wq_size - 1)];
+      iov[i].iov_base = m->str;
+      iov[i].iov_len = m->len;
+    }
+    iov[0].iov_base = (char *)iov[0].iov_base + cl->wq_off;
+    iov[0].iov_len -= cl->wq_off;
+
+    if ((ret = writev(cl->fd, iov, nr_iov)) < 0) {
+      if (errno == EAGAIN || errno == EINTR) {
 #if 0
 	fprintf(stderr, "EAGAIN: fd = %d\n", cl->fd);
 #endif
-      } else {
-	perror("uim-helper_server write(2) failed");
-	if (errno == EPIPE) {
-	  fprintf(stderr, "fd = %d\n", cl->fd);
-	  FD_CLR(cl->fd, &s_fdset_read);
-	  FD_CLR(cl->fd, &s_fdset_write);
-	  if (cl->fd == s_max_fd)
-	    s_max_fd--;
-	  close_client(cl);
-	}
+	break;
       }
-      break;
-    } else {
-      out += ret;
-      out_len -= ret;
+      /* the client cannot be written to any more */
+      perror("uim-helper_server write(2) failed");
+      fprintf(stderr, "fd = %d\n", cl->fd);
+      close_client(cl);
+      return;
     }
+
+    /* drop the messages written out */
+    len = ret + cl->wq_off;
+    while (cl->wq_len > 0) {
+      m = cl->wq[cl->wq_head];
+      if (len < m->len)
+	break;
+      len -= m->len;
+      unref_message(m);
+      cl->wq_head = (cl->wq_head + 1) & (cl->wq_size - 1);
+      cl->wq_len--;
+    }
+    cl->wq_off = len;
   }
-  if (out_len == 0) {
-    free(cl->wbuf);
-    cl->wbuf = uim_strdup("");
-    FD_CLR(cl->fd, &s_fdset_write);    
-  } else {
-    uim_helper_buffer_shift(cl->wbuf, message_len - out_len);
-  }
+
+  if (cl->wq_len == 0)
+    watch_writable(cl, UIM_FALSE);
 }
 
 
@@ -315,20 +495,56 @@ read_message(struct client *cl)
 
   result = reflect_message_fragment(cl);
   
-  if (result < 0) {
-    FD_CLR(cl->fd, &s_fdset_read);
-    FD_CLR(cl->fd, &s_fdset_write);
-    if (cl->fd == s_max_fd)
-      s_max_fd--;
+  if (result < 0)
     close_client(cl);
-  }
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static void
+uim_helper_server_process_connection(int server_fd)
+{
+  struct epoll_event events[MAX_EVENTS];
+  struct client *cl;
+  int i, nr_events;
+
+  while (1) {
+    nr_events = epoll_wait(s_epoll_fd, events, MAX_EVENTS, -1);
+    if (nr_events <= 0) {
+      if (nr_events < 0 && errno == EINTR)
+	continue;
+      perror("uim-helper_server epoll_wait(2) failed");
+      sleep(3);
+      continue;
+    }
+
+    for (i = 0; i < nr_events; i++) {
+      cl = events[i].data.ptr;
+      if (!cl) {
+	/* for accept new connection */
+	accept_new_connection(server_fd);
+	continue;
+      }
+
+      /* check data to write and from clients reached */
+      if (cl->fd != -1 && (events[i].events & EPOLLOUT))
+	write_message(cl);
+
+      if (cl->fd != -1 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+	read_message(cl);
+    }
+    free_closed_clients();
+
+    if (!check_session_alive())
+      return;
+  }
+}
+#else
 static void
 uim_helper_server_process_connection(int server_fd)
 {
   int i;
   fd_set readfds, writefds;
+  struct client *cl;
 
   while (1) {
     /* Copy readfds from s_fdset_read/s_fdset_write because select removes
@@ -352,20 +568,26 @@ uim_helper_server_process_connection(int server_fd)
 	continue;
       }
     } else {
-      /* check data to write and from clients reached */
-      for (i = 0; i < nr_client_slots; i++) {
-	if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &writefds))
-	  write_message(&clients[i]);
-
-	if (clients[i].fd != -1 && FD_ISSET(clients[i].fd, &readfds))
-	  read_message(&clients[i]);
+      /*
+       * check data to write and from clients reached.  Walk backwards
+       * since a closed client is replaced with the last one.
+       */
+      for (i = nr_clients - 1; i >= 0; i--) {
+	cl = clients[i];
+	if (FD_ISSET(cl->fd, &writefds))
+	  write_message(cl);
+
+	if (cl->fd != -1 && FD_ISSET(cl->fd, &readfds))
+	  read_message(cl);
       }
+      free_closed_clients();
     }
 
     if (!check_session_alive())
       return;
   }
 }
+#endif
 
 
 int
@@ -382,11 +604,13 @@ main(int argc, char **argv)
   unlink(path);
 
   clients = NULL;
-  nr_client_slots = 0;
+  nr_clients = nr_client_slots = 0;
 
+#ifndef HAVE_SYS_EPOLL_H
   FD_ZERO(&s_fdset_read);
   FD_ZERO(&s_fdset_write);
   s_max_fd = 0;
+#endif
   server_fd = init_server_fd(path);
 
   printf("waiting\n\n");
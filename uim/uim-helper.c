@@ -331,6 +331,91 @@ uim_helper_buffer_get_message(char *buf)
   return msg;
 }
 
+void
+uim_helper_msgbuf_init(struct uim_helper_msgbuf *buf)
+{
+  buf->str = NULL;
+  buf->start = buf->len = buf->capacity = buf->scanned = 0;
+}
+
+void
+uim_helper_msgbuf_release(struct uim_helper_msgbuf *buf)
+{
+  free(buf->str);
+  uim_helper_msgbuf_init(buf);
+}
+
+void
+uim_helper_msgbuf_append(struct uim_helper_msgbuf *buf,
+			 const char *fragment, size_t fragment_size)
+{
+  size_t rest = buf->len - buf->start;
+
+  if (buf->len + fragment_size + 1 > buf->capacity) {
+    /* reclaim the space of taken messages before growing */
+    if (buf->start > 0) {
+      memmove(buf->str, &buf->str[buf->start], rest);
+      buf->start = 0;
+      buf->len = rest;
+    }
+    if (buf->len + fragment_size + 1 > buf->capacity) {
+      buf->capacity = buf->capacity ? buf->capacity * 2 : BUFSIZ;
+      while (buf->len + fragment_size + 1 > buf->capacity)
+	buf->capacity *= 2;
+      buf->str = uim_realloc(buf->str, buf->capacity);
+    }
+  }
+
+  memcpy(&buf->str[buf->len], fragment, fragment_size);
+  buf->len += fragment_size;
+  buf->str[buf->len] = '\0';
+}
+
+/*
+ * Take the first message terminated by "\n\n" out of buf, or return NULL.
+ * Bytes searched once are not searched again by later calls.
+ */
+char *
+uim_helper_msgbuf_get_message(struct uim_helper_msgbuf *buf, size_t *msg_len)
+{
+  size_t msg_size;
+  char *msg, *p, *end;
+
+  if (!buf->str)
+    return NULL;
+
+  if (UIM_CATCH_ERROR_BEGIN())
+    return NULL;
+
+  msg = NULL;
+  p = &buf->str[buf->start + buf->scanned];
+  end = &buf->str[buf->len];
+  while (p < end && (p = memchr(p, '\n', end - p)) && p + 1 < end) {
+    if (p[1] == '\n') {
+      msg_size = p + 2 - &buf->str[buf->start];
+      msg = uim_malloc(msg_size + 1);
+      memcpy(msg, &buf->str[buf->start], msg_size);
+      msg[msg_size] = '\0';
+      if (msg_len)
+	*msg_len = msg_size;
+
+      buf->start += msg_size;
+      buf->scanned = 0;
+      if (buf->start == buf->len)
+	buf->start = buf->len = 0;
+      break;
+    }
+    p++;
+  }
+  /* a trailing '\n' may be completed by the next fragment */
+  if (!msg && buf->len > buf->start)
+    buf->scanned = buf->len - buf->start - 1;
+
+  UIM_CATCH_ERROR_END();
+
+  return msg;
+}
+
 /* Public API for uim_issetugid(). */
 /* TODO: should be renamed to uim_helper_issetugid() */
 uim_bool
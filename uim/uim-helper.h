@@ -59,6 +59,27 @@ char *uim_helper_buffer_append(char *buf,
 void uim_helper_buffer_shift(char *buf, int count);
 char *uim_helper_buffer_get_message(char *buf);
 
+/*
+ * Receive buffer for helper messages which keeps track of its length and
+ * of how far it has been searched for the message terminator.
+ */
+struct uim_helper_msgbuf {
+  char *str;
+  /* bytes before start are already taken out as messages */
+  size_t start;
+  size_t len;
+  size_t capacity;
+  /* bytes from start known not to hold the terminator */
+  size_t scanned;
+};
+
+void uim_helper_msgbuf_init(struct uim_helper_msgbuf *buf);
+void uim_helper_msgbuf_release(struct uim_helper_msgbuf *buf);
+void uim_helper_msgbuf_append(struct uim_helper_msgbuf *buf,
+			      const char *fragment, size_t fragment_size);
+char *uim_helper_msgbuf_get_message(struct uim_helper_msgbuf *buf,
+				    size_t *msg_len);
+
 uim_bool
 uim_helper_is_setugid(void);
 
@@ -74,6 +74,23 @@ struct uim_candidate_ {
   /* char *src_dict; */
 };
 
+/* Preedit segments as pushed back by the IM, before code conversion. The
+ * strings are stored NUL-terminated in the pool, so refilling the buffer
+ * for each update does not allocate once it has grown large enough. */
+struct uim_preedit_seg {
+  int attr;
+  size_t off;  /* offset of the string in pool */
+};
+
+struct uim_preedit_buf {
+  struct uim_preedit_seg *segs;
+  int nr_segs;
+  int segs_capacity;
+  char *pool;
+  size_t pool_len;
+  size_t pool_capacity;
+};
+
 struct uim_context_ {
   uim_lisp sc;  /* Scheme-side context */
   void *ptr;    /* 1st callback argument */
@@ -100,6 +117,14 @@ struct uim_context_ {
   void (*preedit_clear_cb)(void *ptr);
   void (*preedit_pushback_cb)(void *ptr, int attr, const char *str);
   void (*preedit_update_cb)(void *ptr);
+  /* incremental preedit (uim_set_preedit_diff_cb()) */
+  void (*preedit_replace_cb)(void *ptr, int first, int nr_removed,
+                             int nr_added,
+                             const int *attrs, const char *const *strs);
+  struct uim_preedit_buf preedit_shown;    /* as known to the bridge */
+  struct uim_preedit_buf preedit_pending;  /* built since last clear */
+  uim_bool preedit_pending_valid;
+  uim_bool preedit_shown_valid;  /* false if the segments cannot be compared */
   /* candidate selector */
   void (*candidate_selector_activate_cb)(void *ptr, int nr, int index);
   void (*candidate_selector_select_cb)(void *ptr, int index);
@@ -160,6 +185,7 @@ void uim_init_util_subrs(void);
 void uim_init_notify_subrs(void);
 
 void uim_init_rk_subrs(void);
+void uim_quit_rk(void);
 void uim_init_intl_subrs(void);
 
 #if UIM_USE_NOTIFY_PLUGINS
@@ -170,6 +196,8 @@ uim_bool uim_notify_fatal(const char *msg_fmt, ...);
 #endif
 
 void uim_set_encoding(uim_context uc, const char *enc);
+void uim_preedit_diff_reset(uim_context uc);
+void uim_preedit_diff_release(uim_context uc);
 #if HAVE_ISSETUGID
 #define uim_issetugid() issetugid()
 #else
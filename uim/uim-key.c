@@ -277,10 +277,24 @@ static struct key_entry key_tab[] = {
   {0, 0}
 };
 
+/* open addressing table from key code to interned symbol. The size must
+ * be a power of 2 and larger than twice the number of entries in key_tab */
+#define KEY_SYM_TAB_SIZE 512
+
+struct key_sym_entry {
+  int key;
+  uim_lisp sym;
+};
+
+static struct key_sym_entry key_sym_tab[KEY_SYM_TAB_SIZE];
+/* keeps the symbols in key_sym_tab alive */
+static uim_lisp key_syms;
 static uim_lisp protected;
+static uim_lisp key_press_handler, key_release_handler;
 
 static void define_valid_key_symbols(void);
-static const char *get_sym(int key);
+static void init_key_sym_tab(void);
+static uim_lisp get_sym(int key);
 static uim_bool filter_key(uim_context uc,
                            int key, int state, uim_bool is_press);
 static int emergency_key_p(int key, int state);
@@ -319,25 +333,52 @@ define_valid_key_symbols(void)
 		     QUOTE(valid_key_symbols)));
 }
 
-static const char *
-get_sym(int key)
+static void
+init_key_sym_tab(void)
 {
-  int i;
+  int i, h;
 
+  memset(key_sym_tab, 0, sizeof(key_sym_tab));
+  key_syms = uim_scm_null();
   for (i = 0; key_tab[i].key; i++) {
-    if (key_tab[i].key == key)
-      return key_tab[i].str;
+    for (h = key_tab[i].key & (KEY_SYM_TAB_SIZE - 1);
+	 key_sym_tab[h].key;
+	 h = (h + 1) & (KEY_SYM_TAB_SIZE - 1))
+    {
+      if (key_sym_tab[h].key == key_tab[i].key)
+	break;
+    }
+    /* the first name in key_tab wins for aliased keys */
+    if (key_sym_tab[h].key)
+      continue;
+
+    key_sym_tab[h].key = key_tab[i].key;
+    key_sym_tab[h].sym = MAKE_SYM(key_tab[i].str);
+    key_syms = CONS(key_sym_tab[h].sym, key_syms);
   }
+}
 
-  return NULL;
+static uim_lisp
+get_sym(int key)
+{
+  int h;
+
+  for (h = key & (KEY_SYM_TAB_SIZE - 1);
+       key_sym_tab[h].key;
+       h = (h + 1) & (KEY_SYM_TAB_SIZE - 1))
+  {
+    if (key_sym_tab[h].key == key)
+      return key_sym_tab[h].sym;
+  }
+
+  return uim_scm_f();
 }
 
 /* FIXME: Replace 'protected' variable with stack protection */
 static uim_bool
 filter_key(uim_context uc, int key, int state, uim_bool is_press)
 {
-  uim_lisp key_, filtered;
-  const char *sym, *handler;
+  uim_lisp key_, handler, filtered;
 
   if (!uc)
     return UIM_FALSE;
@@ -355,14 +396,14 @@ filter_key(uim_context uc, int key, int state, uim_bool is_press)
   if (ISASCII(key)) {
     protected = key_ = MAKE_INT(key);
   } else {
-    sym = get_sym(key);
-    if (!sym)
+    key_ = get_sym(key);
+    if (FALSEP(key_))
       return UIM_FALSE;
-    protected = key_ = MAKE_SYM(get_sym(key));
+    protected = key_;
   }
 
-  handler = (is_press) ? "key-press-handler" : "key-release-handler";
-  filtered = uim_scm_callf(handler, "poi", uc, key_, state);
+  handler = (is_press) ? key_press_handler : key_release_handler;
+  filtered = uim_scm_call_handle(handler, "poi", uc, key_, state);
   return C_BOOL(filtered);
 }
 
@@ -421,6 +462,13 @@ uim_init_key_subrs(void)
 {
   protected = uim_scm_f();
   uim_scm_gc_protect(&protected);
-
+  key_syms = uim_scm_null();
+  uim_scm_gc_protect(&key_syms);
+  key_press_handler = uim_scm_proc_ref("key-press-handler");
+  uim_scm_gc_protect(&key_press_handler);
+  key_release_handler = uim_scm_proc_ref("key-release-handler");
+  uim_scm_gc_protect(&key_release_handler);
+
+  init_key_sym_tab();
   define_valid_key_symbols();
 }
@@ -77,6 +77,7 @@ static void *uim_scm_call_with_guard_internal(struct call_args *args);
 
 struct callf_args {
   const char *proc;
+  uim_lisp handle;
   const char *args_fmt;
   va_list args;
   uim_bool with_guard;
@@ -1005,6 +1006,46 @@ uim_scm_callf(const char *proc, const char *args_fmt, ...)
   va_start(args.args, args_fmt);
 
   args.proc = proc;
+  args.handle = (uim_lisp)SCM_FALSE;
+  args.args_fmt = args_fmt;
+  args.with_guard = UIM_FALSE;
+  ret = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
+
+  va_end(args.args);
+
+  return ret;
+}
+
+/*
+ * Returns a handle for the procedure named by proc, which can be passed to
+ * uim_scm_call_handle() repeatedly without interning the name each time.
+ * The handle refers to the binding rather than to its current value, so a
+ * later redefinition of the procedure is still honored. Callers must keep
+ * the handle in a variable protected by uim_scm_gc_protect().
+ */
+uim_lisp
+uim_scm_proc_ref(const char *proc)
+{
+  assert(uim_scm_gc_any_contextp());
+  assert(proc);
+
+  return uim_scm_make_symbol(proc);
+}
+
+uim_lisp
+uim_scm_call_handle(uim_lisp handle, const char *args_fmt, ...)
+{
+  uim_lisp ret;
+  struct callf_args args;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uim_scm_symbolp(handle));
+  assert(args_fmt);
+
+  va_start(args.args, args_fmt);
+
+  args.proc = NULL;
+  args.handle = handle;
   args.args_fmt = args_fmt;
   args.with_guard = UIM_FALSE;
   ret = (uim_lisp)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_scm_callf_internal, &args);
@@ -1021,7 +1062,10 @@ uim_scm_callf_internal(struct callf_args *args)
   ScmQueue argq;
   const char *fmtp;
 
-  proc = scm_eval(scm_intern(args->proc), SCM_INTERACTION_ENV);
+  if (args->proc)
+    proc = scm_eval(scm_intern(args->proc), SCM_INTERACTION_ENV);
+  else
+    proc = scm_symbol_value((ScmObj)args->handle, SCM_INTERACTION_ENV);
   scm_args = SCM_NULL;
   SCM_QUEUE_POINT_TO(argq, scm_args);
   for (fmtp = args->args_fmt; *fmtp; fmtp++) {
@@ -1101,6 +1145,7 @@ uim_scm_callf_with_guard(uim_lisp failed,
   va_start(args.args, args_fmt);
 
   args.proc = proc;
+  args.handle = (uim_lisp)SCM_FALSE;
   args.args_fmt = args_fmt;
   args.with_guard = UIM_TRUE;
   args.failed = failed;
@@ -136,6 +136,8 @@ uim_lisp uim_scm_call_with_guard(uim_lisp failed,
 uim_lisp uim_scm_callf(const char *proc, const char *args_fmt, ...);
 uim_lisp uim_scm_callf_with_guard(uim_lisp failed,
                                   const char *proc, const char *args_fmt, ...);
+uim_lisp uim_scm_proc_ref(const char *proc);
+uim_lisp uim_scm_call_handle(uim_lisp handle, const char *args_fmt, ...);
 
 uim_bool uim_scm_load_file(const char *fn);
 uim_bool uim_scm_require_file(const char *fn);
@@ -0,0 +1,642 @@
+/*
+
+  Copyright (c) 2013 uim Project http://code.google.com/p/uim/
+
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  1. Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+  2. Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the following disclaimer in the
+     documentation and/or other materials provided with the distribution.
+  3. Neither the name of authors nor the names of its contributors
+     may be used to endorse or promote products derived from this software
+     without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ``AS IS'' AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+  OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+  OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+  SUCH DAMAGE.
+
+*/
+
+/*
+ * Compiled Compose table shared by the X front ends.
+ *
+ * Each front end parses the Compose file into a builder only when no
+ * usable cache exists.  The builder is flattened into a single block
+ * which holds, in order: a header, the list of source files with
+ * their mtime and size, the nodes, the hashed child slots of every
+ * node, and a string pool.  The block is written to
+ * ~/.uim.d/cache/compose-<hash> (or $LIBUIM_COMPOSE_CACHE_DIR) and
+ * later mmapped as is, so starting
+ * a client costs a few stat(2) calls instead of a full parse.
+ *
+ * Children of a node are kept in an open addressing table keyed by
+ * keysym.  Definitions sharing a keysym (differing only in their
+ * modifiers) are inserted in the order the old sibling lists were
+ * scanned, so the first match found by probing is the same one the
+ * linear scan used to pick.
+ */
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+
+#include "uim.h"
+#include "uim-util.h"
+#include "uim-posix.h"
+#include "uim-helper.h"
+#include "uim-x-util.h"
+
+#define COMPOSE_MAGIC		"uimcmps"
+#define COMPOSE_VERSION		1
+#define COMPOSE_CACHE_DIR	"cache"
+#define NO_CHILD		((unsigned int)-1)
+
+struct compose_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int long_size;
+  unsigned int nr_sources;
+  unsigned int nr_nodes;
+  unsigned int nr_slots;
+  unsigned int pool_len;
+  unsigned int locale;		/* offset into the string pool */
+  unsigned int reserved;
+};
+
+struct compose_source {
+  unsigned int path;		/* offset into the string pool */
+  unsigned int reserved;
+  long mtime;
+  long size;
+};
+
+struct compose_node {
+  unsigned int first_slot;
+  unsigned int nr_slots;	/* 0 for a leaf, otherwise a power of 2 */
+  unsigned int utf8;		/* offset into the string pool */
+  unsigned int reserved;
+};
+
+struct compose_slot {
+  unsigned long keysym;
+  unsigned int modifier_mask;
+  unsigned int modifier;
+  unsigned int child;		/* NO_CHILD for an empty slot */
+  unsigned int reserved;
+};
+
+struct uim_x_compose_table {
+  char *base;
+  size_t len;
+  int mapped;
+  const struct compose_node *nodes;
+  const struct compose_slot *slots;
+  const char *pool;
+  unsigned int nr_nodes;
+};
+
+struct build_node {
+  struct build_node *next;		/* another Key definition */
+  struct build_node *succession;	/* successive Key Sequence */
+  unsigned int modifier_mask;
+  unsigned int modifier;
+  KeySym keysym;
+  char *utf8;
+};
+
+struct uim_x_compose_builder {
+  struct build_node *top;
+  char **sources;
+  int nr_sources;
+};
+
+#define ALIGN_SIZE(n)	(((n) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+static unsigned int
+hash_keysym(KeySym keysym)
+{
+  return (unsigned int)(keysym ^ (keysym >> 8));
+}
+
+static const char *
+pool_str(const uim_x_compose_table *table, unsigned int off)
+{
+  return &table->pool[off];
+}
+
+
+/* builder */
+
+static void
+free_build_node(struct build_node *node)
+{
+  struct build_node *next;
+
+  for (; node; node = next) {
+    next = node->next;
+    free_build_node(node->succession);
+    free(node->utf8);
+    free(node);
+  }
+}
+
+static uim_x_compose_builder *
+builder_new(void)
+{
+  uim_x_compose_builder *b;
+
+  b = malloc(sizeof(uim_x_compose_builder));
+  if (b) {
+    b->top = NULL;
+    b->sources = NULL;
+    b->nr_sources = 0;
+  }
+  return b;
+}
+
+static void
+builder_free(uim_x_compose_builder *b)
+{
+  int i;
+
+  free_build_node(b->top);
+  for (i = 0; i < b->nr_sources; i++)
+    free(b->sources[i]);
+  free(b->sources);
+  free(b);
+}
+
+void
+uim_x_compose_builder_add_source(uim_x_compose_builder *b,
+				 const char *filename)
+{
+  char **sources;
+
+  sources = realloc(b->sources, sizeof(char *) * (b->nr_sources + 1));
+  if (!sources)
+    return;
+  b->sources = sources;
+  b->sources[b->nr_sources] = strdup(filename);
+  if (b->sources[b->nr_sources])
+    b->nr_sources++;
+}
+
+int
+uim_x_compose_builder_add(uim_x_compose_builder *b,
+			  const struct uim_x_compose_key *seq, int n,
+			  const char *utf8)
+{
+  struct build_node **top = &b->top;
+  struct build_node *p = NULL;
+  char *str;
+  int i;
+
+  if (n <= 0 || !(str = strdup(utf8)))
+    return 0;
+
+  for (i = 0; i < n; i++) {
+    for (p = *top; p; p = p->next) {
+      if (seq[i].keysym == p->keysym &&
+	  seq[i].modifier == p->modifier &&
+	  seq[i].modifier_mask == p->modifier_mask)
+	break;
+    }
+    if (!p) {
+      if (!(p = malloc(sizeof(struct build_node)))) {
+	free(str);
+	return 0;
+      }
+      p->keysym = seq[i].keysym;
+      p->modifier = seq[i].modifier;
+      p->modifier_mask = seq[i].modifier_mask;
+      p->succession = NULL;
+      p->utf8 = NULL;
+      p->next = *top;
+      *top = p;
+    }
+    top = &p->succession;
+  }
+
+  free(p->utf8);
+  p->utf8 = str;
+
+  return n;
+}
+
+static void
+count_nodes(struct build_node *node, unsigned int *nr_nodes,
+	    unsigned int *nr_slots, size_t *pool_len)
+{
+  unsigned int nr_children = 0, size;
+  struct build_node *p;
+
+  for (p = node; p; p = p->next) {
+    nr_children++;
+    (*nr_nodes)++;
+    if (p->utf8)
+      *pool_len += strlen(p->utf8) + 1;
+    count_nodes(p->succession, nr_nodes, nr_slots, pool_len);
+  }
+  if (nr_children) {
+    for (size = 2; size < nr_children * 2; size *= 2)
+      ;
+    *nr_slots += size;
+  }
+}
+
+static char *
+compile(uim_x_compose_builder *b, const char *locale, size_t *len_ret)
+{
+  struct compose_header *header;
+  struct compose_source *sources;
+  struct compose_node *nodes;
+  struct compose_slot *slots;
+  struct build_node **queue, *p;
+  char *base, *pool;
+  unsigned int nr_nodes = 1, nr_slots = 0, pool_off, slot_off, i, j;
+  unsigned int nr_children, size, h;
+  size_t pool_len = 1 + strlen(locale) + 1;
+  size_t len, nodes_off, slots_off, pool_start;
+  int k;
+  struct stat st;
+
+  count_nodes(b->top, &nr_nodes, &nr_slots, &pool_len);
+  for (k = 0; k < b->nr_sources; k++)
+    pool_len += strlen(b->sources[k]) + 1;
+
+  nodes_off = ALIGN_SIZE(sizeof(struct compose_header)
+			 + sizeof(struct compose_source) * b->nr_sources);
+  slots_off = ALIGN_SIZE(nodes_off + sizeof(struct compose_node) * nr_nodes);
+  pool_start = slots_off + sizeof(struct compose_slot) * nr_slots;
+  len = pool_start + pool_len;
+
+  base = calloc(1, len);
+  queue = malloc(sizeof(struct build_node *) * nr_nodes);
+  if (!base || !queue) {
+    free(base);
+    free(queue);
+    return NULL;
+  }
+
+  header = (struct compose_header *)base;
+  sources = (struct compose_source *)(base + sizeof(struct compose_header));
+  nodes = (struct compose_node *)(base + nodes_off);
+  slots = (struct compose_slot *)(base + slots_off);
+  pool = base + pool_start;
+
+  memcpy(header->magic, COMPOSE_MAGIC, sizeof(header->magic));
+  header->version = COMPOSE_VERSION;
+  header->long_size = sizeof(long);
+  header->nr_sources = b->nr_sources;
+  header->nr_nodes = nr_nodes;
+  header->nr_slots = nr_slots;
+  header->pool_len = (unsigned int)pool_len;
+
+  /* offset 0 of the pool is the empty string */
+  pool_off = 1;
+  header->locale = pool_off;
+  strcpy(&pool[pool_off], locale);
+  pool_off += (unsigned int)strlen(locale) + 1;
+
+  for (k = 0; k < b->nr_sources; k++) {
+    sources[k].path = pool_off;
+    strcpy(&pool[pool_off], b->sources[k]);
+    pool_off += (unsigned int)strlen(b->sources[k]) + 1;
+    if (stat(b->sources[k], &st) == 0) {
+      sources[k].mtime = (long)st.st_mtime;
+      sources[k].size = (long)st.st_size;
+    } else {
+      sources[k].mtime = -1;
+      sources[k].size = -1;
+    }
+  }
+
+  for (i = 0; i < nr_slots; i++)
+    slots[i].child = NO_CHILD;
+
+  /* breadth first; queue[0] is the root whose children are b->top */
+  queue[0] = NULL;
+  slot_off = 0;
+  j = 1;
+  for (i = 0; i < j; i++) {
+    struct build_node *children = i ? queue[i]->succession : b->top;
+
+    nodes[i].utf8 = 0;
+    if (i && queue[i]->utf8) {
+      nodes[i].utf8 = pool_off;
+      strcpy(&pool[pool_off], queue[i]->utf8);
+      pool_off += (unsigned int)strlen(queue[i]->utf8) + 1;
+    }
+
+    nr_children = 0;
+    for (p = children; p; p = p->next)
+      nr_children++;
+    if (!nr_children) {
+      nodes[i].first_slot = 0;
+      nodes[i].nr_slots = 0;
+      continue;
+    }
+    for (size = 2; size < nr_children * 2; size *= 2)
+      ;
+    nodes[i].first_slot = slot_off;
+    nodes[i].nr_slots = size;
+    for (p = children; p; p = p->next) {
+      h = hash_keysym(p->keysym) & (size - 1);
+      while (slots[slot_off + h].child != NO_CHILD)
+	h = (h + 1) & (size - 1);
+      slots[slot_off + h].keysym = p->keysym;
+      slots[slot_off + h].modifier_mask = p->modifier_mask;
+      slots[slot_off + h].modifier = p->modifier;
+      slots[slot_off + h].child = j;
+      queue[j++] = p;
+    }
+    slot_off += size;
+  }
+  free(queue);
+
+  *len_ret = len;
+  return base;
+}
+
+
+/* table */
+
+static uim_x_compose_table *
+table_new(char *base, size_t len, int mapped)
+{
+  uim_x_compose_table *table;
+  const struct compose_header *header;
+  size_t nodes_off, slots_off, pool_start;
+  unsigned int i;
+
+  header = (const struct compose_header *)base;
+  if (len < sizeof(struct compose_header)
+      || memcmp(header->magic, COMPOSE_MAGIC, sizeof(header->magic))
+      || header->version != COMPOSE_VERSION
+      || header->long_size != sizeof(long)
+      || header->nr_nodes == 0)
+    return NULL;
+
+  nodes_off = ALIGN_SIZE(sizeof(struct compose_header)
+			 + sizeof(struct compose_source) * header->nr_sources);
+  slots_off = ALIGN_SIZE(nodes_off
+			 + sizeof(struct compose_node) * header->nr_nodes);
+  pool_start = slots_off + sizeof(struct compose_slot) * header->nr_slots;
+  if (pool_start + header->pool_len != len || header->pool_len == 0
+      || base[len - 1] != '\0')
+    return NULL;
+
+  table = malloc(sizeof(uim_x_compose_table));
+  if (!table)
+    return NULL;
+  table->base = base;
+  table->len = len;
+  table->mapped = mapped;
+  table->nodes = (const struct compose_node *)(base + nodes_off);
+  table->slots = (const struct compose_slot *)(base + slots_off);
+  table->pool = base + pool_start;
+  table->nr_nodes = header->nr_nodes;
+
+  /* don't trust the indices of a file blindly */
+  for (i = 0; i < header->nr_nodes; i++) {
+    const struct compose_node *node = &table->nodes[i];
+    if (node->utf8 >= header->pool_len
+	|| node->first_slot + node->nr_slots > header->nr_slots
+	|| (node->nr_slots & (node->nr_slots - 1))) {
+      free(table);
+      return NULL;
+    }
+  }
+  for (i = 0; i < header->nr_slots; i++) {
+    unsigned int child = table->slots[i].child;
+    if (child != NO_CHILD && child >= header->nr_nodes) {
+      free(table);
+      return NULL;
+    }
+  }
+
+  return table;
+}
+
+static uim_bool
+get_cache_filename(char *path, size_t len, const char *filename,
+		   const char *locale)
+{
+  char dir[MAXPATHLEN];
+  unsigned long h = 5381;
+  const char *s, *env;
+
+  /* overridable like LIBUIM_SCM_FILES, for the test suite */
+  env = uim_helper_is_setugid() ? NULL : getenv("LIBUIM_COMPOSE_CACHE_DIR");
+  if (env) {
+    if (strlcpy(dir, env, sizeof(dir)) >= sizeof(dir))
+      return UIM_FALSE;
+  } else if (!uim_get_config_path(dir, sizeof(dir), !uim_helper_is_setugid())
+	     || strlcat(dir, "/" COMPOSE_CACHE_DIR, sizeof(dir)) >= sizeof(dir))
+    return UIM_FALSE;
+  if (!uim_check_dir(dir))
+    return UIM_FALSE;
+
+  for (s = filename; *s; s++)
+    h = h * 33 + (unsigned char)*s;
+  h = h * 33;
+  for (s = locale; *s; s++)
+    h = h * 33 + (unsigned char)*s;
+
+  return (snprintf(path, len, "%s/compose-%08lx", dir, h & 0xffffffffUL)
+	  < (int)len);
+}
+
+static uim_bool
+is_fresh(const uim_x_compose_table *table, const char *filename,
+	 const char *locale)
+{
+  const struct compose_header *header;
+  const struct compose_source *sources;
+  struct stat st;
+  unsigned int i;
+
+  header = (const struct compose_header *)table->base;
+  sources = (const struct compose_source *)(table->base
+					    + sizeof(struct compose_header));
+  if (header->locale >= header->pool_len
+      || strcmp(pool_str(table, header->locale), locale))
+    return UIM_FALSE;
+
+  /* the first source is always the file the table was opened for */
+  if (header->nr_sources == 0)
+    return UIM_FALSE;
+  for (i = 0; i < header->nr_sources; i++) {
+    if (sources[i].path >= header->pool_len)
+      return UIM_FALSE;
+    if (i == 0 && strcmp(pool_str(table, sources[i].path), filename))
+      return UIM_FALSE;
+    if (stat(pool_str(table, sources[i].path), &st) < 0) {
+      if (sources[i].mtime != -1)
+	return UIM_FALSE;
+    } else if ((long)st.st_mtime != sources[i].mtime
+	       || (long)st.st_size != sources[i].size) {
+      return UIM_FALSE;
+    }
+  }
+  return UIM_TRUE;
+}
+
+static uim_x_compose_table *
+load_cache(const char *cache, const char *filename, const char *locale)
+{
+  uim_x_compose_table *table;
+  struct stat st;
+  void *base;
+  int fd;
+
+  fd = open(cache, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  table = table_new(base, st.st_size, 1);
+  if (table && !is_fresh(table, filename, locale)) {
+    free(table);
+    table = NULL;
+  }
+  if (!table)
+    munmap(base, st.st_size);
+
+  return table;
+}
+
+static void
+save_cache(const char *cache, const uim_x_compose_table *table)
+{
+  char tmp[MAXPATHLEN];
+  size_t done = 0;
+  ssize_t n;
+  int fd;
+
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", cache) >= (int)sizeof(tmp))
+    return;
+  fd = mkstemp(tmp);
+  if (fd < 0)
+    return;
+
+  while (done < table->len) {
+    n = write(fd, table->base + done, table->len - done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  if (close(fd) < 0 || done != table->len || rename(tmp, cache) < 0)
+    unlink(tmp);
+}
+
+uim_x_compose_table *
+uim_x_compose_table_open(const char *filename, const char *locale,
+			 uim_x_compose_parse_func parse, void *closure)
+{
+  uim_x_compose_table *table;
+  uim_x_compose_builder *b;
+  char cache[MAXPATHLEN];
+  uim_bool has_cache;
+  char *base;
+  size_t len;
+
+  has_cache = get_cache_filename(cache, sizeof(cache), filename, locale);
+  if (has_cache && (table = load_cache(cache, filename, locale)))
+    return table;
+
+  if (!(b = builder_new()))
+    return NULL;
+  uim_x_compose_builder_add_source(b, filename);
+  parse(b, closure);
+  base = compile(b, locale, &len);
+  builder_free(b);
+  if (!base)
+    return NULL;
+
+  table = table_new(base, len, 0);
+  if (!table) {
+    free(base);
+    return NULL;
+  }
+  if (has_cache)
+    save_cache(cache, table);
+
+  return table;
+}
+
+void
+uim_x_compose_table_close(uim_x_compose_table *table)
+{
+  if (!table)
+    return;
+
+  if (table->mapped)
+    munmap(table->base, table->len);
+  else
+    free(table->base);
+  free(table);
+}
+
+int
+uim_x_compose_table_lookup(const uim_x_compose_table *table, int node,
+			   KeySym keysym, unsigned int state)
+{
+  const struct compose_node *n = &table->nodes[node];
+  const struct compose_slot *s;
+  unsigned int mask, h, i;
+
+  mask = n->nr_slots - 1;
+  h = hash_keysym(keysym) & mask;
+  for (i = 0; i < n->nr_slots; i++, h = (h + 1) & mask) {
+    s = &table->slots[n->first_slot + h];
+    if (s->child == NO_CHILD)
+      break;
+    if (s->keysym == keysym && (state & s->modifier_mask) == s->modifier)
+      return (int)s->child;
+  }
+  return -1;
+}
+
+uim_bool
+uim_x_compose_table_is_leaf(const uim_x_compose_table *table, int node)
+{
+  return table->nodes[node].nr_slots == 0;
+}
+
+const char *
+uim_x_compose_table_utf8(const uim_x_compose_table *table, int node)
+{
+  return pool_str(table, table->nodes[node].utf8);
+}
@@ -44,6 +44,45 @@ int uim_x_kana_input_hack_translate_key(int ukey, KeyCode hardware_keycode);
 int uim_x_kana_input_hack_filter_event(uim_context uc, XEvent *event);
 void uim_x_kana_input_hack_init(Display *display);
 
+/* compiled Compose table, see uim-x-compose.c */
+typedef struct uim_x_compose_table uim_x_compose_table;
+typedef struct uim_x_compose_builder uim_x_compose_builder;
+
+struct uim_x_compose_key {
+  unsigned int modifier_mask;
+  unsigned int modifier;
+  KeySym keysym;
+};
+
+typedef void (*uim_x_compose_parse_func)(uim_x_compose_builder *builder,
+					 void *closure);
+
+#define UIM_X_COMPOSE_ROOT 0
+
+/* Returns the table compiled from filename, from the cache if it's
+ * still valid or by running parse otherwise. The locale determines
+ * the conversion of the results and is part of the cache key. */
+uim_x_compose_table *uim_x_compose_table_open(const char *filename,
+					      const char *locale,
+					      uim_x_compose_parse_func parse,
+					      void *closure);
+void uim_x_compose_table_close(uim_x_compose_table *table);
+/* Returns the child of node matching the key, or -1. */
+int uim_x_compose_table_lookup(const uim_x_compose_table *table, int node,
+			       KeySym keysym, unsigned int state);
+uim_bool uim_x_compose_table_is_leaf(const uim_x_compose_table *table,
+				     int node);
+const char *uim_x_compose_table_utf8(const uim_x_compose_table *table,
+				     int node);
+
+/* for parse functions */
+int uim_x_compose_builder_add(uim_x_compose_builder *builder,
+			      const struct uim_x_compose_key *seq, int n,
+			      const char *utf8);
+/* records a file read by the parser, to be checked on later opens */
+void uim_x_compose_builder_add_source(uim_x_compose_builder *builder,
+				      const char *filename);
+
 #ifdef __cplusplus
 }
 #endif
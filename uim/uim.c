@@ -69,6 +69,13 @@ struct uim_get_candidate_args {
   int enum_hint;
 };
 static void *uim_get_candidate_internal(struct uim_get_candidate_args *args);
+struct uim_get_candidates_args {
+  uim_context uc;
+  int first;
+  int count;
+  int display_limit;
+};
+static void *uim_get_candidates_internal(struct uim_get_candidates_args *args);
 struct uim_delay_activating_args {
   uim_context uc;
   int nr;
@@ -89,6 +96,39 @@ void uim_anthy_utf8_plugin_instance_quit(void);
 static uim_bool uim_initialized;
 static uim_lisp protected0, protected1;
 
+/* Procedures called on every key stroke or candidate window update. Their
+ * handles are resolved once in uim_init_internal() to save looking up the
+ * names on each call. */
+enum {
+  PROC_RESET_HANDLER,
+  PROC_FOCUS_IN_HANDLER,
+  PROC_FOCUS_OUT_HANDLER,
+  PROC_PLACE_HANDLER,
+  PROC_DISPLACE_HANDLER,
+  PROC_GET_CANDIDATE,
+  PROC_GET_CANDIDATES,
+  PROC_SET_CANDIDATE_INDEX,
+  PROC_INPUT_STRING_HANDLER,
+  PROC_MODE_HANDLER,
+  PROC_PROP_ACTIVATE_HANDLER,
+  NR_PROCS
+};
+
+static const char *const proc_names[NR_PROCS] = {
+  "reset-handler",
+  "focus-in-handler",
+  "focus-out-handler",
+  "place-handler",
+  "displace-handler",
+  "get-candidate",
+  "get-candidates",
+  "set-candidate-index",
+  "input-string-handler",
+  "mode-handler",
+  "prop-activate-handler"
+};
+static uim_lisp procs[NR_PROCS];
+
 unsigned int uim_init_count;
 
 /****************************************************************
@@ -130,12 +170,18 @@ static void *
 uim_init_internal(void *dummy)
 {
   char *scm_files;
+  int i;
 
   protected0 = uim_scm_f();
   protected1 = uim_scm_f();
   uim_scm_gc_protect(&protected0);
   uim_scm_gc_protect(&protected1);
 
+  for (i = 0; i < NR_PROCS; i++) {
+    procs[i] = uim_scm_proc_ref(proc_names[i]);
+    uim_scm_gc_protect(&procs[i]);
+  }
+
   /* To allow (cond-expand (uim ...)) in early initialization stages,
    * provision of the "uim" should be performed as early as possible. */
   uim_scm_callf("provide", "s", "uim");
@@ -197,6 +243,7 @@ uim_quit(void)
   uim_scm_callf("annotation-unload", "");
   uim_scm_callf("dynlib-unload-all", "");
   uim_quit_dynlib();
+  uim_quit_rk();
   uim_scm_quit();
   uim_initialized = UIM_FALSE;
 }
@@ -271,6 +318,7 @@ uim_release_context(uim_context uc)
   free(uc->propstr);
   free(uc->modes);
   free(uc->client_encoding);
+  uim_preedit_diff_release(uc);
 #ifdef DEBUG
   /* prevents operating on invalidated uim_context */
   memset(uc, 0, sizeof(*uc));
@@ -289,7 +337,7 @@ uim_reset_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("reset-handler", "p", uc);
+  uim_scm_call_handle(procs[PROC_RESET_HANDLER], "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -303,7 +351,7 @@ uim_focus_in_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("focus-in-handler", "p", uc);
+  uim_scm_call_handle(procs[PROC_FOCUS_IN_HANDLER], "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -317,7 +365,7 @@ uim_focus_out_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("focus-out-handler", "p", uc);
+  uim_scm_call_handle(procs[PROC_FOCUS_OUT_HANDLER], "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -331,7 +379,7 @@ uim_place_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("place-handler", "p", uc);
+  uim_scm_call_handle(procs[PROC_PLACE_HANDLER], "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -345,7 +393,7 @@ uim_displace_context(uim_context uc)
   assert(uim_scm_gc_any_contextp());
   assert(uc);
 
-  uim_scm_callf("displace-handler", "p", uc);
+  uim_scm_call_handle(procs[PROC_DISPLACE_HANDLER], "p", uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -365,6 +413,45 @@ uim_set_preedit_cb(uim_context uc,
   uc->preedit_clear_cb = clear_cb;
   uc->preedit_pushback_cb = pushback_cb;
   uc->preedit_update_cb = update_cb;
+  uc->preedit_replace_cb = NULL;
+
+  UIM_CATCH_ERROR_END();
+}
+
+void
+uim_set_preedit_diff_cb(uim_context uc,
+			void (*replace_cb)(void *ptr, int first,
+					   int nr_removed, int nr_added,
+					   const int *attrs,
+					   const char *const *strs),
+			void (*update_cb)(void *ptr))
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+  assert(replace_cb);
+
+  uc->preedit_clear_cb = NULL;
+  uc->preedit_pushback_cb = NULL;
+  uc->preedit_update_cb = update_cb;
+  uc->preedit_replace_cb = replace_cb;
+  uim_preedit_diff_reset(uc);
+
+  UIM_CATCH_ERROR_END();
+}
+
+void
+uim_reset_preedit_diff(uim_context uc)
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+
+  uim_preedit_diff_reset(uc);
 
   UIM_CATCH_ERROR_END();
 }
@@ -425,8 +512,8 @@ uim_get_candidate_internal(struct uim_get_candidate_args *args)
   const char *str, *head, *ann;
 
   uc = args->uc;
-  triple = uim_scm_callf("get-candidate", "pii",
-			 uc, args->index, args->enum_hint);
+  triple = uim_scm_call_handle(procs[PROC_GET_CANDIDATE], "pii",
+			       uc, args->index, args->enum_hint);
   ENSURE((uim_scm_length(triple) == 3), "invalid candidate triple");
 
   cand = uim_malloc(sizeof(*cand));
@@ -442,6 +529,101 @@ uim_get_candidate_internal(struct uim_get_candidate_args *args)
   return (void *)cand;
 }
 
+uim_candidate *
+uim_get_candidates(uim_context uc, int first, int count, int display_limit)
+{
+  struct uim_get_candidates_args args;
+  uim_candidate *cands;
+
+  if (UIM_CATCH_ERROR_BEGIN())
+    return NULL;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+  assert(first >= 0);
+  assert(count >= 0);
+  assert(display_limit >= 0);
+
+  args.uc = uc;
+  args.first = first;
+  args.count = count;
+  args.display_limit = display_limit;
+
+  cands = (uim_candidate *)uim_scm_call_with_gc_ready_stack((uim_gc_gate_func_ptr)uim_get_candidates_internal, &args);
+
+  UIM_CATCH_ERROR_END();
+
+  return cands;
+}
+
+/*
+ * The page is a single block: the NULL terminated pointer array, the
+ * candidate structs and then their strings.
+ */
+static void *
+uim_get_candidates_internal(struct uim_get_candidates_args *args)
+{
+  uim_context uc;
+  uim_candidate *cands, cand;
+  uim_lisp triples, triple, rest;
+  char **strs, *p;
+  size_t size;
+  int i, j, nr;
+
+  uc = args->uc;
+  triples = uim_scm_call_handle(procs[PROC_GET_CANDIDATES], "piii", uc,
+				args->first, args->count, args->display_limit);
+  nr = uim_scm_length(triples);
+  ENSURE((nr == args->count), "invalid number of candidates");
+  for (rest = triples; !NULLP(rest); rest = CDR(rest))
+    ENSURE((uim_scm_length(CAR(rest)) == 3), "invalid candidate triple");
+
+  /* convert all the strings before sizing the page */
+  strs = uim_malloc(sizeof(char *) * nr * 3);
+  size = sizeof(uim_candidate) * (nr + 1) + sizeof(*cand) * nr;
+  for (i = 0, rest = triples; i < nr; i++, rest = CDR(rest)) {
+    for (j = 0, triple = CAR(rest); j < 3; j++, triple = CDR(triple)) {
+      strs[i * 3 + j] = uc->conv_if->convert(uc->outbound_conv,
+					     REFER_C_STR(CAR(triple)));
+      if (strs[i * 3 + j])
+	size += strlen(strs[i * 3 + j]) + 1;
+    }
+  }
+
+  cands = uim_malloc(size);
+  cand = (uim_candidate)&cands[nr + 1];
+  p = (char *)&cand[nr];
+  for (i = 0; i < nr; i++, cand++) {
+    memset(cand, 0, sizeof(*cand));
+    cands[i] = cand;
+    for (j = 0; j < 3; j++) {
+      /* a failed conversion is left NULL as in uim_get_candidate() */
+      if (!strs[i * 3 + j])
+	continue;
+      size = strlen(strs[i * 3 + j]) + 1;
+      memcpy(p, strs[i * 3 + j], size);
+      free(strs[i * 3 + j]);
+      if (j == 0)
+	cand->str = p;
+      else if (j == 1)
+	cand->heading_label = p;
+      else
+	cand->annotation = p;
+      p += size;
+    }
+  }
+  cands[nr] = NULL;
+  free(strs);
+
+  return (void *)cands;
+}
+
+void
+uim_candidates_free(uim_candidate *cands)
+{
+  free(cands);
+}
+
 /* Accepts NULL candidates that produced by an error on uim_get_candidate(). */
 const char *
 uim_candidate_get_cand_str(uim_candidate cand)
@@ -530,7 +712,7 @@ uim_set_candidate_index(uim_context uc, int nth)
   assert(uc);
   assert(nth >= 0);
 
-  uim_scm_callf("set-candidate-index", "pi", uc, nth);
+  uim_scm_call_handle(procs[PROC_SET_CANDIDATE_INDEX], "pi", uc, nth);
 
   UIM_CATCH_ERROR_END();
 }
@@ -575,7 +757,8 @@ uim_input_string(uim_context uc, const char *str)
   conv = uc->conv_if->convert(uc->inbound_conv, str);
   if (conv) {
     protected0 =
-      consumed = uim_scm_callf("input-string-handler", "ps", uc, conv);
+      consumed = uim_scm_call_handle(procs[PROC_INPUT_STRING_HANDLER], "ps",
+				     uc, conv);
     free(conv);
 
     ret = C_BOOL(consumed);
@@ -908,7 +1091,7 @@ uim_set_mode(uim_context uc, int mode)
   assert(mode >= 0);
 
   uc->mode = mode;
-  uim_scm_callf("mode-handler", "pi", uc, mode);
+  uim_scm_call_handle(procs[PROC_MODE_HANDLER], "pi", uc, mode);
 
   UIM_CATCH_ERROR_END();
 }
@@ -1011,7 +1194,7 @@ uim_prop_activate(uim_context uc, const char *str)
   assert(uc);
   assert(str);
       
-  uim_scm_callf("prop-activate-handler", "ps", uc, str);
+  uim_scm_call_handle(procs[PROC_PROP_ACTIVATE_HANDLER], "ps", uc, str);
 
   UIM_CATCH_ERROR_END();
 }
@@ -1048,6 +1231,27 @@ uim_prop_update_custom(uim_context uc, const char *custom, const char *val)
   UIM_CATCH_ERROR_END();
 }
 
+/** Update custom values from a batched property message.
+ * Update custom values from the body of a custom_update_batch message,
+ * i.e. \a customs is a sequence of "custom_sym\nvalue\n" pairs. All of
+ * them are parsed and applied by one call into the Scheme side.
+ * Validation is the same as for uim_prop_update_custom().
+ */
+void
+uim_prop_update_customs(uim_context uc, const char *customs)
+{
+  if (UIM_CATCH_ERROR_BEGIN())
+    return;
+
+  assert(uim_scm_gc_any_contextp());
+  assert(uc);
+  assert(customs);
+
+  uim_scm_callf("custom-set-batch-handler", "ps", uc, customs);
+
+  UIM_CATCH_ERROR_END();
+}
+
 uim_bool
 uim_prop_reload_configs(void)
 {
@@ -553,6 +553,47 @@ uim_set_preedit_cb(uim_context uc,
 		   /* page change cb .. etc will be here */
 		   void (*update_cb)(void *ptr));
 
+/**
+ * Set callback functions to receive only the changed part of the preedit,
+ * instead of the whole preedit as uim_set_preedit_cb() does. This replaces
+ * the callbacks set by uim_set_preedit_cb(), and vice versa. A bridge
+ * starts with an empty preedit when calling this.
+ *
+ * On each update, the segments [first, first + nr_removed) of the preedit
+ * previously delivered are replaced by the nr_added segments whose
+ * attributes and strings are given in attrs and strs. The arrays are only
+ * valid during the call. update_cb is called afterwards, and neither
+ * callback is called if the preedit did not change. Empty segments are
+ * not delivered unless they have UPreeditAttr_Cursor or
+ * UPreeditAttr_Separator.
+ *
+ * @param uc input context
+ * @param replace_cb called with the changed segments.
+ * @param update_cb called when the changes of preedit string should be updated graphically. May be NULL.
+ *
+ * @see uim_set_preedit_cb
+ * @see uim_reset_preedit_diff
+ */
+void
+uim_set_preedit_diff_cb(uim_context uc,
+			void (*replace_cb)(void *ptr,
+					   int first,
+					   int nr_removed,
+					   int nr_added,
+					   const int *attrs,
+					   const char *const *strs),
+			void (*update_cb)(void *ptr));
+
+/**
+ * Tell uim that the bridge has discarded its preedit by itself, for example
+ * on a toolkit-level reset. The next update is delivered as a replacement
+ * of an empty preedit. Only meaningful with uim_set_preedit_diff_cb().
+ *
+ * @param uc input context
+ */
+void
+uim_reset_preedit_diff(uim_context uc);
+
 /* dealing pressing key */
 /**
  * Send key press event to uim context
@@ -733,6 +774,33 @@ uim_candidate uim_get_candidate(uim_context uc, int index, int accel_enumeration
  * @param cand the data you want to free
  */
 void uim_candidate_free(uim_candidate cand);
+/**
+ * Get data of consecutive candidates at once.
+ *
+ * Same as calling uim_get_candidate() for each index from @a first with
+ * (display_limit ? index % display_limit : index) as the
+ * accel_enumeration_hint, but with a single call into the IM.
+ *
+ * @param uc input context
+ * @param first index of the first candidate you want to get
+ * @param count number of candidates
+ * @param display_limit number of candidates shown on one page, or 0
+ *
+ * @warning You must free the result by uim_candidates_free, and must not
+ * free each candidate by uim_candidate_free.
+ *
+ * @see uim_candidates_free
+ *
+ * @return NULL terminated array of @a count candidates, or NULL on error
+ */
+uim_candidate *uim_get_candidates(uim_context uc, int first, int count,
+				  int display_limit);
+/**
+ * Free the result of uim_get_candidates.
+ *
+ * @param cands the data you want to free
+ */
+void uim_candidates_free(uim_candidate *cands);
 
 int   uim_get_candidate_index(uim_context uc);
 /**
@@ -819,6 +887,8 @@ void
 uim_prop_activate(uim_context uc, const char *str);
 void
 uim_prop_update_custom(uim_context uc, const char *custom, const char *val);
+void
+uim_prop_update_customs(uim_context uc, const char *customs);
 uim_bool
 uim_prop_reload_configs(void);
 
@@ -61,12 +61,11 @@
 static int parse_line(char *line, char **argv, int argsize);
 static unsigned int KeySymToUcs4(KeySym keysym);
 
-Compose::Compose(DefTree *top, XimIC *xic)
+Compose::Compose(uim_x_compose_table *table, XimIC *xic)
 {
     m_xic = xic;
-    m_composed = NULL;
-    m_top = top;
-    m_context = top;
+    m_table = table;
+    m_context = UIM_X_COMPOSE_ROOT;
 }
 
 Compose::~Compose()
@@ -75,46 +74,39 @@ Compose::~Compose()
 
 bool Compose::handleKey(KeySym xkeysym, int xkeystate, bool is_push)
 {
-    DefTree *p;
+    int p;
 
-    if ((is_push == false)  || m_top == NULL)
+    if ((is_push == false)  || m_table == NULL)
 	return false;
 
     if (IsModifierKey(xkeysym))
 	return false;
 
-    for (p = m_context; p ; p = p->next) {
-	if (((xkeystate & p->modifier_mask) == p->modifier) &&
-		(xkeysym == p->keysym)) {
-	    break;
-	}
-    }
+    p = uim_x_compose_table_lookup(m_table, m_context, xkeysym, xkeystate);
 
-    if (p) { // Matched
-	if (p->succession) { // Intermediate
-	    m_context = p->succession;
+    if (p != -1) { // Matched
+	if (!uim_x_compose_table_is_leaf(m_table, p)) { // Intermediate
+	    m_context = p;
 	    return true;
 	} else { // Terminate (reached to leaf)
-	    m_composed = p;
 	    // commit string here
-	    m_xic->commit_string(m_composed->utf8);
+	    m_xic->commit_string(uim_x_compose_table_utf8(m_table, p));
 	    // initialize internal state for next key sequence
-	    m_context = m_top;
+	    m_context = UIM_X_COMPOSE_ROOT;
 	    return true;
 	}
     } else { // Unmatched
-	if (m_context == m_top)
+	if (m_context == UIM_X_COMPOSE_ROOT)
 	    return false;
 	// Error (Sequence Unmatch occurred)
-	m_context = m_top;
+	m_context = UIM_X_COMPOSE_ROOT;
 	return true;
     }
 }
 
 void Compose::reset()
 {
-    m_context = m_top;
-    m_composed = NULL;
+    m_context = UIM_X_COMPOSE_ROOT;
 }
 
 static int
@@ -439,31 +431,23 @@ XimIM::get_mb_string(char *buf, KeySym ks)
 #define SEQUENCE_MAX    10
 
 int
-XimIM::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
+XimIM::parse_compose_line(uim_x_compose_builder *builder, FILE *fp,
+			  char **tokenbuf, size_t *buflen)
 {
     int token;
     unsigned modifier_mask;
     unsigned modifier;
     unsigned tmp;
     KeySym keysym = NoSymbol;
-    DefTree **top = &mTreeTop;
-    DefTree *p = NULL;
     Bool exclam, tilde;
     KeySym rhs_keysym = 0;
     char *rhs_string_mb;
     int l;
     int lastch = 0;
     char local_mb_buf[MB_LEN_MAX + 1];
-    char local_utf8_buf[LOCAL_UTF8_BUFSIZE], *rhs_string_utf8;
-
-    struct DefBuffer {
-	unsigned modifier_mask;
-	unsigned modifier;
-	KeySym keysym;
-    };
-
-    struct DefBuffer buf[SEQUENCE_MAX];
-    int i, n;
+    char local_utf8_buf[LOCAL_UTF8_BUFSIZE];
+    struct uim_x_compose_key buf[SEQUENCE_MAX];
+    int n;
     const char *encoding = get_encoding();
 
     do {
@@ -488,7 +472,8 @@ XimIM::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
 	    infp = fopen(filename, "r");
 	    if (infp == NULL)
 		goto error;
-	    ParseComposeStringFile(infp);
+	    uim_x_compose_builder_add_source(builder, filename);
+	    ParseComposeStringFile(builder, infp);
 	    fclose(infp);
 	    return 0;
 	} else if ((token == KEY) && (strcmp("None", *tokenbuf) == 0)) {
@@ -603,46 +588,9 @@ XimIM::parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen)
     if (l == LOCAL_UTF8_BUFSIZE - 1) {
 	local_utf8_buf[l] = '\0';
     }
-    if ((rhs_string_utf8 = (char *)malloc(l + 1)) == NULL) {
-	free(rhs_string_mb);
-	return 0;
-    }
-    memcpy(rhs_string_utf8, local_utf8_buf, l + 1);
+    free(rhs_string_mb);
 
-    for (i = 0; i < n; i++) {
-	for (p = *top; p; p = p->next) {
-	    if (buf[i].keysym == p->keysym &&
-		buf[i].modifier == p->modifier &&
-		buf[i].modifier_mask == p->modifier_mask) {
-		break;
-	    }
-	}
-	if (p) {
-	    top = &p->succession;
-	} else {
-	    if ((p = (DefTree*)malloc(sizeof(DefTree))) == NULL) {
-		free(rhs_string_mb);
-		goto error;
-	    }
-	    p->keysym = buf[i].keysym;
-	    p->modifier = buf[i].modifier;
-	    p->modifier_mask = buf[i].modifier_mask;
-	    p->succession = NULL;
-	    p->next = *top;
-	    p->mb = NULL;
-	    p->utf8 = NULL;
-	    p->ks = NoSymbol;
-	    *top = p;
-	    top = &p->succession;
-	}
-    }
-
-    free(p->mb);
-    p->mb = rhs_string_mb;
-    free(p->utf8);
-    p->utf8 = rhs_string_utf8;
-    p->ks = rhs_keysym;
-    return n;
+    return uim_x_compose_builder_add(builder, buf, n, local_utf8_buf);
 error:
     while (token != ENDOFLINE && token != ENDOFFILE) {
 	token = nexttoken(fp, tokenbuf, &lastch, buflen);
@@ -651,7 +599,7 @@ error:
 }
 
 void
-XimIM::ParseComposeStringFile(FILE *fp)
+XimIM::ParseComposeStringFile(uim_x_compose_builder *builder, FILE *fp)
 {
     char *tbp, *p[1];
     struct stat st;
@@ -663,18 +611,32 @@ XimIM::ParseComposeStringFile(FILE *fp)
 	tbp = (char *)malloc(buflen);
 	p[0] = tbp;
 	if (tbp != NULL) {
-	    while (parse_compose_line(fp, p, &buflen) >= 0) {
+	    while (parse_compose_line(builder, fp, p, &buflen) >= 0) {
 	    }
 	    free(p[0]);
 	}
     }
 }
 
+struct compose_parse_arg {
+    XimIM *im;
+    FILE *fp;
+};
+
+static void
+parse_compose_file(uim_x_compose_builder *builder, void *closure)
+{
+    struct compose_parse_arg *arg = (struct compose_parse_arg *)closure;
+
+    arg->im->ParseComposeStringFile(builder, arg->fp);
+}
+
 void XimIM::create_compose_tree()
 {
     FILE *fp = NULL;
-    char name[MAXPATHLEN];
+    char name[MAXPATHLEN], locale[BUFSIZ];
     const char *lang_region, *encoding;
+    struct compose_parse_arg arg;
     char *compose_env;
 
     name[0] = '\0';
@@ -708,14 +670,19 @@ void XimIM::create_compose_tree()
 	fclose(fp);
 	return;
     }
+    snprintf(locale, sizeof(locale), "%s.%s", lang_region, encoding);
 
-    ParseComposeStringFile(fp);
+    // parsed only if the cached table is missing or stale
+    arg.im = this;
+    arg.fp = fp;
+    mComposeTable = uim_x_compose_table_open(name, locale,
+					     parse_compose_file, &arg);
     fclose(fp);
 }
 
-DefTree *XimIM::get_compose_tree()
+uim_x_compose_table *XimIM::get_compose_tree()
 {
-    return mTreeTop;
+    return mComposeTable;
 }
 
 int XimIM::get_compose_filename(char *filename, size_t len)
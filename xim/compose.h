@@ -36,30 +36,20 @@
 
 #include <X11/X.h>
 
-typedef struct _DefTree {
-    struct _DefTree *next;		/* another Key definition */
-    struct _DefTree *succession;	/* successive Key Sequence */
-					/* Key definitions */
-    unsigned modifier_mask;
-    unsigned modifier;
-    KeySym keysym;			/* leaf only */
-    char *mb;
-    char *utf8;				/* make from mb */
-    KeySym ks;
-} DefTree;
+#include "uim/uim.h"
+#include "uim/uim-x-util.h"
 
 class XimIC;
 class Compose {
 public:
-    Compose(DefTree *, XimIC *);
+    Compose(uim_x_compose_table *, XimIC *);
     ~Compose();
     bool handleKey(KeySym xkeysym, int xstate, bool is_push);
     void reset();
 private:
     XimIC *m_xic;
-    DefTree *m_top;
-    DefTree *m_context;
-    DefTree *m_composed;
+    uim_x_compose_table *m_table;
+    int m_context; // node of m_table
 };
 
 #endif
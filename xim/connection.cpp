@@ -45,9 +45,6 @@
 #include <map>
 #include <unistd.h>
 #include <X11/Xatom.h>
-#ifdef HAVE_ALLOCA_H
-# include <alloca.h>
-#endif
 
 #define INIT_BUF_SIZE 1024
 #define TRANSPORT_UNIT 20
@@ -138,6 +135,7 @@ XConnection::XConnection(XimServer *svr, Window clientWin, Window commWin) :
     mClientWin = clientWin;
     mCommWin = commWin;
     mBuf.buf = (char *)malloc(INIT_BUF_SIZE);
+    mBuf.start = 0;
     mBuf.len = 0;
     mBuf.size = INIT_BUF_SIZE;
     add_window_watch(mClientWin, this, STRUCTURE_NOTIFY_MASK);
@@ -166,47 +164,69 @@ void XConnection::readProc(XClientMessageEvent *ev)
 
     checkByteorder();
 
+    // Packets are parsed in place.  They are all consumed by OnRecv()
+    // before the buffer is touched again, so only the offset of the
+    // unread data is advanced here.
     bool pushed = true;
     do {
 	int len = -1;
-	if (mBuf.len >= 4)
-	    len = RxPacket::getPacketLength((unsigned char *)mBuf.buf,
+	char *head = &mBuf.buf[mBuf.start];
+	int avail = mBuf.len - mBuf.start;
+	if (avail >= 4)
+	    len = RxPacket::getPacketLength((unsigned char *)head,
 					    mByteorder);
 
-	if ((len > 4 && len <= mBuf.len) ||
-	    (len == 4 && mBuf.buf[0] == XIM_DISCONNECT)) {
+	if ((len > 4 && len <= avail) ||
+	    (len == 4 && head[0] == XIM_DISCONNECT)) {
 	    RxPacket *p = 
-		createRxPacket((unsigned char *)mBuf.buf, mByteorder);
-	    shiftBuffer(len);
+		createRxPacket((unsigned char *)head, mByteorder);
+	    mBuf.start += len;
 	    mRxQ.push_back(p);
 	} else if (len == 4) {
 	    // do nothing
-	    shiftBuffer(4);
+	    mBuf.start += 4;
 	} else {
 	    pushed = false;
 	}
     } while (pushed);
     OnRecv();
 
+    if (mBuf.start == mBuf.len)
+	mBuf.start = mBuf.len = 0;
+
     writeProc();
 }
 
-void XConnection::shiftBuffer(int len)
+// Make room for len more bytes, moving a pending partial packet to
+// the front of the buffer only when the tail is too short.
+void XConnection::reserveBuffer(long len)
 {
-    memmove(mBuf.buf, &mBuf.buf[len], mBuf.len - len);
-    mBuf.len -= len;
+    if (mBuf.len + len <= mBuf.size)
+	return;
+
+    if (mBuf.start > 0) {
+	memmove(mBuf.buf, &mBuf.buf[mBuf.start], mBuf.len - mBuf.start);
+	mBuf.len -= mBuf.start;
+	mBuf.start = 0;
+	if (mBuf.len + len <= mBuf.size)
+	    return;
+    }
+    while (mBuf.len + len > mBuf.size)
+	mBuf.size *= 2;
+    mBuf.buf = (char *)realloc(mBuf.buf, mBuf.size);
 }
 
 bool XConnection::checkByteorder()
 {
     if (mByteorder == BYTEORDER_UNKNOWN) {
-	if (mBuf.buf[0] != XIM_CONNECT) {
+	char *head = &mBuf.buf[mBuf.start];
+	if (head[0] != XIM_CONNECT) {
 	    printf("not XIM_CONNECT\n");
 	    return false;
 	}
-	if (mBuf.buf[4] == 0x42)
+	if (head[4] == 0x42)
 	    mByteorder = MSB_FIRST;
-	else if (mBuf.buf[4] == 0x6c)
+	else if (head[4] == 0x6c)
 	    mByteorder = LSB_FIRST;
 	else
 	    return false;
@@ -225,10 +245,7 @@ bool XConnection::readToBuf(XClientMessageEvent *ev)
 	unsigned long remain;
 	char *data;
 
-	while (ev->data.l[0] >= mBuf.size) {
-	    mBuf.size += 1024;
-	    mBuf.buf = (char *)realloc(mBuf.buf, mBuf.size);
-	}
+	reserveBuffer(ev->data.l[0]);
 	do {
 	    XGetWindowProperty(XimServer::gDpy, ev->window, ev->data.l[1],
 			       offset, mBuf.size - mBuf.len, True,
@@ -239,6 +256,7 @@ bool XConnection::readToBuf(XClientMessageEvent *ev)
 		return false;
 
 	    if (format == 8) {
+		reserveBuffer(static_cast<long>(nrItems));
 		memcpy(&mBuf.buf[mBuf.len], data, nrItems);
 		mBuf.len += static_cast<int>(nrItems);
 	    } else
@@ -247,10 +265,7 @@ bool XConnection::readToBuf(XClientMessageEvent *ev)
 	} while (remain > 0);
     } else if (ev->format == 8) {
 	// direct
-	if ((mBuf.len + TRANSPORT_UNIT) >= mBuf.size) {
-	    mBuf.size += TRANSPORT_UNIT;
-	    mBuf.buf = (char *)realloc(mBuf.buf, mBuf.size);
-	}
+	reserveBuffer(TRANSPORT_UNIT);
 	memcpy(&mBuf.buf[mBuf.len], ev->data.b, TRANSPORT_UNIT);
 	mBuf.len += TRANSPORT_UNIT;
     } else
@@ -436,11 +451,10 @@ void XConnection::doSend(TxPacket *t, bool passive)
 
     XClientMessageEvent r;
     int buflen;
-    char *buf;
+    const char *buf;
 
     buflen = t->get_length();
-    buf = (char *)alloca(buflen);
-    t->write_to_buf((unsigned char *)buf, buflen, mByteorder);
+    buf = (const char *)t->get_data();
     if (buflen < TRANSPORT_MAX) {
 	// via event
 	int offset = 0;
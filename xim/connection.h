@@ -54,13 +54,14 @@ public:
 private:
     bool readToBuf(XClientMessageEvent *);
     bool checkByteorder();
-    void shiftBuffer(int);
+    void reserveBuffer(long);
     void doSend(TxPacket *t, bool is_passive);
 
     Window mClientWin, mCommWin;
     bool mIsValid;
     struct {
 	char *buf;
+	int start; // offset of the data not parsed yet
 	int len;
 	long size;
     } mBuf;
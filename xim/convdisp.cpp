@@ -44,6 +44,9 @@
 #endif
 #include <clocale>
 #include <cstdlib>
+#include <map>
+#include <string>
+#include <utility>
 #include "xim.h"
 #include "ximserver.h"
 #include "convdisp.h"
@@ -114,8 +117,10 @@ update_default_xftfont() {
 			XFT_PIXEL_SIZE, XftTypeDouble, (double)DEFAULT_FONT_SIZE,
 			NULL);
 	if (xftfont) {
-	    if (gXftFont)
+	    if (gXftFont) {
+		forget_glyph_extents(gXftFont);
 		XftFontClose(XimServer::gDpy, gXftFont);
+	    }
 	    free(gXftFontName);
 	    free(gXftFontLocale);
 	    gXftFont = xftfont;
@@ -164,6 +169,105 @@ choose_default_fontset(const char *im_lang, const char *locale) {
     return create_default_fontset(im_lang, locale);
 }
 
+//
+// Glyph extents
+//
+// Measuring a character costs an extents query, and for non UTF-8
+// encodings a conversion through iconv as well.  The results are kept
+// per font (and encoding) so that redrawing the preedit measures only
+// the characters not seen before.  Fonts must be forgotten with
+// forget_glyph_extents() before they are freed.
+
+struct glyph_extent {
+    int width;
+    int height;
+    bool valid; // false if the character can't be converted
+};
+
+typedef std::map<uchar, glyph_extent> glyph_extent_map;
+typedef std::pair<const void *, std::string> glyph_font_key;
+
+static std::map<glyph_font_key, glyph_extent_map> glyph_extent_cache;
+
+void
+forget_glyph_extents(const void *font)
+{
+    std::map<glyph_font_key, glyph_extent_map>::iterator it, next;
+
+    for (it = glyph_extent_cache.begin(); it != glyph_extent_cache.end();
+	 it = next) {
+	next = it;
+	++next;
+	if (it->first.first == font)
+	    glyph_extent_cache.erase(it);
+    }
+}
+
+static glyph_extent
+measure_glyph(Convdisp *cd, const void *font, const char *encoding, uchar ch)
+{
+    glyph_extent ext;
+    char utf8[6];
+    int len;
+
+    ext.width = 0;
+    ext.height = 0;
+    ext.valid = true;
+
+    if (cd->use_xft() == true) {
+#if HAVE_XFT_UTF8_STRING
+	XGlyphInfo ginfo;
+	len = utf8_wctomb((unsigned char *)utf8, ch);
+	XftTextExtentsUtf8(XimServer::gDpy, (XftFont *)font,
+			(unsigned char *)utf8, len, &ginfo);
+	ext.width = ginfo.xOff;
+#endif
+    } else {
+	XRectangle ink, logical;
+
+	if (!strcmp(encoding, "UTF-8")) {
+	    XwcTextExtents((XFontSet)font, &ch, 1, &ink, &logical);
+	} else {
+	    char *native_str;
+	    XimIM *im = get_im_by_id(cd->get_context()->get_ic()->get_imid());
+
+	    len = utf8_wctomb((unsigned char *)utf8, ch);
+	    utf8[len] = '\0';
+	    native_str = im->utf8_to_native_str(utf8);
+	    if (!native_str) {
+		ext.valid = false;
+		return ext;
+	    }
+	    len = static_cast<int>(strlen(native_str));
+	    XmbTextExtents((XFontSet)font, native_str, len, &ink, &logical);
+	    free(native_str);
+	}
+	ext.width = logical.width;
+	ext.height = logical.height;
+    }
+
+    return ext;
+}
+
+// Fill ext[0..len) with the extents of chs[0..len) drawn with font,
+// which is an XftFont or an XFontSet according to cd->use_xft().
+static void
+get_glyph_extents(Convdisp *cd, const void *font, const char *encoding,
+		  const uchar *chs, int len, glyph_extent *ext)
+{
+    glyph_font_key key(font, cd->use_xft() ? "" : encoding);
+    glyph_extent_map &cache = glyph_extent_cache[key];
+    int i;
+
+    for (i = 0; i < len; i++) {
+	glyph_extent_map::iterator it = cache.find(chs[i]);
+	if (it == cache.end())
+	    it = cache.insert(std::make_pair(chs[i],
+				measure_glyph(cd, font, encoding, chs[i]))).first;
+	ext[i] = it->second;
+    }
+}
+
 struct char_ent {
     uchar c;
     int stat;
@@ -190,6 +294,7 @@ public:
     void set_xftfont(const char *xfld);
 #endif
     void set_fontset(XFontSet f);
+    void get_extents(const uchar *chs, int len, glyph_extent *ext);
     
     virtual void set_size(int w, int h);
     void set_pos(int x, int y);
@@ -236,10 +341,9 @@ public:
 
 private:
     void calc_extent(pe_stat *p);
-    int calc_segment_extent(pe_ustring *s);
-    void draw_segment(pe_ustring *s);
+    int calc_segment_extent(pe_stat *p, pe_segment *s);
+    void draw_segment(pe_stat *p, pe_segment *s);
     void draw_cursor();
-    int get_char_width(uchar ch);
 
     int m_x;
     int mCharPos;
@@ -317,12 +421,17 @@ public:
     virtual bool use_xft();
 
 private:
-    void compose_preedit_array(TxPacket *);
-    void compose_feedback_array(TxPacket *);
+    void make_feedback_array(std::vector<C32> *);
+    void compose_preedit_array(TxPacket *, int first, int len);
+    void compose_feedback_array(TxPacket *, std::vector<C32> *,
+				int first, int len);
   
     Connection *mConn;
     C16 mImid, mIcid;
     int mPrevLen;
+    // preedit as last drawn by the client
+    uString mPrevStr;
+    std::vector<C32> mPrevFeedback;
 };
 
 Convdisp *create_convdisp(int style, InputContext *k,
@@ -428,8 +537,10 @@ PeWin::~PeWin()
 #if HAVE_XFT_UTF8_STRING 
     if (mConvdisp->use_xft() == true) {
 	XftDrawDestroy(mXftDraw);
-	if (mXftFont != gXftFont)
+	if (mXftFont != gXftFont) {
+	    forget_glyph_extents(mXftFont);
 	    XftFontClose(XimServer::gDpy, mXftFont);
+	}
     }
 #endif
 
@@ -541,6 +652,18 @@ void PeWin::set_fontset(XFontSet f)
 	mFontset = f;
 }
 
+void PeWin::get_extents(const uchar *chs, int len, glyph_extent *ext)
+{
+    const void *font = NULL;
+#if HAVE_XFT_UTF8_STRING
+    if (mConvdisp->use_xft() == true)
+	font = mXftFont;
+#endif
+    if (mConvdisp->use_xft() == false)
+	font = mFontset;
+    get_glyph_extents(mConvdisp, font, mEncoding, chs, len, ext);
+}
+
 #if HAVE_XFT_UTF8_STRING
 void PeWin::set_xftfont(const char *xfld)
 {
@@ -550,8 +673,10 @@ void PeWin::set_xftfont(const char *xfld)
 	if (!gXftFont)
 	    init_default_xftfont();
 	if (size != -1 && (mXftFontSize != size || strcmp(locale, gXftFontLocale))) {
-	    if (mXftFont != gXftFont)
+	    if (mXftFont != gXftFont) {
+		forget_glyph_extents(mXftFont);
 		XftFontClose(XimServer::gDpy, mXftFont);
+	    }
 
 	    mXftFont = XftFontOpen(XimServer::gDpy,
 			    DefaultScreen(XimServer::gDpy),
@@ -676,9 +801,9 @@ void PeLineWin::draw_pe(pe_stat *p)
     m_x = PE_LINE_WIN_MARGIN_X;
     mCursorX = m_x;
     mCharPos = 0;
-    std::list<pe_ustring>::iterator i;
-    for (i = p->ustrings.begin(); i != p->ustrings.end(); ++i) {
-	draw_segment(&(*i));
+    std::vector<pe_segment>::iterator i;
+    for (i = p->segments.begin(); i != p->segments.end(); ++i) {
+	draw_segment(p, &(*i));
     }
     draw_cursor();
 }
@@ -692,51 +817,18 @@ void PeLineWin::draw_cursor()
 		    PE_LINE_WIN_FONT_POS_Y + 1);
 }
 
-int PeLineWin::get_char_width(uchar ch)
+void PeLineWin::draw_segment(pe_stat *p, pe_segment *s)
 {
-    int width = 0;
-    char utf8[6];
-
-    int len = utf8_wctomb((unsigned char *)utf8, ch);
-    utf8[len] = '\0';
-
-    if (mConvdisp->use_xft() == true) {
-#ifdef HAVE_XFT_UTF8_STRING
-	XGlyphInfo ginfo;
-	XftTextExtentsUtf8(XimServer::gDpy, mXftFont, (unsigned char *)utf8,
-			len, &ginfo);
-	width = ginfo.xOff;
-#endif
-    } else {
-	XRectangle ink, logical;
-
-	if (!strcmp(mEncoding, "UTF-8")) {
-	    XwcTextExtents(mFontset, &ch, 1, &ink, &logical);
-	} else {
-	    char *native_str;
-	    XimIM *im = get_im_by_id(mConvdisp->get_context()->get_ic()->get_imid());
-
-	    native_str = im->utf8_to_native_str(utf8);
-	    if (!native_str)
-		return 0;
-	    len = static_cast<int>(strlen(native_str));
-	    XmbTextExtents(mFontset, native_str, len, &ink, &logical);
-	    free(native_str);
-	}
-	width = logical.width;
-    }
-
-    return width;
-}
-
-void PeLineWin::draw_segment(pe_ustring *s)
-{
-    uString::iterator i;
+    int i;
     int caret_pos = mConvdisp->get_caret_pos();
+    std::vector<glyph_extent> ext(s->len);
 
-    for (i = s->s.begin(); i != s->s.end(); ++i) {
-	uchar ch = *i;
-	int width = get_char_width(ch);
+    if (s->len > 0)
+	get_extents(&p->str[s->first], s->len, &ext[0]);
+
+    for (i = s->first; i < s->first + s->len; i++) {
+	uchar ch = p->str[i];
+	int width = ext[i - s->first].width;
 	draw_char(m_x, PE_LINE_WIN_FONT_POS_Y, ch, s->stat);
 	mCharPos++;
 
@@ -764,25 +856,28 @@ void PeLineWin::draw_segment(pe_ustring *s)
     }
 }
 
-int PeLineWin::calc_segment_extent(pe_ustring *s)
+int PeLineWin::calc_segment_extent(pe_stat *p, pe_segment *s)
 {
     int width = 0;
-    uString::iterator i;
+    int i;
+    std::vector<glyph_extent> ext(s->len);
+
+    if (s->len > 0)
+	get_extents(&p->str[s->first], s->len, &ext[0]);
+
+    for (i = 0; i < s->len; i++)
+	width += ext[i].width;
 
-    for (i = s->s.begin(); i != s->s.end(); ++i) {
-	uchar ch = *i;
-	width += get_char_width(ch);
-    }
     return width;
 }
 
 void PeLineWin::calc_extent(pe_stat *p)
 {
     int width = 0;
-    std::list<pe_ustring>::iterator i;
+    std::vector<pe_segment>::iterator i;
 
-    for (i = p->ustrings.begin(); i != p->ustrings.end(); ++i)
-	width += calc_segment_extent(&(*i));	
+    for (i = p->segments.begin(); i != p->segments.end(); ++i)
+	width += calc_segment_extent(p, &(*i));
 
     if (width < PE_LINE_WIN_WIDTH)
 	set_size(PE_LINE_WIN_WIDTH, PE_LINE_WIN_HEIGHT);
@@ -920,12 +1015,7 @@ void Convdisp::set_pe(pe_stat *p)
 
 uString Convdisp::get_pe()
 {
-    uString s;
-    std::list<pe_ustring>::iterator it;
-    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
-	append_ustring(&s, &(*it).s);
-    }
-    return s;
+    return m_pe->str;
 }
 
 void Convdisp::set_focus()
@@ -1409,16 +1499,12 @@ bool ConvdispOv::check_atr()
 
 void ConvdispOv::make_ce_array()
 {
-    std::list<pe_ustring>::iterator i;
-    uString::iterator j;
-    int s;
-    int c = 0;
-    for (i = m_pe->ustrings.begin(); i != m_pe->ustrings.end(); ++i) {
-	s = (*i).stat;
-	for (j = (*i).s.begin(); j != (*i).s.end(); ++j) {
-	    m_ce[c].c = *j;
-	    m_ce[c].stat = s;
-	    c++;
+    std::vector<pe_segment>::iterator i;
+    int j;
+    for (i = m_pe->segments.begin(); i != m_pe->segments.end(); ++i) {
+	for (j = (*i).first; j < (*i).first + (*i).len; j++) {
+	    m_ce[j].c = m_pe->str[j];
+	    m_ce[j].stat = (*i).stat;
 	}
     }
 }
@@ -1434,44 +1520,29 @@ void ConvdispOv::layoutCharEnt()
     x = m_atr->spot_location.x;
     y = m_atr->spot_location.y;
 
-    for (i = 0; i < m_ce_len; i++) {
-	uchar ch = m_ce[i].c;
+    // measure the whole preedit at once
+    std::vector<uchar> chs(m_ce_len);
+    std::vector<glyph_extent> ext(m_ce_len);
+    const void *font = m_atr->font_set;
+#if HAVE_XFT_UTF8_STRING
+    if (use_xft() == true)
+	font = m_ov_win->mXftFont;
+#endif
+    for (i = 0; i < m_ce_len; i++)
+	chs[i] = m_ce[i].c;
+    if (m_ce_len > 0)
+	get_glyph_extents(this, font, mEncoding, &chs[0], m_ce_len, &ext[0]);
 
-	char utf8[6];
-	int len;
+    for (i = 0; i < m_ce_len; i++) {
+	m_ce[i].width = ext[i].width;
 	if (use_xft() == true) {
 #if HAVE_XFT_UTF8_STRING
-	    len = utf8_wctomb((unsigned char *)utf8, ch);
-	    utf8[len] = '\0';
-
-	    XGlyphInfo ginfo;
-	    XftTextExtentsUtf8(XimServer::gDpy, m_ov_win->mXftFont, (unsigned char *)utf8, len, &ginfo);
-	    m_ce[i].width = ginfo.xOff;
 	    m_ce[i].height = m_ov_win->mXftFontSize;
 #endif
+	} else if (ext[i].valid) {
+	    m_ce[i].height = ext[i].height;
 	} else {
-	    XRectangle ink, logical;
-
-	    if (!strcmp(mEncoding, "UTF-8")) {
-		XwcTextExtents(m_atr->font_set, &ch, 1, &ink, &logical);
-		m_ce[i].width = logical.width;
-		m_ce[i].height = logical.height;
-	    } else {
-		len = utf8_wctomb((unsigned char *)utf8, ch);
-		utf8[len] = '\0';
-		XimIM *im = get_im_by_id(mKkContext->get_ic()->get_imid());
-		char *str = im->utf8_to_native_str(utf8);
-		if (!str) {
-		    logical.width = 0;
-		    logical.height = (unsigned short)((i > 0) ? m_ce[i - 1].height : 0);
-		} else {
-		    len = static_cast<int>(strlen(str));
-		    XmbTextExtents(m_atr->font_set, str, len, &ink, &logical);
-		    free(str);
-		}
-		m_ce[i].width = logical.width;
-		m_ce[i].height = logical.height;
-	    }
+	    m_ce[i].height = (i > 0) ? m_ce[i - 1].height : 0;
 	}
 
 	if (m_ce[i].width + x > right_limit) {
@@ -1550,6 +1621,8 @@ void ConvdispOs::update_preedit()
     TxPacket *t;
 
     int len, caret_pos;
+    int first, tail, common, chg_length, nr_added;
+    std::vector<C32> feedback;
     len = m_pe->get_char_count();
     caret_pos = m_pe->caret_pos;
 
@@ -1557,38 +1630,59 @@ void ConvdispOs::update_preedit()
 	return;
 
     if (mPrevLen == 0 && len) {
-	t = createTxPacket(XIM_PREEDIT_START, 0);
+	t = createTxPacket(XIM_PREEDIT_START, 0, mConn->byte_order());
 	t->pushC16(mImid);
 	t->pushC16(mIcid);
 	mConn->push_passive_packet(t);
     }
 
-    t = createTxPacket(XIM_PREEDIT_DRAW, 0);
-    t->pushC16(mImid);
-    t->pushC16(mIcid);
-    t->pushC32(caret_pos);// caret
-    t->pushC32(0); // chg_first
-    t->pushC32(mPrevLen); // chg_length
+    // Only the range that differs from the preedit previously drawn is
+    // sent, as a replacement of chg_length characters at chg_first.
+    make_feedback_array(&feedback);
+    common = (mPrevLen < len) ? mPrevLen : len;
+    for (first = 0; first < common; first++) {
+	if (mPrevStr[first] != m_pe->str[first] ||
+	    mPrevFeedback[first] != feedback[first])
+	    break;
+    }
+    for (tail = 0; tail < common - first; tail++) {
+	if (mPrevStr[mPrevLen - 1 - tail] != m_pe->str[len - 1 - tail] ||
+	    mPrevFeedback[mPrevLen - 1 - tail] != feedback[len - 1 - tail])
+	    break;
+    }
+    chg_length = mPrevLen - first - tail;
+    nr_added = len - first - tail;
 
-    if (!m_pe->ustrings.empty())
-	t->pushC32(0);
-    else
-	t->pushC32(3);
-  
-    compose_preedit_array(t);
-    compose_feedback_array(t);
-    mConn->push_passive_packet(t);
+    if (chg_length || nr_added) {
+	t = createTxPacket(XIM_PREEDIT_DRAW, 0, mConn->byte_order());
+	t->pushC16(mImid);
+	t->pushC16(mIcid);
+	t->pushC32(caret_pos);// caret
+	t->pushC32(first); // chg_first
+	t->pushC32(chg_length); // chg_length
+
+	if (nr_added)
+	    t->pushC32(0);
+	else
+	    t->pushC32(3);
+
+	compose_preedit_array(t, first, nr_added);
+	compose_feedback_array(t, &feedback, first, nr_added);
+	mConn->push_passive_packet(t);
+    }
 
     if (mPrevLen && len == 0) {
-	t = createTxPacket(XIM_PREEDIT_DONE, 0);
+	t = createTxPacket(XIM_PREEDIT_DONE, 0, mConn->byte_order());
 	t->pushC16(mImid);
 	t->pushC16(mIcid);
 	mConn->push_passive_packet(t);
     }
     mPrevLen = len;
+    mPrevStr = m_pe->str;
+    mPrevFeedback.swap(feedback);
 
     if (len) {
-	t = createTxPacket(XIM_PREEDIT_CARET, 0);
+	t = createTxPacket(XIM_PREEDIT_CARET, 0, mConn->byte_order());
 	t->pushC16(mImid);
 	t->pushC16(mIcid);
 	t->pushC32(caret_pos);
@@ -1639,23 +1733,46 @@ void ConvdispOs::move_candwin()
 void ConvdispOs::clear_preedit()
 {
     mPrevLen = 0;
+    mPrevStr.clear();
+    mPrevFeedback.clear();
 }
 
 void ConvdispOs::update_icxatr()
 {
 }
 
-void ConvdispOs::compose_preedit_array(TxPacket *t)
+void ConvdispOs::make_feedback_array(std::vector<C32> *feedback)
 {
-    uString s;
-    std::list<pe_ustring>::iterator it;
-    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
-	append_ustring(&s, &(*it).s);
+    int stat, xstat;
+    std::vector<pe_segment>::iterator it;
+
+    feedback->reserve(m_pe->str.size());
+    for (it = m_pe->segments.begin(); it != m_pe->segments.end(); ++it) {
+	stat = (*it).stat;
+	xstat = FB_None;
+	if (stat & PE_REVERSE)
+	    xstat |= FB_Reverse;
+
+	if (stat & PE_UNDERLINE)
+	    xstat |= FB_Underline;
+
+	if (stat & PE_HILIGHT)
+	    xstat |= FB_Highlight;
+
+	feedback->insert(feedback->end(), (*it).len, xstat);
     }
+}
+
+void ConvdispOs::compose_preedit_array(TxPacket *t, int first, int len)
+{
+    uString s(m_pe->str.begin() + first, m_pe->str.begin() + first + len);
 
     XimIM *im = get_im_by_id(mKkContext->get_ic()->get_imid());
-    char *c = im->uStringToCtext(&s);
-    int i, len = 0;
+    char *c = NULL;
+    int i;
+    if (len)
+	c = im->uStringToCtext(&s);
+    len = 0;
     if (c)
 	len = static_cast<int>(strlen(c));
     t->pushC16((C16)len); // LENGTH
@@ -1669,30 +1786,15 @@ void ConvdispOs::compose_preedit_array(TxPacket *t)
     free(c);
 }
 
-void ConvdispOs::compose_feedback_array(TxPacket *t)
+void ConvdispOs::compose_feedback_array(TxPacket *t,
+					std::vector<C32> *feedback,
+					int first, int len)
 {
-    int i, len, stat, xstat;
-    len = m_pe->get_char_count();
+    int i;
     t->pushC16((C16)(len * 4));
     t->pushC16(0);
-    std::list<pe_ustring>::iterator it;
-    for (it = m_pe->ustrings.begin(); it != m_pe->ustrings.end(); ++it) {
-	len = static_cast<int>((*it).s.size());
-	stat = (*it).stat;
-	xstat = FB_None;
-	if (stat & PE_REVERSE)
-	    xstat |= FB_Reverse;
-
-	if (stat & PE_UNDERLINE)
-	    xstat |= FB_Underline;
-
-	if (stat & PE_HILIGHT)
-	    xstat |= FB_Highlight;
-
-	for (i = 0; i < len; i++) {
-	    t->pushC32(xstat);
-	}
-    }
+    for (i = first; i < first + len; i++)
+	t->pushC32((*feedback)[i]);
 }
 
 bool ConvdispOs::use_xft()
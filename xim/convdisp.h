@@ -73,6 +73,7 @@ protected:
 
 Convdisp *create_convdisp(int style, InputContext *, icxatr *, Connection *);
 XFontSet get_font_set(const char *name, const char *locale);
+void forget_glyph_extents(const void *font);
 
 #endif
 /*
@@ -251,6 +251,12 @@ helper_str_parse(char *str)
 	    (*it).second->customContext(custom, val);
 	}
 	return;
+    } else if (strcmp("custom_update_batch", line) == 0) {
+	std::map<Window, XimServer *>::iterator it;
+	for (it = XimServer::gServerMap.begin(); it != XimServer::gServerMap.end(); ++it) {
+	    (*it).second->customContexts(eol + 1);
+	}
+	return;
     } else if (strcmp("custom_reload_notify", line) == 0) {
 	std::map<Window, XimServer *>::iterator it;
 	for (it = XimServer::gServerMap.begin(); it != XimServer::gServerMap.end(); ++it) {
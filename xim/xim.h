@@ -62,9 +62,10 @@ public:
     virtual ~TxPacket() {};
 
     virtual int get_length() = 0;
-    virtual int write_to_buf(unsigned char *buf, int buflen, int byte_order) = 0;
+    // the whole packet including its header, get_length() bytes
+    virtual const unsigned char *get_data() = 0;
 
-    virtual void dump(int byte_order) = 0;
+    virtual void dump() = 0;
     virtual C8 get_major() = 0;
 
     virtual int pushC8(C8) = 0;
@@ -72,8 +73,6 @@ public:
     virtual int pushC32(C32) = 0;
     virtual int pushSTRING(char *) = 0;
     virtual int pushBytes(const char *, int) = 0;
-
-    virtual int pop_back() = 0;
 };
 
 class RxPacket {
@@ -98,7 +97,8 @@ public:
     static int getPacketLength(unsigned char *, int byte_order);
 };
 
-TxPacket *createTxPacket(C8 major, C8 minor);
+TxPacket *createTxPacket(C8 major, C8 minor, int byte_order);
+// the packet refers to buf, which must outlive it
 RxPacket *createRxPacket(unsigned char *buf, int byte_order);
 RxPacket *copyRxPacket(RxPacket *packet);
 
@@ -198,7 +198,8 @@ public:
     struct input_style *getInputStyles();
     // for Compose
     void create_compose_tree();
-    DefTree *get_compose_tree();
+    uim_x_compose_table *get_compose_tree();
+    void ParseComposeStringFile(uim_x_compose_builder *builder, FILE *fp);
 
 protected:
     Connection *mConn;
@@ -210,11 +211,10 @@ protected:
     // for Compose
     int get_compose_filename(char *filename, size_t len);
     int TransFileName(char *transname, const char *name, size_t len);
-    void ParseComposeStringFile(FILE *fp);
-    void FreeComposeTree(DefTree *top);
-    int parse_compose_line(FILE *fp, char **tokenbuf, size_t *buflen);
+    int parse_compose_line(uim_x_compose_builder *builder, FILE *fp,
+			   char **tokenbuf, size_t *buflen);
     int get_mb_string(char *buf, KeySym ks);
-    DefTree *mTreeTop;
+    uim_x_compose_table *mComposeTable;
 };
 
 C16 unused_im_id();
@@ -107,6 +107,7 @@ release_font_set(const char *name, const char *locale)
 	if (!strcmp(it->name, name) && !strcmp(it->locale, locale)) {
 	    it->refc--;
 	    if (!it->refc) {
+		forget_glyph_extents(it->fs);
 		XFreeFontSet(XimServer::gDpy, it->fs);
 		free(it->name);
 		free(it->locale);
@@ -125,34 +126,30 @@ pe_stat::pe_stat(InputContext *c)
 
 void pe_stat::clear()
 {
-    ustrings.erase(ustrings.begin(), ustrings.end());
+    // keeps the capacity for the next preedit
+    str.clear();
+    segments.clear();
     caret_pos = 0;
 }
 
 void pe_stat::new_segment(int s)
 {
-    pe_ustring p;
+    pe_segment p;
+    p.first = static_cast<int>(str.size());
+    p.len = 0;
     p.stat = s;
-    ustrings.push_back(p);
+    segments.push_back(p);
 }
 
-void pe_stat::push_uchar(uchar c)
+void pe_stat::push_ustring(uString *s)
 {
-    std::list<pe_ustring>::reverse_iterator i = ustrings.rbegin();
-    (*i).s.push_back(c);
+    str.insert(str.end(), s->begin(), s->end());
+    segments.back().len += static_cast<int>(s->size());
 }
 
 int pe_stat::get_char_count()
 {
-    std::list<pe_ustring>::iterator i;
-    uString::iterator j;
-    int k = 0;
-    for (i = ustrings.begin(); i != ustrings.end(); ++i) {
-	for (j = (*i).s.begin(); j != (*i).s.end(); ++j) {
-	    k++;
-	}
-    }
-    return k;
+    return static_cast<int>(str.size());
 }
 
 icxatr::icxatr()
@@ -433,7 +430,7 @@ void XimIC::changeContext(const char *engine)
 void XimIC::send_key_event(XKeyEvent *e)
 {
     TxPacket *t;
-    t = createTxPacket(XIM_FORWARD_EVENT, 0);
+    t = createTxPacket(XIM_FORWARD_EVENT, 0, mConn->byte_order());
     t->pushC16(mIMid);
     t->pushC16(mICid);
     t->pushC16(1); // flag, synchronous
@@ -572,7 +569,7 @@ void XimIC::set_ic_attr(C16 id, C8 *val, int len)
 void XimIC::reset_ic()
 {
     TxPacket *t;
-    t = createTxPacket(XIM_RESET_IC_REPLY, 0);
+    t = createTxPacket(XIM_RESET_IC_REPLY, 0, mConn->byte_order());
     t->pushC16(mIMid);
     t->pushC16(mICid);
 
@@ -635,7 +632,7 @@ void XimIC::onSendPacket()
     }
 
     TxPacket *t;
-    t = createTxPacket(XIM_COMMIT, 0);
+    t = createTxPacket(XIM_COMMIT, 0, mConn->byte_order());
     t->pushC16(mIMid);
     t->pushC16(mICid);
 
@@ -132,7 +132,7 @@ void XimIM_impl::create_ic(RxPacket *p)
     m_ics.insert(n);
 
     TxPacket *t;
-    t = createTxPacket(XIM_CREATE_IC_REPLY, 0);
+    t = createTxPacket(XIM_CREATE_IC_REPLY, 0, mConn->byte_order());
     t->pushC16(mID);
     t->pushC16(ic->get_icid());
     mConn->push_packet(t);
@@ -141,7 +141,7 @@ void XimIM_impl::create_ic(RxPacket *p)
 void XimIM_impl::destroy_ic(C16 icid)
 {
     TxPacket *t;
-    t = createTxPacket(XIM_DESTROY_IC_REPLY, 0);
+    t = createTxPacket(XIM_DESTROY_IC_REPLY, 0, mConn->byte_order());
     t->pushC16(mID);
     t->pushC16(icid);
     mConn->push_packet(t);
@@ -184,7 +184,7 @@ void XimIM_impl::set_ic_values(RxPacket *p)
 
     ic->setICAttrs((void *)v, atr_len);
 
-    TxPacket *t = createTxPacket(XIM_SET_IC_VALUES_REPLY, 0);
+    TxPacket *t = createTxPacket(XIM_SET_IC_VALUES_REPLY, 0, mConn->byte_order());
     t->pushC16(imid);
     t->pushC16(icid);
     mConn->push_packet(t);
@@ -202,7 +202,7 @@ void XimIM_impl::get_ic_values(RxPacket *p)
     int len;
     len = p->getC16();
 
-    TxPacket *t = createTxPacket(XIM_GET_IC_VALUES_REPLY, 0);
+    TxPacket *t = createTxPacket(XIM_GET_IC_VALUES_REPLY, 0, mConn->byte_order());
     t->pushC16(mID);
     t->pushC16(icid);
     int i, l;
@@ -365,7 +365,7 @@ void XimIM_impl::delete_ic(XimIC *ic)
 
 void XimIM_impl::send_sync_reply(C16 icid)
 {
-    TxPacket *t = createTxPacket(XIM_SYNC_REPLY, 0);
+    TxPacket *t = createTxPacket(XIM_SYNC_REPLY, 0, mConn->byte_order());
     t->pushC16(mID);
     t->pushC16(icid);
     mConn->push_packet(t);
@@ -373,7 +373,7 @@ void XimIM_impl::send_sync_reply(C16 icid)
 
 void XimIM_impl::send_sync(C16 icid)
 {
-    TxPacket *t = createTxPacket(XIM_SYNC, 0);
+    TxPacket *t = createTxPacket(XIM_SYNC, 0, mConn->byte_order());
     t->pushC16(mID);
     t->pushC16(icid);
     mConn->push_packet(t);
@@ -393,7 +393,7 @@ XimIM::XimIM(Connection *c, C16 id)
     mID = id;
     mEncoding = NULL;
     mLangRegion = NULL;
-    mTreeTop = NULL;
+    mComposeTable = NULL;
     mLocale = NULL;
 }
 
@@ -401,24 +401,10 @@ XimIM::~XimIM()
 {
     free(mEncoding);
     free(mLangRegion);
-    FreeComposeTree(mTreeTop);
+    uim_x_compose_table_close(mComposeTable);
     delete mLocale;
 }
 
-void XimIM::FreeComposeTree(DefTree *top)
-{
-   if (!top)
-	return;
-
-   if (top->succession)
-	FreeComposeTree(top->succession);
-   if (top->next)
-	FreeComposeTree(top->next);
-   free(top->mb);
-   free(top->utf8);
-   free(top);
-}
-
 void XimIM::set_encoding(const char *encoding)
 {
     free(mEncoding);
@@ -37,7 +37,6 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <list>
 
 #include "xim.h"
 #include "util.h"
@@ -115,121 +114,20 @@ C32 readC32(unsigned char *buf, int byte_order)
 // TxPacket
 //
 
-class TxElement{
-public:
-    virtual ~TxElement() {};
-    virtual int get_size() = 0;
-    virtual int write_to_buf(unsigned char *buf, int byte_order) = 0;
-};
-
-class TxC8 : public TxElement {
-public:
-    TxC8(C8 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 1;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC8(val, bo, buf);
-	return 1;
-    }
-private:
-    C8 val;
-};
-
-class TxC16 : public TxElement {
-public:
-    TxC16(C16 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 2;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC16(val, bo, buf);
-	return 2;
-    }
-private:
-    C16 val;
-};
-
-class TxC32 : public TxElement {
-public:
-    TxC32(C32 v) {
-	val = v;
-    }
-    virtual int get_size() {
-	return 4;
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC32(val, bo, buf);
-	return 4;
-    }
-private:
-    C32 val;
-};
-
-class TxString : public TxElement {
-public:
-    TxString(char *s) {
-	init(s, static_cast<int>(strlen(s)));
-    }
-    TxString(char *s, int len) {
-	init(s, static_cast<int>(len));
-    }
-    virtual ~TxString() {
-	free(m_str);
-    }
-    virtual int get_size() {
-	return 2 + m_len + pad4(2 + m_len);
-    }
-    virtual int write_to_buf(unsigned char *buf, int bo) {
-	writeC16((C16)m_len, bo, buf);
-	memcpy(&buf[2], m_str, m_len);
-	return get_size();
-    }
-private:
-    void init(char *s, int len) {
-	m_len = len;
-	m_str = (char *)malloc(len + 1);
-	strlcpy(m_str, s, len + 1);
-    }
-    int m_len;
-    char *m_str;
-};
-
-class TxBytes : public TxElement {
-public:
-    TxBytes(const char *s, int len) {
-	m_str = (char *)malloc(len);
-	m_len = len;
-	memcpy(m_str, s, len);
-    };
-    virtual ~TxBytes() {
-	free(m_str);
-    }
-    virtual int get_size() {
-	return m_len;
-    }
-    virtual int write_to_buf(unsigned char *buf, int /* bo */) {
-	memcpy(buf, m_str, m_len);
-	return get_size();
-    }
-private:
-    int m_len;
-    char *m_str;
-};
+// Elements are serialized into one buffer in the byte order of the
+// connection as they are pushed, so sending a packet needs no further
+// conversion.  Most packets fit in the inline storage.
+#define TX_INLINE_SIZE 64
 
 class TxPacket_impl : public TxPacket {
 public:
-    TxPacket_impl(C8 major, C8 minor);
+    TxPacket_impl(C8 major, C8 minor, int byte_order);
     virtual ~TxPacket_impl();
 
     virtual int get_length();
-    virtual int write_to_buf(unsigned char *buf, int buflen, int byte_order);
+    virtual const unsigned char *get_data();
 
-    virtual void dump(int byte_order);
+    virtual void dump();
     virtual C8 get_major();
 
     virtual int pushC8(C8);
@@ -237,134 +135,115 @@ public:
     virtual int pushC32(C32);
     virtual int pushSTRING(char *);
     virtual int pushBytes(const char *, int);
-
-    virtual int pop_back();
 private:
-    void write_header(unsigned char *buf, int l, int byte_order);
-    C8 m_major, m_minor;
-    std::list <TxElement *> m_elms;
+    unsigned char *extend(int len);
+    int m_byte_order;
+    unsigned char *m_buf;
+    int m_len;
+    int m_size;
+    unsigned char m_inline[TX_INLINE_SIZE];
 };
 
-TxPacket_impl::TxPacket_impl(C8 major, C8 minor)
+TxPacket_impl::TxPacket_impl(C8 major, C8 minor, int byte_order)
 {
-    m_major = major;
-    m_minor = minor;
+    m_byte_order = byte_order;
+    m_buf = m_inline;
+    m_size = TX_INLINE_SIZE;
+    m_len = 4; // header is written by get_data()
+    m_buf[0] = major;
+    m_buf[1] = minor;
 }
 
 TxPacket_impl::~TxPacket_impl()
 {
-    std::list<TxElement *>::iterator i;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	delete *i;
+    if (m_buf != m_inline)
+	free(m_buf);
+}
+
+unsigned char *TxPacket_impl::extend(int len)
+{
+    unsigned char *p;
+
+    if (m_len + len > m_size) {
+	while (m_len + len > m_size)
+	    m_size *= 2;
+	if (m_buf == m_inline) {
+	    m_buf = (unsigned char *)malloc(m_size);
+	    memcpy(m_buf, m_inline, m_len);
+	} else {
+	    m_buf = (unsigned char *)realloc(m_buf, m_size);
+	}
     }
+    p = &m_buf[m_len];
+    m_len += len;
+    return p;
 }
 
 int TxPacket_impl::get_length()
 {
-    std::list<TxElement *>::iterator i;
-    int l;
-    l = 4;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	l +=  (*i)->get_size();
-    }  
-    return l;
+    return rup4(m_len);
 }
 
-int TxPacket_impl::write_to_buf(unsigned char *buf, int buflen, int byte_order)
+const unsigned char *TxPacket_impl::get_data()
 {
-    std::list<TxElement *>::iterator i;
-    int l, m;
-    l = 4;
-    for (i = m_elms.begin(); i != m_elms.end(); ++i) {
-	m = (*i)->get_size();
-	if (l + m > buflen)
-	    return 0;
+    int l = rup4(m_len);
 
-	m = (*i)->write_to_buf(&buf[l], byte_order);
-	l += m;
-    }
-    l = rup4(l);
-    write_header(buf, l, byte_order);
-    return l;
+    if (l > m_len)
+	memset(extend(l - m_len), 0, l - m_len);
+    writeC16((C16)(l / 4 - 1), m_byte_order, &m_buf[2]);
+    return m_buf;
 }
 
 int TxPacket_impl::pushC8(C8 v)
 {
-    TxElement *e;
-    e = new TxC8(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC8(v, m_byte_order, extend(1));
+    return 1;
 }
 
 int TxPacket_impl::pushC16(C16 v)
 {
-    TxElement *e;
-    e = new TxC16(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC16(v, m_byte_order, extend(2));
+    return 2;
 }
 
 int TxPacket_impl::pushC32(C32 v)
 {
-    TxElement *e;
-    e = new TxC32(v);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC32(v, m_byte_order, extend(4));
+    return 4;
 }
 
 int TxPacket_impl::pushSTRING(char *s)
 {
-    TxElement *e;
-    e = new TxString(s);
-    m_elms.push_back(e);
-    return e->get_size();
-}
+    int len = static_cast<int>(strlen(s));
+    int size = 2 + len + pad4(2 + len);
+    unsigned char *p = extend(size);
 
-int TxPacket_impl::pushBytes(const char *b, int len)
-{
-    TxElement *e;
-    e = new TxBytes(b, len);
-    m_elms.push_back(e);
-    return e->get_size();
+    writeC16((C16)len, m_byte_order, p);
+    memcpy(&p[2], s, len);
+    memset(&p[2 + len], 0, size - 2 - len);
+    return size;
 }
 
-int TxPacket_impl::pop_back()
+int TxPacket_impl::pushBytes(const char *b, int len)
 {
-    int len;
-    TxElement *e;
-    e = m_elms.back();
-    len = e->get_size();
-    delete e;
-    m_elms.pop_back();
+    memcpy(extend(len), b, len);
     return len;
 }
 
-void TxPacket_impl::write_header(unsigned char *buf, int l, int byte_order)
+void TxPacket_impl::dump()
 {
-    buf[0] = m_major;
-    buf[1] = m_minor;
-    writeC16((C16)(l / 4 - 1), byte_order, &buf[2]);
-}
-
-void TxPacket_impl::dump(int byte_order)
-{
-    unsigned char *buf;
-    int len;
-    len = get_length();
-    buf = (unsigned char *)malloc(len);
-    write_to_buf(buf, len, byte_order);
-    hex_dump(buf, len);
-    free(buf);
+    int len = get_length();
+    hex_dump((unsigned char *)get_data(), len);
 }
 
 C8 TxPacket_impl::get_major()
 {
-    return m_major;
+    return m_buf[0];
 }
 
-TxPacket *createTxPacket(C8 major, C8 minor)
+TxPacket *createTxPacket(C8 major, C8 minor, int byte_order)
 {
-    return new TxPacket_impl(major, minor);
+    return new TxPacket_impl(major, minor, byte_order);
 }
 
 //
@@ -397,16 +276,18 @@ private:
     bool canRead(int);
     int mLen;
     unsigned char *mBuf;
+    bool mOwnBuf;
     int mIndex;
     int mByteOrder;
     bool mIsOverRun;
 };
 
+// The packet is read in place; b must stay valid while it is used.
 RxPacket_impl::RxPacket_impl(unsigned char *b, int byte_order)
 {
     mLen = getPacketLength(b, byte_order);
-    mBuf = (unsigned char *)malloc(mLen);
-    memcpy(mBuf, b, mLen);
+    mBuf = b;
+    mOwnBuf = false;
     mByteOrder = byte_order;
     rewind();
 }
@@ -416,6 +297,7 @@ RxPacket_impl::RxPacket_impl(const RxPacket_impl& rhs) : RxPacket(rhs)
     mLen = rhs.mLen;
     mBuf = (unsigned char *)malloc(mLen);
     memcpy(mBuf, rhs.mBuf, mLen);
+    mOwnBuf = true;
     mIndex = rhs.mIndex;
     mByteOrder = rhs.mByteOrder;
     mIsOverRun = rhs.mIsOverRun;
@@ -423,7 +305,8 @@ RxPacket_impl::RxPacket_impl(const RxPacket_impl& rhs) : RxPacket(rhs)
 
 RxPacket_impl::~RxPacket_impl()
 {
-    free(mBuf);
+    if (mOwnBuf)
+	free(mBuf);
 }
 
 void RxPacket_impl::rewind()
@@ -112,10 +112,7 @@ void erase_ustring(uString *s)
 
 void append_ustring(uString *d, uString *s)
 {
-    uString::iterator i;
-    for (i = s->begin(); i !=s->end(); ++i) {
-	d->push_back(*i);
-    }
+    d->insert(d->end(), s->begin(), s->end());
 }
 
 XimServer::XimServer(const char *name, const char *lang)
@@ -161,6 +158,31 @@ void XimServer::customContext(const char *custom, const char *val) {
 	break;
     }
 
+    customUpdated(custom, val);
+}
+
+void XimServer::customContexts(const char *customs) {
+    std::list<InputContext *>::iterator it;
+    for (it = ic_list.begin(); it != ic_list.end(); ++it) {
+	(*it)->customContexts(customs);
+	break;
+    }
+
+    char *buf = strdup(customs);
+    char *custom, *val, *eol;
+    for (custom = buf; (eol = strchr(custom, '\n')) && eol != custom;
+	 custom = eol + 1) {
+	*eol = '\0';
+	val = eol + 1;
+	if (!(eol = strchr(val, '\n')))
+	    break;
+	*eol = '\0';
+	customUpdated(custom, val);
+    }
+    free(buf);
+}
+
+void XimServer::customUpdated(const char *custom, const char *val) {
     // Updated global IM of XimServer
     if (!strcmp(custom, "custom-preserved-default-im-name") &&
 	uim_scm_symbol_value_bool("custom-activate-default-im-name?"))
@@ -553,6 +575,12 @@ InputContext::customContext(const char *custom, const char *val)
     uim_prop_update_custom(mUc, custom, val);
 }
 
+void
+InputContext::customContexts(const char *customs)
+{
+    uim_prop_update_customs(mUc, customs);
+}
+
 InputContext *
 InputContext::focusedContext()
 {
@@ -757,11 +785,7 @@ void InputContext::pushback_preedit_string(int attr, const char *str)
     m_pe->new_segment(p);
     uString js;
     mServer->strToUstring(&js, str);
-
-    uString::iterator it;
-    for (it = js.begin(); it != js.end(); ++it) {
-	m_pe->push_uchar(*it);
-    }
+    m_pe->push_ustring(&js);
 }
 
 void InputContext::update_preedit()
@@ -1227,15 +1251,15 @@ bool InputContext::isCaretStateShown()
 keyState::keyState(XimIC *ic)
 {
     XimIM *im;
-    DefTree *top;
+    uim_x_compose_table *table;
 
     mModState = 0;
     mIc = ic;
 
     im = get_im_by_id(mIc->get_imid());
-    top = im->get_compose_tree();
+    table = im->get_compose_tree();
 
-    mCompose = new Compose(top, mIc);
+    mCompose = new Compose(table, mIc);
 }
 
 keyState::~keyState()
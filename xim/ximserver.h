@@ -54,12 +54,14 @@
 #define PE_HILIGHT 4
 
 typedef wchar_t uchar;
-typedef std::list<uchar> uString;
+typedef std::vector<uchar> uString;
 #if UIM_XIM_USE_NEW_PAGE_HANDLING
 typedef std::vector<const char *> CandList;
 #endif
-struct pe_ustring {
-    uString s;
+// a run of characters in pe_stat::str drawn with the same ornament
+struct pe_segment {
+    int first;
+    int len;
     int stat;
 };
 typedef enum {
@@ -82,10 +84,11 @@ public:
     pe_stat(class InputContext *);
     void clear();
     void new_segment(int s);
-    void push_uchar(uchar);
+    void push_ustring(uString *);
     int get_char_count();
     int caret_pos;
-    std::list<pe_ustring> ustrings; // separated with segments
+    uString str; // whole preedit string
+    std::vector<pe_segment> segments; // index into str
     class InputContext *cont;
 };
 
@@ -201,6 +204,7 @@ public:
     const char *get_locale_name();
     void changeContext(const char *engine);
     void customContext(const char *custom, const char *val);
+    void customContexts(const char *customs);
     void createUimContext(const char *engine);
     void configuration_changed();
     void switch_app_global_im(const char *name);
@@ -291,6 +295,7 @@ public:
     void set_im(const char *name);
     void changeContext(const char *engine);
     void customContext(const char *custom, const char *val);
+    void customContexts(const char *customs);
     void reloadConfigs();
     std::list<InputContext *> ic_list;
 public:
@@ -301,6 +306,7 @@ public:
     static CandWinStyle gCandWinStyle;
     static bool gCandWinStyleUpdated;
 private:
+    void customUpdated(const char *custom, const char *val);
     Window mSelectionWin;
     Atom mServerAtom;
     char *mIMName;
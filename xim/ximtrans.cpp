@@ -353,7 +353,7 @@ void Connection::push_passive_packet(TxPacket *p)
 void Connection::push_error_packet(C16 imid, C16 icid, C16 er, const char *str)
 {
     TxPacket *t;
-    t = createTxPacket(XIM_ERROR, 0);
+    t = createTxPacket(XIM_ERROR, 0, mByteorder);
     t->pushC16(imid);
     t->pushC16(icid);
     int m = 0;
@@ -463,7 +463,7 @@ void Connection::xim_connect(RxPacket *p)
 	return;
     }
 
-    t = createTxPacket(XIM_CONNECT_REPLY, 0);
+    t = createTxPacket(XIM_CONNECT_REPLY, 0, mByteorder);
     t->pushC16(1);
     t->pushC16(0);
     push_packet(t);
@@ -474,7 +474,7 @@ void Connection::xim_connect(RxPacket *p)
 void Connection::xim_disconnect()
 {
     TxPacket *t;
-    t = createTxPacket(XIM_DISCONNECT_REPLY, 0);
+    t = createTxPacket(XIM_DISCONNECT_REPLY, 0, mByteorder);
     push_packet(t);
 
     terminate();
@@ -503,7 +503,7 @@ void Connection::xim_open(RxPacket *p)
     mCreatedIm.push_back(imid); // had to be deleted by the creator Connection
     im = create_im(this, imid);
     im->set_lang_region(buf);
-    t = createTxPacket(XIM_OPEN_REPLY, 0);
+    t = createTxPacket(XIM_OPEN_REPLY, 0, mByteorder);
     t->pushC16(imid);
     XIMATTRIBUTE::write_imattr_to_packet(t);
     XICATTRIBUTE::write_icattr_to_packet(t);
@@ -512,7 +512,7 @@ void Connection::xim_open(RxPacket *p)
 
     // EventMask selection
 
-    t = createTxPacket(XIM_SET_EVENT_MASK, 0);
+    t = createTxPacket(XIM_SET_EVENT_MASK, 0, mByteorder);
     t->pushC16(imid);
     t->pushC16(0);
     if (g_option_mask & OPT_ON_DEMAND_SYNC) {
@@ -533,7 +533,7 @@ void Connection::xim_close(RxPacket *p)
     C16 imid;
     imid = p->getC16();
     TxPacket *t;
-    t = createTxPacket(XIM_CLOSE_REPLY, 0);
+    t = createTxPacket(XIM_CLOSE_REPLY, 0, mByteorder);
     t->pushC16(imid);
     t->pushC16(0);
     push_packet(t);
@@ -553,7 +553,7 @@ void Connection::xim_query_extension(RxPacket *p)
     imid = p->getC16();
 
     TxPacket *t;
-    t = createTxPacket(XIM_QUERY_EXTENSION_REPLY, 0);
+    t = createTxPacket(XIM_QUERY_EXTENSION_REPLY, 0, mByteorder);
     t->pushC16(imid);
     t->pushC16(0);
   
@@ -563,7 +563,7 @@ void Connection::xim_query_extension(RxPacket *p)
 void Connection::xim_encoding_negotiation(RxPacket *p)
 {
     TxPacket *t;
-    t = createTxPacket(XIM_ENCODING_NEGOTIATION_REPLY, 0);
+    t = createTxPacket(XIM_ENCODING_NEGOTIATION_REPLY, 0, mByteorder);
     C16 l, index;
     int i, m, s;
     C16 imid, idx;
@@ -604,7 +604,7 @@ void Connection::xim_get_im_values(RxPacket *p)
     int l, i;
     C16 imid;
     TxPacket *t;
-    t = createTxPacket(XIM_GET_IM_VALUES_REPLY, 0);
+    t = createTxPacket(XIM_GET_IM_VALUES_REPLY, 0, mByteorder);
     imid = p->getC16(); // input-method id
     l = p->getC16() / 2; // number
 